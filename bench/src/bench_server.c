@@ -0,0 +1,428 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ServerSocket_api.h"
+#include "GetOptions_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/***************************************/
+/********** Private constants **********/
+/***************************************/
+
+#define BENCH_SERVER_LOG_BUFFER_SIZE        10000
+#define BENCH_SERVER_LOG_INIT_MASK          0x00    // Logs disabled, so they do not distort measurements.
+
+#define BENCH_SERVER_LEN_RX_BUFFER          16384
+#define BENCH_SERVER_MAX_RESPONSE_SIZE      65536
+#define BENCH_SERVER_REQUEST_DELIMITER      '\n'
+#define BENCH_SERVER_COMPRESS_MIN_SIZE      128     // Same as the library's default.
+#define BENCH_SERVER_NS_PER_S               1000000000UL
+#define BENCH_SERVER_BROADCAST_MIN_SIZE     ((int)sizeof(unsigned long))    // Send timestamp.
+#define BENCH_SERVER_BROADCAST_DEFAULT_SIZE 64
+#define BENCH_SERVER_BROADCAST_MAX_QUEUED   (1024 * 1024UL)
+#define BENCH_SERVER_BROADCAST_STACK_SIZE   (SERVER_SOCKET_MIN_STACK_SIZE + 2 * BENCH_SERVER_LEN_RX_BUFFER)
+
+/************ Port settings ************/
+
+#define PORT_OPT_CHAR                       'r'
+#define PORT_OPT_LONG                       "Port"
+#define PORT_OPT_DETAIL                     "Server port."
+#define PORT_MIN_VALUE                      49152
+#define PORT_MAX_VALUE                      65535
+#define PORT_DEFAULT_VALUE                  50000
+
+/********* Connection settings *********/
+
+#define CLIENTS_OPT_CHAR                    'm'
+#define CLIENTS_OPT_LONG                    "Clients"
+#define CLIENTS_OPT_DETAIL                  "Maximum number of clients."
+#define CLIENTS_MIN_VALUE                   1
+#define CLIENTS_MAX_VALUE                   65536
+#define CLIENTS_DEFAULT_VALUE               1024
+
+/*********** Response size ***********/
+
+#define RESPONSE_SIZE_OPT_CHAR              'z'
+#define RESPONSE_SIZE_OPT_LONG              "ResponseSize"
+#define RESPONSE_SIZE_OPT_DETAIL            "Bytes sent back per newline-terminated request (0 echoes data back)."
+#define RESPONSE_SIZE_MIN_VALUE             0
+#define RESPONSE_SIZE_MAX_VALUE             BENCH_SERVER_MAX_RESPONSE_SIZE
+#define RESPONSE_SIZE_DEFAULT_VALUE         0
+
+/********** Receive timeout (s) ******/
+
+#define RX_TIMEOUT_SECS_CHAR                't'
+#define RX_TIMEOUT_SECS_OPT_LONG            "RXTimeoutSecs"
+#define RX_TIMEOUT_SECS_OPT_DETAIL          "Receive Timeout in seconds."
+#define RX_TIMEOUT_SECS_MIN_VALUE           0
+#define RX_TIMEOUT_SECS_MAX_VALUE           3600    // 1 hour
+#define RX_TIMEOUT_SECS_DEFAULT_VALUE       1
+
+/********** Idle timeout (ms) ******/
+
+#define IDLE_TIMEOUT_MS_CHAR                'i'
+#define IDLE_TIMEOUT_MS_OPT_LONG            "IdleTimeoutMs"
+#define IDLE_TIMEOUT_MS_OPT_DETAIL          "Close clients idle for longer than this many milliseconds (0 disables it)."
+#define IDLE_TIMEOUT_MS_MIN_VALUE           0
+#define IDLE_TIMEOUT_MS_MAX_VALUE           3600000 // 1 hour
+#define IDLE_TIMEOUT_MS_DEFAULT_VALUE       0
+
+/********** Low-latency spin (us) ******/
+
+#define SPIN_US_CHAR                        'b'
+#define SPIN_US_OPT_LONG                    "SpinUs"
+#define SPIN_US_OPT_DETAIL                  "Low-latency mode: reads spin for this many microseconds before blocking (0 disables it)."
+#define SPIN_US_MIN_VALUE                   0
+#define SPIN_US_MAX_VALUE                   1000000 // 1 second
+#define SPIN_US_DEFAULT_VALUE               0
+
+/********* Compression level *********/
+
+#define COMPRESS_LEVEL_CHAR                 'e'
+#define COMPRESS_LEVEL_OPT_LONG             "CompressLevel"
+#define COMPRESS_LEVEL_OPT_DETAIL           "Compress every connection at this level (1 to 9), 0 disables it."
+#define COMPRESS_LEVEL_MIN_VALUE            0
+#define COMPRESS_LEVEL_MAX_VALUE            9
+#define COMPRESS_LEVEL_DEFAULT_VALUE        0
+
+/********** Broadcast period (us) ******/
+
+#define BROADCAST_US_CHAR                   'n'
+#define BROADCAST_US_OPT_LONG               "BroadcastUs"
+#define BROADCAST_US_OPT_DETAIL             "Fan-out: broadcast a timestamped message (ResponseSize bytes) to every client this often (0 disables it)."
+#define BROADCAST_US_MIN_VALUE              0
+#define BROADCAST_US_MAX_VALUE              10000000    // 10 seconds
+#define BROADCAST_US_DEFAULT_VALUE          0
+
+/********* Secure connection *********/
+
+#define SECURE_CONN_CHAR                    's'
+#define SECURE_CONN_LONG                    "Secure"
+#define SECURE_CONN_DETAIL                  "Secure connection."
+#define SECURE_CONN_DEFAULT_VALUE           false
+
+/********* Low-memory TLS *********/
+
+#define LOW_MEMORY_CHAR                     'l'
+#define LOW_MEMORY_LONG                     "LowMemory"
+#define LOW_MEMORY_DETAIL                   "TLS low-memory mode."
+#define LOW_MEMORY_DEFAULT_VALUE            false
+
+/************ Server certificate ************/
+
+#define CERT_OPT_CHAR                       'c'
+#define CERT_OPT_LONG                       "Certificate"
+#define CERT_OPT_DETAIL                     "Server certificate."
+#define CERT_DEFAULT_VALUE                  "~/C_Server_Socket/certificate_test/certificate.crt"
+
+/************ Server private key ************/
+
+#define PKEY_OPT_CHAR                       'k'
+#define PKEY_OPT_LONG                       "Key"
+#define PKEY_OPT_DETAIL                     "Server private key."
+#define PKEY_DEFAULT_VALUE                  "~/C_Server_Socket/certificate_test/private.key"
+
+/***************************************/
+
+/***************************************/
+/********** Private variables **********/
+/***************************************/
+
+static int response_size;
+static int compress_level;
+static int broadcast_us;
+static char response[BENCH_SERVER_MAX_RESPONSE_SIZE];
+
+/***************************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int BenchServerWriteAll(const int client_socket, const char* tx_buffer, const unsigned long tx_buffer_size);
+static void BenchServerFillText(char* buffer, const int size);
+static int BenchServerInteract(int client_socket);
+static void* BenchServerBroadcastRoutine(void* arg);
+
+/*************************************/
+
+/// @brief Constructor function. Inits logs.
+__attribute__((constructor)) static void BenchServerLoad(void)
+{
+    SeverityLogInitWithMask(BENCH_SERVER_LOG_BUFFER_SIZE, BENCH_SERVER_LOG_INIT_MASK);
+}
+
+/// @brief Fills a buffer with text-like data (words from a small set), so compression ratios are not meaningless.
+/// @param buffer Target buffer.
+/// @param size Buffer size.
+static void BenchServerFillText(char* buffer, const int size)
+{
+    const char* words[] = {"alpha", "beta", "gamma", "delta", "epsilon", "\"id\":", "\"name\":", "{", "}", "1234"};
+    unsigned int seed = 2;
+    int filled = 0;
+
+    while(filled < size)
+    {
+        const char* word = words[rand_r(&seed) % (sizeof(words) / sizeof(words[0]))];
+
+        for(int i = 0; word[i] != 0 && filled < size; i++)
+            buffer[filled++] = word[i];
+
+        if(filled < size)
+            buffer[filled++] = ' ';
+    }
+}
+
+/// @brief Writes the whole buffer, even if the underlying socket accepts it in several chunks.
+/// @param client_socket Client socket.
+/// @param tx_buffer TX buffer.
+/// @param tx_buffer_size TX buffer size.
+/// @return 0 if succeeded, < 0 otherwise.
+static int BenchServerWriteAll(const int client_socket, const char* tx_buffer, const unsigned long tx_buffer_size)
+{
+    unsigned long written = 0;
+
+    while(written < tx_buffer_size)
+    {
+        int write_to_socket = ServerSocketWrite(client_socket, tx_buffer + written, tx_buffer_size - written);
+
+        if(write_to_socket <= 0)
+            return -1;
+
+        written += write_to_socket;
+    }
+
+    return 0;
+}
+
+/// @brief Echoes every read chunk back, or answers each newline-terminated request with a fixed-size response.
+/// @param client_socket Client socket.
+/// @return > 0 while the client keeps the connection open, 0 otherwise.
+static int BenchServerInteract(int client_socket)
+{
+    char rx_buffer[BENCH_SERVER_LEN_RX_BUFFER];
+
+    // Every connection is a low-latency one if spinning is enabled (it does nothing otherwise).
+    ServerSocketEnableLowLatency(client_socket);
+
+    // The load generator compresses from the start, so no negotiation takes place.
+    if(compress_level > 0 && ServerSocketEnableCompression(client_socket, SERVER_SOCKET_COMPRESSION_DEFLATE) < 0)
+        return 0;
+
+    errno = 0;
+    int read_from_socket = SERVER_SOCKET_READ(client_socket, rx_buffer);
+
+    // Receive timeouts just mean the client is idle.
+    if(read_from_socket < 0)
+        return (errno == 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+
+    if(read_from_socket == 0)
+        return 0;
+
+    if(response_size == 0)
+        return (BenchServerWriteAll(client_socket, rx_buffer, read_from_socket) == 0);
+
+    for(int i = 0; i < read_from_socket; i++)
+        if(rx_buffer[i] == BENCH_SERVER_REQUEST_DELIMITER)
+            if(BenchServerWriteAll(client_socket, response, response_size) < 0)
+                return 0;
+
+    return 1;
+}
+
+/// @brief Fan-out workload: broadcasts a message to every client periodically, its first bytes being the time it was sent at
+/// (CLOCK_MONOTONIC nanoseconds), so the load generator can tell how long each client took to get it.
+/// @param arg Unused.
+/// @return NULL.
+static void* BenchServerBroadcastRoutine(void* arg)
+{
+    char message[BENCH_SERVER_MAX_RESPONSE_SIZE];
+    int message_size = (response_size >= BENCH_SERVER_BROADCAST_MIN_SIZE ? response_size : BENCH_SERVER_BROADCAST_DEFAULT_SIZE);
+
+    memcpy(message, response, message_size);
+
+    while(true)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        unsigned long now_ns = now.tv_sec * BENCH_SERVER_NS_PER_S + now.tv_nsec;
+        memcpy(message, &now_ns, sizeof(now_ns));
+
+        SERVER_SOCKET_BUFFER* p_buffer = ServerSocketBufferCreate(message, message_size);
+
+        if(p_buffer)
+        {
+            ServerSocketBroadcast(p_buffer, NULL, 0);
+            ServerSocketBufferRelease(p_buffer);
+        }
+
+        usleep(broadcast_us);
+    }
+
+    return NULL;
+}
+
+/*
+@brief Main function. Program's entry point.
+*/
+int main(int argc, char** argv)
+{
+    int server_port             ;
+    int max_clients_num         ;
+    int rx_timeout_s            ;
+    int idle_timeout_ms         ;
+    int spin_us                 ;
+    bool secure_connection      ;
+    bool low_memory             ;
+    char* path_cert = calloc(100, 1);
+    char* path_pkey = calloc(100, 1);
+
+    SetOptionDefinitionInt(     PORT_OPT_CHAR                       ,
+                                PORT_OPT_LONG                       ,
+                                PORT_OPT_DETAIL                     ,
+                                PORT_MIN_VALUE                      ,
+                                PORT_MAX_VALUE                      ,
+                                PORT_DEFAULT_VALUE                  ,
+                                &server_port                        );
+
+    SetOptionDefinitionInt(     CLIENTS_OPT_CHAR                    ,
+                                CLIENTS_OPT_LONG                    ,
+                                CLIENTS_OPT_DETAIL                  ,
+                                CLIENTS_MIN_VALUE                   ,
+                                CLIENTS_MAX_VALUE                   ,
+                                CLIENTS_DEFAULT_VALUE               ,
+                                &max_clients_num                    );
+
+    SetOptionDefinitionInt(     RESPONSE_SIZE_OPT_CHAR              ,
+                                RESPONSE_SIZE_OPT_LONG              ,
+                                RESPONSE_SIZE_OPT_DETAIL            ,
+                                RESPONSE_SIZE_MIN_VALUE             ,
+                                RESPONSE_SIZE_MAX_VALUE             ,
+                                RESPONSE_SIZE_DEFAULT_VALUE         ,
+                                &response_size                      );
+
+    SetOptionDefinitionInt(     RX_TIMEOUT_SECS_CHAR                ,
+                                RX_TIMEOUT_SECS_OPT_LONG            ,
+                                RX_TIMEOUT_SECS_OPT_DETAIL          ,
+                                RX_TIMEOUT_SECS_MIN_VALUE           ,
+                                RX_TIMEOUT_SECS_MAX_VALUE           ,
+                                RX_TIMEOUT_SECS_DEFAULT_VALUE       ,
+                                &rx_timeout_s                       );
+
+    SetOptionDefinitionInt(     IDLE_TIMEOUT_MS_CHAR                ,
+                                IDLE_TIMEOUT_MS_OPT_LONG            ,
+                                IDLE_TIMEOUT_MS_OPT_DETAIL          ,
+                                IDLE_TIMEOUT_MS_MIN_VALUE           ,
+                                IDLE_TIMEOUT_MS_MAX_VALUE           ,
+                                IDLE_TIMEOUT_MS_DEFAULT_VALUE       ,
+                                &idle_timeout_ms                    );
+
+    SetOptionDefinitionInt(     SPIN_US_CHAR                        ,
+                                SPIN_US_OPT_LONG                    ,
+                                SPIN_US_OPT_DETAIL                  ,
+                                SPIN_US_MIN_VALUE                   ,
+                                SPIN_US_MAX_VALUE                   ,
+                                SPIN_US_DEFAULT_VALUE               ,
+                                &spin_us                            );
+
+    SetOptionDefinitionInt(     COMPRESS_LEVEL_CHAR                 ,
+                                COMPRESS_LEVEL_OPT_LONG             ,
+                                COMPRESS_LEVEL_OPT_DETAIL           ,
+                                COMPRESS_LEVEL_MIN_VALUE            ,
+                                COMPRESS_LEVEL_MAX_VALUE            ,
+                                COMPRESS_LEVEL_DEFAULT_VALUE        ,
+                                &compress_level                     );
+
+    SetOptionDefinitionInt(     BROADCAST_US_CHAR                   ,
+                                BROADCAST_US_OPT_LONG               ,
+                                BROADCAST_US_OPT_DETAIL             ,
+                                BROADCAST_US_MIN_VALUE              ,
+                                BROADCAST_US_MAX_VALUE              ,
+                                BROADCAST_US_DEFAULT_VALUE          ,
+                                &broadcast_us                       );
+
+    SetOptionDefinitionBool(    SECURE_CONN_CHAR                    ,
+                                SECURE_CONN_LONG                    ,
+                                SECURE_CONN_DETAIL                  ,
+                                SECURE_CONN_DEFAULT_VALUE           ,
+                                &secure_connection                  );
+
+    SetOptionDefinitionBool(    LOW_MEMORY_CHAR                     ,
+                                LOW_MEMORY_LONG                     ,
+                                LOW_MEMORY_DETAIL                   ,
+                                LOW_MEMORY_DEFAULT_VALUE            ,
+                                &low_memory                         );
+
+    SetOptionDefinitionStringNL(CERT_OPT_CHAR                       ,
+                                CERT_OPT_LONG                       ,
+                                CERT_OPT_DETAIL                     ,
+                                CERT_DEFAULT_VALUE                  ,
+                                path_cert                           );
+
+    SetOptionDefinitionStringNL(PKEY_OPT_CHAR                       ,
+                                PKEY_OPT_LONG                       ,
+                                PKEY_OPT_DETAIL                     ,
+                                PKEY_DEFAULT_VALUE                  ,
+                                path_pkey                           );
+
+    int parse_arguments = ParseOptions(argc, argv);
+    if(parse_arguments < 0)
+        return parse_arguments;
+
+    BenchServerFillText(response, sizeof(response));
+    if(response_size > 0)
+        response[response_size - 1] = BENCH_SERVER_REQUEST_DELIMITER;
+
+    ServerSocketSetTLSMemAccounting(true);
+    ServerSocketSetTLSLowMemory(low_memory);
+    ServerSocketSetTimeouts(idle_timeout_ms, 0, 0);
+    ServerSocketSetLowLatency(spin_us, 0, 0);
+
+    if(compress_level > 0)
+        ServerSocketSetCompression(compress_level, BENCH_SERVER_COMPRESS_MIN_SIZE);
+
+    // Fan-out clients only listen, so they are many: small stacks let every one of them get its thread.
+    if(broadcast_us > 0)
+    {
+        pthread_t broadcast_thread;
+
+        ServerSocketSetBroadcast(BENCH_SERVER_BROADCAST_MAX_QUEUED);
+        ServerSocketSetThreadProfile(BENCH_SERVER_BROADCAST_STACK_SIZE, 0, 0);
+
+        if(pthread_create(&broadcast_thread, NULL, BenchServerBroadcastRoutine, NULL) != 0)
+            return -1;
+    }
+
+    ServerSocketRun(server_port         ,
+                    max_clients_num     ,
+                    true                ,
+                    false               ,
+                    true                ,
+                    true                ,
+                    rx_timeout_s        ,
+                    0                   ,
+                    rx_timeout_s        ,
+                    0                   ,
+                    secure_connection   ,
+                    path_cert           ,
+                    path_pkey           ,
+                    BenchServerInteract );
+
+    if(path_cert != NULL)
+        free(path_cert);
+
+    if(path_pkey != NULL)
+        free(path_pkey);
+
+    return 0;
+}
@@ -0,0 +1,466 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "ServerSocket_api.h"
+
+extern "C"
+{
+#include "GetOptions_api.h"
+#include "SeverityLog_api.h"
+}
+
+/************************************/
+
+/***************************************/
+/********** Private constants **********/
+/***************************************/
+
+#define CPP_BENCH_LOG_BUFFER_SIZE           10000
+#define CPP_BENCH_LOG_INIT_MASK             0x00    // Logs disabled, so they do not distort measurements.
+
+#define CPP_BENCH_HOST                      "127.0.0.1"
+#define CPP_BENCH_NS_PER_S                  1000000000UL
+#define CPP_BENCH_MAX_CLIENTS               16
+#define CPP_BENCH_MAX_PAYLOAD               1024
+#define CPP_BENCH_BATCH_REQUESTS            64      // Requests in flight per batch, so the server runs them back to back.
+#define CPP_BENCH_SOCKET_BUFFER_SIZE        (1024 * 1024)
+#define CPP_BENCH_MAX_REPEATS               64
+#define CPP_BENCH_POLL_US                   1000
+
+#define CPP_BENCH_ERR_ARGS                  -1
+#define CPP_BENCH_ERR_SETUP                 -2
+#define CPP_BENCH_ERR_RUN                   -3
+
+#define CPP_BENCH_MSG_SETUP_ERR             "C++ front-end benchmark setup failed: %s.\n"
+#define CPP_BENCH_MSG_RUN_ERR               "C++ front-end benchmark failed: %s.\n"
+
+/************ Port settings ************/
+
+#define PORT_OPT_CHAR                       'r'
+#define PORT_OPT_LONG                       "Port"
+#define PORT_OPT_DETAIL                     "Port the library server is run on."
+#define PORT_MIN_VALUE                      49152
+#define PORT_MAX_VALUE                      65535
+#define PORT_DEFAULT_VALUE                  50002
+
+/************* Iterations *************/
+
+#define ITERATIONS_OPT_CHAR                 'i'
+#define ITERATIONS_OPT_LONG                 "Iterations"
+#define ITERATIONS_OPT_DETAIL               "Requests per measurement."
+#define ITERATIONS_MIN_VALUE                CPP_BENCH_BATCH_REQUESTS
+#define ITERATIONS_MAX_VALUE                10000000
+#define ITERATIONS_DEFAULT_VALUE            20000
+
+/************** Repeats ***************/
+
+#define REPEATS_OPT_CHAR                    'e'
+#define REPEATS_OPT_LONG                    "Repeats"
+#define REPEATS_OPT_DETAIL                  "Repetitions of each measurement (fastest and median are reported)."
+#define REPEATS_MIN_VALUE                   1
+#define REPEATS_MAX_VALUE                   CPP_BENCH_MAX_REPEATS
+#define REPEATS_DEFAULT_VALUE               5
+
+/*********** Implementation ***********/
+
+#define IMPL_OPT_CHAR                       'w'
+#define IMPL_OPT_LONG                       "Impl"
+#define IMPL_OPT_DETAIL                     "Server implementation: c (interaction function pointer), cpp (templated handler) or cpp_raw (templated handler, raw transport)."
+#define IMPL_DEFAULT_VALUE                  "c"
+
+/********* Secure connection *********/
+
+#define SECURE_CONN_CHAR                    's'
+#define SECURE_CONN_LONG                    "Secure"
+#define SECURE_CONN_DETAIL                  "Run the library server with TLS (cpp_raw excluded)."
+#define SECURE_CONN_DEFAULT_VALUE           false
+
+/************ Server certificate ************/
+
+#define CERT_OPT_CHAR                       'c'
+#define CERT_OPT_LONG                       "Certificate"
+#define CERT_OPT_DETAIL                     "Server certificate."
+#define CERT_DEFAULT_VALUE                  "~/C_Server_Socket/certificate_test/certificate.crt"
+
+/************ Server private key ************/
+
+#define PKEY_OPT_CHAR                       'k'
+#define PKEY_OPT_LONG                       "Key"
+#define PKEY_OPT_DETAIL                     "Server private key."
+#define PKEY_DEFAULT_VALUE                  "~/C_Server_Socket/certificate_test/private.key"
+
+/***************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+typedef struct
+{
+    int fd;
+    SSL* p_ssl;
+} CPP_BENCH_ENDPOINT;
+
+/// @brief Echo handler, instantiated for each transport.
+struct CppBenchEcho
+{
+    char rx_buffer[CPP_BENCH_MAX_PAYLOAD];
+    bool tuned = false;
+
+    template<typename Transport>
+    int operator()(const ServerSocket::Connection<Transport>& connection);
+};
+
+/**********************************/
+
+/***************************************/
+/********** Private variables **********/
+/***************************************/
+
+static const int payloads[] = {1, 64, CPP_BENCH_MAX_PAYLOAD};
+
+// Bytes the server reads per request, set by the client before each measurement.
+static std::atomic<int> server_payload{payloads[0]};
+
+static int iterations;
+static int repeats;
+static bool secure;
+static char impl[100];
+static SSL_CTX* p_client_ctx;
+
+/***************************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static unsigned long CppBenchNowNs(void);
+static int CppBenchCompare(const void* a, const void* b);
+static void CppBenchTuneSocket(const int fd);
+static int CppBenchCInteract(int client_socket);
+static void* CppBenchServerRoutine(void* arg);
+static int CppBenchConnect(const int port, CPP_BENCH_ENDPOINT* p_endpoint);
+static int CppBenchWrite(const CPP_BENCH_ENDPOINT* p_endpoint, const char* buffer, const int size);
+static int CppBenchRead(const CPP_BENCH_ENDPOINT* p_endpoint, char* buffer, const int size);
+static double CppBenchRun(const CPP_BENCH_ENDPOINT* p_endpoint, const int payload);
+
+/*************************************/
+
+/// @brief Constructor function. Inits logs.
+__attribute__((constructor)) static void CppBenchLoad(void)
+{
+    SeverityLogInitWithMask(CPP_BENCH_LOG_BUFFER_SIZE, CPP_BENCH_LOG_INIT_MASK);
+}
+
+/// @brief Monotonic timestamp.
+/// @return Nanoseconds.
+static unsigned long CppBenchNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * CPP_BENCH_NS_PER_S + now.tv_nsec;
+}
+
+static int CppBenchCompare(const void* a, const void* b)
+{
+    double diff = *(const double*)a - *(const double*)b;
+
+    return (diff > 0) - (diff < 0);
+}
+
+/// @brief Sets socket buffers large enough for a whole batch to fit.
+/// @param fd Socket.
+static void CppBenchTuneSocket(const int fd)
+{
+    int buffer_size = CPP_BENCH_SOCKET_BUFFER_SIZE;
+    int no_delay = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+/// @brief Echoes a request back, the same way the C interaction function below does.
+/// @param connection Client connection.
+/// @return > 0 if interaction is meant to go on, <= 0 to close the connection.
+template<typename Transport>
+int CppBenchEcho::operator()(const ServerSocket::Connection<Transport>& connection)
+{
+    // Responses would otherwise wait for the client to acknowledge the previous one (Nagle's algorithm).
+    if(!tuned)
+    {
+        CppBenchTuneSocket(connection.Socket());
+        tuned = true;
+    }
+
+    int read_bytes = connection.Read(rx_buffer, server_payload.load(std::memory_order_relaxed));
+
+    return (read_bytes > 0 ? connection.Write(rx_buffer, read_bytes) : 0);
+}
+
+/// @brief Interaction function, called by the C core through a function pointer.
+/// @param client_socket Client socket.
+/// @return > 0 if interaction is meant to go on, <= 0 to close the connection.
+static int CppBenchCInteract(int client_socket)
+{
+    static thread_local char rx_buffer[CPP_BENCH_MAX_PAYLOAD];
+    static thread_local bool tuned;
+
+    if(!tuned)
+    {
+        CppBenchTuneSocket(client_socket);
+        tuned = true;
+    }
+
+    int read_bytes = ServerSocketRead(client_socket, rx_buffer, server_payload.load(std::memory_order_relaxed));
+
+    return (read_bytes > 0 ? ServerSocketWrite(client_socket, rx_buffer, read_bytes) : 0);
+}
+
+/// @brief Runs the library server with the selected implementation.
+/// @param arg Server options.
+/// @return NULL.
+static void* CppBenchServerRoutine(void* arg)
+{
+    const ServerSocket::ServerOptions& options = *(const ServerSocket::ServerOptions*)arg;
+
+    if(strcmp(impl, "cpp_raw") == 0)
+        ServerSocket::Server<CppBenchEcho, ServerSocket::RawTransport>::Run(options);
+    else if(strcmp(impl, "cpp") == 0 && secure)
+        ServerSocket::Server<CppBenchEcho, ServerSocket::TlsTransport>::Run(options);
+    else if(strcmp(impl, "cpp") == 0)
+        ServerSocket::Server<CppBenchEcho, ServerSocket::PlainTransport>::Run(options);
+    else
+        ServerSocketRun(options.port, options.max_conn_num, options.concurrent, options.non_blocking, options.reuse_address,
+                        options.reuse_port, 0, 0, 0, 0, secure, options.cert_path, options.pkey_path, CppBenchCInteract);
+
+    return NULL;
+}
+
+/// @brief Connects to the library server, handshaking if required.
+/// @param port Server port.
+/// @param p_endpoint Target endpoint.
+/// @return 0 if succeeded, < 0 otherwise.
+static int CppBenchConnect(const int port, CPP_BENCH_ENDPOINT* p_endpoint)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, CPP_BENCH_HOST, &addr.sin_addr);
+
+    p_endpoint->p_ssl = NULL;
+    p_endpoint->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(p_endpoint->fd < 0)
+        return -1;
+
+    CppBenchTuneSocket(p_endpoint->fd);
+
+    if(connect(p_endpoint->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        return -1;
+
+    if(!secure)
+        return 0;
+
+    p_endpoint->p_ssl = SSL_new(p_client_ctx);
+    if(p_endpoint->p_ssl == NULL || SSL_set_fd(p_endpoint->p_ssl, p_endpoint->fd) != 1 || SSL_connect(p_endpoint->p_ssl) != 1)
+        return -1;
+
+    return 0;
+}
+
+static int CppBenchWrite(const CPP_BENCH_ENDPOINT* p_endpoint, const char* buffer, const int size)
+{
+    return (p_endpoint->p_ssl != NULL ? SSL_write(p_endpoint->p_ssl, buffer, size) : (int)write(p_endpoint->fd, buffer, size));
+}
+
+static int CppBenchRead(const CPP_BENCH_ENDPOINT* p_endpoint, char* buffer, const int size)
+{
+    return (p_endpoint->p_ssl != NULL ? SSL_read(p_endpoint->p_ssl, buffer, size) : (int)read(p_endpoint->fd, buffer, size));
+}
+
+/// @brief Times a given amount of requests. Requests are sent in batches, so the server serves a whole batch back to back
+/// and the time per request is mostly server-side work.
+/// @param p_endpoint Client endpoint.
+/// @param payload Bytes per request (and response).
+/// @return Nanoseconds per request, < 0 if any call failed.
+static double CppBenchRun(const CPP_BENCH_ENDPOINT* p_endpoint, const int payload)
+{
+    static char tx_buffer[CPP_BENCH_BATCH_REQUESTS * CPP_BENCH_MAX_PAYLOAD];
+    static char rx_buffer[CPP_BENCH_BATCH_REQUESTS * CPP_BENCH_MAX_PAYLOAD];
+
+    int batches = iterations / CPP_BENCH_BATCH_REQUESTS;
+    int batch_bytes = CPP_BENCH_BATCH_REQUESTS * payload;
+
+    unsigned long start_ns = CppBenchNowNs();
+
+    for(int i = 0; i < batches; i++)
+    {
+        if(CppBenchWrite(p_endpoint, tx_buffer, batch_bytes) != batch_bytes)
+            return -1;
+
+        for(int received = 0; received < batch_bytes; )
+        {
+            int read_bytes = CppBenchRead(p_endpoint, rx_buffer, batch_bytes - received);
+            if(read_bytes <= 0)
+                return -1;
+
+            received += read_bytes;
+        }
+    }
+
+    return (double)(CppBenchNowNs() - start_ns) / (batches * CPP_BENCH_BATCH_REQUESTS);
+}
+
+/*
+@brief Main function. Program's entry point.
+*/
+int main(int argc, char** argv)
+{
+    int server_port;
+    char* path_cert = (char*)calloc(100, 1);
+    char* path_pkey = (char*)calloc(100, 1);
+
+    SetOptionDefinitionInt(     PORT_OPT_CHAR               ,
+                                PORT_OPT_LONG               ,
+                                PORT_OPT_DETAIL             ,
+                                PORT_MIN_VALUE              ,
+                                PORT_MAX_VALUE              ,
+                                PORT_DEFAULT_VALUE          ,
+                                &server_port                );
+
+    SetOptionDefinitionInt(     ITERATIONS_OPT_CHAR         ,
+                                ITERATIONS_OPT_LONG         ,
+                                ITERATIONS_OPT_DETAIL       ,
+                                ITERATIONS_MIN_VALUE        ,
+                                ITERATIONS_MAX_VALUE        ,
+                                ITERATIONS_DEFAULT_VALUE    ,
+                                &iterations                 );
+
+    SetOptionDefinitionInt(     REPEATS_OPT_CHAR            ,
+                                REPEATS_OPT_LONG            ,
+                                REPEATS_OPT_DETAIL          ,
+                                REPEATS_MIN_VALUE           ,
+                                REPEATS_MAX_VALUE           ,
+                                REPEATS_DEFAULT_VALUE       ,
+                                &repeats                    );
+
+    SetOptionDefinitionStringNL(IMPL_OPT_CHAR               ,
+                                IMPL_OPT_LONG               ,
+                                IMPL_OPT_DETAIL             ,
+                                IMPL_DEFAULT_VALUE          ,
+                                impl                        );
+
+    SetOptionDefinitionBool(    SECURE_CONN_CHAR            ,
+                                SECURE_CONN_LONG            ,
+                                SECURE_CONN_DETAIL          ,
+                                SECURE_CONN_DEFAULT_VALUE   ,
+                                &secure                     );
+
+    SetOptionDefinitionStringNL(CERT_OPT_CHAR               ,
+                                CERT_OPT_LONG               ,
+                                CERT_OPT_DETAIL             ,
+                                CERT_DEFAULT_VALUE          ,
+                                path_cert                   );
+
+    SetOptionDefinitionStringNL(PKEY_OPT_CHAR               ,
+                                PKEY_OPT_LONG               ,
+                                PKEY_OPT_DETAIL             ,
+                                PKEY_DEFAULT_VALUE          ,
+                                path_pkey                   );
+
+    if(ParseOptions(argc, argv) < 0)
+        return CPP_BENCH_ERR_ARGS;
+
+    if((strcmp(impl, "c") != 0 && strcmp(impl, "cpp") != 0 && strcmp(impl, "cpp_raw") != 0) || (secure && strcmp(impl, "cpp_raw") == 0))
+    {
+        fprintf(stderr, CPP_BENCH_MSG_SETUP_ERR, "unknown implementation (or cpp_raw along with TLS)");
+        return CPP_BENCH_ERR_ARGS;
+    }
+
+    if(secure)
+    {
+        p_client_ctx = SSL_CTX_new(TLS_client_method());
+        if(p_client_ctx == NULL)
+        {
+            fprintf(stderr, CPP_BENCH_MSG_SETUP_ERR, "TLS context");
+            return CPP_BENCH_ERR_SETUP;
+        }
+
+        // Self-signed test certificates are expected.
+        SSL_CTX_set_verify(p_client_ctx, SSL_VERIFY_NONE, NULL);
+    }
+
+    ServerSocket::ServerOptions options;
+    options.port            = server_port;
+    options.max_conn_num    = CPP_BENCH_MAX_CLIENTS;
+    options.reuse_port      = true;
+    options.cert_path       = path_cert;
+    options.pkey_path       = path_pkey;
+
+    pthread_t server_thread;
+
+    if(pthread_create(&server_thread, NULL, CppBenchServerRoutine, &options) != 0)
+    {
+        fprintf(stderr, CPP_BENCH_MSG_SETUP_ERR, "server thread");
+        return CPP_BENCH_ERR_SETUP;
+    }
+
+    CPP_BENCH_ENDPOINT client;
+
+    // The server may still be starting up.
+    while(CppBenchConnect(server_port, &client) < 0)
+    {
+        if(client.p_ssl != NULL)
+            SSL_free(client.p_ssl);
+
+        close(client.fd);
+        usleep(CPP_BENCH_POLL_US);
+    }
+
+    double samples[CPP_BENCH_MAX_REPEATS];
+
+    for(int payload : payloads)
+    {
+        server_payload.store(payload, std::memory_order_relaxed);
+
+        // Discard a first run: caches, TLS buffers and the TCP congestion window need to warm up.
+        if(CppBenchRun(&client, payload) < 0)
+        {
+            fprintf(stderr, CPP_BENCH_MSG_RUN_ERR, "connection lost");
+            _exit(CPP_BENCH_ERR_RUN);
+        }
+
+        for(int i = 0; i < repeats; i++)
+            samples[i] = CppBenchRun(&client, payload);
+
+        qsort(samples, repeats, sizeof(double), CppBenchCompare);
+
+        if(samples[0] < 0)
+        {
+            fprintf(stderr, CPP_BENCH_MSG_RUN_ERR, "connection lost");
+            _exit(CPP_BENCH_ERR_RUN);
+        }
+
+        printf("{\"impl\":\"%s\",\"secure\":%s,\"payload\":%d,\"requests\":%d,\"ns_per_request\":%.1f,\"ns_per_request_median\":%.1f}\n",
+               impl, (secure ? "true" : "false"), payload, iterations, samples[0], samples[repeats / 2]);
+    }
+
+    fflush(stdout);
+
+    // ServerSocketRun does not return until the process gets a signal, and cleaning up after a signal exits with success.
+    _exit(0);
+}
@@ -0,0 +1,1082 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "ServerSocket_api.h"      // Compressed connections' wire format.
+#include "GetOptions_api.h"
+
+/************************************/
+
+/***************************************/
+/********** Private constants **********/
+/***************************************/
+
+#define LOAD_GEN_HOST                       "127.0.0.1"
+#define LOAD_GEN_MAX_MSG_SIZE               65536
+#define LOAD_GEN_REQUEST_DELIMITER          '\n'
+#define LOAD_GEN_EPOLL_TIMEOUT_MS           100
+#define LOAD_GEN_EPOLL_MAX_EVENTS           256
+#define LOAD_GEN_NS_PER_S                   1000000000UL
+#define LOAD_GEN_PROC_STAT_PATH             "/proc/%d/stat"
+#define LOAD_GEN_LEN_PROC_STAT_PATH         32
+#define LOAD_GEN_NO_SERVER_PID              0
+#define LOAD_GEN_COMPRESS_MIN_SIZE          128     // Same as the library's default.
+#define LOAD_GEN_COMPRESS_TRAILER_SIZE      4
+#define LOAD_GEN_COMPRESS_FRAME_SIZE        (SERVER_SOCKET_COMPRESS_HEADER_SIZE + SERVER_SOCKET_COMPRESS_MAX_FRAME + 64)
+#define LOAD_GEN_TEXT_WORDS                 {"alpha", "beta", "gamma", "delta", "epsilon", "\"id\":", "\"name\":", "{", "}", "1234"}
+
+#define LOAD_GEN_WORKLOAD_ECHO              "echo"
+#define LOAD_GEN_WORKLOAD_REQRESP           "reqresp"
+#define LOAD_GEN_WORKLOAD_CHURN             "churn"
+#define LOAD_GEN_WORKLOAD_FANOUT            "fanout"
+
+// Log-linear latency histogram, same layout as the library's one: 1.6% worst case relative error.
+#define LOAD_GEN_HIST_SUB_BITS              5
+#define LOAD_GEN_HIST_SUB_COUNT             (1UL << LOAD_GEN_HIST_SUB_BITS)
+#define LOAD_GEN_HIST_BUCKETS               ((64 - LOAD_GEN_HIST_SUB_BITS) * LOAD_GEN_HIST_SUB_COUNT)
+
+#define LOAD_GEN_ERR_ARGS                   -1
+#define LOAD_GEN_ERR_SSL_CTX                -2
+#define LOAD_GEN_ERR_THREADS                -3
+
+#define LOAD_GEN_MSG_UNKNOWN_WORKLOAD       "Unknown workload <%s>, use echo, reqresp, churn or fanout.\n"
+#define LOAD_GEN_MSG_SSL_CTX_ERR            "Could not create SSL client context.\n"
+#define LOAD_GEN_MSG_THREAD_ERR             "Could not launch load generator threads.\n"
+
+/************ Port settings ************/
+
+#define PORT_OPT_CHAR                       'r'
+#define PORT_OPT_LONG                       "Port"
+#define PORT_OPT_DETAIL                     "Server port."
+#define PORT_MIN_VALUE                      1
+#define PORT_MAX_VALUE                      65535
+#define PORT_DEFAULT_VALUE                  50000
+
+/************ Connections ************/
+
+#define CONNS_OPT_CHAR                      'c'
+#define CONNS_OPT_LONG                      "Connections"
+#define CONNS_OPT_DETAIL                    "Concurrent connections (echo, reqresp and fanout workloads)."
+#define CONNS_MIN_VALUE                     1
+#define CONNS_MAX_VALUE                     65536
+#define CONNS_DEFAULT_VALUE                 64
+
+/************** Threads **************/
+
+#define THREADS_OPT_CHAR                    'n'
+#define THREADS_OPT_LONG                    "Threads"
+#define THREADS_OPT_DETAIL                  "Load generator threads."
+#define THREADS_MIN_VALUE                   1
+#define THREADS_MAX_VALUE                   256
+#define THREADS_DEFAULT_VALUE               4
+
+/************* Workload **************/
+
+#define WORKLOAD_OPT_CHAR                   'w'
+#define WORKLOAD_OPT_LONG                   "Workload"
+#define WORKLOAD_OPT_DETAIL                 "Workload: echo, reqresp, churn or fanout."
+#define WORKLOAD_DEFAULT_VALUE              LOAD_GEN_WORKLOAD_ECHO
+
+/************* Duration **************/
+
+#define DURATION_OPT_CHAR                   'd'
+#define DURATION_OPT_LONG                   "Duration"
+#define DURATION_OPT_DETAIL                 "Measurement duration in seconds."
+#define DURATION_MIN_VALUE                  1
+#define DURATION_MAX_VALUE                  3600
+#define DURATION_DEFAULT_VALUE              10
+
+/*********** Request size ************/
+
+#define REQUEST_SIZE_OPT_CHAR               'q'
+#define REQUEST_SIZE_OPT_LONG               "RequestSize"
+#define REQUEST_SIZE_OPT_DETAIL             "Request size in bytes."
+#define REQUEST_SIZE_MIN_VALUE              1
+#define REQUEST_SIZE_MAX_VALUE              LOAD_GEN_MAX_MSG_SIZE
+#define REQUEST_SIZE_DEFAULT_VALUE          64
+
+/*********** Response size ***********/
+
+#define RESPONSE_SIZE_OPT_CHAR              'z'
+#define RESPONSE_SIZE_OPT_LONG              "ResponseSize"
+#define RESPONSE_SIZE_OPT_DETAIL            "Response size in bytes (reqresp and fanout workloads, must match the server's)."
+#define RESPONSE_SIZE_MIN_VALUE             1
+#define RESPONSE_SIZE_MAX_VALUE             LOAD_GEN_MAX_MSG_SIZE
+#define RESPONSE_SIZE_DEFAULT_VALUE         64
+
+/************ Server PID *************/
+
+#define SERVER_PID_OPT_CHAR                 'p'
+#define SERVER_PID_OPT_LONG                 "ServerPid"
+#define SERVER_PID_OPT_DETAIL               "Server process ID, to report the CPU time it used while measuring (0 disables it)."
+#define SERVER_PID_MIN_VALUE                0
+#define SERVER_PID_MAX_VALUE                0x7FFFFFFF
+#define SERVER_PID_DEFAULT_VALUE            LOAD_GEN_NO_SERVER_PID
+
+/********* Compression level *********/
+
+#define COMPRESS_LEVEL_OPT_CHAR             'e'
+#define COMPRESS_LEVEL_OPT_LONG             "CompressLevel"
+#define COMPRESS_LEVEL_OPT_DETAIL           "Transport compression level (1 to 9, must match the server's), 0 disables it."
+#define COMPRESS_LEVEL_MIN_VALUE            0
+#define COMPRESS_LEVEL_MAX_VALUE            9
+#define COMPRESS_LEVEL_DEFAULT_VALUE        0
+
+/********* Secure connection *********/
+
+#define SECURE_CONN_CHAR                    's'
+#define SECURE_CONN_LONG                    "Secure"
+#define SECURE_CONN_DETAIL                  "Secure connection."
+#define SECURE_CONN_DEFAULT_VALUE           false
+
+/***************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+typedef enum
+{
+    LOAD_GEN_ECHO = 0   ,
+    LOAD_GEN_REQRESP    ,
+    LOAD_GEN_CHURN      ,
+    LOAD_GEN_FANOUT     ,
+} LOAD_GEN_WORKLOAD;
+
+typedef struct
+{
+    unsigned long count;
+    unsigned long sum;
+    unsigned long min;
+    unsigned long max;
+    unsigned long buckets[LOAD_GEN_HIST_BUCKETS];
+} LOAD_GEN_HIST;
+
+typedef struct
+{
+    int fd;
+    SSL* p_ssl;
+    int sent;               // Request bytes sent so far (frame bytes on compressed connections).
+    int tx_size;            // Bytes to be sent for the current request, 0 until it starts.
+    int received;           // Response bytes received so far (once inflated on compressed connections).
+    bool want_write;        // Waiting for the socket to become writable.
+    unsigned long start_ns; // Request start timestamp.
+    unsigned char sent_stamp[sizeof(unsigned long)];    // Fan-out only: time the server sent the current message at.
+
+    // Compressed connections only.
+    z_stream deflater;
+    z_stream inflater;
+    unsigned char* p_tx_frame;
+    unsigned char* p_rx_frame;
+    int rx_frame_used;
+} LOAD_GEN_CONN;
+
+typedef struct
+{
+    pthread_t thread;
+    int conns_num;
+    LOAD_GEN_CONN* conns;
+    unsigned long requests;
+    unsigned long connects;
+    unsigned long errors;
+    unsigned long connect_ns;   // Time spent establishing the initial connections.
+    unsigned long wire_bytes;   // Bytes sent and received, as seen on the wire (TLS excluded).
+    LOAD_GEN_HIST hist;
+} LOAD_GEN_THREAD;
+
+/**********************************/
+
+/***************************************/
+/********** Private variables **********/
+/***************************************/
+
+static int port;
+static int request_size;
+static int expected_size;
+static int compress_level;
+static bool secure;
+static LOAD_GEN_WORKLOAD workload;
+static SSL_CTX* p_ssl_ctx;
+static char request[LOAD_GEN_MAX_MSG_SIZE];
+static volatile bool stop;
+static int threads_total;
+static int threads_ready;
+static unsigned long all_ready_ns;  // Time every connection was set up at (fan-out messages sent earlier are not measured).
+
+static const unsigned char sync_flush_trailer[LOAD_GEN_COMPRESS_TRAILER_SIZE] = {0x00, 0x00, 0xFF, 0xFF};
+static __thread unsigned long thread_wire_bytes;
+
+/***************************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static unsigned long LoadGenNowNs(void);
+static double LoadGenProcessCPUSeconds(const int pid);
+static unsigned int LoadGenHistBucket(const unsigned long value);
+static unsigned long LoadGenHistBucketMid(const unsigned int bucket);
+static void LoadGenHistRecord(LOAD_GEN_HIST* p_hist, const unsigned long value);
+static void LoadGenHistMerge(LOAD_GEN_HIST* p_dst, const LOAD_GEN_HIST* p_src);
+static unsigned long LoadGenHistPercentile(const LOAD_GEN_HIST* p_hist, const double percentile);
+static int LoadGenConnect(LOAD_GEN_CONN* p_conn);
+static void LoadGenClose(LOAD_GEN_CONN* p_conn);
+static void LoadGenFillText(char* buffer, const int size);
+static int LoadGenStartRequest(LOAD_GEN_CONN* p_conn);
+static int LoadGenInflateFrame(LOAD_GEN_CONN* p_conn);
+static int LoadGenSend(LOAD_GEN_CONN* p_conn, const bool blocking);
+static int LoadGenRecv(LOAD_GEN_CONN* p_conn, const bool blocking);
+static void* LoadGenSteadyRoutine(void* arg);
+static void* LoadGenChurnRoutine(void* arg);
+
+/*************************************/
+
+/// @brief Monotonic timestamp.
+/// @return Nanoseconds.
+static unsigned long LoadGenNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * LOAD_GEN_NS_PER_S + now.tv_nsec;
+}
+
+/// @brief Retrieves the CPU time (user and system) a process has used so far.
+/// @param pid Process ID.
+/// @return CPU seconds, < 0 if they could not be read.
+static double LoadGenProcessCPUSeconds(const int pid)
+{
+    char stat_path[LOAD_GEN_LEN_PROC_STAT_PATH];
+    snprintf(stat_path, sizeof(stat_path), LOAD_GEN_PROC_STAT_PATH, pid);
+
+    FILE* p_stat_file = fopen(stat_path, "r");
+
+    if(!p_stat_file)
+        return -1.0;
+
+    unsigned long utime_ticks = 0;
+    unsigned long stime_ticks = 0;
+
+    // Process name may contain spaces, so fields are counted from its closing parenthesis on.
+    int scan_stat = fscanf(p_stat_file, "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime_ticks, &stime_ticks);
+
+    fclose(p_stat_file);
+
+    if(scan_stat != 2)
+        return -1.0;
+
+    return (double)(utime_ticks + stime_ticks) / sysconf(_SC_CLK_TCK);
+}
+
+/// @brief Maps a value to its histogram bucket.
+/// @param value Value.
+/// @return Bucket index.
+static unsigned int LoadGenHistBucket(const unsigned long value)
+{
+    if(value < LOAD_GEN_HIST_SUB_COUNT)
+        return value;
+
+    unsigned int msb = 63 - __builtin_clzl(value);
+    unsigned int shift = msb - LOAD_GEN_HIST_SUB_BITS;
+
+    return (shift + 1) * LOAD_GEN_HIST_SUB_COUNT + ((value >> shift) - LOAD_GEN_HIST_SUB_COUNT);
+}
+
+/// @brief Midpoint of the values a bucket covers.
+/// @param bucket Bucket index.
+/// @return Representative value.
+static unsigned long LoadGenHistBucketMid(const unsigned int bucket)
+{
+    if(bucket < LOAD_GEN_HIST_SUB_COUNT)
+        return bucket;
+
+    unsigned int shift = bucket / LOAD_GEN_HIST_SUB_COUNT - 1;
+    unsigned long low = (LOAD_GEN_HIST_SUB_COUNT + bucket % LOAD_GEN_HIST_SUB_COUNT) << shift;
+
+    return low + ((1UL << shift) >> 1);
+}
+
+/// @brief Records a sample.
+/// @param p_hist Target histogram.
+/// @param value Sample.
+static void LoadGenHistRecord(LOAD_GEN_HIST* p_hist, const unsigned long value)
+{
+    if(p_hist->count == 0 || value < p_hist->min)
+        p_hist->min = value;
+
+    if(value > p_hist->max)
+        p_hist->max = value;
+
+    p_hist->count++;
+    p_hist->sum += value;
+    p_hist->buckets[LoadGenHistBucket(value)]++;
+}
+
+/// @brief Adds a histogram to another one.
+/// @param p_dst Target histogram.
+/// @param p_src Source histogram.
+static void LoadGenHistMerge(LOAD_GEN_HIST* p_dst, const LOAD_GEN_HIST* p_src)
+{
+    if(p_src->count == 0)
+        return;
+
+    if(p_dst->count == 0 || p_src->min < p_dst->min)
+        p_dst->min = p_src->min;
+
+    if(p_src->max > p_dst->max)
+        p_dst->max = p_src->max;
+
+    p_dst->count += p_src->count;
+    p_dst->sum += p_src->sum;
+
+    for(unsigned int i = 0; i < LOAD_GEN_HIST_BUCKETS; i++)
+        p_dst->buckets[i] += p_src->buckets[i];
+}
+
+/// @brief Computes a percentile.
+/// @param p_hist Histogram.
+/// @param percentile Percentile, between 0 and 100.
+/// @return Percentile value, clamped to recorded min and max.
+static unsigned long LoadGenHistPercentile(const LOAD_GEN_HIST* p_hist, const double percentile)
+{
+    if(p_hist->count == 0)
+        return 0;
+
+    unsigned long rank = (unsigned long)(percentile / 100.0 * p_hist->count + 0.5);
+    if(rank == 0)
+        rank = 1;
+
+    unsigned long seen = 0;
+
+    for(unsigned int i = 0; i < LOAD_GEN_HIST_BUCKETS; i++)
+    {
+        seen += p_hist->buckets[i];
+
+        if(seen >= rank)
+        {
+            unsigned long value = LoadGenHistBucketMid(i);
+
+            if(value < p_hist->min)
+                return p_hist->min;
+
+            return (value > p_hist->max ? p_hist->max : value);
+        }
+    }
+
+    return p_hist->max;
+}
+
+/// @brief Opens a blocking connection to the server, then performs the TLS handshake if required.
+/// @param p_conn Connection.
+/// @return 0 if succeeded, < 0 otherwise.
+static int LoadGenConnect(LOAD_GEN_CONN* p_conn)
+{
+    struct sockaddr_in server_addr = {};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    inet_pton(AF_INET, LOAD_GEN_HOST, &server_addr.sin_addr);
+
+    memset(p_conn, 0, sizeof(LOAD_GEN_CONN));
+
+    p_conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(p_conn->fd < 0)
+        return -1;
+
+    if(compress_level > 0)
+    {
+        p_conn->p_tx_frame = malloc(LOAD_GEN_COMPRESS_FRAME_SIZE);
+        p_conn->p_rx_frame = malloc(LOAD_GEN_COMPRESS_FRAME_SIZE);
+
+        if( p_conn->p_tx_frame == NULL || p_conn->p_rx_frame == NULL ||
+            deflateInit2(&p_conn->deflater, compress_level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK ||
+            inflateInit2(&p_conn->inflater, -MAX_WBITS) != Z_OK)
+        {
+            LoadGenClose(p_conn);
+            return -1;
+        }
+    }
+
+    int no_delay = 1;
+    setsockopt(p_conn->fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    if(connect(p_conn->fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0)
+    {
+        LoadGenClose(p_conn);
+        return -1;
+    }
+
+    if(!secure)
+        return 0;
+
+    p_conn->p_ssl = SSL_new(p_ssl_ctx);
+    if(p_conn->p_ssl == NULL || SSL_set_fd(p_conn->p_ssl, p_conn->fd) != 1 || SSL_connect(p_conn->p_ssl) != 1)
+    {
+        LoadGenClose(p_conn);
+        return -1;
+    }
+
+    return 0;
+}
+
+/// @brief Closes a connection.
+/// @param p_conn Connection.
+static void LoadGenClose(LOAD_GEN_CONN* p_conn)
+{
+    if(p_conn->p_ssl != NULL)
+    {
+        SSL_shutdown(p_conn->p_ssl);
+        SSL_free(p_conn->p_ssl);
+        p_conn->p_ssl = NULL;
+    }
+
+    if(p_conn->fd >= 0)
+        close(p_conn->fd);
+
+    p_conn->fd = -1;
+
+    // Ending a stream that was never set up is harmless.
+    if(p_conn->p_tx_frame != NULL)
+    {
+        deflateEnd(&p_conn->deflater);
+        inflateEnd(&p_conn->inflater);
+    }
+
+    free(p_conn->p_tx_frame);
+    free(p_conn->p_rx_frame);
+    p_conn->p_tx_frame = NULL;
+    p_conn->p_rx_frame = NULL;
+}
+
+/// @brief Fills a buffer with text-like data (words from a small set), so compression ratios are not meaningless.
+/// @param buffer Target buffer.
+/// @param size Buffer size.
+static void LoadGenFillText(char* buffer, const int size)
+{
+    const char* words[] = LOAD_GEN_TEXT_WORDS;
+    unsigned int seed = 1;
+    int filled = 0;
+
+    while(filled < size)
+    {
+        const char* word = words[rand_r(&seed) % (sizeof(words) / sizeof(words[0]))];
+
+        for(int i = 0; word[i] != 0 && filled < size; i++)
+            buffer[filled++] = word[i];
+
+        if(filled < size)
+            buffer[filled++] = ' ';
+    }
+}
+
+/// @brief Gets a new request ready to be sent. Compressed connections send it as a frame, deflated if it is big enough.
+/// @param p_conn Connection.
+/// @return 0 if succeeded, < 0 otherwise.
+static int LoadGenStartRequest(LOAD_GEN_CONN* p_conn)
+{
+    p_conn->sent = 0;
+    p_conn->tx_size = request_size;
+
+    if(compress_level == 0)
+        return 0;
+
+    unsigned char flags = 0;
+    unsigned long payload_size = request_size;
+
+    if(request_size >= LOAD_GEN_COMPRESS_MIN_SIZE)
+    {
+        p_conn->deflater.next_in = (unsigned char*)request;
+        p_conn->deflater.avail_in = request_size;
+        p_conn->deflater.next_out = p_conn->p_tx_frame + SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+        p_conn->deflater.avail_out = LOAD_GEN_COMPRESS_FRAME_SIZE - SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+
+        if(deflate(&p_conn->deflater, Z_SYNC_FLUSH) != Z_OK || p_conn->deflater.avail_in > 0)
+            return -1;
+
+        flags = SERVER_SOCKET_COMPRESS_FLAG_DEFLATE;
+        payload_size = LOAD_GEN_COMPRESS_FRAME_SIZE - SERVER_SOCKET_COMPRESS_HEADER_SIZE - p_conn->deflater.avail_out - LOAD_GEN_COMPRESS_TRAILER_SIZE;
+    }
+    else
+        memcpy(p_conn->p_tx_frame + SERVER_SOCKET_COMPRESS_HEADER_SIZE, request, request_size);
+
+    p_conn->p_tx_frame[0] = flags;
+    p_conn->p_tx_frame[1] = (unsigned char)(payload_size >> 24);
+    p_conn->p_tx_frame[2] = (unsigned char)(payload_size >> 16);
+    p_conn->p_tx_frame[3] = (unsigned char)(payload_size >> 8);
+    p_conn->p_tx_frame[4] = (unsigned char)payload_size;
+
+    p_conn->tx_size = SERVER_SOCKET_COMPRESS_HEADER_SIZE + payload_size;
+
+    return 0;
+}
+
+/// @brief Handles a fully received frame, adding its (inflated) payload size to received response bytes.
+/// @param p_conn Connection.
+/// @return 0 if succeeded, < 0 if the frame could not be inflated.
+static int LoadGenInflateFrame(LOAD_GEN_CONN* p_conn)
+{
+    static __thread unsigned char inflated[LOAD_GEN_MAX_MSG_SIZE];
+
+    unsigned char flags = p_conn->p_rx_frame[0];
+    int payload_size = p_conn->rx_frame_used - SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+
+    p_conn->rx_frame_used = 0;
+
+    if(flags & SERVER_SOCKET_COMPRESS_FLAG_RESET)
+        inflateReset(&p_conn->inflater);
+
+    if(!(flags & SERVER_SOCKET_COMPRESS_FLAG_DEFLATE))
+    {
+        p_conn->received += payload_size;
+        return 0;
+    }
+
+    // Payload first, then the sync flush trailer the server stripped off.
+    for(int pass = 0; pass < 2; pass++)
+    {
+        p_conn->inflater.next_in = (pass == 0 ? p_conn->p_rx_frame + SERVER_SOCKET_COMPRESS_HEADER_SIZE : (unsigned char*)sync_flush_trailer);
+        p_conn->inflater.avail_in = (pass == 0 ? payload_size : LOAD_GEN_COMPRESS_TRAILER_SIZE);
+
+        do
+        {
+            p_conn->inflater.next_out = inflated;
+            p_conn->inflater.avail_out = sizeof(inflated);
+
+            int inflate_payload = inflate(&p_conn->inflater, Z_SYNC_FLUSH);
+
+            if(inflate_payload != Z_OK && inflate_payload != Z_BUF_ERROR)
+                return -1;
+
+            p_conn->received += sizeof(inflated) - p_conn->inflater.avail_out;
+        } while(p_conn->inflater.avail_out == 0);
+    }
+
+    return 0;
+}
+
+/// @brief Sends the remaining part of the current request.
+/// @param p_conn Connection.
+/// @param blocking Keep on sending until the whole request is gone.
+/// @return 1 if the whole request has been sent, 0 if the socket is not writable yet, < 0 on error.
+static int LoadGenSend(LOAD_GEN_CONN* p_conn, const bool blocking)
+{
+    if(p_conn->tx_size == 0 && LoadGenStartRequest(p_conn) < 0)
+        return -1;
+
+    const char* tx_data = (compress_level > 0 ? (const char*)p_conn->p_tx_frame : request);
+
+    while(p_conn->sent < p_conn->tx_size)
+    {
+        int sent;
+
+        if(p_conn->p_ssl == NULL)
+            sent = send(p_conn->fd, tx_data + p_conn->sent, p_conn->tx_size - p_conn->sent, MSG_NOSIGNAL);
+        else
+            sent = SSL_write(p_conn->p_ssl, tx_data + p_conn->sent, p_conn->tx_size - p_conn->sent);
+
+        if(sent > 0)
+        {
+            p_conn->sent += sent;
+            thread_wire_bytes += sent;
+            continue;
+        }
+
+        if(blocking)
+            return -1;
+
+        if(p_conn->p_ssl == NULL && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+
+        if(p_conn->p_ssl != NULL)
+        {
+            int ssl_error = SSL_get_error(p_conn->p_ssl, sent);
+            if(ssl_error == SSL_ERROR_WANT_WRITE || ssl_error == SSL_ERROR_WANT_READ)
+                return 0;
+        }
+
+        return -1;
+    }
+
+    return 1;
+}
+
+/// @brief Reads response bytes.
+/// @param p_conn Connection.
+/// @param blocking Keep on reading until the whole response has arrived.
+/// @return 1 if the whole response has been received, 0 if more data is expected, < 0 on error or disconnection.
+static int LoadGenRecv(LOAD_GEN_CONN* p_conn, const bool blocking)
+{
+    static __thread char rx_buffer[LOAD_GEN_MAX_MSG_SIZE];
+
+    while(p_conn->received < expected_size)
+    {
+        char* p_rx = rx_buffer;
+        int to_receive = expected_size - p_conn->received;
+
+        // Compressed connections receive a frame header first, then its payload.
+        if(compress_level > 0)
+        {
+            unsigned char* p_frame = p_conn->p_rx_frame;
+            int frame_size = SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+
+            if(p_conn->rx_frame_used >= SERVER_SOCKET_COMPRESS_HEADER_SIZE)
+                frame_size += (p_frame[1] << 24) | (p_frame[2] << 16) | (p_frame[3] << 8) | p_frame[4];
+
+            if(frame_size > LOAD_GEN_COMPRESS_FRAME_SIZE)
+                return -1;
+
+            p_rx = (char*)p_frame + p_conn->rx_frame_used;
+            to_receive = frame_size - p_conn->rx_frame_used;
+        }
+
+        int received;
+
+        if(p_conn->p_ssl == NULL)
+            received = recv(p_conn->fd, p_rx, to_receive, 0);
+        else
+            received = SSL_read(p_conn->p_ssl, p_rx, to_receive);
+
+        if(received > 0)
+        {
+            thread_wire_bytes += received;
+
+            if(compress_level == 0)
+            {
+                // Broadcast messages start with the time they were sent at.
+                if(workload == LOAD_GEN_FANOUT && p_conn->received < (int)sizeof(p_conn->sent_stamp))
+                {
+                    int stamp_bytes = (int)sizeof(p_conn->sent_stamp) - p_conn->received;
+                    memcpy(p_conn->sent_stamp + p_conn->received, p_rx, (received < stamp_bytes ? received : stamp_bytes));
+                }
+
+                p_conn->received += received;
+                continue;
+            }
+
+            p_conn->rx_frame_used += received;
+
+            // Headers announcing an empty payload complete their frame on their own.
+            bool frame_done = (received == to_receive &&
+                               (p_conn->rx_frame_used > SERVER_SOCKET_COMPRESS_HEADER_SIZE || (p_conn->p_rx_frame[1] | p_conn->p_rx_frame[2] | p_conn->p_rx_frame[3] | p_conn->p_rx_frame[4]) == 0));
+
+            if(frame_done && LoadGenInflateFrame(p_conn) < 0)
+                return -1;
+
+            continue;
+        }
+
+        if(received == 0 || blocking)
+            return -1;
+
+        if(p_conn->p_ssl == NULL && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+
+        if(p_conn->p_ssl != NULL)
+        {
+            int ssl_error = SSL_get_error(p_conn->p_ssl, received);
+            if(ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+                return 0;
+        }
+
+        return -1;
+    }
+
+    return 1;
+}
+
+/// @brief Echo, request/response and fan-out workloads. Every connection keeps exactly one request in flight (closed loop),
+/// except for fan-out ones, which only receive the server's broadcasts (latency being measured from the time they were sent at).
+/// @param arg Thread data.
+/// @return NULL.
+static void* LoadGenSteadyRoutine(void* arg)
+{
+    LOAD_GEN_THREAD* p_thread = (LOAD_GEN_THREAD*)arg;
+    struct epoll_event events[LOAD_GEN_EPOLL_MAX_EVENTS];
+
+    int epoll_fd = epoll_create1(0);
+    if(epoll_fd < 0)
+    {
+        p_thread->errors++;
+        return NULL;
+    }
+
+    unsigned long connect_start_ns = LoadGenNowNs();
+
+    for(int i = 0; i < p_thread->conns_num; i++)
+    {
+        LOAD_GEN_CONN* p_conn = &p_thread->conns[i];
+
+        if(LoadGenConnect(p_conn) < 0)
+        {
+            p_thread->errors++;
+            continue;
+        }
+
+        p_thread->connects++;
+    }
+
+    p_thread->connect_ns = LoadGenNowNs() - connect_start_ns;
+
+    if(__atomic_add_fetch(&threads_ready, 1, __ATOMIC_ACQ_REL) == threads_total)
+        __atomic_store_n(&all_ready_ns, LoadGenNowNs(), __ATOMIC_RELEASE);
+
+    for(int i = 0; i < p_thread->conns_num; i++)
+    {
+        LOAD_GEN_CONN* p_conn = &p_thread->conns[i];
+
+        if(p_conn->fd < 0)
+            continue;
+
+        fcntl(p_conn->fd, F_SETFL, fcntl(p_conn->fd, F_GETFL) | O_NONBLOCK);
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = p_conn};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, p_conn->fd, &event);
+
+        p_conn->start_ns = LoadGenNowNs();
+        if(workload != LOAD_GEN_FANOUT && LoadGenSend(p_conn, false) == 0)
+        {
+            p_conn->want_write = true;
+            event.events = EPOLLIN | EPOLLOUT;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, p_conn->fd, &event);
+        }
+    }
+
+    while(!stop)
+    {
+        int events_num = epoll_wait(epoll_fd, events, LOAD_GEN_EPOLL_MAX_EVENTS, LOAD_GEN_EPOLL_TIMEOUT_MS);
+
+        for(int i = 0; i < events_num && !stop; i++)
+        {
+            LOAD_GEN_CONN* p_conn = (LOAD_GEN_CONN*)events[i].data.ptr;
+            int progress;
+
+            // Responses may only arrive once the whole request is gone, so keep on sending first.
+            while((progress = (workload == LOAD_GEN_FANOUT ? 1 : LoadGenSend(p_conn, false))) > 0 && (progress = LoadGenRecv(p_conn, false)) > 0)
+            {
+                unsigned long now_ns = LoadGenNowNs();
+
+                if(workload == LOAD_GEN_FANOUT)
+                    memcpy(&p_conn->start_ns, p_conn->sent_stamp, sizeof(p_conn->start_ns));
+
+                // Fan-out messages sent while connections were still being set up spent that time queued.
+                unsigned long ready_ns = __atomic_load_n(&all_ready_ns, __ATOMIC_ACQUIRE);
+
+                if(workload != LOAD_GEN_FANOUT || (ready_ns > 0 && p_conn->start_ns >= ready_ns))
+                {
+                    LoadGenHistRecord(&p_thread->hist, now_ns - p_conn->start_ns);
+                    p_thread->requests++;
+                }
+
+                p_conn->start_ns = now_ns;
+                p_conn->tx_size = 0;
+                p_conn->received = 0;
+            }
+
+            if(progress < 0)
+            {
+                p_thread->errors++;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p_conn->fd, NULL);
+                LoadGenClose(p_conn);
+                continue;
+            }
+
+            bool want_write = (p_conn->sent < p_conn->tx_size);
+            if(want_write != p_conn->want_write)
+            {
+                struct epoll_event event = {.events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.ptr = p_conn};
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, p_conn->fd, &event);
+                p_conn->want_write = want_write;
+            }
+        }
+    }
+
+    for(int i = 0; i < p_thread->conns_num; i++)
+        if(p_thread->conns[i].fd >= 0)
+            LoadGenClose(&p_thread->conns[i]);
+
+    close(epoll_fd);
+
+    p_thread->wire_bytes = thread_wire_bytes;
+
+    return NULL;
+}
+
+/// @brief Connect-churn workload: connect (and handshake), exchange a single echo request, then close.
+/// @param arg Thread data.
+/// @return NULL.
+static void* LoadGenChurnRoutine(void* arg)
+{
+    LOAD_GEN_THREAD* p_thread = (LOAD_GEN_THREAD*)arg;
+    LOAD_GEN_CONN conn;
+
+    while(!stop)
+    {
+        unsigned long start_ns = LoadGenNowNs();
+
+        if(LoadGenConnect(&conn) < 0)
+        {
+            p_thread->errors++;
+            continue;
+        }
+
+        int exchange = LoadGenSend(&conn, true);
+        if(exchange > 0)
+            exchange = LoadGenRecv(&conn, true);
+
+        LoadGenClose(&conn);
+
+        if(exchange < 0)
+        {
+            p_thread->errors++;
+            continue;
+        }
+
+        LoadGenHistRecord(&p_thread->hist, LoadGenNowNs() - start_ns);
+        p_thread->connects++;
+        p_thread->requests++;
+    }
+
+    p_thread->wire_bytes = thread_wire_bytes;
+
+    return NULL;
+}
+
+/*
+@brief Main function. Program's entry point.
+*/
+int main(int argc, char** argv)
+{
+    int conns_num       ;
+    int threads_num     ;
+    int duration_s      ;
+    int response_size   ;
+    int server_pid      ;
+    char* workload_name = calloc(100, 1);
+
+    SetOptionDefinitionInt(     PORT_OPT_CHAR               ,
+                                PORT_OPT_LONG               ,
+                                PORT_OPT_DETAIL             ,
+                                PORT_MIN_VALUE              ,
+                                PORT_MAX_VALUE              ,
+                                PORT_DEFAULT_VALUE          ,
+                                &port                       );
+
+    SetOptionDefinitionInt(     CONNS_OPT_CHAR              ,
+                                CONNS_OPT_LONG              ,
+                                CONNS_OPT_DETAIL            ,
+                                CONNS_MIN_VALUE             ,
+                                CONNS_MAX_VALUE             ,
+                                CONNS_DEFAULT_VALUE         ,
+                                &conns_num                  );
+
+    SetOptionDefinitionInt(     THREADS_OPT_CHAR            ,
+                                THREADS_OPT_LONG            ,
+                                THREADS_OPT_DETAIL          ,
+                                THREADS_MIN_VALUE           ,
+                                THREADS_MAX_VALUE           ,
+                                THREADS_DEFAULT_VALUE       ,
+                                &threads_num                );
+
+    SetOptionDefinitionStringNL(WORKLOAD_OPT_CHAR           ,
+                                WORKLOAD_OPT_LONG           ,
+                                WORKLOAD_OPT_DETAIL         ,
+                                WORKLOAD_DEFAULT_VALUE      ,
+                                workload_name               );
+
+    SetOptionDefinitionInt(     DURATION_OPT_CHAR           ,
+                                DURATION_OPT_LONG           ,
+                                DURATION_OPT_DETAIL         ,
+                                DURATION_MIN_VALUE          ,
+                                DURATION_MAX_VALUE          ,
+                                DURATION_DEFAULT_VALUE      ,
+                                &duration_s                 );
+
+    SetOptionDefinitionInt(     REQUEST_SIZE_OPT_CHAR       ,
+                                REQUEST_SIZE_OPT_LONG       ,
+                                REQUEST_SIZE_OPT_DETAIL     ,
+                                REQUEST_SIZE_MIN_VALUE      ,
+                                REQUEST_SIZE_MAX_VALUE      ,
+                                REQUEST_SIZE_DEFAULT_VALUE  ,
+                                &request_size               );
+
+    SetOptionDefinitionInt(     RESPONSE_SIZE_OPT_CHAR      ,
+                                RESPONSE_SIZE_OPT_LONG      ,
+                                RESPONSE_SIZE_OPT_DETAIL    ,
+                                RESPONSE_SIZE_MIN_VALUE     ,
+                                RESPONSE_SIZE_MAX_VALUE     ,
+                                RESPONSE_SIZE_DEFAULT_VALUE ,
+                                &response_size              );
+
+    SetOptionDefinitionInt(     SERVER_PID_OPT_CHAR         ,
+                                SERVER_PID_OPT_LONG         ,
+                                SERVER_PID_OPT_DETAIL       ,
+                                SERVER_PID_MIN_VALUE        ,
+                                SERVER_PID_MAX_VALUE        ,
+                                SERVER_PID_DEFAULT_VALUE    ,
+                                &server_pid                 );
+
+    SetOptionDefinitionInt(     COMPRESS_LEVEL_OPT_CHAR     ,
+                                COMPRESS_LEVEL_OPT_LONG     ,
+                                COMPRESS_LEVEL_OPT_DETAIL   ,
+                                COMPRESS_LEVEL_MIN_VALUE    ,
+                                COMPRESS_LEVEL_MAX_VALUE    ,
+                                COMPRESS_LEVEL_DEFAULT_VALUE,
+                                &compress_level             );
+
+    SetOptionDefinitionBool(    SECURE_CONN_CHAR            ,
+                                SECURE_CONN_LONG            ,
+                                SECURE_CONN_DETAIL          ,
+                                SECURE_CONN_DEFAULT_VALUE   ,
+                                &secure                     );
+
+    if(ParseOptions(argc, argv) < 0)
+        return LOAD_GEN_ERR_ARGS;
+
+    if(strcmp(workload_name, LOAD_GEN_WORKLOAD_ECHO) == 0)
+        workload = LOAD_GEN_ECHO;
+    else if(strcmp(workload_name, LOAD_GEN_WORKLOAD_REQRESP) == 0)
+        workload = LOAD_GEN_REQRESP;
+    else if(strcmp(workload_name, LOAD_GEN_WORKLOAD_CHURN) == 0)
+        workload = LOAD_GEN_CHURN;
+    else if(strcmp(workload_name, LOAD_GEN_WORKLOAD_FANOUT) == 0)
+        workload = LOAD_GEN_FANOUT;
+    else
+    {
+        fprintf(stderr, LOAD_GEN_MSG_UNKNOWN_WORKLOAD, workload_name);
+        return LOAD_GEN_ERR_ARGS;
+    }
+
+    // Request/response: the server answers every newline-terminated request with a fixed-size response.
+    LoadGenFillText(request, request_size);
+    request[request_size - 1] = LOAD_GEN_REQUEST_DELIMITER;
+    expected_size = (workload == LOAD_GEN_REQRESP || workload == LOAD_GEN_FANOUT ? response_size : request_size);
+
+    // Churn workload keeps one connection per thread.
+    if(workload == LOAD_GEN_CHURN)
+        conns_num = threads_num;
+
+    if(threads_num > conns_num)
+        threads_num = conns_num;
+
+    threads_total = threads_num;
+
+    if(secure)
+    {
+        p_ssl_ctx = SSL_CTX_new(TLS_client_method());
+        if(p_ssl_ctx == NULL)
+        {
+            fprintf(stderr, LOAD_GEN_MSG_SSL_CTX_ERR);
+            return LOAD_GEN_ERR_SSL_CTX;
+        }
+
+        // Self-signed test certificates are expected.
+        SSL_CTX_set_verify(p_ssl_ctx, SSL_VERIFY_NONE, NULL);
+    }
+
+    LOAD_GEN_THREAD* threads = calloc(threads_num, sizeof(LOAD_GEN_THREAD));
+    LOAD_GEN_CONN* conns = calloc(conns_num, sizeof(LOAD_GEN_CONN));
+    LOAD_GEN_HIST* p_latency = calloc(1, sizeof(LOAD_GEN_HIST));
+
+    double server_start_cpu_s = (server_pid != LOAD_GEN_NO_SERVER_PID ? LoadGenProcessCPUSeconds(server_pid) : -1.0);
+    unsigned long start_ns = LoadGenNowNs();
+    int launched = 0;
+
+    for(int i = 0, first_conn = 0; i < threads_num; i++)
+    {
+        threads[i].conns_num = conns_num / threads_num + (i < conns_num % threads_num);
+        threads[i].conns = &conns[first_conn];
+        first_conn += threads[i].conns_num;
+
+        if(pthread_create(&threads[i].thread, NULL, (workload == LOAD_GEN_CHURN ? LoadGenChurnRoutine : LoadGenSteadyRoutine), &threads[i]) != 0)
+            break;
+
+        launched++;
+    }
+
+    // Fan-out is only measured once every connection is set up, however long it takes (TLS handshakes mostly).
+    while(launched == threads_num && workload == LOAD_GEN_FANOUT && __atomic_load_n(&all_ready_ns, __ATOMIC_ACQUIRE) == 0)
+        usleep(LOAD_GEN_EPOLL_TIMEOUT_MS * 1000);
+
+    if(launched == threads_num)
+        sleep(duration_s);
+
+    stop = true;
+
+    unsigned long requests = 0;
+    unsigned long connects = 0;
+    unsigned long errors = 0;
+    unsigned long connect_ns = 0;
+    unsigned long wire_bytes = 0;
+
+    for(int i = 0; i < launched; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+
+        requests += threads[i].requests;
+        connects += threads[i].connects;
+        errors += threads[i].errors;
+        wire_bytes += threads[i].wire_bytes;
+        LoadGenHistMerge(p_latency, &threads[i].hist);
+
+        if(threads[i].connect_ns > connect_ns)
+            connect_ns = threads[i].connect_ns;
+    }
+
+    double elapsed_s = (double)(LoadGenNowNs() - start_ns) / LOAD_GEN_NS_PER_S;
+
+    // Server CPU usage (100 per fully busy CPU) and CPU time per request, so latency gains can be weighed against their cost.
+    double server_end_cpu_s = (server_start_cpu_s >= 0 ? LoadGenProcessCPUSeconds(server_pid) : -1.0);
+    double server_cpu_s = (server_end_cpu_s >= server_start_cpu_s ? server_end_cpu_s - server_start_cpu_s : 0);
+    double server_cpu_pct = (server_start_cpu_s >= 0 ? 100.0 * server_cpu_s / elapsed_s : 0);
+    unsigned long server_cpu_ns_per_req = (server_start_cpu_s >= 0 && requests > 0 ? (unsigned long)(server_cpu_s * LOAD_GEN_NS_PER_S / requests) : 0);
+
+    // Churn: every request is a full connection cycle. Steady workloads: initial connection setup rate.
+    double conns_per_s = (workload == LOAD_GEN_CHURN ? connects / elapsed_s : (connect_ns > 0 ? connects * (double)LOAD_GEN_NS_PER_S / connect_ns : 0));
+
+    printf("{\"workload\":\"%s\",\"secure\":%s,\"connections\":%d,\"threads\":%d,\"request_size\":%d,\"response_size\":%d,"
+           "\"duration_s\":%.3f,\"requests\":%lu,\"connects\":%lu,\"errors\":%lu,"
+           "\"connections_per_sec\":%.1f,\"requests_per_sec\":%.1f,"
+           "\"server_cpu_pct\":%.1f,\"server_cpu_ns_per_request\":%lu,"
+           "\"compress_level\":%d,\"wire_bytes_per_request\":%lu,"
+           "\"latency_ns\":{\"min\":%lu,\"mean\":%lu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu}}\n",
+           workload_name, (secure ? "true" : "false"), conns_num, threads_num, request_size, expected_size,
+           elapsed_s, requests, connects, errors,
+           conns_per_s, requests / elapsed_s,
+           server_cpu_pct, server_cpu_ns_per_req,
+           compress_level, (requests > 0 ? wire_bytes / requests : 0),
+           p_latency->min, (p_latency->count > 0 ? p_latency->sum / p_latency->count : 0),
+           LoadGenHistPercentile(p_latency, 50.0), LoadGenHistPercentile(p_latency, 90.0),
+           LoadGenHistPercentile(p_latency, 99.0), LoadGenHistPercentile(p_latency, 99.9),
+           p_latency->max);
+
+    free(p_latency);
+    free(conns);
+    free(threads);
+    free(workload_name);
+
+    if(p_ssl_ctx != NULL)
+        SSL_CTX_free(p_ssl_ctx);
+
+    if(launched < threads_num)
+    {
+        fprintf(stderr, LOAD_GEN_MSG_THREAD_ERR);
+        return LOAD_GEN_ERR_THREADS;
+    }
+
+    return 0;
+}
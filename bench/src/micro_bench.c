@@ -0,0 +1,774 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ServerSocket_api.h"
+#include "GetOptions_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/***************************************/
+/********** Private constants **********/
+/***************************************/
+
+#define MICRO_BENCH_LOG_BUFFER_SIZE         10000
+#define MICRO_BENCH_LOG_INIT_MASK           0x00    // Logs disabled, so they do not distort measurements.
+
+#define MICRO_BENCH_HOST                    "127.0.0.1"
+#define MICRO_BENCH_NS_PER_S                1000000000UL
+#define MICRO_BENCH_MAX_PAYLOAD             16384
+#define MICRO_BENCH_BATCH_BYTES             (64 * 1024)     // Data in flight per batch, always below socket buffer sizes.
+#define MICRO_BENCH_BATCH_MAX_CALLS         128             // Tiny writes take up a whole buffer each on UNIX sockets.
+#define MICRO_BENCH_SOCKET_BUFFER_SIZE      (1024 * 1024)
+#define MICRO_BENCH_MAX_REPEATS             64
+#define MICRO_BENCH_MAX_ROWS                1024
+#define MICRO_BENCH_TABLE_SIZE_STEP         16
+#define MICRO_BENCH_START_MARK              'M'
+#define MICRO_BENCH_POLL_US                 1000
+
+#define MICRO_BENCH_ERR_ARGS                -1
+#define MICRO_BENCH_ERR_SETUP               -2
+#define MICRO_BENCH_ERR_REGRESSION          -3
+
+#define MICRO_BENCH_MSG_SETUP_ERR           "Micro benchmark setup failed: %s.\n"
+
+/************ Port settings ************/
+
+#define PORT_OPT_CHAR                       'r'
+#define PORT_OPT_LONG                       "Port"
+#define PORT_OPT_DETAIL                     "Port the library server is run on."
+#define PORT_MIN_VALUE                      49152
+#define PORT_MAX_VALUE                      65535
+#define PORT_DEFAULT_VALUE                  50001
+
+/************* Iterations *************/
+
+#define ITERATIONS_OPT_CHAR                 'i'
+#define ITERATIONS_OPT_LONG                 "Iterations"
+#define ITERATIONS_OPT_DETAIL               "Calls per measurement."
+#define ITERATIONS_MIN_VALUE                1
+#define ITERATIONS_MAX_VALUE                10000000
+#define ITERATIONS_DEFAULT_VALUE            20000
+
+/************** Repeats ***************/
+
+#define REPEATS_OPT_CHAR                    'e'
+#define REPEATS_OPT_LONG                    "Repeats"
+#define REPEATS_OPT_DETAIL                  "Repetitions of each measurement (fastest and median are reported)."
+#define REPEATS_MIN_VALUE                   1
+#define REPEATS_MAX_VALUE                   MICRO_BENCH_MAX_REPEATS
+#define REPEATS_DEFAULT_VALUE               5
+
+/********** Connection table **********/
+
+#define TABLE_OPT_CHAR                      'm'
+#define TABLE_OPT_LONG                      "MaxTableSize"
+#define TABLE_OPT_DETAIL                    "Largest connection table size (1, 16, 256, ... up to this value are measured)."
+#define TABLE_MIN_VALUE                     1
+#define TABLE_MAX_VALUE                     65536
+#define TABLE_DEFAULT_VALUE                 256
+
+/******** Regression threshold ********/
+
+#define THRESHOLD_OPT_CHAR                  'x'
+#define THRESHOLD_OPT_LONG                  "MaxOverheadNs"
+#define THRESHOLD_OPT_DETAIL                "Fail if any wrapper adds more than this many ns per call (0 disables the check)."
+#define THRESHOLD_MIN_VALUE                 0
+#define THRESHOLD_MAX_VALUE                 1000000
+#define THRESHOLD_DEFAULT_VALUE             0
+
+/********* Secure connection *********/
+
+#define SECURE_CONN_CHAR                    's'
+#define SECURE_CONN_LONG                    "Secure"
+#define SECURE_CONN_DETAIL                  "Run the library server with TLS (measures the TLS wrapper)."
+#define SECURE_CONN_DEFAULT_VALUE           false
+
+/************ Server certificate ************/
+
+#define CERT_OPT_CHAR                       'c'
+#define CERT_OPT_LONG                       "Certificate"
+#define CERT_OPT_DETAIL                     "Server certificate."
+#define CERT_DEFAULT_VALUE                  "~/C_Server_Socket/certificate_test/certificate.crt"
+
+/************ Server private key ************/
+
+#define PKEY_OPT_CHAR                       'k'
+#define PKEY_OPT_LONG                       "Key"
+#define PKEY_OPT_DETAIL                     "Server private key."
+#define PKEY_DEFAULT_VALUE                  "~/C_Server_Socket/certificate_test/private.key"
+
+/***************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+typedef struct
+{
+    int fd;
+    SSL* p_ssl;
+} MICRO_BENCH_ENDPOINT;
+
+typedef int (*MICRO_BENCH_IO_FN)(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+
+typedef struct
+{
+    const char* transport;
+    const char* impl;
+    const char* op;
+    int payload;
+    int table_size;
+    unsigned long calls;
+    double ns_per_call;         // Fastest repetition.
+    double ns_per_call_median;  // Median repetition.
+    double overhead_ns;         // Compared to the raw call of the same transport, operation and payload (wrappers only).
+} MICRO_BENCH_ROW;
+
+/**********************************/
+
+/***************************************/
+/********** Private variables **********/
+/***************************************/
+
+static const int payloads[] = {1, 64, 1024, MICRO_BENCH_MAX_PAYLOAD};
+
+static int iterations;
+static int repeats;
+static bool secure;
+static SSL_CTX* p_server_ctx;
+static SSL_CTX* p_client_ctx;
+
+static MICRO_BENCH_ROW rows[MICRO_BENCH_MAX_ROWS];
+static int rows_num;
+
+// Library server measurement: the connection sending the start mark runs the measurements from its serving thread.
+static MICRO_BENCH_ENDPOINT library_peer;
+static int library_table_size;
+static sem_t library_done;
+
+/***************************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static unsigned long MicroBenchNowNs(void);
+static int MicroBenchRawRead(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+static int MicroBenchRawWrite(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+static int MicroBenchSSLRead(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+static int MicroBenchSSLWrite(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+static int MicroBenchWrapperRead(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+static int MicroBenchWrapperWrite(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size);
+static int MicroBenchCompare(const void* a, const void* b);
+static double MicroBenchRun(MICRO_BENCH_IO_FN io_fn, const MICRO_BENCH_ENDPOINT* p_endpoint, MICRO_BENCH_IO_FN peer_fn, const MICRO_BENCH_ENDPOINT* p_peer, const bool is_write, const int payload, const int calls);
+static void MicroBenchMeasure(const char* transport, const char* impl, const int table_size, MICRO_BENCH_IO_FN read_fn, MICRO_BENCH_IO_FN write_fn, const MICRO_BENCH_ENDPOINT* p_endpoint, MICRO_BENCH_IO_FN peer_read_fn, MICRO_BENCH_IO_FN peer_write_fn, const MICRO_BENCH_ENDPOINT* p_peer);
+static void MicroBenchTuneSocket(const int fd);
+static int MicroBenchLoopbackPair(int fds[2]);
+static int MicroBenchSSLPair(const int fds[2], MICRO_BENCH_ENDPOINT* p_server, MICRO_BENCH_ENDPOINT* p_client);
+static void MicroBenchClosePair(MICRO_BENCH_ENDPOINT* p_server, MICRO_BENCH_ENDPOINT* p_client);
+static int MicroBenchRawTransport(const char* transport, const int fds[2]);
+static int MicroBenchConnect(const int port, MICRO_BENCH_ENDPOINT* p_endpoint);
+static int MicroBenchLibraryInteract(int client_socket);
+static void* MicroBenchLibraryRoutine(void* arg);
+static int MicroBenchReport(const int max_overhead_ns);
+
+/*************************************/
+
+/// @brief Constructor function. Inits logs.
+__attribute__((constructor)) static void MicroBenchLoad(void)
+{
+    SeverityLogInitWithMask(MICRO_BENCH_LOG_BUFFER_SIZE, MICRO_BENCH_LOG_INIT_MASK);
+}
+
+/// @brief Monotonic timestamp.
+/// @return Nanoseconds.
+static unsigned long MicroBenchNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * MICRO_BENCH_NS_PER_S + now.tv_nsec;
+}
+
+static int MicroBenchRawRead(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size)
+{
+    return read(p_endpoint->fd, buffer, size);
+}
+
+static int MicroBenchRawWrite(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size)
+{
+    return write(p_endpoint->fd, buffer, size);
+}
+
+static int MicroBenchSSLRead(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size)
+{
+    return SSL_read(p_endpoint->p_ssl, buffer, size);
+}
+
+static int MicroBenchSSLWrite(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size)
+{
+    return SSL_write(p_endpoint->p_ssl, buffer, size);
+}
+
+static int MicroBenchWrapperRead(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size)
+{
+    return ServerSocketRead(p_endpoint->fd, buffer, size);
+}
+
+static int MicroBenchWrapperWrite(const MICRO_BENCH_ENDPOINT* p_endpoint, char* buffer, int size)
+{
+    return ServerSocketWrite(p_endpoint->fd, buffer, size);
+}
+
+static int MicroBenchCompare(const void* a, const void* b)
+{
+    double diff = *(const double*)a - *(const double*)b;
+
+    return (diff > 0) - (diff < 0);
+}
+
+/// @brief Times a given amount of calls. Data is moved in batches small enough never to block,
+/// so the peer side (untimed) drains or refills the connection between batches from the very same thread.
+/// @param io_fn Measured function.
+/// @param p_endpoint Measured endpoint.
+/// @param peer_fn Peer function (read if measuring writes, write otherwise).
+/// @param p_peer Peer endpoint.
+/// @param is_write True if measuring writes, false if measuring reads.
+/// @param payload Bytes per call.
+/// @param calls Amount of calls.
+/// @return Nanoseconds per call, < 0 if any call failed.
+static double MicroBenchRun(MICRO_BENCH_IO_FN io_fn, const MICRO_BENCH_ENDPOINT* p_endpoint, MICRO_BENCH_IO_FN peer_fn, const MICRO_BENCH_ENDPOINT* p_peer, const bool is_write, const int payload, const int calls)
+{
+    static __thread char buffer[MICRO_BENCH_MAX_PAYLOAD];
+    static __thread char peer_buffer[MICRO_BENCH_MAX_PAYLOAD];
+
+    int batch = MICRO_BENCH_BATCH_BYTES / payload;
+    if(batch > MICRO_BENCH_BATCH_MAX_CALLS)
+        batch = MICRO_BENCH_BATCH_MAX_CALLS;
+
+    unsigned long elapsed_ns = 0;
+    unsigned long done_calls = 0;
+
+    for(int remaining = calls; remaining > 0; )
+    {
+        int batch_calls = (remaining < batch ? remaining : batch);
+        long batch_bytes = (long)batch_calls * payload;
+
+        if(is_write)
+        {
+            unsigned long start_ns = MicroBenchNowNs();
+
+            for(int i = 0; i < batch_calls; i++)
+                if(io_fn(p_endpoint, buffer, payload) != payload)
+                    return -1;
+
+            elapsed_ns += MicroBenchNowNs() - start_ns;
+            done_calls += batch_calls;
+
+            for(long drained = 0; drained < batch_bytes; )
+            {
+                int peer_read = peer_fn(p_peer, peer_buffer, sizeof(peer_buffer));
+                if(peer_read <= 0)
+                    return -1;
+
+                drained += peer_read;
+            }
+        }
+        else
+        {
+            // Fill with payload-sized writes, so TLS records match read sizes.
+            for(int i = 0; i < batch_calls; i++)
+                if(peer_fn(p_peer, peer_buffer, payload) != payload)
+                    return -1;
+
+            unsigned long start_ns = MicroBenchNowNs();
+
+            for(long received = 0; received < batch_bytes; done_calls++)
+            {
+                int io_read = io_fn(p_endpoint, buffer, payload);
+                if(io_read <= 0)
+                    return -1;
+
+                received += io_read;
+            }
+
+            elapsed_ns += MicroBenchNowNs() - start_ns;
+        }
+
+        remaining -= batch_calls;
+    }
+
+    return (double)elapsed_ns / done_calls;
+}
+
+/// @brief Measures reads and writes for every payload size, then stores the results.
+/// @param transport Transport name.
+/// @param impl Implementation name.
+/// @param table_size Connection table size (0 if the library is not involved).
+/// @param read_fn Measured read function.
+/// @param write_fn Measured write function.
+/// @param p_endpoint Measured endpoint.
+/// @param peer_read_fn Peer read function.
+/// @param peer_write_fn Peer write function.
+/// @param p_peer Peer endpoint.
+static void MicroBenchMeasure(const char* transport, const char* impl, const int table_size, MICRO_BENCH_IO_FN read_fn, MICRO_BENCH_IO_FN write_fn, const MICRO_BENCH_ENDPOINT* p_endpoint, MICRO_BENCH_IO_FN peer_read_fn, MICRO_BENCH_IO_FN peer_write_fn, const MICRO_BENCH_ENDPOINT* p_peer)
+{
+    double samples[MICRO_BENCH_MAX_REPEATS];
+
+    for(unsigned int payload_idx = 0; payload_idx < sizeof(payloads) / sizeof(payloads[0]); payload_idx++)
+    {
+        for(int is_write = 0; is_write <= 1 && rows_num < MICRO_BENCH_MAX_ROWS; is_write++)
+        {
+            MICRO_BENCH_ROW* p_row = &rows[rows_num++];
+
+            p_row->transport = transport;
+            p_row->impl = impl;
+            p_row->op = (is_write ? "write" : "read");
+            p_row->payload = payloads[payload_idx];
+            p_row->table_size = table_size;
+            p_row->calls = iterations;
+
+            // Discard a first run: caches, TLS buffers and the TCP congestion window need to warm up.
+            MicroBenchRun(is_write ? write_fn : read_fn, p_endpoint, is_write ? peer_read_fn : peer_write_fn, p_peer, is_write, payloads[payload_idx], iterations);
+
+            for(int i = 0; i < repeats; i++)
+                samples[i] = MicroBenchRun(is_write ? write_fn : read_fn, p_endpoint, is_write ? peer_read_fn : peer_write_fn, p_peer, is_write, payloads[payload_idx], iterations);
+
+            qsort(samples, repeats, sizeof(double), MicroBenchCompare);
+
+            p_row->ns_per_call = samples[0];
+            p_row->ns_per_call_median = samples[repeats / 2];
+        }
+    }
+}
+
+/// @brief Sets socket buffers large enough for a whole batch to fit.
+/// @param fd Socket.
+static void MicroBenchTuneSocket(const int fd)
+{
+    int buffer_size = MICRO_BENCH_SOCKET_BUFFER_SIZE;
+    int no_delay = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+/// @brief Creates a connected pair of TCP loopback sockets.
+/// @param fds Target sockets.
+/// @return 0 if succeeded, < 0 otherwise.
+static int MicroBenchLoopbackPair(int fds[2])
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    socklen_t addr_len = sizeof(addr);
+    inet_pton(AF_INET, MICRO_BENCH_HOST, &addr.sin_addr);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(listener < 0)
+        return -1;
+
+    if(bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 1) < 0 || getsockname(listener, (struct sockaddr*)&addr, &addr_len) < 0)
+    {
+        close(listener);
+        return -1;
+    }
+
+    fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if(fds[1] < 0 || connect(fds[1], (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(listener);
+        return -1;
+    }
+
+    fds[0] = accept(listener, NULL, NULL);
+    close(listener);
+
+    if(fds[0] < 0)
+        return -1;
+
+    MicroBenchTuneSocket(fds[0]);
+    MicroBenchTuneSocket(fds[1]);
+
+    return 0;
+}
+
+/// @brief Establishes a TLS session over a pair of connected sockets, handshaking both sides from the calling thread.
+/// @param fds Connected sockets (server side first).
+/// @param p_server Target server endpoint.
+/// @param p_client Target client endpoint.
+/// @return 0 if succeeded, < 0 otherwise.
+static int MicroBenchSSLPair(const int fds[2], MICRO_BENCH_ENDPOINT* p_server, MICRO_BENCH_ENDPOINT* p_client)
+{
+    p_server->fd = fds[0];
+    p_client->fd = fds[1];
+    p_server->p_ssl = SSL_new(p_server_ctx);
+    p_client->p_ssl = SSL_new(p_client_ctx);
+
+    if(p_server->p_ssl == NULL || p_client->p_ssl == NULL)
+        return -1;
+
+    SSL_set_fd(p_server->p_ssl, fds[0]);
+    SSL_set_fd(p_client->p_ssl, fds[1]);
+
+    for(int i = 0; i < 2; i++)
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+
+    int server_done = 0;
+    int client_done = 0;
+
+    while(server_done != 1 || client_done != 1)
+    {
+        if(client_done != 1)
+            client_done = SSL_connect(p_client->p_ssl);
+
+        if(server_done != 1)
+            server_done = SSL_accept(p_server->p_ssl);
+
+        if((client_done <= 0 && SSL_get_error(p_client->p_ssl, client_done) != SSL_ERROR_WANT_READ) ||
+           (server_done <= 0 && SSL_get_error(p_server->p_ssl, server_done) != SSL_ERROR_WANT_READ))
+            return -1;
+    }
+
+    for(int i = 0; i < 2; i++)
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) & ~O_NONBLOCK);
+
+    return 0;
+}
+
+/// @brief Frees a TLS pair (sockets are not closed).
+/// @param p_server Server endpoint.
+/// @param p_client Client endpoint.
+static void MicroBenchClosePair(MICRO_BENCH_ENDPOINT* p_server, MICRO_BENCH_ENDPOINT* p_client)
+{
+    SSL_free(p_server->p_ssl);
+    SSL_free(p_client->p_ssl);
+    p_server->p_ssl = NULL;
+    p_client->p_ssl = NULL;
+}
+
+/// @brief Measures raw syscalls, raw OpenSSL calls and (if TLS is not enabled yet) the plain library wrapper on a pair of sockets.
+/// @param transport Transport name.
+/// @param fds Connected sockets.
+/// @return 0 if succeeded, < 0 otherwise.
+static int MicroBenchRawTransport(const char* transport, const int fds[2])
+{
+    MICRO_BENCH_ENDPOINT server = {.fd = fds[0]};
+    MICRO_BENCH_ENDPOINT client = {.fd = fds[1]};
+
+    MicroBenchMeasure(transport, "raw_syscall", 0, MicroBenchRawRead, MicroBenchRawWrite, &server, MicroBenchRawRead, MicroBenchRawWrite, &client);
+
+    // Plain wrappers only call the syscall while the library is not running in TLS mode.
+    if(!secure)
+        MicroBenchMeasure(transport, "plain_wrapper", 0, MicroBenchWrapperRead, MicroBenchWrapperWrite, &server, MicroBenchRawRead, MicroBenchRawWrite, &client);
+
+    if(MicroBenchSSLPair(fds, &server, &client) < 0)
+        return -1;
+
+    MicroBenchMeasure(transport, "raw_ssl", 0, MicroBenchSSLRead, MicroBenchSSLWrite, &server, MicroBenchSSLRead, MicroBenchSSLWrite, &client);
+
+    MicroBenchClosePair(&server, &client);
+
+    return 0;
+}
+
+/// @brief Connects to the library server, handshaking if required.
+/// @param port Server port.
+/// @param p_endpoint Target endpoint.
+/// @return 0 if succeeded, < 0 otherwise.
+static int MicroBenchConnect(const int port, MICRO_BENCH_ENDPOINT* p_endpoint)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, MICRO_BENCH_HOST, &addr.sin_addr);
+
+    p_endpoint->p_ssl = NULL;
+    p_endpoint->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(p_endpoint->fd < 0)
+        return -1;
+
+    MicroBenchTuneSocket(p_endpoint->fd);
+
+    if(connect(p_endpoint->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        return -1;
+
+    if(!secure)
+        return 0;
+
+    p_endpoint->p_ssl = SSL_new(p_client_ctx);
+    if(p_endpoint->p_ssl == NULL || SSL_set_fd(p_endpoint->p_ssl, p_endpoint->fd) != 1 || SSL_connect(p_endpoint->p_ssl) != 1)
+        return -1;
+
+    return 0;
+}
+
+/// @brief Interaction function. Idle connections just wait, the one sending the start mark is measured from its serving thread.
+/// @param client_socket Client socket.
+/// @return 0 always, so the connection is closed afterwards.
+static int MicroBenchLibraryInteract(int client_socket)
+{
+    char start_mark;
+
+    if(ServerSocketRead(client_socket, &start_mark, sizeof(start_mark)) <= 0 || start_mark != MICRO_BENCH_START_MARK)
+        return 0;
+
+    MICRO_BENCH_ENDPOINT server = {.fd = client_socket};
+
+    MicroBenchTuneSocket(client_socket);
+
+    // Raw calls on a library connection would break the TLS session, so TLS wrappers are compared to the raw_ssl loopback pair.
+    if(secure)
+        MicroBenchMeasure("loopback", "tls_wrapper", library_table_size, MicroBenchWrapperRead, MicroBenchWrapperWrite, &server, MicroBenchSSLRead, MicroBenchSSLWrite, &library_peer);
+    else
+    {
+        MicroBenchMeasure("loopback", "raw_syscall", library_table_size, MicroBenchRawRead, MicroBenchRawWrite, &server, MicroBenchRawRead, MicroBenchRawWrite, &library_peer);
+        MicroBenchMeasure("loopback", "plain_wrapper", library_table_size, MicroBenchWrapperRead, MicroBenchWrapperWrite, &server, MicroBenchRawRead, MicroBenchRawWrite, &library_peer);
+    }
+
+    sem_post(&library_done);
+
+    return 0;
+}
+
+/// @brief Runs the library server.
+/// @param arg Server parameters.
+/// @return NULL.
+static void* MicroBenchLibraryRoutine(void* arg)
+{
+    const int* params = (const int*)arg;
+    const char** paths = (const char**)(params + 2);
+
+    ServerSocketRun(params[0], params[1], true, false, true, true, 0, 0, 0, 0, secure, paths[0], paths[1], MicroBenchLibraryInteract);
+
+    return NULL;
+}
+
+/// @brief Computes wrapper overheads, then prints every result as a JSON line.
+/// @param max_overhead_ns Maximum allowed overhead per call (0 disables the check).
+/// @return Amount of rows exceeding the maximum allowed overhead.
+static int MicroBenchReport(const int max_overhead_ns)
+{
+    int regressions = 0;
+
+    for(int i = 0; i < rows_num; i++)
+    {
+        MICRO_BENCH_ROW* p_row = &rows[i];
+        const char* baseline = (strcmp(p_row->impl, "plain_wrapper") == 0 ? "raw_syscall" : (strcmp(p_row->impl, "tls_wrapper") == 0 ? "raw_ssl" : NULL));
+
+        if(baseline != NULL)
+        {
+            // Baseline measured on the same connection if available, on the raw pair of the same transport otherwise.
+            MICRO_BENCH_ROW* p_baseline = NULL;
+
+            for(int j = 0; j < rows_num; j++)
+            {
+                if(strcmp(rows[j].impl, baseline) == 0 && strcmp(rows[j].transport, p_row->transport) == 0 &&
+                   strcmp(rows[j].op, p_row->op) == 0 && rows[j].payload == p_row->payload &&
+                   (rows[j].table_size == p_row->table_size || (rows[j].table_size == 0 && p_baseline == NULL)))
+                    p_baseline = &rows[j];
+            }
+
+            if(p_baseline != NULL)
+                p_row->overhead_ns = p_row->ns_per_call - p_baseline->ns_per_call;
+
+            if(max_overhead_ns > 0 && p_row->overhead_ns > max_overhead_ns)
+                regressions++;
+        }
+
+        printf("{\"transport\":\"%s\",\"impl\":\"%s\",\"op\":\"%s\",\"payload\":%d,\"table_size\":%d,\"calls\":%lu,"
+               "\"ns_per_call\":%.1f,\"ns_per_call_median\":%.1f,\"overhead_ns\":%.1f}\n",
+               p_row->transport, p_row->impl, p_row->op, p_row->payload, p_row->table_size, p_row->calls,
+               p_row->ns_per_call, p_row->ns_per_call_median, p_row->overhead_ns);
+    }
+
+    printf("{\"max_overhead_ns\":%d,\"regressions\":%d}\n", max_overhead_ns, regressions);
+
+    return regressions;
+}
+
+/*
+@brief Main function. Program's entry point.
+*/
+int main(int argc, char** argv)
+{
+    int server_port     ;
+    int max_table_size  ;
+    int max_overhead_ns ;
+    char* path_cert = calloc(100, 1);
+    char* path_pkey = calloc(100, 1);
+
+    SetOptionDefinitionInt(     PORT_OPT_CHAR               ,
+                                PORT_OPT_LONG               ,
+                                PORT_OPT_DETAIL             ,
+                                PORT_MIN_VALUE              ,
+                                PORT_MAX_VALUE              ,
+                                PORT_DEFAULT_VALUE          ,
+                                &server_port                );
+
+    SetOptionDefinitionInt(     ITERATIONS_OPT_CHAR         ,
+                                ITERATIONS_OPT_LONG         ,
+                                ITERATIONS_OPT_DETAIL       ,
+                                ITERATIONS_MIN_VALUE        ,
+                                ITERATIONS_MAX_VALUE        ,
+                                ITERATIONS_DEFAULT_VALUE    ,
+                                &iterations                 );
+
+    SetOptionDefinitionInt(     REPEATS_OPT_CHAR            ,
+                                REPEATS_OPT_LONG            ,
+                                REPEATS_OPT_DETAIL          ,
+                                REPEATS_MIN_VALUE           ,
+                                REPEATS_MAX_VALUE           ,
+                                REPEATS_DEFAULT_VALUE       ,
+                                &repeats                    );
+
+    SetOptionDefinitionInt(     TABLE_OPT_CHAR              ,
+                                TABLE_OPT_LONG              ,
+                                TABLE_OPT_DETAIL            ,
+                                TABLE_MIN_VALUE             ,
+                                TABLE_MAX_VALUE             ,
+                                TABLE_DEFAULT_VALUE         ,
+                                &max_table_size             );
+
+    SetOptionDefinitionInt(     THRESHOLD_OPT_CHAR          ,
+                                THRESHOLD_OPT_LONG          ,
+                                THRESHOLD_OPT_DETAIL        ,
+                                THRESHOLD_MIN_VALUE         ,
+                                THRESHOLD_MAX_VALUE         ,
+                                THRESHOLD_DEFAULT_VALUE     ,
+                                &max_overhead_ns            );
+
+    SetOptionDefinitionBool(    SECURE_CONN_CHAR            ,
+                                SECURE_CONN_LONG            ,
+                                SECURE_CONN_DETAIL          ,
+                                SECURE_CONN_DEFAULT_VALUE   ,
+                                &secure                     );
+
+    SetOptionDefinitionStringNL(CERT_OPT_CHAR               ,
+                                CERT_OPT_LONG               ,
+                                CERT_OPT_DETAIL             ,
+                                CERT_DEFAULT_VALUE          ,
+                                path_cert                   );
+
+    SetOptionDefinitionStringNL(PKEY_OPT_CHAR               ,
+                                PKEY_OPT_LONG               ,
+                                PKEY_OPT_DETAIL             ,
+                                PKEY_DEFAULT_VALUE          ,
+                                path_pkey                   );
+
+    if(ParseOptions(argc, argv) < 0)
+        return MICRO_BENCH_ERR_ARGS;
+
+    p_server_ctx = SSL_CTX_new(TLS_server_method());
+    p_client_ctx = SSL_CTX_new(TLS_client_method());
+
+    if(p_server_ctx == NULL || p_client_ctx == NULL ||
+       SSL_CTX_use_certificate_file(p_server_ctx, path_cert, SSL_FILETYPE_PEM) <= 0 ||
+       SSL_CTX_use_PrivateKey_file(p_server_ctx, path_pkey, SSL_FILETYPE_PEM) <= 0)
+    {
+        fprintf(stderr, MICRO_BENCH_MSG_SETUP_ERR, "certificate or private key");
+        return MICRO_BENCH_ERR_SETUP;
+    }
+
+    // Self-signed test certificates are expected.
+    SSL_CTX_set_verify(p_client_ctx, SSL_VERIFY_NONE, NULL);
+
+    int fds[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0 || MicroBenchRawTransport("socketpair", fds) < 0)
+    {
+        fprintf(stderr, MICRO_BENCH_MSG_SETUP_ERR, "socketpair");
+        return MICRO_BENCH_ERR_SETUP;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+    if(MicroBenchLoopbackPair(fds) < 0 || MicroBenchRawTransport("loopback", fds) < 0)
+    {
+        fprintf(stderr, MICRO_BENCH_MSG_SETUP_ERR, "loopback");
+        return MICRO_BENCH_ERR_SETUP;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+    // Library server: the measured connection always takes the last slot of the table, which is the worst case for slot lookups.
+    struct
+    {
+        int params[2];
+        const char* paths[2];
+    } server_args = {{server_port, max_table_size}, {path_cert, path_pkey}};
+
+    pthread_t server_thread;
+    sem_init(&library_done, 0, 0);
+
+    if(pthread_create(&server_thread, NULL, MicroBenchLibraryRoutine, &server_args) != 0)
+    {
+        fprintf(stderr, MICRO_BENCH_MSG_SETUP_ERR, "server thread");
+        return MICRO_BENCH_ERR_SETUP;
+    }
+
+    MICRO_BENCH_ENDPOINT* idle_conns = calloc(max_table_size, sizeof(MICRO_BENCH_ENDPOINT));
+    int idle_conns_num = 0;
+
+    for(library_table_size = 1; library_table_size <= max_table_size; library_table_size *= MICRO_BENCH_TABLE_SIZE_STEP)
+    {
+        for(; idle_conns_num < library_table_size - 1; idle_conns_num++)
+        {
+            // The server may still be starting up.
+            while(MicroBenchConnect(server_port, &idle_conns[idle_conns_num]) < 0)
+            {
+                close(idle_conns[idle_conns_num].fd);
+                usleep(MICRO_BENCH_POLL_US);
+            }
+        }
+
+        // Wait for every idle connection (and the previously measured one) to settle in its slot.
+        SERVER_SOCKET_STATS stats;
+        do
+        {
+            usleep(MICRO_BENCH_POLL_US);
+            ServerSocketGetStats(&stats);
+        } while(stats.active_connections != (unsigned long)idle_conns_num);
+
+        while(MicroBenchConnect(server_port, &library_peer) < 0)
+        {
+            close(library_peer.fd);
+            usleep(MICRO_BENCH_POLL_US);
+        }
+
+        char start_mark = MICRO_BENCH_START_MARK;
+        if(secure)
+            SSL_write(library_peer.p_ssl, &start_mark, sizeof(start_mark));
+        else
+            write(library_peer.fd, &start_mark, sizeof(start_mark));
+
+        sem_wait(&library_done);
+
+        if(library_peer.p_ssl != NULL)
+            SSL_free(library_peer.p_ssl);
+
+        close(library_peer.fd);
+    }
+
+    int regressions = MicroBenchReport(max_overhead_ns);
+
+    fflush(stdout);
+
+    // ServerSocketRun does not return until the process gets a signal, and cleaning up after a signal exits with success.
+    _exit(regressions > 0 ? MICRO_BENCH_ERR_REGRESSION : 0);
+}
@@ -0,0 +1,433 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ServerSocket_api.h"
+#include "GetOptions_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/***************************************/
+/********** Private constants **********/
+/***************************************/
+
+#define ZEROCOPY_BENCH_LOG_BUFFER_SIZE      10000
+#define ZEROCOPY_BENCH_LOG_INIT_MASK        0x00    // Logs disabled, so they do not distort measurements.
+
+#define ZEROCOPY_BENCH_HOST                 "127.0.0.1"
+#define ZEROCOPY_BENCH_NS_PER_S             1000000000UL
+#define ZEROCOPY_BENCH_BYTES_PER_MB         (1024 * 1024UL)
+#define ZEROCOPY_BENCH_BYTES_PER_GB         (1024 * 1024 * 1024UL)
+#define ZEROCOPY_BENCH_MAX_PAYLOAD          (1024 * 1024UL)
+#define ZEROCOPY_BENCH_SEND_SIZE            (1024 * 1024UL)
+#define ZEROCOPY_BENCH_SOCKET_BUFFER_SIZE   (4 * 1024 * 1024)
+#define ZEROCOPY_BENCH_CACHE_LINE           64
+#define ZEROCOPY_BENCH_MAX_REPEATS          64
+#define ZEROCOPY_BENCH_LEN_CONTROL          128
+
+#define ZEROCOPY_BENCH_ERR_ARGS             -1
+#define ZEROCOPY_BENCH_ERR_SETUP            -2
+#define ZEROCOPY_BENCH_ERR_RUN              -3
+
+#define ZEROCOPY_BENCH_MSG_SETUP_ERR        "Zero-copy receive benchmark setup failed: %s.\n"
+#define ZEROCOPY_BENCH_MSG_RUN_ERR          "Zero-copy receive benchmark failed: %s.\n"
+
+/************** Data size *************/
+
+#define DATA_SIZE_OPT_CHAR                  't'
+#define DATA_SIZE_OPT_LONG                  "DataMB"
+#define DATA_SIZE_OPT_DETAIL                "Megabytes received per measurement."
+#define DATA_SIZE_MIN_VALUE                 1
+#define DATA_SIZE_MAX_VALUE                 65536
+#define DATA_SIZE_DEFAULT_VALUE             256
+
+/************** Repeats ***************/
+
+#define REPEATS_OPT_CHAR                    'e'
+#define REPEATS_OPT_LONG                    "Repeats"
+#define REPEATS_OPT_DETAIL                  "Repetitions of each measurement (fastest and median are reported)."
+#define REPEATS_MIN_VALUE                   1
+#define REPEATS_MAX_VALUE                   ZEROCOPY_BENCH_MAX_REPEATS
+#define REPEATS_DEFAULT_VALUE               5
+
+/*********** Data consumption ***********/
+
+#define TOUCH_OPT_CHAR                      'u'
+#define TOUCH_OPT_LONG                      "NoTouch"
+#define TOUCH_OPT_DETAIL                    "Do not read received data (every cache line is read by default, as handlers would)."
+#define TOUCH_DEFAULT_VALUE                 false
+
+/***************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+typedef int (*ZEROCOPY_BENCH_READ_FN)(int fd, unsigned long payload);
+
+typedef struct
+{
+    double rx_cpu_ns_per_gb;    // Receiving thread's CPU time.
+    double ns_per_call;         // Wall time.
+    double mapped_ratio;        // Received bytes which were mapped rather than copied.
+} ZEROCOPY_BENCH_SAMPLE;
+
+/**********************************/
+
+/***************************************/
+/********** Private variables **********/
+/***************************************/
+
+static const unsigned long payloads[] = {4096, 16384, 65536, 262144, ZEROCOPY_BENCH_MAX_PAYLOAD};
+
+static int data_mb;
+static int repeats;
+static bool no_touch;
+static volatile bool sender_stop;
+static volatile unsigned long touch_sum;
+
+static char* read_buffer;
+
+/***************************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static unsigned long ZeroCopyBenchNowNs(clockid_t clock_id);
+static int ZeroCopyBenchCompare(const void* a, const void* b);
+static void ZeroCopyBenchTouch(const char* data, unsigned long size);
+static int ZeroCopyBenchLoopbackPair(int fds[2]);
+static void ZeroCopyBenchDrainErrQueue(int fd);
+static void* ZeroCopyBenchSenderRoutine(void* arg);
+static int ZeroCopyBenchRead(int fd, unsigned long payload);
+static int ZeroCopyBenchReadZeroCopy(int fd, unsigned long payload);
+static int ZeroCopyBenchRun(ZEROCOPY_BENCH_READ_FN read_fn, int fd, unsigned long payload, ZEROCOPY_BENCH_SAMPLE* p_sample);
+static int ZeroCopyBenchMeasure(const char* impl, ZEROCOPY_BENCH_READ_FN read_fn, int fd, unsigned long payload, double* p_rx_cpu_ns_per_gb);
+
+/*************************************/
+
+/// @brief Constructor function. Inits logs.
+__attribute__((constructor)) static void ZeroCopyBenchLoad(void)
+{
+    SeverityLogInitWithMask(ZEROCOPY_BENCH_LOG_BUFFER_SIZE, ZEROCOPY_BENCH_LOG_INIT_MASK);
+}
+
+/// @brief Timestamp.
+/// @param clock_id Clock (monotonic for wall time, thread CPU time for CPU usage).
+/// @return Nanoseconds.
+static unsigned long ZeroCopyBenchNowNs(const clockid_t clock_id)
+{
+    struct timespec now;
+    clock_gettime(clock_id, &now);
+
+    return now.tv_sec * ZEROCOPY_BENCH_NS_PER_S + now.tv_nsec;
+}
+
+static int ZeroCopyBenchCompare(const void* a, const void* b)
+{
+    const ZEROCOPY_BENCH_SAMPLE* p_a = (const ZEROCOPY_BENCH_SAMPLE*)a;
+    const ZEROCOPY_BENCH_SAMPLE* p_b = (const ZEROCOPY_BENCH_SAMPLE*)b;
+    double diff = p_a->rx_cpu_ns_per_gb - p_b->rx_cpu_ns_per_gb;
+
+    return (diff > 0) - (diff < 0);
+}
+
+/// @brief Reads every cache line of received data, as a handler consuming it would.
+/// @param data Received data.
+/// @param size Received data size.
+static void ZeroCopyBenchTouch(const char* data, const unsigned long size)
+{
+    unsigned long sum = 0;
+
+    if(no_touch)
+        return;
+
+    for(unsigned long offset = 0; offset < size; offset += ZEROCOPY_BENCH_CACHE_LINE)
+        sum += (unsigned char)data[offset];
+
+    touch_sum += sum;
+}
+
+/// @brief Creates a connected pair of TCP loopback sockets, with buffers large enough for several sends in flight.
+/// @param fds Target sockets (receiving side first).
+/// @return 0 if succeeded, < 0 otherwise.
+static int ZeroCopyBenchLoopbackPair(int fds[2])
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    socklen_t addr_len = sizeof(addr);
+    int buffer_size = ZEROCOPY_BENCH_SOCKET_BUFFER_SIZE;
+    inet_pton(AF_INET, ZEROCOPY_BENCH_HOST, &addr.sin_addr);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(listener < 0)
+        return -1;
+
+    // Set before listening, so the window scale negotiated on connection fits the buffer.
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    if(bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 1) < 0 || getsockname(listener, (struct sockaddr*)&addr, &addr_len) < 0)
+    {
+        close(listener);
+        return -1;
+    }
+
+    fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if(fds[1] < 0)
+    {
+        close(listener);
+        return -1;
+    }
+
+    setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+    if(connect(fds[1], (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(listener);
+        return -1;
+    }
+
+    fds[0] = accept(listener, NULL, NULL);
+    close(listener);
+
+    return (fds[0] < 0 ? -1 : 0);
+}
+
+/// @brief Reaps MSG_ZEROCOPY completions, so the sender does not run out of option memory.
+/// @param fd Sending socket.
+static void ZeroCopyBenchDrainErrQueue(const int fd)
+{
+    char control[ZEROCOPY_BENCH_LEN_CONTROL];
+    struct msghdr msg = {.msg_control = control, .msg_controllen = sizeof(control)};
+
+    while(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0)
+        msg.msg_controllen = sizeof(control);
+}
+
+/// @brief Sends data until told to stop, with MSG_ZEROCOPY from a page-aligned buffer: loopback then hands the receiver
+/// payload in whole pages, as network cards splitting headers off do. Plain sends are used if MSG_ZEROCOPY is not supported.
+/// @param arg Sending socket.
+/// @return NULL.
+static void* ZeroCopyBenchSenderRoutine(void* arg)
+{
+    const int fd = *(const int*)arg;
+    int zerocopy = 1;
+
+    char* send_buffer = mmap(NULL, ZEROCOPY_BENCH_SEND_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(send_buffer == MAP_FAILED)
+        return NULL;
+
+    memset(send_buffer, 'Z', ZEROCOPY_BENCH_SEND_SIZE);
+
+    int send_flags = (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &zerocopy, sizeof(zerocopy)) == 0 ? MSG_ZEROCOPY : 0);
+
+    while(!sender_stop)
+    {
+        if(send(fd, send_buffer, ZEROCOPY_BENCH_SEND_SIZE, send_flags) < 0 && errno != ENOBUFS && errno != EINTR)
+            break;
+
+        if(send_flags)
+            ZeroCopyBenchDrainErrQueue(fd);
+    }
+
+    munmap(send_buffer, ZEROCOPY_BENCH_SEND_SIZE);
+
+    return NULL;
+}
+
+/// @brief Copies received data (read), then consumes it.
+/// @param fd Receiving socket.
+/// @param payload Maximum bytes per call.
+/// @return Bytes received, <= 0 if failed.
+static int ZeroCopyBenchRead(const int fd, const unsigned long payload)
+{
+    int read_bytes = read(fd, read_buffer, payload);
+
+    if(read_bytes > 0)
+        ZeroCopyBenchTouch(read_buffer, read_bytes);
+
+    return read_bytes;
+}
+
+/// @brief Maps received data (or copies what cannot be mapped) through the library, then consumes and releases it.
+/// @param fd Receiving socket.
+/// @param payload Maximum bytes per call.
+/// @return Bytes received, <= 0 if failed.
+static int ZeroCopyBenchReadZeroCopy(const int fd, const unsigned long payload)
+{
+    SERVER_SOCKET_MESSAGE view;
+
+    int read_bytes = ServerSocketReadZeroCopy(fd, &view, payload, SERVER_SOCKET_WAIT_FOREVER);
+
+    if(read_bytes > 0)
+    {
+        ZeroCopyBenchTouch(view.data, view.size);
+        ServerSocketReleaseZeroCopy(fd);
+    }
+
+    return read_bytes;
+}
+
+/// @brief Receives data_mb megabytes.
+/// @param read_fn Measured read function.
+/// @param fd Receiving socket.
+/// @param payload Maximum bytes per call.
+/// @param p_sample Target sample.
+/// @return 0 if succeeded, < 0 if any call failed.
+static int ZeroCopyBenchRun(ZEROCOPY_BENCH_READ_FN read_fn, const int fd, const unsigned long payload, ZEROCOPY_BENCH_SAMPLE* p_sample)
+{
+    unsigned long total = data_mb * ZEROCOPY_BENCH_BYTES_PER_MB;
+    unsigned long received = 0;
+    unsigned long calls = 0;
+    SERVER_SOCKET_STATS stats_start;
+    SERVER_SOCKET_STATS stats_end;
+
+    ServerSocketGetStats(&stats_start);
+
+    unsigned long start_ns = ZeroCopyBenchNowNs(CLOCK_MONOTONIC);
+    unsigned long start_cpu_ns = ZeroCopyBenchNowNs(CLOCK_THREAD_CPUTIME_ID);
+
+    for(; received < total; calls++)
+    {
+        int read_bytes = read_fn(fd, payload);
+        if(read_bytes <= 0)
+            return -1;
+
+        received += read_bytes;
+    }
+
+    unsigned long cpu_ns = ZeroCopyBenchNowNs(CLOCK_THREAD_CPUTIME_ID) - start_cpu_ns;
+    unsigned long elapsed_ns = ZeroCopyBenchNowNs(CLOCK_MONOTONIC) - start_ns;
+
+    ServerSocketGetStats(&stats_end);
+
+    p_sample->rx_cpu_ns_per_gb = (double)cpu_ns * ZEROCOPY_BENCH_BYTES_PER_GB / received;
+    p_sample->ns_per_call = (double)elapsed_ns / calls;
+    p_sample->mapped_ratio = (double)(stats_end.zerocopy_bytes_in - stats_start.zerocopy_bytes_in) / received;
+
+    return 0;
+}
+
+/// @brief Measures a read function for a given payload, then prints the result as a JSON line.
+/// @param impl Implementation name.
+/// @param read_fn Measured read function.
+/// @param fd Receiving socket.
+/// @param payload Maximum bytes per call.
+/// @param p_rx_cpu_ns_per_gb Target fastest receiving CPU time per GB.
+/// @return 0 if succeeded, < 0 if any call failed.
+static int ZeroCopyBenchMeasure(const char* impl, ZEROCOPY_BENCH_READ_FN read_fn, const int fd, const unsigned long payload, double* p_rx_cpu_ns_per_gb)
+{
+    ZEROCOPY_BENCH_SAMPLE samples[ZEROCOPY_BENCH_MAX_REPEATS];
+
+    // Discard a first run: caches and the TCP congestion window need to warm up.
+    if(ZeroCopyBenchRun(read_fn, fd, payload, &samples[0]) < 0)
+        return -1;
+
+    for(int i = 0; i < repeats; i++)
+        if(ZeroCopyBenchRun(read_fn, fd, payload, &samples[i]) < 0)
+            return -1;
+
+    qsort(samples, repeats, sizeof(ZEROCOPY_BENCH_SAMPLE), ZeroCopyBenchCompare);
+
+    *p_rx_cpu_ns_per_gb = samples[0].rx_cpu_ns_per_gb;
+
+    printf("{\"impl\":\"%s\",\"payload\":%lu,\"touch\":%s,\"rx_cpu_ns_per_gb\":%.0f,\"rx_cpu_ns_per_gb_median\":%.0f,"
+           "\"ns_per_call\":%.1f,\"mapped_ratio\":%.3f}\n",
+           impl, payload, (no_touch ? "false" : "true"), samples[0].rx_cpu_ns_per_gb, samples[repeats / 2].rx_cpu_ns_per_gb,
+           samples[0].ns_per_call, samples[0].mapped_ratio);
+
+    return 0;
+}
+
+/*
+@brief Main function. Program's entry point.
+*/
+int main(int argc, char** argv)
+{
+    SetOptionDefinitionInt(     DATA_SIZE_OPT_CHAR          ,
+                                DATA_SIZE_OPT_LONG          ,
+                                DATA_SIZE_OPT_DETAIL        ,
+                                DATA_SIZE_MIN_VALUE         ,
+                                DATA_SIZE_MAX_VALUE         ,
+                                DATA_SIZE_DEFAULT_VALUE     ,
+                                &data_mb                    );
+
+    SetOptionDefinitionInt(     REPEATS_OPT_CHAR            ,
+                                REPEATS_OPT_LONG            ,
+                                REPEATS_OPT_DETAIL          ,
+                                REPEATS_MIN_VALUE           ,
+                                REPEATS_MAX_VALUE           ,
+                                REPEATS_DEFAULT_VALUE       ,
+                                &repeats                    );
+
+    SetOptionDefinitionBool(    TOUCH_OPT_CHAR              ,
+                                TOUCH_OPT_LONG              ,
+                                TOUCH_OPT_DETAIL            ,
+                                TOUCH_DEFAULT_VALUE         ,
+                                &no_touch                   );
+
+    if(ParseOptions(argc, argv) < 0)
+        return ZEROCOPY_BENCH_ERR_ARGS;
+
+    // Every read size is mapped whenever possible, so the threshold can be told from the results.
+    ServerSocketSetZeroCopyReceive(ZEROCOPY_BENCH_MAX_PAYLOAD, 0);
+
+    read_buffer = malloc(ZEROCOPY_BENCH_MAX_PAYLOAD);
+
+    int fds[2];
+    pthread_t sender_thread;
+
+    if(!read_buffer || ZeroCopyBenchLoopbackPair(fds) < 0 || pthread_create(&sender_thread, NULL, ZeroCopyBenchSenderRoutine, &fds[1]) != 0)
+    {
+        fprintf(stderr, ZEROCOPY_BENCH_MSG_SETUP_ERR, "loopback sender");
+        return ZEROCOPY_BENCH_ERR_SETUP;
+    }
+
+    unsigned long threshold = 0;
+
+    for(unsigned int payload_idx = 0; payload_idx < sizeof(payloads) / sizeof(payloads[0]); payload_idx++)
+    {
+        double read_cpu_ns_per_gb;
+        double zerocopy_cpu_ns_per_gb;
+
+        if(ZeroCopyBenchMeasure("read", ZeroCopyBenchRead, fds[0], payloads[payload_idx], &read_cpu_ns_per_gb) < 0 ||
+           ZeroCopyBenchMeasure("zerocopy", ZeroCopyBenchReadZeroCopy, fds[0], payloads[payload_idx], &zerocopy_cpu_ns_per_gb) < 0)
+        {
+            fprintf(stderr, ZEROCOPY_BENCH_MSG_RUN_ERR, "connection lost");
+            return ZEROCOPY_BENCH_ERR_RUN;
+        }
+
+        // Smallest read size from which mapping keeps beating copying.
+        if(zerocopy_cpu_ns_per_gb >= read_cpu_ns_per_gb)
+            threshold = 0;
+        else if(threshold == 0)
+            threshold = payloads[payload_idx];
+    }
+
+    printf("{\"threshold\":%lu}\n", threshold);
+
+    fflush(stdout);
+
+    sender_stop = true;
+    shutdown(fds[0], SHUT_RDWR);
+    pthread_join(sender_thread, NULL);
+
+    close(fds[0]);
+    close(fds[1]);
+    free(read_buffer);
+
+    return 0;
+}
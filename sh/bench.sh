@@ -0,0 +1,176 @@
+#!/bin/bash
+
+DEFAULT_BENCH_PORT=55556
+DEFAULT_MAX_CLIENTS=1024
+DEFAULT_CONN_NUM=64
+DEFAULT_THREAD_NUM=4
+DEFAULT_DURATION_S=10
+DEFAULT_REQUEST_SIZE=64
+DEFAULT_RESPONSE_SIZE=1024
+DEFAULT_LOW_LATENCY_CONN_NUM=1
+DEFAULT_SPIN_US=50
+COMPRESS_LEVELS="0 1 6 9"
+FANOUT_CONN_NUMS="1000 10000"
+DEFAULT_BROADCAST_US=100000
+DEFAULT_MICRO_PORT=55557
+DEFAULT_MICRO_MAX_TABLE_SIZE=256
+DEFAULT_CPP_PORT=55558
+
+# Maximum ns per call any library wrapper may add to the raw call (0 disables the check).
+MICRO_BENCH_MAX_OVERHEAD_NS=${MICRO_BENCH_MAX_OVERHEAD_NS:-0}
+
+CONFIG_FILE="config.xml"
+
+PATH_TO_THIS="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+PATH_TO_LIB_ROOT="$(dirname ${PATH_TO_THIS})"
+PATH_TO_TEST_DEPS="$( xmlstarlet sel -t -v "config/test/deps/@Dest" ${CONFIG_FILE})"
+PATH_TO_TEST_DEP_DYN_LIBS=${PATH_TO_LIB_ROOT}/${PATH_TO_TEST_DEPS}/lib
+
+CERTIFICATE_TEST_DIR="$(realpath $(dirname $(realpath ${0}))/../certificate_test)"
+CERTIFICATE_PATH="${CERTIFICATE_TEST_DIR}/certificate.crt"
+PKEY_PATH="${CERTIFICATE_TEST_DIR}/private.key"
+CERT_TEST_SCRIPT_PATH="$(realpath $(dirname $(realpath ${0}))/create_self_signed_cert.sh)"
+
+CERT_CREATION_MSG="Creating testing self-signed certificate ..."
+
+BENCH_SERVER=./bench/exe/bench_server
+LOAD_GEN=./bench/exe/load_gen
+MICRO_BENCH=./bench/exe/micro_bench
+CPP_BENCH=./bench/exe/cpp_bench
+ZEROCOPY_BENCH=./bench/exe/zerocopy_bench
+BENCH_RESULTS=./bench/exe/results.json
+MICRO_BENCH_RESULTS=./bench/exe/micro_results.json
+CPP_BENCH_RESULTS=./bench/exe/cpp_results.json
+ZEROCOPY_BENCH_RESULTS=./bench/exe/zerocopy_results.json
+
+export LD_LIBRARY_PATH=${PATH_TO_TEST_DEP_DYN_LIBS}
+
+# Erase the directory and its content if it exists, then create both the certificate and the private key again.
+if [ ! -d ${CERTIFICATE_TEST_DIR} ] || [ ! -f ${CERTIFICATE_PATH} ] || [ ! -f ${PKEY_PATH} ]
+then
+    rm -rf ${CERTIFICATE_TEST_DIR}
+
+    echo "${CERT_CREATION_MSG}"
+
+    $(${CERT_TEST_SCRIPT_PATH})
+fi
+
+# Runs a single workload against a freshly started server.
+# $1: workload, $2: secure ("-s" or empty), $3: server response size (0 echoes data back),
+# $4: server spin time in microseconds (optional, 0 by default), $5: connections (optional),
+# $6: compression level (optional, 0 by default), $7: broadcast period in microseconds (optional, 0 by default).
+run_workload()
+{
+    local spin_us=${4:-0}
+    local conn_num=${5:-${DEFAULT_CONN_NUM}}
+    local compress_level=${6:-0}
+    local broadcast_us=${7:-0}
+    local max_clients=$(( conn_num > DEFAULT_MAX_CLIENTS ? conn_num : DEFAULT_MAX_CLIENTS ))
+
+    ${BENCH_SERVER} -r ${DEFAULT_BENCH_PORT} -m ${max_clients} -z ${3} -b ${spin_us} -e ${compress_level} -n ${broadcast_us} ${2} -c ${CERTIFICATE_PATH} -k ${PKEY_PATH} > /dev/null 2>&1 &
+    local server_pid=$!
+
+    # Give the server some time to start listening.
+    sleep 1
+
+    ${LOAD_GEN} -r ${DEFAULT_BENCH_PORT} -c ${conn_num} -n ${DEFAULT_THREAD_NUM} -d ${DEFAULT_DURATION_S} \
+                -w ${1} -q ${DEFAULT_REQUEST_SIZE} -z ${DEFAULT_RESPONSE_SIZE} -e ${compress_level} -p ${server_pid} ${2} | tee -a ${BENCH_RESULTS}
+
+    kill -INT ${server_pid}
+    wait ${server_pid}
+}
+
+echo
+echo "************************************"
+echo "Running benchmarks (JSON lines output)."
+echo "************************************"
+
+rm -f ${BENCH_RESULTS}
+
+for secure in "" "-s"
+do
+    run_workload echo       "${secure}" 0
+    run_workload reqresp    "${secure}" ${DEFAULT_RESPONSE_SIZE}
+    run_workload churn      "${secure}" 0
+done
+
+echo
+echo "************************************"
+echo "Running low-latency mode trade-off (server CPU usage vs latency, blocking then spinning reads)."
+echo "************************************"
+
+for spin_us in 0 ${DEFAULT_SPIN_US}
+do
+    run_workload reqresp "" ${DEFAULT_RESPONSE_SIZE} ${spin_us} ${DEFAULT_LOW_LATENCY_CONN_NUM}
+done
+
+echo
+echo "************************************"
+echo "Running compression trade-off (bytes on wire vs server CPU per request)."
+echo "************************************"
+
+for compress_level in ${COMPRESS_LEVELS}
+do
+    run_workload reqresp "" ${DEFAULT_RESPONSE_SIZE} 0 ${DEFAULT_CONN_NUM} ${compress_level}
+done
+
+echo
+echo "************************************"
+echo "Running fan-out latency (from broadcast to each recipient getting the whole message)."
+echo "************************************"
+
+for secure in "" "-s"
+do
+    for conn_num in ${FANOUT_CONN_NUMS}
+    do
+        run_workload fanout "${secure}" ${DEFAULT_RESPONSE_SIZE} 0 ${conn_num} 0 ${DEFAULT_BROADCAST_US}
+    done
+done
+
+echo
+echo "************************************"
+echo "Running I/O micro benchmarks (ns per call)."
+echo "************************************"
+
+rm -f ${MICRO_BENCH_RESULTS}
+micro_bench_failed=0
+
+for secure in "" "-s"
+do
+    ${MICRO_BENCH} -r ${DEFAULT_MICRO_PORT} -m ${DEFAULT_MICRO_MAX_TABLE_SIZE} -x ${MICRO_BENCH_MAX_OVERHEAD_NS} ${secure} \
+                   -c ${CERTIFICATE_PATH} -k ${PKEY_PATH} 2> /dev/null | tee -a ${MICRO_BENCH_RESULTS}
+
+    if [ ${PIPESTATUS[0]} -ne 0 ]
+    then
+        micro_bench_failed=1
+    fi
+done
+
+echo
+echo "************************************"
+echo "Running C++ front-end comparison (ns per request, interaction function pointer vs templated handlers)."
+echo "************************************"
+
+rm -f ${CPP_BENCH_RESULTS}
+
+for impl in c cpp cpp_raw
+do
+    ${CPP_BENCH} -r ${DEFAULT_CPP_PORT} -w ${impl} -c ${CERTIFICATE_PATH} -k ${PKEY_PATH} 2> /dev/null | tee -a ${CPP_BENCH_RESULTS}
+done
+
+for impl in c cpp
+do
+    ${CPP_BENCH} -r ${DEFAULT_CPP_PORT} -w ${impl} -s -c ${CERTIFICATE_PATH} -k ${PKEY_PATH} 2> /dev/null | tee -a ${CPP_BENCH_RESULTS}
+done
+
+echo
+echo "************************************"
+echo "Running zero-copy receive comparison (receiving CPU per GB, read vs mapped pages, by read size)."
+echo "************************************"
+
+${ZEROCOPY_BENCH} 2> /dev/null | tee ${ZEROCOPY_BENCH_RESULTS}
+
+echo
+echo "Results stored in ${BENCH_RESULTS}, ${MICRO_BENCH_RESULTS}, ${CPP_BENCH_RESULTS} and ${ZEROCOPY_BENCH_RESULTS}"
+
+exit ${micro_bench_failed}
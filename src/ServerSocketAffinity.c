@@ -0,0 +1,255 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // CPU sets, pthread_attr_setaffinity_np.
+#include <sched.h>
+#include <stdio.h>              // Parse NUMA topology.
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/filter.h>       // Reuseport steering program.
+#include "ServerSocketAffinity.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_AFFINITY_SUCCESS          0
+#define SERVER_SOCKET_AFFINITY_ERR_GET_MASK     -1
+#define SERVER_SOCKET_AFFINITY_ERR_PIN          -2
+#define SERVER_SOCKET_AFFINITY_ERR_ATTR         -3
+
+#define SERVER_SOCKET_AFFINITY_NO_CPU           -1
+#define SOCKET_AFFINITY_MAX_NODES               64
+#define SOCKET_AFFINITY_NODE_CPULIST_PATH       "/sys/devices/system/node/node%d/cpulist"
+#define SOCKET_AFFINITY_LEN_PATH                64
+
+#define SERVER_SOCKET_MSG_AFFINITY_PIN_NOK      "Could not pin accepting thread to CPU <%d>."
+#define SERVER_SOCKET_MSG_AFFINITY_PIN_OK       "Accepting thread pinned to CPU <%d>."
+#define SERVER_SOCKET_MSG_AFFINITY_CBPF_NOK     "Could not attach reuseport steering program, listeners are picked by hash."
+#define SERVER_SOCKET_MSG_AFFINITY_NODES        "<%d> NUMA nodes found."
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static SERVER_SOCKET_AFFINITY affinity_policy = SERVER_SOCKET_AFFINITY_NONE;
+static int affinity_accept_cpu = SERVER_SOCKET_AFFINITY_NO_CPU;
+
+/// @brief CPUs the process was allowed to run on before the accepting thread got pinned.
+static cpu_set_t affinity_process_cpus;
+/// @brief CPUs found in each NUMA node, as well as the node each CPU belongs to.
+static cpu_set_t affinity_node_cpus[SOCKET_AFFINITY_MAX_NODES];
+static unsigned char affinity_cpu_node[CPU_SETSIZE];
+static int affinity_nodes_num = 0;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static void SocketAffinityParseCPUList(const char* cpu_list, cpu_set_t* p_cpus);
+static void SocketAffinityLoadNodes(void);
+static int SocketAffinityAttachSteering(int socket_desc);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Parses a kernel CPU list (such as "0-3,8-11").
+/// @param cpu_list CPU list.
+/// @param p_cpus Target CPU set.
+static void SocketAffinityParseCPUList(const char* cpu_list, cpu_set_t* p_cpus)
+{
+    CPU_ZERO(p_cpus);
+
+    while(*cpu_list)
+    {
+        int first_cpu, last_cpu, consumed = 0;
+
+        // Either a range or a single CPU.
+        if(sscanf(cpu_list, "%d-%d%n", &first_cpu, &last_cpu, &consumed) != 2)
+        {
+            if(sscanf(cpu_list, "%d%n", &first_cpu, &consumed) != 1)
+                return;
+
+            last_cpu = first_cpu;
+        }
+
+        if(first_cpu < 0 || consumed <= 0)
+            return;
+
+        for(int cpu = first_cpu; cpu <= last_cpu && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, p_cpus);
+
+        cpu_list += consumed;
+
+        if(*cpu_list == ',')
+            cpu_list++;
+    }
+}
+
+/// @brief Loads NUMA topology from sysfs. Single node machines (or missing sysfs) end up with every CPU in node 0.
+static void SocketAffinityLoadNodes(void)
+{
+    memset(affinity_cpu_node, 0, sizeof(affinity_cpu_node));
+    affinity_nodes_num = 0;
+
+    for(int node = 0; node < SOCKET_AFFINITY_MAX_NODES; node++)
+    {
+        char node_path[SOCKET_AFFINITY_LEN_PATH];
+        char cpu_list[BUFSIZ] = {0};
+
+        snprintf(node_path, sizeof(node_path), SOCKET_AFFINITY_NODE_CPULIST_PATH, node);
+
+        FILE* p_node_file = fopen(node_path, "r");
+
+        if(!p_node_file)
+            break;
+
+        if(!fgets(cpu_list, sizeof(cpu_list), p_node_file))
+            cpu_list[0] = 0;
+
+        fclose(p_node_file);
+
+        cpu_list[strcspn(cpu_list, "\n")] = 0;
+
+        SocketAffinityParseCPUList(cpu_list, &affinity_node_cpus[node]);
+
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if(CPU_ISSET(cpu, &affinity_node_cpus[node]))
+                affinity_cpu_node[cpu] = node;
+
+        affinity_nodes_num++;
+    }
+
+    if(affinity_nodes_num == 0)
+    {
+        affinity_node_cpus[0] = affinity_process_cpus;
+        affinity_nodes_num = 1;
+    }
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_AFFINITY_NODES, affinity_nodes_num);
+}
+
+/// @brief Attaches a reuseport program picking the listener whose index matches the CPU the connection came in on.
+/// Listeners falling out of the group size are picked by hash, as usual.
+/// @param socket_desc Listening socket.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketAffinityAttachSteering(const int socket_desc)
+{
+    struct sock_filter steering_code[] =
+    {
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_RET | BPF_A,           0, 0, 0                       },
+    };
+
+    struct sock_fprog steering_program =
+    {
+        .len    = sizeof(steering_code) / sizeof(steering_code[0]),
+        .filter = steering_code,
+    };
+
+    return setsockopt(socket_desc, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &steering_program, sizeof(steering_program));
+}
+
+/// @brief Sets CPU affinity. To be called before ServerSocketRun.
+/// @param policy Where serving threads are meant to run (SERVER_SOCKET_AFFINITY_NONE by default).
+/// @param accept_cpu CPU the accepting thread is meant to be pinned to, < 0 not to pin it (default).
+void ServerSocketSetCPUAffinity(const SERVER_SOCKET_AFFINITY policy, const int accept_cpu)
+{
+    affinity_policy = policy;
+    affinity_accept_cpu = (accept_cpu >= 0 && accept_cpu < CPU_SETSIZE ? accept_cpu : SERVER_SOCKET_AFFINITY_NO_CPU);
+}
+
+/// @brief Tells whether CPU affinity is enabled or not.
+/// @return True if either serving threads or accepting thread are meant to be pinned, false otherwise.
+bool SocketAffinityEnabled(void)
+{
+    return (affinity_policy != SERVER_SOCKET_AFFINITY_NONE || affinity_accept_cpu != SERVER_SOCKET_AFFINITY_NO_CPU);
+}
+
+/// @brief Performs CPU affinity setup: loads NUMA topology and pins the calling (accepting) thread.
+/// If the port is shared, a steering program is attached so every listener gets connections from its own CPU.
+/// @param socket_desc Listening socket.
+/// @param reuse_port Tells whether the port is shared by several listeners.
+/// @return 0 if succeeded, < 0 otherwise (serving threads are not pinned then).
+int SocketAffinitySetup(const int socket_desc, const bool reuse_port)
+{
+    if(sched_getaffinity(0, sizeof(affinity_process_cpus), &affinity_process_cpus) < 0)
+    {
+        affinity_policy = SERVER_SOCKET_AFFINITY_NONE;
+        affinity_accept_cpu = SERVER_SOCKET_AFFINITY_NO_CPU;
+        return SERVER_SOCKET_AFFINITY_ERR_GET_MASK;
+    }
+
+    SocketAffinityLoadNodes();
+
+    if(affinity_accept_cpu == SERVER_SOCKET_AFFINITY_NO_CPU)
+        return SERVER_SOCKET_AFFINITY_SUCCESS;
+
+    cpu_set_t accept_cpus;
+    CPU_ZERO(&accept_cpus);
+    CPU_SET(affinity_accept_cpu, &accept_cpus);
+
+    if(pthread_setaffinity_np(pthread_self(), sizeof(accept_cpus), &accept_cpus) != 0)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_AFFINITY_PIN_NOK, affinity_accept_cpu);
+        affinity_accept_cpu = SERVER_SOCKET_AFFINITY_NO_CPU;
+        return SERVER_SOCKET_AFFINITY_ERR_PIN;
+    }
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_AFFINITY_PIN_OK, affinity_accept_cpu);
+
+    if(reuse_port && SocketAffinityAttachSteering(socket_desc) < 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_AFFINITY_CBPF_NOK);
+
+    return SERVER_SOCKET_AFFINITY_SUCCESS;
+}
+
+/// @brief Sets serving thread's CPU affinity according to the CPU the connection came in on (SO_INCOMING_CPU).
+/// Threads which are not meant to be pinned get the whole process mask back, as they would inherit the accepting one otherwise.
+/// @param client_socket Accepted client socket.
+/// @param p_attr Initialized thread attributes to be set.
+/// @return 1 if attributes were set, 0 if default attributes are fine, < 0 if any error happened.
+int SocketAffinityWorkerAttr(const int client_socket, pthread_attr_t* p_attr)
+{
+    if(!SocketAffinityEnabled())
+        return 0;
+
+    int incoming_cpu = SERVER_SOCKET_AFFINITY_NO_CPU;
+    socklen_t incoming_cpu_len = sizeof(incoming_cpu);
+
+    if(affinity_policy != SERVER_SOCKET_AFFINITY_NONE)
+        getsockopt(client_socket, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, &incoming_cpu_len);
+
+    bool incoming_cpu_allowed = (incoming_cpu >= 0 && incoming_cpu < CPU_SETSIZE && CPU_ISSET(incoming_cpu, &affinity_process_cpus));
+
+    cpu_set_t worker_cpus = affinity_process_cpus;
+
+    if(incoming_cpu_allowed && affinity_policy == SERVER_SOCKET_AFFINITY_CPU)
+    {
+        CPU_ZERO(&worker_cpus);
+        CPU_SET(incoming_cpu, &worker_cpus);
+    }
+    else if(incoming_cpu_allowed && affinity_policy == SERVER_SOCKET_AFFINITY_NODE)
+        CPU_AND(&worker_cpus, &affinity_process_cpus, &affinity_node_cpus[affinity_cpu_node[incoming_cpu]]);
+    else if(affinity_accept_cpu == SERVER_SOCKET_AFFINITY_NO_CPU)
+        return 0;
+
+    if(CPU_COUNT(&worker_cpus) == 0 || pthread_attr_setaffinity_np(p_attr, sizeof(worker_cpus), &worker_cpus) != 0)
+        return SERVER_SOCKET_AFFINITY_ERR_ATTR;
+
+    return 1;
+}
+
+/*************************************/
@@ -0,0 +1,23 @@
+#ifndef SERVER_SOCKET_AFFINITY_H
+#define SERVER_SOCKET_AFFINITY_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/************************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketAffinityEnabled(void);
+int SocketAffinitySetup(int socket_desc, bool reuse_port);
+int SocketAffinityWorkerAttr(int client_socket, pthread_attr_t* p_attr);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,441 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // IOV_MAX.
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>            // writev.
+#include "ServerSocketBatch.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketCache.h"
+#include "ServerSocketFraming.h"
+#include "ServerSocketCompress.h"
+#include "ServerSocketShm.h"
+#include "ServerSocketSSL.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocket_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_BATCH_SUCCESS         0
+#define SERVER_SOCKET_BATCH_ERR_ALLOC       -1
+#define SERVER_SOCKET_BATCH_ERR_WRITE       -2
+#define SERVER_SOCKET_BATCH_ERR_FRAMING     -3
+#define SERVER_SOCKET_BATCH_GO_ON           1
+
+#define SOCKET_BATCH_MAX_REQUESTS           64
+#define SOCKET_BATCH_INITIAL_ARENA_SIZE     4096
+#define SOCKET_BATCH_INITIAL_SEGMENTS       16
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Response chunk. Either copied into the arena (p_data is NULL then) or referenced.
+typedef struct
+{
+    const char*     p_data;
+    unsigned long   arena_offset;
+    unsigned long   size;
+} SOCKET_BATCH_SEGMENT;
+
+/// @brief Responses collected while handling a batch of requests.
+struct SERVER_SOCKET_BATCH
+{
+    char*                   p_arena;
+    unsigned long           arena_used;
+    unsigned long           arena_size;
+    SOCKET_BATCH_SEGMENT*   p_segments;
+    int                     segments_num;
+    int                     segments_size;
+    struct iovec*           p_iov;
+    SOCKET_CACHE_ENTRY*     p_cached[SOCKET_BATCH_MAX_REQUESTS];    // Cached responses, held until they have been sent.
+    int                     cached_num;
+};
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static SERVER_SOCKET_BATCH_FN batch_fn = NULL;
+
+/// @brief Batch of the connection served by the current thread. Buffers are kept from one batch to the next one.
+static __thread SERVER_SOCKET_BATCH thread_batch;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int SocketBatchReserveArena(SERVER_SOCKET_BATCH* p_batch, unsigned long size);
+static int SocketBatchAddSegment(SERVER_SOCKET_BATCH* p_batch, const char* p_data, unsigned long arena_offset, unsigned long size);
+static void SocketBatchAccountWrite(ssize_t write_result);
+static int SocketBatchFlushVectored(int client_socket, SERVER_SOCKET_BATCH* p_batch);
+static int SocketBatchFlushTLS(int client_socket, SERVER_SOCKET_BATCH* p_batch);
+static int SocketBatchHandleCached(int client_socket, const SERVER_SOCKET_MESSAGE* p_requests, int requests_num, SERVER_SOCKET_BATCH* p_batch);
+static void SocketBatchReleaseCached(SERVER_SOCKET_BATCH* p_batch);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Makes sure the arena can take a given amount of extra bytes.
+/// @param p_batch Target batch.
+/// @param size Amount of bytes to be appended.
+/// @return 0 if succeeded, < 0 if arena could not be grown.
+static int SocketBatchReserveArena(SERVER_SOCKET_BATCH* p_batch, const unsigned long size)
+{
+    if(p_batch->arena_used + size <= p_batch->arena_size)
+        return SERVER_SOCKET_BATCH_SUCCESS;
+
+    unsigned long arena_size = (p_batch->arena_size ? p_batch->arena_size : SOCKET_BATCH_INITIAL_ARENA_SIZE);
+
+    while(arena_size < p_batch->arena_used + size)
+        arena_size <<= 1;
+
+    char* p_arena = realloc(p_batch->p_arena, arena_size);
+
+    if(!p_arena)
+        return SERVER_SOCKET_BATCH_ERR_ALLOC;
+
+    p_batch->p_arena = p_arena;
+    p_batch->arena_size = arena_size;
+
+    return SERVER_SOCKET_BATCH_SUCCESS;
+}
+
+/// @brief Appends a response chunk, merging it with the previous one if both are contiguous within the arena.
+/// @param p_batch Target batch.
+/// @param p_data Referenced data, NULL if data is found in the arena.
+/// @param arena_offset Data offset within the arena (ignored for referenced data).
+/// @param size Data size.
+/// @return 0 if succeeded, < 0 if segments array could not be grown.
+static int SocketBatchAddSegment(SERVER_SOCKET_BATCH* p_batch, const char* p_data, const unsigned long arena_offset, const unsigned long size)
+{
+    SOCKET_BATCH_SEGMENT* p_last = (p_batch->segments_num > 0 ? &p_batch->p_segments[p_batch->segments_num - 1] : NULL);
+
+    if(!p_data && p_last && !p_last->p_data && p_last->arena_offset + p_last->size == arena_offset)
+    {
+        p_last->size += size;
+        return SERVER_SOCKET_BATCH_SUCCESS;
+    }
+
+    if(p_batch->segments_num == p_batch->segments_size)
+    {
+        int segments_size = (p_batch->segments_size ? 2 * p_batch->segments_size : SOCKET_BATCH_INITIAL_SEGMENTS);
+
+        SOCKET_BATCH_SEGMENT* p_segments = realloc(p_batch->p_segments, segments_size * sizeof(SOCKET_BATCH_SEGMENT));
+        struct iovec* p_iov = realloc(p_batch->p_iov, segments_size * sizeof(struct iovec));
+
+        if(p_segments)
+            p_batch->p_segments = p_segments;
+
+        if(p_iov)
+            p_batch->p_iov = p_iov;
+
+        if(!p_segments || !p_iov)
+            return SERVER_SOCKET_BATCH_ERR_ALLOC;
+
+        p_batch->segments_size = segments_size;
+    }
+
+    p_batch->p_segments[p_batch->segments_num++] = (SOCKET_BATCH_SEGMENT)
+    {
+        .p_data         = p_data        ,
+        .arena_offset   = arena_offset  ,
+        .size           = size          ,
+    };
+
+    return SERVER_SOCKET_BATCH_SUCCESS;
+}
+
+/// @brief Updates I/O statistics (and pushes idle deadline forward) after a write.
+/// @param write_result Value returned by the write operation.
+static void SocketBatchAccountWrite(const ssize_t write_result)
+{
+    if(write_result > 0)
+    {
+        SocketStatsCount(SERVER_SOCKET_CNT_BYTES_OUT, write_result);
+        SocketStatsRecord(SERVER_SOCKET_HIST_WRITE_BYTES, write_result);
+        SocketTimerTouch();
+        SocketBufTuneTransferred(write_result);
+    }
+    else if(write_result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+}
+
+/// @brief Sends every response with as few vectored writes as possible (a single one unless the socket buffer fills up).
+/// @param client_socket Client socket.
+/// @param p_batch Responses.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketBatchFlushVectored(const int client_socket, SERVER_SOCKET_BATCH* p_batch)
+{
+    struct iovec* p_iov = p_batch->p_iov;
+    int iov_num = p_batch->segments_num;
+
+    // Arena may have moved while responses were being appended, so addresses are only resolved now.
+    for(int segment_idx = 0; segment_idx < iov_num; segment_idx++)
+    {
+        SOCKET_BATCH_SEGMENT* p_segment = &p_batch->p_segments[segment_idx];
+
+        p_iov[segment_idx].iov_base = (void*)(p_segment->p_data ? p_segment->p_data : p_batch->p_arena + p_segment->arena_offset);
+        p_iov[segment_idx].iov_len  = p_segment->size;
+    }
+
+    if(SocketShmActive())
+        return (SocketShmWritev(client_socket, p_iov, iov_num) < 0 ? SERVER_SOCKET_BATCH_ERR_WRITE : SERVER_SOCKET_BATCH_SUCCESS);
+
+    // Compressed connections get every response in as few frames as possible.
+    if(SocketCompressActive())
+        return (SocketCompressWritev(client_socket, p_iov, iov_num) < 0 ? SERVER_SOCKET_BATCH_ERR_WRITE : SERVER_SOCKET_BATCH_SUCCESS);
+
+    while(iov_num > 0)
+    {
+        ssize_t write_to_socket = writev(client_socket, p_iov, (iov_num < IOV_MAX ? iov_num : IOV_MAX));
+
+        SocketBatchAccountWrite(write_to_socket);
+
+        if(write_to_socket <= 0)
+        {
+            if(write_to_socket == 0 || ServerSocketRetryWrite(client_socket) < 0)
+                return SERVER_SOCKET_BATCH_ERR_WRITE;
+
+            continue;
+        }
+
+        // Skip whatever has been written already.
+        while(iov_num > 0 && (size_t)write_to_socket >= p_iov->iov_len)
+        {
+            write_to_socket -= p_iov->iov_len;
+            p_iov++;
+            iov_num--;
+        }
+
+        if(iov_num > 0)
+        {
+            p_iov->iov_base = (char*)p_iov->iov_base + write_to_socket;
+            p_iov->iov_len -= write_to_socket;
+        }
+    }
+
+    return SERVER_SOCKET_BATCH_SUCCESS;
+}
+
+/// @brief Sends every response with a single TLS write, so they share as few records as possible.
+/// Referenced chunks have already been copied into the arena, so responses are contiguous.
+/// @param client_socket Client socket.
+/// @param p_batch Responses.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketBatchFlushTLS(const int client_socket, SERVER_SOCKET_BATCH* p_batch)
+{
+    unsigned long written = 0;
+
+    while(written < p_batch->arena_used)
+    {
+        int write_to_socket = ServerSocketSSLWrite(p_batch->p_arena + written, p_batch->arena_used - written);
+
+        SocketBatchAccountWrite(write_to_socket);
+
+        if(write_to_socket <= 0)
+        {
+            if(write_to_socket == 0 || ServerSocketRetryWrite(client_socket) < 0)
+                return SERVER_SOCKET_BATCH_ERR_WRITE;
+
+            continue;
+        }
+
+        written += write_to_socket;
+    }
+
+    return SERVER_SOCKET_BATCH_SUCCESS;
+}
+
+/// @brief Answers requests found in the response cache straight from it, handing runs of the remaining ones to the
+/// batch handler in between, so responses keep requests' order.
+/// @param client_socket Client socket.
+/// @param p_requests Requests.
+/// @param requests_num Amount of requests.
+/// @param p_batch Batch responses are appended to.
+/// @return Last batch handler's return value (> 0 if every request was cached), <= 0 as soon as the handler returns so.
+static int SocketBatchHandleCached(const int client_socket, const SERVER_SOCKET_MESSAGE* p_requests, const int requests_num, SERVER_SOCKET_BATCH* p_batch)
+{
+    int batch = SERVER_SOCKET_BATCH_GO_ON;
+    int misses_start = 0;
+
+    for(int request_idx = 0; request_idx < requests_num; request_idx++)
+    {
+        SOCKET_CACHE_ENTRY* p_entry = SocketCacheLookup(p_requests[request_idx].data, p_requests[request_idx].size);
+
+        if(!p_entry)
+            continue;
+
+        if(request_idx > misses_start)
+            batch = batch_fn(client_socket, p_requests + misses_start, request_idx - misses_start, p_batch);
+
+        misses_start = request_idx + 1;
+
+        if(batch <= 0)
+        {
+            SocketCacheEntryRelease(p_entry);
+            return batch;
+        }
+
+        unsigned long response_size;
+        const char* response = SocketCacheEntryResponse(p_entry, &response_size);
+
+        p_batch->p_cached[p_batch->cached_num++] = p_entry;
+
+        if(ServerSocketBatchAppendRef(p_batch, response, response_size) < 0)
+            return SERVER_SOCKET_BATCH_ERR_ALLOC;
+    }
+
+    if(requests_num > misses_start)
+        batch = batch_fn(client_socket, p_requests + misses_start, requests_num - misses_start, p_batch);
+
+    return batch;
+}
+
+/// @brief Drops cached responses held by a batch, once it has been sent.
+/// @param p_batch Target batch.
+static void SocketBatchReleaseCached(SERVER_SOCKET_BATCH* p_batch)
+{
+    for(int cached_idx = 0; cached_idx < p_batch->cached_num; cached_idx++)
+        SocketCacheEntryRelease(p_batch->p_cached[cached_idx]);
+
+    p_batch->cached_num = 0;
+}
+
+/// @brief Sets a batch handler, which gets every complete request (see ServerSocketSetFraming) available after each read.
+/// @param fn Batch handler, NULL to go back to the interaction function.
+void ServerSocketSetBatchHandler(const SERVER_SOCKET_BATCH_FN fn)
+{
+    batch_fn = fn;
+}
+
+/// @brief Appends a response, copying its data.
+/// @param p_batch Batch the response belongs to.
+/// @param data Response data.
+/// @param size Response size.
+/// @return 0 if succeeded, < 0 otherwise.
+int ServerSocketBatchAppend(SERVER_SOCKET_BATCH* p_batch, const char* data, const unsigned long size)
+{
+    if(!p_batch || (!data && size > 0))
+        return SERVER_SOCKET_BATCH_ERR_ALLOC;
+
+    if(size == 0)
+        return SERVER_SOCKET_BATCH_SUCCESS;
+
+    if(SocketBatchReserveArena(p_batch, size) < 0)
+        return SERVER_SOCKET_BATCH_ERR_ALLOC;
+
+    unsigned long arena_offset = p_batch->arena_used;
+
+    memcpy(p_batch->p_arena + arena_offset, data, size);
+    p_batch->arena_used += size;
+
+    return SocketBatchAddSegment(p_batch, NULL, arena_offset, size);
+}
+
+/// @brief Appends a response without copying it (TLS connections copy it anyway, as records need contiguous data).
+/// @param p_batch Batch the response belongs to.
+/// @param data Response data. Must stay valid until the batch has been sent (after the handler returns),
+/// so it can point to request data, static or heap memory, but not to handler's stack.
+/// @param size Response size.
+/// @return 0 if succeeded, < 0 otherwise.
+int ServerSocketBatchAppendRef(SERVER_SOCKET_BATCH* p_batch, const char* data, const unsigned long size)
+{
+    if(ServerSocketIsSecure())
+        return ServerSocketBatchAppend(p_batch, data, size);
+
+    if(!p_batch || (!data && size > 0))
+        return SERVER_SOCKET_BATCH_ERR_ALLOC;
+
+    if(size == 0)
+        return SERVER_SOCKET_BATCH_SUCCESS;
+
+    return SocketBatchAddSegment(p_batch, data, 0, size);
+}
+
+/// @brief Tells whether a batch handler has been set or not.
+/// @return True if a batch handler has been set, false otherwise.
+bool SocketBatchEnabled(void)
+{
+    return (batch_fn != NULL);
+}
+
+/// @brief Interaction function used when a batch handler is set. Reads once, hands every complete request
+/// to the batch handler, then sends every response together.
+/// @param client_socket Client socket.
+/// @return Batch handler's return value (> 0 if interaction is meant to go on), <= 0 if reading or writing failed.
+int SocketBatchInteract(int client_socket)
+{
+    SERVER_SOCKET_MESSAGE requests[SOCKET_BATCH_MAX_REQUESTS];
+    SERVER_SOCKET_BATCH* p_batch = &thread_batch;
+
+    // errno is only looked at if reading failed, so a value left by any earlier call must not be taken for a timeout.
+    errno = 0;
+
+    int requests_num = SocketFramingReadBatch(client_socket, requests, SOCKET_BATCH_MAX_REQUESTS, SERVER_SOCKET_WAIT_FOREVER);
+
+    // Malformed data would be found again on every call, so the connection is over.
+    if(requests_num == SOCKET_FRAMING_ERR_PROTOCOL)
+        return SERVER_SOCKET_BATCH_ERR_FRAMING;
+
+    // Receive timeouts just mean the client is idle.
+    if(requests_num < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+
+    if(requests_num == 0)
+        return 0;
+
+    p_batch->arena_used = 0;
+    p_batch->segments_num = 0;
+
+    // Requests whose response is cached never reach the handler.
+    int batch = (SocketCacheEnabled() ? SocketBatchHandleCached(client_socket, requests, requests_num, p_batch) : batch_fn(client_socket, requests, requests_num, p_batch));
+
+    if(p_batch->segments_num > 0)
+    {
+        int flush_batch = (ServerSocketIsSecure() && !SocketCompressActive() && !SocketShmActive() ? SocketBatchFlushTLS(client_socket, p_batch) : SocketBatchFlushVectored(client_socket, p_batch));
+
+        if(flush_batch < 0)
+        {
+            SocketBatchReleaseCached(p_batch);
+            return flush_batch;
+        }
+    }
+
+    SocketBatchReleaseCached(p_batch);
+
+    return batch;
+}
+
+/// @brief Frees batch buffers of the connection served by the current thread. To be called once the connection is over.
+void SocketBatchRelease(void)
+{
+    SocketBatchReleaseCached(&thread_batch);
+
+    free(thread_batch.p_arena);
+    free(thread_batch.p_segments);
+    free(thread_batch.p_iov);
+
+    thread_batch = (SERVER_SOCKET_BATCH){0};
+}
+
+/*************************************/
@@ -0,0 +1,22 @@
+#ifndef SERVER_SOCKET_BATCH_H
+#define SERVER_SOCKET_BATCH_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketBatchEnabled(void);
+int SocketBatchInteract(int client_socket);
+void SocketBatchRelease(void);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,635 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // ppoll.
+#include <pthread.h>
+#include <signal.h>             // Serving threads waiting for data are woken up with a signal.
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>             // IOV_MAX
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>       // Broadcast table is sized after the descriptor limit.
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_BROADCAST_SUCCESS         0
+#define SERVER_SOCKET_BROADCAST_ERR_DISABLED    -1
+#define SERVER_SOCKET_BROADCAST_ERR_BUFFER      -2
+#define SERVER_SOCKET_BROADCAST_ERR_ALLOC       -3
+#define SERVER_SOCKET_BROADCAST_ERR_SIGNAL      -4
+#define SERVER_SOCKET_BROADCAST_ERR_WRITE       -5
+
+#define SOCKET_BROADCAST_DISABLED               0
+#define SOCKET_BROADCAST_QUEUE_LEN              64              // Buffers queued per connection, at most.
+#define SOCKET_BROADCAST_MAX_FDS                (1UL << 20)     // Table entries, at most (8MB of address space).
+#define SOCKET_BROADCAST_SIGNAL                 SIGURG          // Ignored by default, and TCP urgent data is hardly ever used.
+#define SOCKET_BROADCAST_US_PER_SEC             1000000L
+#define SOCKET_BROADCAST_NS_PER_US              1000L
+
+#define SERVER_SOCKET_MSG_BROADCAST_SETUP_NOK   "Could not set broadcasting up, broadcasts will not be delivered."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Buffer shared by every connection it is queued on. Only freed once the last one is done with it.
+struct SERVER_SOCKET_BUFFER
+{
+    unsigned long   refs;
+    unsigned long   size;
+    char            data[];
+};
+
+/// @brief Broadcast state of a connection. Entries are kept per descriptor number and reused by later connections
+/// getting the same descriptor, so broadcasters never touch freed memory.
+struct SOCKET_BROADCAST_CONN
+{
+    pthread_mutex_t         mtx;            // Guards everything below.
+    pthread_t               owner;          // Serving thread.
+    bool                    attached;
+    bool                    direct;         // Plain connection: broadcasters write to it themselves while its owner waits for data.
+    bool                    waiting;        // Owner is waiting for client data (or for broadcasts), so nothing else is being written.
+    bool                    kicked;         // Owner has been signalled and has not taken queued buffers since.
+    SERVER_SOCKET_BUFFER*   queue[SOCKET_BROADCAST_QUEUE_LEN];
+    unsigned int            queue_head;     // Oldest queued buffer.
+    unsigned int            queue_num;
+    unsigned long           first_offset;   // Bytes of the oldest queued buffer already sent.
+    unsigned long           queued_bytes;
+    long                    rx_timeout_us;  // Socket's own receive timeout, SERVER_SOCKET_WAIT_FOREVER if there is none.
+};
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long            broadcast_max_queued    = SOCKET_BROADCAST_DISABLED;
+static SOCKET_BROADCAST_CONN**  p_broadcast_conns       = NULL;     // Indexed by client socket.
+static unsigned long            broadcast_conns_size    = 0;
+static int                      broadcast_high_fd       = -1;       // Highest client socket ever attached.
+
+/// @brief Signal mask serving threads wait for data with (the one they run with, broadcast signal unblocked).
+static __thread sigset_t        thread_wait_mask;
+
+/// @brief Tells whether the current thread is writing queued buffers, as TLS and compressed connections write them
+/// through ServerSocketWrite, which may try to write queued buffers again.
+static __thread bool            thread_flushing;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread SOCKET_BROADCAST_CONN* p_socket_broadcast_current = NULL;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static void SocketBroadcastSignalHandler(int signal_num);
+static void SocketBroadcastBufferRef(SERVER_SOCKET_BUFFER* p_buffer);
+static void SocketBroadcastDropQueue(SOCKET_BROADCAST_CONN* p_conn);
+static bool SocketBroadcastDeliver(SOCKET_BROADCAST_CONN* p_conn, int client_socket, SERVER_SOCKET_BUFFER* p_buffer);
+static int SocketBroadcastSendPlain(int client_socket, struct iovec* p_iov, int iov_num);
+static int SocketBroadcastSendOwned(int client_socket, const struct iovec* p_iov, int iov_num);
+static int SocketBroadcastFlush(int client_socket);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Broadcast signal handler. It does nothing: the signal is only there to interrupt the wait for client data.
+/// @param signal_num Signal number.
+static void SocketBroadcastSignalHandler(const int signal_num)
+{
+    (void)signal_num;
+}
+
+/// @brief Takes a reference on a buffer.
+/// @param p_buffer Buffer.
+static void SocketBroadcastBufferRef(SERVER_SOCKET_BUFFER* p_buffer)
+{
+    __atomic_add_fetch(&p_buffer->refs, 1, __ATOMIC_RELAXED);
+}
+
+/// @brief Releases every queued buffer. Connection lock must be held.
+/// @param p_conn Connection.
+static void SocketBroadcastDropQueue(SOCKET_BROADCAST_CONN* p_conn)
+{
+    for(unsigned int queued_idx = 0; queued_idx < p_conn->queue_num; queued_idx++)
+        ServerSocketBufferRelease(p_conn->queue[(p_conn->queue_head + queued_idx) % SOCKET_BROADCAST_QUEUE_LEN]);
+
+    p_conn->queue_head = 0;
+    p_conn->queue_num = 0;
+    p_conn->first_offset = 0;
+    p_conn->queued_bytes = 0;
+}
+
+/// @brief Hands a buffer over to a connection. Plain connections whose owner is waiting for data get it written straight
+/// away (without blocking), while the rest is queued for the owner to write, so slow clients only hold up their own thread.
+/// Connection lock must be held.
+/// @param p_conn Connection.
+/// @param client_socket Client socket.
+/// @param p_buffer Buffer.
+/// @return True if the buffer was written or queued, false if it was dropped.
+static bool SocketBroadcastDeliver(SOCKET_BROADCAST_CONN* p_conn, const int client_socket, SERVER_SOCKET_BUFFER* p_buffer)
+{
+    unsigned long sent = 0;
+
+    if(p_conn->direct && p_conn->waiting && p_conn->queue_num == 0)
+    {
+        ssize_t send_to_socket = send(client_socket, p_buffer->data, p_buffer->size, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if(send_to_socket > 0)
+        {
+            SocketStatsCount(SERVER_SOCKET_CNT_BYTES_OUT, send_to_socket);
+            SocketStatsRecord(SERVER_SOCKET_HIST_WRITE_BYTES, send_to_socket);
+            sent = send_to_socket;
+        }
+        else if(errno != EAGAIN && errno != EWOULDBLOCK)
+            return false;
+
+        if(sent == p_buffer->size)
+            return true;
+    }
+
+    // Buffers are dropped whole, so clients never get a partial one.
+    if(p_conn->queue_num == SOCKET_BROADCAST_QUEUE_LEN || p_conn->queued_bytes + p_buffer->size - sent > broadcast_max_queued)
+    {
+        SocketStatsCount(SERVER_SOCKET_CNT_BROADCAST_DROPS, 1);
+        return false;
+    }
+
+    SocketBroadcastBufferRef(p_buffer);
+
+    p_conn->queue[(p_conn->queue_head + p_conn->queue_num) % SOCKET_BROADCAST_QUEUE_LEN] = p_buffer;
+    p_conn->queue_num++;
+    p_conn->queued_bytes += p_buffer->size - sent;
+
+    if(sent > 0)
+        p_conn->first_offset = sent;
+
+    // Owners busy with a request write queued buffers once they are done, the waiting ones have to be woken up.
+    if(p_conn->waiting && !p_conn->kicked)
+    {
+        p_conn->kicked = true;
+        pthread_kill(p_conn->owner, SOCKET_BROADCAST_SIGNAL);
+    }
+
+    return true;
+}
+
+/// @brief Writes queued buffers to a plain connection, straight from shared memory, with as few vectored writes as possible.
+/// @param client_socket Client socket.
+/// @param p_iov Buffers (modified as they get written).
+/// @param iov_num Amount of buffers.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketBroadcastSendPlain(const int client_socket, struct iovec* p_iov, int iov_num)
+{
+    while(iov_num > 0)
+    {
+        ssize_t write_to_socket = writev(client_socket, p_iov, (iov_num < IOV_MAX ? iov_num : IOV_MAX));
+
+        if(write_to_socket <= 0)
+        {
+            if(write_to_socket == 0 || ServerSocketRetryWrite(client_socket) < 0)
+            {
+                SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+                return SERVER_SOCKET_BROADCAST_ERR_WRITE;
+            }
+
+            continue;
+        }
+
+        SocketStatsCount(SERVER_SOCKET_CNT_BYTES_OUT, write_to_socket);
+        SocketStatsRecord(SERVER_SOCKET_HIST_WRITE_BYTES, write_to_socket);
+        SocketTimerTouch();
+        SocketBufTuneTransferred(write_to_socket);
+
+        // Skip whatever has been written already.
+        while(iov_num > 0 && (size_t)write_to_socket >= p_iov->iov_len)
+        {
+            write_to_socket -= p_iov->iov_len;
+            p_iov++;
+            iov_num--;
+        }
+
+        if(iov_num > 0)
+        {
+            p_iov->iov_base = (char*)p_iov->iov_base + write_to_socket;
+            p_iov->iov_len -= write_to_socket;
+        }
+    }
+
+    return SERVER_SOCKET_BROADCAST_SUCCESS;
+}
+
+/// @brief Writes queued buffers through the connection's own transport (TLS or compression), one at a time.
+/// @param client_socket Client socket.
+/// @param p_iov Buffers.
+/// @param iov_num Amount of buffers.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketBroadcastSendOwned(const int client_socket, const struct iovec* p_iov, const int iov_num)
+{
+    for(int iov_idx = 0; iov_idx < iov_num; iov_idx++)
+    {
+        unsigned long written = 0;
+
+        while(written < p_iov[iov_idx].iov_len)
+        {
+            int write_to_socket = ServerSocketWrite(client_socket, (const char*)p_iov[iov_idx].iov_base + written, p_iov[iov_idx].iov_len - written);
+
+            if(write_to_socket <= 0)
+                return SERVER_SOCKET_BROADCAST_ERR_WRITE;
+
+            written += write_to_socket;
+        }
+    }
+
+    return SERVER_SOCKET_BROADCAST_SUCCESS;
+}
+
+/// @brief Writes every buffer queued on the current connection. Only called by the owner, between requests.
+/// @param client_socket Client socket.
+/// @return 0 if succeeded, < 0 if writing failed.
+static int SocketBroadcastFlush(const int client_socket)
+{
+    SOCKET_BROADCAST_CONN* p_conn = p_socket_broadcast_current;
+    SERVER_SOCKET_BUFFER* taken[SOCKET_BROADCAST_QUEUE_LEN];
+    struct iovec iov[SOCKET_BROADCAST_QUEUE_LEN];
+
+    // Buffers taken by an outer call are being written, later ones must not get in the middle of them.
+    if(thread_flushing)
+        return SERVER_SOCKET_BROADCAST_SUCCESS;
+
+    while(true)
+    {
+        pthread_mutex_lock(&p_conn->mtx);
+
+        unsigned int taken_num = p_conn->queue_num;
+        unsigned long first_offset = p_conn->first_offset;
+        bool direct = p_conn->direct;
+
+        for(unsigned int taken_idx = 0; taken_idx < taken_num; taken_idx++)
+            taken[taken_idx] = p_conn->queue[(p_conn->queue_head + taken_idx) % SOCKET_BROADCAST_QUEUE_LEN];
+
+        p_conn->queue_head = 0;
+        p_conn->queue_num = 0;
+        p_conn->first_offset = 0;
+        p_conn->queued_bytes = 0;
+        p_conn->kicked = false;
+
+        pthread_mutex_unlock(&p_conn->mtx);
+
+        if(taken_num == 0)
+            return SERVER_SOCKET_BROADCAST_SUCCESS;
+
+        for(unsigned int taken_idx = 0; taken_idx < taken_num; taken_idx++)
+        {
+            unsigned long offset = (taken_idx == 0 ? first_offset : 0);
+
+            iov[taken_idx].iov_base = taken[taken_idx]->data + offset;
+            iov[taken_idx].iov_len  = taken[taken_idx]->size - offset;
+        }
+
+        // Buffers are written without holding the lock, so broadcasters are never held up by this connection.
+        thread_flushing = true;
+        int send_buffers = (direct ? SocketBroadcastSendPlain(client_socket, iov, taken_num) : SocketBroadcastSendOwned(client_socket, iov, taken_num));
+        thread_flushing = false;
+
+        for(unsigned int taken_idx = 0; taken_idx < taken_num; taken_idx++)
+            ServerSocketBufferRelease(taken[taken_idx]);
+
+        if(send_buffers < 0)
+            return send_buffers;
+    }
+}
+
+/// @brief Creates a buffer to be broadcast.
+/// @param data Buffer data (copied).
+/// @param size Data size.
+/// @return Buffer holding a single reference, NULL if it could not be allocated.
+SERVER_SOCKET_BUFFER* ServerSocketBufferCreate(const char* data, const unsigned long size)
+{
+    SERVER_SOCKET_BUFFER* p_buffer = malloc(sizeof(SERVER_SOCKET_BUFFER) + size);
+
+    if(!p_buffer)
+        return NULL;
+
+    p_buffer->refs = 1;
+    p_buffer->size = size;
+    memcpy(p_buffer->data, data, size);
+
+    return p_buffer;
+}
+
+/// @brief Releases a reference on a buffer, freeing it if it was the last one.
+/// @param p_buffer Buffer.
+void ServerSocketBufferRelease(SERVER_SOCKET_BUFFER* p_buffer)
+{
+    if(p_buffer && __atomic_sub_fetch(&p_buffer->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(p_buffer);
+}
+
+/// @brief Sets broadcasting up. To be called before ServerSocketRun.
+/// @param max_queued_bytes Bytes queued per connection, at most, 0 to disable broadcasting.
+void ServerSocketSetBroadcast(const unsigned long max_queued_bytes)
+{
+    broadcast_max_queued = max_queued_bytes;
+}
+
+/// @brief Writes (or queues) a buffer on a set of connections.
+/// @param p_buffer Buffer. Caller keeps its own reference.
+/// @param p_client_sockets Client sockets, NULL for every connection.
+/// @param clients_num Amount of client sockets.
+/// @return Amount of connections the buffer was written or queued on, < 0 if broadcasting is disabled or the buffer is empty.
+int ServerSocketBroadcast(SERVER_SOCKET_BUFFER* p_buffer, const int* p_client_sockets, const int clients_num)
+{
+    if(!p_broadcast_conns)
+        return SERVER_SOCKET_BROADCAST_ERR_DISABLED;
+
+    if(!p_buffer || p_buffer->size == 0)
+        return SERVER_SOCKET_BROADCAST_ERR_BUFFER;
+
+    int targets_num = (p_client_sockets ? clients_num : __atomic_load_n(&broadcast_high_fd, __ATOMIC_ACQUIRE) + 1);
+    int delivered = 0;
+
+    for(int target_idx = 0; target_idx < targets_num; target_idx++)
+    {
+        int client_socket = (p_client_sockets ? p_client_sockets[target_idx] : target_idx);
+
+        if(client_socket < 0 || (unsigned long)client_socket >= broadcast_conns_size)
+            continue;
+
+        SOCKET_BROADCAST_CONN* p_conn = __atomic_load_n(&p_broadcast_conns[client_socket], __ATOMIC_ACQUIRE);
+
+        if(!p_conn)
+            continue;
+
+        pthread_mutex_lock(&p_conn->mtx);
+
+        if(p_conn->attached && SocketBroadcastDeliver(p_conn, client_socket, p_buffer))
+            delivered++;
+
+        pthread_mutex_unlock(&p_conn->mtx);
+    }
+
+    return delivered;
+}
+
+/// @brief Allocates the broadcast table and installs the signal handler waking serving threads up. To be called before
+/// accepting connections.
+/// @return 0 if succeeded (or broadcasting is disabled), < 0 otherwise.
+int SocketSetupBroadcast(void)
+{
+    if(broadcast_max_queued == SOCKET_BROADCAST_DISABLED || p_broadcast_conns != NULL)
+        return SERVER_SOCKET_BROADCAST_SUCCESS;
+
+    struct rlimit fds_limit;
+    unsigned long conns_size = SOCKET_BROADCAST_MAX_FDS;
+
+    if(getrlimit(RLIMIT_NOFILE, &fds_limit) == 0 && fds_limit.rlim_cur < conns_size)
+        conns_size = fds_limit.rlim_cur;
+
+    // No SA_RESTART: waits for data are meant to be interrupted.
+    struct sigaction broadcast_action = {.sa_handler = SocketBroadcastSignalHandler};
+    sigemptyset(&broadcast_action.sa_mask);
+
+    if(sigaction(SOCKET_BROADCAST_SIGNAL, &broadcast_action, NULL) < 0)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_BROADCAST_SETUP_NOK);
+        return SERVER_SOCKET_BROADCAST_ERR_SIGNAL;
+    }
+
+    // Untouched pages take no memory, so only entries of descriptors actually used cost anything.
+    SOCKET_BROADCAST_CONN** p_conns = calloc(conns_size, sizeof(SOCKET_BROADCAST_CONN*));
+
+    if(!p_conns)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_BROADCAST_SETUP_NOK);
+        return SERVER_SOCKET_BROADCAST_ERR_ALLOC;
+    }
+
+    broadcast_conns_size = conns_size;
+    __atomic_store_n(&p_broadcast_conns, p_conns, __ATOMIC_RELEASE);
+
+    return SERVER_SOCKET_BROADCAST_SUCCESS;
+}
+
+/// @brief Lets broadcasts be queued on the connection served by the current thread. To be called by its serving thread,
+/// before interacting with the client.
+/// @param client_socket Client socket.
+/// @param secure True for TLS connections, which only their serving thread may write to.
+void SocketBroadcastAttach(const int client_socket, const bool secure)
+{
+    if(!p_broadcast_conns || client_socket < 0 || (unsigned long)client_socket >= broadcast_conns_size)
+        return;
+
+    SOCKET_BROADCAST_CONN* p_conn = p_broadcast_conns[client_socket];
+
+    // Only the connection owning a descriptor ever creates its entry.
+    if(!p_conn)
+    {
+        p_conn = calloc(1, sizeof(SOCKET_BROADCAST_CONN));
+
+        if(!p_conn)
+            return;
+
+        pthread_mutex_init(&p_conn->mtx, NULL);
+        __atomic_store_n(&p_broadcast_conns[client_socket], p_conn, __ATOMIC_RELEASE);
+    }
+
+    // The broadcast signal is only let in while waiting for data, so it never interrupts anything else.
+    sigset_t broadcast_set;
+    sigemptyset(&broadcast_set);
+    sigaddset(&broadcast_set, SOCKET_BROADCAST_SIGNAL);
+    pthread_sigmask(SIG_BLOCK, &broadcast_set, &thread_wait_mask);
+    sigdelset(&thread_wait_mask, SOCKET_BROADCAST_SIGNAL);
+
+    pthread_mutex_lock(&p_conn->mtx);
+
+    p_conn->owner           = pthread_self();
+    p_conn->attached        = true;
+    p_conn->direct          = !secure;
+    p_conn->waiting         = false;
+    p_conn->kicked          = false;
+    p_conn->rx_timeout_us   = ServerSocketGetTimeoutUs(client_socket, SO_RCVTIMEO);
+
+    pthread_mutex_unlock(&p_conn->mtx);
+
+    int high_fd = __atomic_load_n(&broadcast_high_fd, __ATOMIC_RELAXED);
+
+    while(client_socket > high_fd && !__atomic_compare_exchange_n(&broadcast_high_fd, &high_fd, client_socket, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    p_socket_broadcast_current = p_conn;
+}
+
+/// @brief Makes broadcasts to the current connection go through its own transport (e.g. once it got compressed).
+void SocketBroadcastOwnerOnly(void)
+{
+    SOCKET_BROADCAST_CONN* p_conn = p_socket_broadcast_current;
+
+    if(!p_conn)
+        return;
+
+    pthread_mutex_lock(&p_conn->mtx);
+    p_conn->direct = false;
+    pthread_mutex_unlock(&p_conn->mtx);
+}
+
+/// @brief Stops broadcasts from being queued on the current connection, dropping the queued ones.
+/// To be called before the client socket gets closed, so its descriptor can be reused.
+void SocketBroadcastDetach(void)
+{
+    SOCKET_BROADCAST_CONN* p_conn = p_socket_broadcast_current;
+
+    if(!p_conn)
+        return;
+
+    p_socket_broadcast_current = NULL;
+
+    pthread_mutex_lock(&p_conn->mtx);
+
+    p_conn->attached = false;
+    p_conn->waiting = false;
+    SocketBroadcastDropQueue(p_conn);
+
+    pthread_mutex_unlock(&p_conn->mtx);
+}
+
+/// @brief Waits until the client socket is readable, writing queued broadcasts meanwhile. Replaces blocking reads,
+/// as the broadcast signal can only interrupt a wait that lets it in atomically (ppoll).
+/// @param client_socket Client socket.
+/// @param timeout_us Maximum time to wait for, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return > 0 if readable (or broadcasts could not be written), 0 if timed out, < 0 if any error happened.
+int SocketBroadcastWaitReadable(const int client_socket, const long timeout_us)
+{
+    SOCKET_BROADCAST_CONN* p_conn = p_socket_broadcast_current;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long deadline_us = (timeout_us >= 0 ? now.tv_sec * SOCKET_BROADCAST_US_PER_SEC + now.tv_nsec / SOCKET_BROADCAST_NS_PER_US + timeout_us : SERVER_SOCKET_WAIT_FOREVER);
+
+    struct pollfd client_poll_fd =
+    {
+        .fd     = client_socket,
+        .events = POLLIN,
+    };
+
+    while(true)
+    {
+        // A connection which cannot be written to anymore is reported readable: reading it tells what happened.
+        if(SocketBroadcastFlush(client_socket) < 0)
+            return 1;
+
+        pthread_mutex_lock(&p_conn->mtx);
+
+        bool queue_empty = (p_conn->queue_num == 0);
+        p_conn->waiting = queue_empty;
+
+        pthread_mutex_unlock(&p_conn->mtx);
+
+        if(!queue_empty)
+            continue;
+
+        struct timespec timeout = {0};
+
+        if(deadline_us != SERVER_SOCKET_WAIT_FOREVER)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            long remaining_us = deadline_us - (now.tv_sec * SOCKET_BROADCAST_US_PER_SEC + now.tv_nsec / SOCKET_BROADCAST_NS_PER_US);
+
+            if(remaining_us > 0)
+            {
+                timeout.tv_sec  = remaining_us / SOCKET_BROADCAST_US_PER_SEC;
+                timeout.tv_nsec = (remaining_us % SOCKET_BROADCAST_US_PER_SEC) * SOCKET_BROADCAST_NS_PER_US;
+            }
+        }
+
+        int wait_readable = ppoll(&client_poll_fd, 1, (deadline_us == SERVER_SOCKET_WAIT_FOREVER ? NULL : &timeout), &thread_wait_mask);
+
+        pthread_mutex_lock(&p_conn->mtx);
+        p_conn->waiting = false;
+        pthread_mutex_unlock(&p_conn->mtx);
+
+        if(wait_readable < 0 && errno == EINTR)
+            continue;
+
+        // Partially written buffers are completed now, before the connection's transport can change (e.g. compression).
+        if(SocketBroadcastFlush(client_socket) < 0)
+            return 1;
+
+        return wait_readable;
+    }
+}
+
+/// @brief Writes whatever is queued on the current connection right away. Only called by its serving thread, in between
+/// two of its own writes.
+/// @param client_socket Client socket.
+/// @return 0 if succeeded (or nothing was queued), < 0 if writing failed.
+int SocketBroadcastWritePending(const int client_socket)
+{
+    return SocketBroadcastFlush(client_socket);
+}
+
+/// @brief Gets the receive timeout of the connection served by the current thread.
+/// @return Timeout, 0 for non-blocking sockets, SERVER_SOCKET_WAIT_FOREVER if there is none.
+long SocketBroadcastRxTimeoutUs(void)
+{
+    return p_socket_broadcast_current->rx_timeout_us;
+}
+
+/// @brief Frees the broadcast table, along with every buffer still queued. To be called once serving threads are gone.
+void SocketFreeBroadcastResources(void)
+{
+    SOCKET_BROADCAST_CONN** p_conns = __atomic_exchange_n(&p_broadcast_conns, NULL, __ATOMIC_ACQ_REL);
+
+    if(!p_conns)
+        return;
+
+    for(int client_socket = 0; client_socket <= broadcast_high_fd; client_socket++)
+    {
+        SOCKET_BROADCAST_CONN* p_conn = p_conns[client_socket];
+
+        if(!p_conn)
+            continue;
+
+        SocketBroadcastDropQueue(p_conn);
+        pthread_mutex_destroy(&p_conn->mtx);
+        free(p_conn);
+    }
+
+    free(p_conns);
+
+    broadcast_conns_size = 0;
+    broadcast_high_fd = -1;
+}
+
+/*************************************/
@@ -0,0 +1,59 @@
+#ifndef SERVER_SOCKET_BROADCAST_H
+#define SERVER_SOCKET_BROADCAST_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+#include <stddef.h>             // NULL.
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+typedef struct SOCKET_BROADCAST_CONN SOCKET_BROADCAST_CONN;
+
+/**********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Broadcast state of the connection served by the current thread, NULL if broadcasting is disabled.
+extern __thread SOCKET_BROADCAST_CONN* p_socket_broadcast_current;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+int SocketSetupBroadcast(void);
+void SocketBroadcastAttach(int client_socket, bool secure);
+void SocketBroadcastOwnerOnly(void);
+void SocketBroadcastDetach(void);
+int SocketBroadcastWaitReadable(int client_socket, long timeout_us);
+int SocketBroadcastWritePending(int client_socket);
+long SocketBroadcastRxTimeoutUs(void);
+void SocketFreeBroadcastResources(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Tells whether the connection served by the current thread may get broadcasts, so it has to wait for
+/// them along with client data. Cheap enough for every read.
+/// @return True if broadcasts may be queued on the current connection, false otherwise.
+static inline bool SocketBroadcastAttached(void)
+{
+    return (p_socket_broadcast_current != NULL);
+}
+
+/*************************************/
+
+#endif
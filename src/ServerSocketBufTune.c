@@ -0,0 +1,251 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stddef.h>             // offsetof
+#include <string.h>
+#include <netinet/in.h>         // IPPROTO_TCP
+#include <linux/tcp.h>          // TCP_INFO, along with delivery rate (glibc's own tcp_info predates it).
+#include <sys/socket.h>
+#include "ServerSocketBufTune.h"
+#include "ServerSocketStats.h"
+#include "ServerSocket_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_BUF_TUNE_SUCCESS          0
+#define SERVER_SOCKET_BUF_TUNE_ERR_TCP_INFO     -1
+
+#define SOCKET_BUF_TUNE_DISABLED                0
+#define SOCKET_BUF_TUNE_FIRST_SAMPLE_BYTES      (64 * 1024UL)   // Connections are left alone until they move this much.
+#define SOCKET_BUF_TUNE_HEADROOM                2               // Buffers hold this many BDPs, so the window can double between samples.
+#define SOCKET_BUF_TUNE_SHRINK_RATIO            2               // Buffers only shrink once they are this many times too big.
+#define SOCKET_BUF_TUNE_US_PER_SEC              1000000UL
+#define SOCKET_BUF_TUNE_NS_PER_MS               1000000UL
+
+/// @brief Tells whether a kernel reported some tcp_info field (older kernels report a shorter structure).
+#define SOCKET_BUF_TUNE_HAS_FIELD(info_len, field)  \
+        ((info_len) >= offsetof(struct tcp_info, field) + sizeof(((struct tcp_info*)0)->field))
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long buf_tune_min_bytes = SOCKET_BUF_TUNE_DISABLED;
+static unsigned long buf_tune_max_bytes = SOCKET_BUF_TUNE_DISABLED;
+static unsigned long buf_tune_sample_ns = 0;
+
+/// @brief Time the current connection may be sampled again at.
+static __thread unsigned long buf_tune_next_sample_ns;
+
+/// @brief Buffer sizes last set on the current connection, 0 if they are still the kernel's.
+static __thread unsigned long buf_tune_snd_buf;
+static __thread unsigned long buf_tune_rcv_buf;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread bool socket_buf_tune_active = false;
+__thread int socket_buf_tune_socket = -1;
+__thread unsigned long socket_buf_tune_bytes = 0;
+__thread unsigned long socket_buf_tune_next_bytes = 0;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int SocketBufTuneGetInfo(const int client_socket, SERVER_SOCKET_TCP_STATS* p_tcp_stats);
+static unsigned long SocketBufTuneTarget(const unsigned long bdp_bytes);
+static bool SocketBufTuneResize(const int client_socket, const int option, const int force_option, const unsigned long target, unsigned long* p_current);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Samples the kernel's view of a connection (TCP_INFO) and works its bandwidth-delay product out.
+/// The BDP is the largest of the delivery rate times the smoothed RTT and the congestion window, as delivery rates
+/// sampled while the application had nothing to send fall short of what the path can take.
+/// @param client_socket Client socket.
+/// @param p_tcp_stats Target figures.
+/// @return 0 if succeeded, < 0 if the socket is not a TCP one.
+static int SocketBufTuneGetInfo(const int client_socket, SERVER_SOCKET_TCP_STATS* p_tcp_stats)
+{
+    struct tcp_info info;
+    socklen_t info_len = sizeof(info);
+
+    memset(&info, 0, sizeof(info));
+
+    if(getsockopt(client_socket, IPPROTO_TCP, TCP_INFO, &info, &info_len) < 0)
+        return SERVER_SOCKET_BUF_TUNE_ERR_TCP_INFO;
+
+    memset(p_tcp_stats, 0, sizeof(SERVER_SOCKET_TCP_STATS));
+
+    p_tcp_stats->rtt_us     = info.tcpi_rtt;
+    p_tcp_stats->rtt_var_us = info.tcpi_rttvar;
+    p_tcp_stats->snd_cwnd   = info.tcpi_snd_cwnd;
+    p_tcp_stats->snd_mss    = info.tcpi_snd_mss;
+    p_tcp_stats->rcv_space  = info.tcpi_rcv_space;
+
+    if(SOCKET_BUF_TUNE_HAS_FIELD(info_len, tcpi_min_rtt))
+        p_tcp_stats->min_rtt_us = info.tcpi_min_rtt;
+
+    if(SOCKET_BUF_TUNE_HAS_FIELD(info_len, tcpi_delivery_rate))
+    {
+        p_tcp_stats->delivery_rate = info.tcpi_delivery_rate;
+        p_tcp_stats->app_limited = info.tcpi_delivery_rate_app_limited;
+    }
+
+    unsigned long rate_bdp = p_tcp_stats->delivery_rate * p_tcp_stats->rtt_us / SOCKET_BUF_TUNE_US_PER_SEC;
+    unsigned long cwnd_bdp = (unsigned long)p_tcp_stats->snd_cwnd * p_tcp_stats->snd_mss;
+
+    p_tcp_stats->bdp_bytes = (rate_bdp > cwnd_bdp ? rate_bdp : cwnd_bdp);
+
+    int buf_size;
+    socklen_t buf_size_len = sizeof(buf_size);
+
+    if(getsockopt(client_socket, SOL_SOCKET, SO_SNDBUF, &buf_size, &buf_size_len) == 0)
+        p_tcp_stats->snd_buf = buf_size;
+
+    buf_size_len = sizeof(buf_size);
+
+    if(getsockopt(client_socket, SOL_SOCKET, SO_RCVBUF, &buf_size, &buf_size_len) == 0)
+        p_tcp_stats->rcv_buf = buf_size;
+
+    return SERVER_SOCKET_BUF_TUNE_SUCCESS;
+}
+
+/// @brief Works out the buffer size a bandwidth-delay product calls for.
+/// @param bdp_bytes Bandwidth-delay product.
+/// @return Buffer size, within configured limits.
+static unsigned long SocketBufTuneTarget(const unsigned long bdp_bytes)
+{
+    unsigned long target = bdp_bytes * SOCKET_BUF_TUNE_HEADROOM;
+
+    if(target < buf_tune_min_bytes)
+        return buf_tune_min_bytes;
+
+    return (target > buf_tune_max_bytes ? buf_tune_max_bytes : target);
+}
+
+/// @brief Resizes a socket buffer if it is too small, or far too big. Privileged processes get past system-wide
+/// limits (net.core.wmem_max / rmem_max), others are capped by them.
+/// @param client_socket Client socket.
+/// @param option SO_SNDBUF or SO_RCVBUF.
+/// @param force_option SO_SNDBUFFORCE or SO_RCVBUFFORCE.
+/// @param target Wanted size.
+/// @param p_current Size last set (updated if resized).
+/// @return True if the buffer was resized, false otherwise.
+static bool SocketBufTuneResize(const int client_socket, const int option, const int force_option, const unsigned long target, unsigned long* p_current)
+{
+    if(target <= *p_current && target * SOCKET_BUF_TUNE_SHRINK_RATIO > *p_current)
+        return false;
+
+    int buf_size = (int)target;
+
+    if( setsockopt(client_socket, SOL_SOCKET, force_option, &buf_size, sizeof(buf_size)) < 0 &&
+        setsockopt(client_socket, SOL_SOCKET, option, &buf_size, sizeof(buf_size)) < 0)
+        return false;
+
+    *p_current = target;
+
+    return true;
+}
+
+/// @brief Sets socket buffer auto-tuning up. To be called before ServerSocketRun.
+/// @param min_bytes Smallest buffer size.
+/// @param max_bytes Largest buffer size, 0 to disable auto-tuning (default).
+/// @param sample_ms Minimum time between two samples of the same connection.
+void ServerSocketSetBufferTuning(const unsigned long min_bytes, const unsigned long max_bytes, const unsigned long sample_ms)
+{
+    buf_tune_min_bytes = (min_bytes < max_bytes ? min_bytes : max_bytes);
+    buf_tune_max_bytes = max_bytes;
+    buf_tune_sample_ns = sample_ms * SOCKET_BUF_TUNE_NS_PER_MS;
+}
+
+/// @brief Gets the current figures of a connection, as seen by the kernel.
+/// @param client_socket Client socket.
+/// @param p_tcp_stats Target figures.
+/// @return 0 if succeeded, < 0 if the socket is not a TCP one.
+int ServerSocketGetTCPStats(int client_socket, SERVER_SOCKET_TCP_STATS* p_tcp_stats)
+{
+    return SocketBufTuneGetInfo(client_socket, p_tcp_stats);
+}
+
+/// @brief Lets socket buffers of the connection served by the current thread be sized after its bandwidth-delay product.
+/// @param client_socket Client socket.
+void SocketBufTuneAttach(const int client_socket)
+{
+    if(buf_tune_max_bytes == SOCKET_BUF_TUNE_DISABLED)
+        return;
+
+    socket_buf_tune_active      = true;
+    socket_buf_tune_socket      = client_socket;
+    socket_buf_tune_bytes       = 0;
+    socket_buf_tune_next_bytes  = SOCKET_BUF_TUNE_FIRST_SAMPLE_BYTES;
+    buf_tune_next_sample_ns     = 0;
+    buf_tune_snd_buf            = 0;
+    buf_tune_rcv_buf            = 0;
+}
+
+/// @brief Samples the current connection (at most once per sampling period), then resizes its socket buffers so they
+/// hold what its bandwidth-delay product calls for. Send buffers follow the BDP, receive buffers whichever is larger of
+/// the BDP and what the kernel measured the client to send per round trip.
+/// @param client_socket Client socket.
+void SocketBufTuneSample(const int client_socket)
+{
+    if(!socket_buf_tune_active)
+        return;
+
+    socket_buf_tune_bytes = 0;
+
+    unsigned long now_ns = SocketStatsNowNs();
+
+    if(now_ns < buf_tune_next_sample_ns)
+        return;
+
+    buf_tune_next_sample_ns = now_ns + buf_tune_sample_ns;
+
+    SERVER_SOCKET_TCP_STATS tcp_stats;
+
+    // Not a TCP socket, nothing to tune.
+    if(SocketBufTuneGetInfo(client_socket, &tcp_stats) < 0)
+    {
+        socket_buf_tune_active = false;
+        return;
+    }
+
+    SocketStatsRecord(SERVER_SOCKET_HIST_RTT, tcp_stats.rtt_us);
+    SocketStatsRecord(SERVER_SOCKET_HIST_BDP, tcp_stats.bdp_bytes);
+
+    unsigned long rcv_bdp = (tcp_stats.rcv_space > tcp_stats.bdp_bytes ? tcp_stats.rcv_space : tcp_stats.bdp_bytes);
+
+    if(SocketBufTuneResize(client_socket, SO_SNDBUF, SO_SNDBUFFORCE, SocketBufTuneTarget(tcp_stats.bdp_bytes), &buf_tune_snd_buf))
+        SocketStatsCount(SERVER_SOCKET_CNT_BUFFER_RESIZES, 1);
+
+    if(SocketBufTuneResize(client_socket, SO_RCVBUF, SO_RCVBUFFORCE, SocketBufTuneTarget(rcv_bdp), &buf_tune_rcv_buf))
+        SocketStatsCount(SERVER_SOCKET_CNT_BUFFER_RESIZES, 1);
+
+    // Next sample once about a send buffer's worth has been transferred: roughly a round trip for bulk transfers.
+    socket_buf_tune_next_bytes = (buf_tune_snd_buf > SOCKET_BUF_TUNE_FIRST_SAMPLE_BYTES ? buf_tune_snd_buf : SOCKET_BUF_TUNE_FIRST_SAMPLE_BYTES);
+}
+
+/// @brief Stops tuning the current connection. To be called once it is over.
+void SocketBufTuneRelease(void)
+{
+    socket_buf_tune_active = false;
+}
+
+/*************************************/
@@ -0,0 +1,55 @@
+#ifndef SERVER_SOCKET_BUF_TUNE_H
+#define SERVER_SOCKET_BUF_TUNE_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Tells whether socket buffers of the connection served by the current thread are sized after its bandwidth-delay product.
+extern __thread bool socket_buf_tune_active;
+
+/// @brief Client socket of the connection served by the current thread.
+extern __thread int socket_buf_tune_socket;
+
+/// @brief Bytes the current connection has transferred since its last sample.
+extern __thread unsigned long socket_buf_tune_bytes;
+
+/// @brief Bytes after which the current connection is sampled again.
+extern __thread unsigned long socket_buf_tune_next_bytes;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+void SocketBufTuneAttach(int client_socket);
+void SocketBufTuneSample(int client_socket);
+void SocketBufTuneRelease(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Accounts for bytes the current connection transferred, sampling it once it moved about a socket buffer's worth
+/// of them. Cheap enough for every read and write.
+/// @param bytes Transferred bytes.
+static inline void SocketBufTuneTransferred(const unsigned long bytes)
+{
+    if(socket_buf_tune_active && (socket_buf_tune_bytes += bytes) >= socket_buf_tune_next_bytes)
+        SocketBufTuneSample(socket_buf_tune_socket);
+}
+
+/*************************************/
+
+#endif
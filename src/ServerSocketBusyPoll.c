@@ -0,0 +1,207 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // CPU sets, pthread_setaffinity_np.
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "ServerSocketBusyPoll.h"
+#include "ServerSocketSSL.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_BUSY_POLL_SUCCESS         0
+#define SERVER_SOCKET_BUSY_POLL_ERR_DISABLED    -1
+#define SERVER_SOCKET_BUSY_POLL_ERR_NO_CPU      -2
+#define SERVER_SOCKET_BUSY_POLL_ERR_PIN         -3
+
+#define SOCKET_BUSY_POLL_NO_CPU                 -1
+#define SOCKET_BUSY_POLL_US_PER_SEC             1000000L
+#define SOCKET_BUSY_POLL_NS_PER_US              1000L
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SOCKET_BUSY_POLL_CPU_RELAX()            __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define SOCKET_BUSY_POLL_CPU_RELAX()            __asm__ __volatile__("yield")
+#else
+#define SOCKET_BUSY_POLL_CPU_RELAX()
+#endif
+
+#define SERVER_SOCKET_MSG_BUSY_POLL_OPT_NOK     "Could not set kernel busy polling on socket <%d>, spinning on reads only."
+#define SERVER_SOCKET_MSG_BUSY_POLL_NO_CPU      "No dedicated CPU left for low-latency socket <%d>."
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static long busy_poll_spin_us = 0;
+static int busy_poll_first_cpu = 0;
+static int busy_poll_cpus_num = 0;
+
+/// @brief Dedicated CPUs already taken by a spinning thread.
+static bool busy_poll_cpus_taken[CPU_SETSIZE];
+
+/// @brief Dedicated CPU taken by the current thread, SOCKET_BUSY_POLL_NO_CPU if there is none.
+static __thread int busy_poll_cpu = SOCKET_BUSY_POLL_NO_CPU;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread bool socket_busy_poll_active = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static long SocketBusyPollNowUs(void);
+static int SocketBusyPollTakeCPU(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Current monotonic time.
+/// @return Microseconds.
+static long SocketBusyPollNowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * SOCKET_BUSY_POLL_US_PER_SEC + now.tv_nsec / SOCKET_BUSY_POLL_NS_PER_US;
+}
+
+/// @brief Takes a free dedicated CPU and pins the current thread to it.
+/// @return 0 if succeeded, < 0 if every dedicated CPU is taken or pinning failed.
+static int SocketBusyPollTakeCPU(void)
+{
+    for(int cpu = busy_poll_first_cpu; cpu < busy_poll_first_cpu + busy_poll_cpus_num && cpu < CPU_SETSIZE; cpu++)
+    {
+        bool cpu_free = false;
+
+        if(!__atomic_compare_exchange_n(&busy_poll_cpus_taken[cpu], &cpu_free, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        cpu_set_t spin_cpus;
+        CPU_ZERO(&spin_cpus);
+        CPU_SET(cpu, &spin_cpus);
+
+        if(pthread_setaffinity_np(pthread_self(), sizeof(spin_cpus), &spin_cpus) != 0)
+        {
+            __atomic_store_n(&busy_poll_cpus_taken[cpu], false, __ATOMIC_RELEASE);
+            return SERVER_SOCKET_BUSY_POLL_ERR_PIN;
+        }
+
+        busy_poll_cpu = cpu;
+        return SERVER_SOCKET_BUSY_POLL_SUCCESS;
+    }
+
+    return SERVER_SOCKET_BUSY_POLL_ERR_NO_CPU;
+}
+
+/// @brief Sets low-latency mode parameters. To be called before ServerSocketRun.
+/// @param spin_us Time reads spin for before blocking, 0 to disable low-latency mode (default).
+/// @param first_cpu First CPU dedicated to spinning threads.
+/// @param cpus_num Amount of dedicated CPUs (one per low-latency connection), 0 not to pin spinning threads.
+void ServerSocketSetLowLatency(const unsigned long spin_us, const int first_cpu, const int cpus_num)
+{
+    busy_poll_spin_us = spin_us;
+    busy_poll_first_cpu = (first_cpu > 0 ? first_cpu : 0);
+    busy_poll_cpus_num = (cpus_num > 0 ? cpus_num : 0);
+}
+
+/// @brief Enables low-latency mode for the current connection. To be called from the interaction function.
+/// @param client_socket Client socket.
+/// @return 0 if succeeded, < 0 if low-latency mode is disabled or there is no dedicated CPU left.
+int ServerSocketEnableLowLatency(int client_socket)
+{
+    if(busy_poll_spin_us <= 0)
+        return SERVER_SOCKET_BUSY_POLL_ERR_DISABLED;
+
+    if(socket_busy_poll_active)
+        return SERVER_SOCKET_BUSY_POLL_SUCCESS;
+
+    // Spinning on a shared CPU would steal it from other connections, so it is better not to spin at all.
+    if(busy_poll_cpus_num > 0 && SocketBusyPollTakeCPU() < 0)
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_BUSY_POLL_NO_CPU, client_socket);
+        return SERVER_SOCKET_BUSY_POLL_ERR_NO_CPU;
+    }
+
+    // Lets the kernel poll the device queue itself while reads spin (raising it above net.core.busy_read needs CAP_NET_ADMIN).
+    int busy_poll_us = (int)busy_poll_spin_us;
+    int socket_options = setsockopt(client_socket, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us));
+
+#ifdef SO_PREFER_BUSY_POLL
+    int prefer_busy_poll = 1;
+    socket_options |= setsockopt(client_socket, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer_busy_poll, sizeof(prefer_busy_poll));
+#endif
+
+    if(socket_options < 0)
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_BUSY_POLL_OPT_NOK, client_socket);
+
+    socket_busy_poll_active = true;
+
+    return SERVER_SOCKET_BUSY_POLL_SUCCESS;
+}
+
+/// @brief Spins until the client socket is readable (data, EOF or error), or already decrypted data is pending.
+/// @param client_socket Client socket.
+/// @param timeout_us Maximum time to spin for if shorter than the spin budget, < 0 (SERVER_SOCKET_WAIT_FOREVER) for the whole budget.
+/// @return > 0 if readable, 0 if the budget ran out (so the caller is meant to block).
+int SocketBusyPollSpin(const int client_socket, const long timeout_us)
+{
+    long spin_us = (timeout_us >= 0 && timeout_us < busy_poll_spin_us ? timeout_us : busy_poll_spin_us);
+    long deadline_us = SocketBusyPollNowUs() + spin_us;
+    char peek_byte;
+
+    do
+    {
+        if(ServerSocketIsSecure() && ServerSocketSSLPending())
+            return 1;
+
+        if(recv(client_socket, &peek_byte, sizeof(peek_byte), MSG_PEEK | MSG_DONTWAIT) >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            return 1;
+
+        SOCKET_BUSY_POLL_CPU_RELAX();
+
+    } while(SocketBusyPollNowUs() < deadline_us);
+
+    return 0;
+}
+
+/// @brief Retrieves the spin budget.
+/// @return Microseconds reads spin for before blocking.
+long SocketBusyPollSpinUs(void)
+{
+    return busy_poll_spin_us;
+}
+
+/// @brief Leaves low-latency mode, giving the dedicated CPU (if any) back. To be called once the connection is over.
+void SocketBusyPollRelease(void)
+{
+    if(busy_poll_cpu != SOCKET_BUSY_POLL_NO_CPU)
+        __atomic_store_n(&busy_poll_cpus_taken[busy_poll_cpu], false, __ATOMIC_RELEASE);
+
+    busy_poll_cpu = SOCKET_BUSY_POLL_NO_CPU;
+    socket_busy_poll_active = false;
+}
+
+/*************************************/
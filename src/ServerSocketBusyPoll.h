@@ -0,0 +1,44 @@
+#ifndef SERVER_SOCKET_BUSY_POLL_H
+#define SERVER_SOCKET_BUSY_POLL_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Tells whether the connection served by the current thread spins before blocking on reads.
+extern __thread bool socket_busy_poll_active;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+int SocketBusyPollSpin(int client_socket, long timeout_us);
+long SocketBusyPollSpinUs(void);
+void SocketBusyPollRelease(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Tells whether reads on the current thread are meant to spin first. Cheap enough for every read.
+/// @return True if low-latency mode is enabled for the current connection, false otherwise.
+static inline bool SocketBusyPollActive(void)
+{
+    return socket_busy_poll_active;
+}
+
+/*************************************/
+
+#endif
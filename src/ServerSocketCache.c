@@ -0,0 +1,534 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "ServerSocketCache.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketStats.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_CACHE_SUCCESS         0
+#define SERVER_SOCKET_CACHE_MISS            0
+#define SERVER_SOCKET_CACHE_HIT             1
+#define SERVER_SOCKET_CACHE_ERR_DISABLED    -1
+#define SERVER_SOCKET_CACHE_ERR_ALLOC       -2
+#define SERVER_SOCKET_CACHE_ERR_SIZE        -3
+#define SERVER_SOCKET_CACHE_ERR_WRITE       -4
+
+#define SOCKET_CACHE_DISABLED               0
+#define SOCKET_CACHE_NO_TTL                 0
+#define SOCKET_CACHE_SHARDS_NUM             16      // Power of 2.
+#define SOCKET_CACHE_EXPECTED_ENTRY_SIZE    512     // Used to size hash tables only.
+#define SOCKET_CACHE_MIN_BUCKETS            64
+#define SOCKET_CACHE_MAX_BUCKETS            65536
+#define SOCKET_CACHE_HASH_MULTIPLIER        0x9E3779B97F4A7C15UL
+#define SOCKET_CACHE_CACHE_LINE_SIZE        64
+
+#define SERVER_SOCKET_MSG_CACHE_SETUP_NOK   "Response cache could not be allocated, going on without it."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Cached response, stored right after its key. Entries are reference counted, so a response being written
+/// out can be evicted (or replaced) meanwhile, the last reference freeing it.
+struct SOCKET_CACHE_ENTRY
+{
+    struct SOCKET_CACHE_ENTRY*  p_bucket_next;
+    struct SOCKET_CACHE_ENTRY*  p_clock_next;   // Entries of a shard make up a circular list swept by the CLOCK hand.
+    struct SOCKET_CACHE_ENTRY*  p_clock_prev;
+    uint64_t                    hash;
+    unsigned long               expiry_ms;
+    unsigned long               key_size;
+    unsigned long               response_size;
+    unsigned int                refs;           // One of them is the cache's own while the entry is linked.
+    bool                        referenced;     // Hit since the CLOCK hand last went by.
+    char                        data[];
+};
+
+/// @brief Independently locked part of the cache. Keys are spread across shards by hash, so concurrent lookups seldom contend.
+typedef struct
+{
+    pthread_mutex_t         mtx;
+    SOCKET_CACHE_ENTRY**    p_buckets;
+    unsigned long           buckets_mask;
+    SOCKET_CACHE_ENTRY*     p_hand;         // Next eviction candidate, NULL if the shard is empty.
+    unsigned long           bytes;          // Entries' size, bookkeeping included.
+} __attribute__((aligned(SOCKET_CACHE_CACHE_LINE_SIZE))) SOCKET_CACHE_SHARD;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long        cache_max_bytes     = SOCKET_CACHE_DISABLED;
+static unsigned long        cache_ttl_ms        = SOCKET_CACHE_NO_TTL;
+static unsigned long        cache_shard_bytes   = 0;
+static SOCKET_CACHE_SHARD*  p_cache_shards      = NULL;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static unsigned long SocketCacheNowMs(void);
+static uint64_t SocketCacheHash(const char* key, unsigned long key_size);
+static SOCKET_CACHE_SHARD* SocketCacheShard(uint64_t hash);
+static SOCKET_CACHE_ENTRY** SocketCacheBucket(SOCKET_CACHE_SHARD* p_shard, uint64_t hash);
+static unsigned long SocketCacheEntryBytes(const SOCKET_CACHE_ENTRY* p_entry);
+static SOCKET_CACHE_ENTRY* SocketCacheFind(SOCKET_CACHE_SHARD* p_shard, uint64_t hash, const char* key, unsigned long key_size);
+static void SocketCacheUnlink(SOCKET_CACHE_SHARD* p_shard, SOCKET_CACHE_ENTRY* p_entry);
+static void SocketCacheLink(SOCKET_CACHE_SHARD* p_shard, SOCKET_CACHE_ENTRY* p_entry);
+static void SocketCacheEvict(SOCKET_CACHE_SHARD* p_shard, unsigned long needed_bytes);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Gets a millisecond timestamp. Coarse clock is enough for expiry times, and it is read without a system call.
+/// @return Monotonic time in milliseconds.
+static unsigned long SocketCacheNowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    return now.tv_sec * 1000UL + now.tv_nsec / 1000000UL;
+}
+
+/// @brief Hashes a key 8 bytes at a time (multiply and fold), so long requests used as keys are hashed quickly.
+/// @param key Key.
+/// @param key_size Key size.
+/// @return Key hash.
+static uint64_t SocketCacheHash(const char* key, const unsigned long key_size)
+{
+    uint64_t hash = key_size * SOCKET_CACHE_HASH_MULTIPLIER;
+    unsigned long offset = 0;
+
+    for(; offset + sizeof(uint64_t) <= key_size; offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, key + offset, sizeof(uint64_t));
+
+        hash = (hash ^ word) * SOCKET_CACHE_HASH_MULTIPLIER;
+        hash ^= hash >> 29;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, key + offset, key_size - offset);
+
+    hash = (hash ^ tail) * SOCKET_CACHE_HASH_MULTIPLIER;
+
+    return hash ^ (hash >> 32);
+}
+
+/// @brief Gets the shard a hash belongs to (highest bits, as lowest ones pick the bucket).
+/// @param hash Key hash.
+/// @return Target shard.
+static SOCKET_CACHE_SHARD* SocketCacheShard(const uint64_t hash)
+{
+    return &p_cache_shards[(hash >> 60) & (SOCKET_CACHE_SHARDS_NUM - 1)];
+}
+
+/// @brief Gets the bucket a hash belongs to within its shard.
+/// @param p_shard Target shard.
+/// @param hash Key hash.
+/// @return Bucket's first entry.
+static SOCKET_CACHE_ENTRY** SocketCacheBucket(SOCKET_CACHE_SHARD* p_shard, const uint64_t hash)
+{
+    return &p_shard->p_buckets[hash & p_shard->buckets_mask];
+}
+
+/// @brief Gets the memory taken by an entry, which is what the memory budget is made of.
+/// @param p_entry Target entry.
+/// @return Entry size in bytes.
+static unsigned long SocketCacheEntryBytes(const SOCKET_CACHE_ENTRY* p_entry)
+{
+    return sizeof(SOCKET_CACHE_ENTRY) + p_entry->key_size + p_entry->response_size;
+}
+
+/// @brief Looks for an entry. Shard must be locked.
+/// @param p_shard Target shard.
+/// @param hash Key hash.
+/// @param key Key.
+/// @param key_size Key size.
+/// @return Entry if found (expired or not), NULL otherwise.
+static SOCKET_CACHE_ENTRY* SocketCacheFind(SOCKET_CACHE_SHARD* p_shard, const uint64_t hash, const char* key, const unsigned long key_size)
+{
+    for(SOCKET_CACHE_ENTRY* p_entry = *SocketCacheBucket(p_shard, hash); p_entry; p_entry = p_entry->p_bucket_next)
+        if(p_entry->hash == hash && p_entry->key_size == key_size && memcmp(p_entry->data, key, key_size) == 0)
+            return p_entry;
+
+    return NULL;
+}
+
+/// @brief Removes an entry from its shard, dropping the cache's reference. Shard must be locked.
+/// @param p_shard Target shard.
+/// @param p_entry Target entry.
+static void SocketCacheUnlink(SOCKET_CACHE_SHARD* p_shard, SOCKET_CACHE_ENTRY* p_entry)
+{
+    SOCKET_CACHE_ENTRY** pp_link = SocketCacheBucket(p_shard, p_entry->hash);
+
+    while(*pp_link != p_entry)
+        pp_link = &(*pp_link)->p_bucket_next;
+
+    *pp_link = p_entry->p_bucket_next;
+
+    if(p_entry->p_clock_next == p_entry)
+        p_shard->p_hand = NULL;
+    else
+    {
+        p_entry->p_clock_prev->p_clock_next = p_entry->p_clock_next;
+        p_entry->p_clock_next->p_clock_prev = p_entry->p_clock_prev;
+
+        if(p_shard->p_hand == p_entry)
+            p_shard->p_hand = p_entry->p_clock_next;
+    }
+
+    p_shard->bytes -= SocketCacheEntryBytes(p_entry);
+
+    SocketCacheEntryRelease(p_entry);
+}
+
+/// @brief Adds an entry to its shard, right behind the CLOCK hand (so it is the last one to be swept). Shard must be locked.
+/// @param p_shard Target shard.
+/// @param p_entry Target entry.
+static void SocketCacheLink(SOCKET_CACHE_SHARD* p_shard, SOCKET_CACHE_ENTRY* p_entry)
+{
+    SOCKET_CACHE_ENTRY** pp_bucket = SocketCacheBucket(p_shard, p_entry->hash);
+
+    p_entry->p_bucket_next = *pp_bucket;
+    *pp_bucket = p_entry;
+
+    if(!p_shard->p_hand)
+    {
+        p_entry->p_clock_next = p_entry;
+        p_entry->p_clock_prev = p_entry;
+        p_shard->p_hand = p_entry;
+    }
+    else
+    {
+        p_entry->p_clock_next = p_shard->p_hand;
+        p_entry->p_clock_prev = p_shard->p_hand->p_clock_prev;
+        p_entry->p_clock_prev->p_clock_next = p_entry;
+        p_shard->p_hand->p_clock_prev = p_entry;
+    }
+
+    p_shard->bytes += SocketCacheEntryBytes(p_entry);
+}
+
+/// @brief Evicts entries (CLOCK: entries hit since the hand last went by get a second chance, expired ones do not)
+/// until a given amount of bytes fits into the shard. Shard must be locked.
+/// @param p_shard Target shard.
+/// @param needed_bytes Amount of bytes to make room for (never above the shard's budget).
+static void SocketCacheEvict(SOCKET_CACHE_SHARD* p_shard, const unsigned long needed_bytes)
+{
+    unsigned long now_ms = SocketCacheNowMs();
+
+    while(p_shard->p_hand && p_shard->bytes + needed_bytes > cache_shard_bytes)
+    {
+        SOCKET_CACHE_ENTRY* p_candidate = p_shard->p_hand;
+        bool expired = (cache_ttl_ms != SOCKET_CACHE_NO_TTL && now_ms >= p_candidate->expiry_ms);
+
+        if(p_candidate->referenced && !expired)
+        {
+            p_candidate->referenced = false;
+            p_shard->p_hand = p_candidate->p_clock_next;
+            continue;
+        }
+
+        SocketCacheUnlink(p_shard, p_candidate);
+        SocketStatsCount(SERVER_SOCKET_CNT_CACHE_EVICTIONS, 1);
+    }
+}
+
+/// @brief Tells whether the response cache has been set up.
+/// @return True if responses can be cached, false otherwise.
+bool SocketCacheEnabled(void)
+{
+    return (p_cache_shards != NULL);
+}
+
+/// @brief Allocates shards, their hash tables being sized after the memory budget.
+/// @return 0 if succeeded (or the cache is disabled), < 0 otherwise.
+int SocketSetupCache(void)
+{
+    if(cache_max_bytes == SOCKET_CACHE_DISABLED || p_cache_shards != NULL)
+        return SERVER_SOCKET_CACHE_SUCCESS;
+
+    SOCKET_CACHE_SHARD* p_shards = aligned_alloc(SOCKET_CACHE_CACHE_LINE_SIZE, SOCKET_CACHE_SHARDS_NUM * sizeof(SOCKET_CACHE_SHARD));
+
+    if(!p_shards)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_CACHE_SETUP_NOK);
+        return SERVER_SOCKET_CACHE_ERR_ALLOC;
+    }
+
+    cache_shard_bytes = cache_max_bytes / SOCKET_CACHE_SHARDS_NUM;
+
+    unsigned long buckets_num = SOCKET_CACHE_MIN_BUCKETS;
+
+    while(buckets_num < SOCKET_CACHE_MAX_BUCKETS && buckets_num * SOCKET_CACHE_EXPECTED_ENTRY_SIZE < cache_shard_bytes)
+        buckets_num <<= 1;
+
+    for(int shard_idx = 0; shard_idx < SOCKET_CACHE_SHARDS_NUM; shard_idx++)
+    {
+        p_shards[shard_idx] = (SOCKET_CACHE_SHARD)
+        {
+            .p_buckets      = calloc(buckets_num, sizeof(SOCKET_CACHE_ENTRY*))  ,
+            .buckets_mask   = buckets_num - 1                                   ,
+        };
+
+        pthread_mutex_init(&p_shards[shard_idx].mtx, NULL);
+
+        if(!p_shards[shard_idx].p_buckets)
+        {
+            for(int allocated_idx = 0; allocated_idx <= shard_idx; allocated_idx++)
+            {
+                free(p_shards[allocated_idx].p_buckets);
+                pthread_mutex_destroy(&p_shards[allocated_idx].mtx);
+            }
+
+            free(p_shards);
+            SVRTY_LOG_WNG(SERVER_SOCKET_MSG_CACHE_SETUP_NOK);
+            return SERVER_SOCKET_CACHE_ERR_ALLOC;
+        }
+    }
+
+    p_cache_shards = p_shards;
+
+    return SERVER_SOCKET_CACHE_SUCCESS;
+}
+
+/// @brief Looks for a response, counting hits and misses. Expired responses are dropped on the way.
+/// @param key Key.
+/// @param key_size Key size.
+/// @return Entry holding the response (to be released with SocketCacheEntryRelease once written), NULL if there is none.
+SOCKET_CACHE_ENTRY* SocketCacheLookup(const char* key, const unsigned long key_size)
+{
+    uint64_t hash = SocketCacheHash(key, key_size);
+    SOCKET_CACHE_SHARD* p_shard = SocketCacheShard(hash);
+
+    pthread_mutex_lock(&p_shard->mtx);
+
+    SOCKET_CACHE_ENTRY* p_entry = SocketCacheFind(p_shard, hash, key, key_size);
+
+    if(p_entry && cache_ttl_ms != SOCKET_CACHE_NO_TTL && SocketCacheNowMs() >= p_entry->expiry_ms)
+    {
+        SocketCacheUnlink(p_shard, p_entry);
+        SocketStatsCount(SERVER_SOCKET_CNT_CACHE_EVICTIONS, 1);
+        p_entry = NULL;
+    }
+
+    if(p_entry)
+    {
+        p_entry->referenced = true;
+        __atomic_add_fetch(&p_entry->refs, 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&p_shard->mtx);
+
+    SocketStatsCount(p_entry ? SERVER_SOCKET_CNT_CACHE_HITS : SERVER_SOCKET_CNT_CACHE_MISSES, 1);
+
+    return p_entry;
+}
+
+/// @brief Gets the response held by an entry.
+/// @param p_entry Target entry.
+/// @param p_response_size Target response size.
+/// @return Response data, valid until the entry is released.
+const char* SocketCacheEntryResponse(const SOCKET_CACHE_ENTRY* p_entry, unsigned long* p_response_size)
+{
+    *p_response_size = p_entry->response_size;
+
+    return p_entry->data + p_entry->key_size;
+}
+
+/// @brief Drops a reference to an entry, freeing it if it was the last one.
+/// @param p_entry Target entry.
+void SocketCacheEntryRelease(SOCKET_CACHE_ENTRY* p_entry)
+{
+    if(__atomic_sub_fetch(&p_entry->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(p_entry);
+}
+
+/// @brief Gets the memory taken by cached responses.
+/// @return Cached bytes, bookkeeping included.
+unsigned long SocketCacheBytes(void)
+{
+    if(!p_cache_shards)
+        return 0;
+
+    unsigned long bytes = 0;
+
+    for(int shard_idx = 0; shard_idx < SOCKET_CACHE_SHARDS_NUM; shard_idx++)
+        bytes += __atomic_load_n(&p_cache_shards[shard_idx].bytes, __ATOMIC_RELAXED);
+
+    return bytes;
+}
+
+/// @brief Sets the response cache up. To be called before ServerSocketRun.
+/// @param max_bytes Memory budget, 0 to disable the cache (default).
+/// @param ttl_ms Time responses are valid for, 0 to keep them until evicted.
+void ServerSocketSetResponseCache(const unsigned long max_bytes, const unsigned long ttl_ms)
+{
+    cache_max_bytes = max_bytes;
+    cache_ttl_ms = ttl_ms;
+}
+
+/// @brief Stores a response, replacing the one stored under the same key (if any).
+/// @param key Key (request bytes or any handler-supplied key).
+/// @param key_size Key size.
+/// @param response Response data.
+/// @param response_size Response size.
+/// @return 0 if succeeded, < 0 if the cache is disabled, the entry does not fit into a shard or it could not be allocated.
+int ServerSocketCacheStore(const char* key, const unsigned long key_size, const char* response, const unsigned long response_size)
+{
+    if(!p_cache_shards)
+        return SERVER_SOCKET_CACHE_ERR_DISABLED;
+
+    if(!key || (!response && response_size > 0) || sizeof(SOCKET_CACHE_ENTRY) + key_size + response_size > cache_shard_bytes)
+        return SERVER_SOCKET_CACHE_ERR_SIZE;
+
+    SOCKET_CACHE_ENTRY* p_entry = malloc(sizeof(SOCKET_CACHE_ENTRY) + key_size + response_size);
+
+    if(!p_entry)
+        return SERVER_SOCKET_CACHE_ERR_ALLOC;
+
+    p_entry->hash           = SocketCacheHash(key, key_size);
+    p_entry->expiry_ms      = (cache_ttl_ms != SOCKET_CACHE_NO_TTL ? SocketCacheNowMs() + cache_ttl_ms : 0);
+    p_entry->key_size       = key_size;
+    p_entry->response_size  = response_size;
+    p_entry->refs           = 1;
+    p_entry->referenced     = false;
+
+    memcpy(p_entry->data, key, key_size);
+    memcpy(p_entry->data + key_size, response, response_size);
+
+    SOCKET_CACHE_SHARD* p_shard = SocketCacheShard(p_entry->hash);
+
+    pthread_mutex_lock(&p_shard->mtx);
+
+    SOCKET_CACHE_ENTRY* p_previous = SocketCacheFind(p_shard, p_entry->hash, key, key_size);
+
+    if(p_previous)
+        SocketCacheUnlink(p_shard, p_previous);
+
+    SocketCacheEvict(p_shard, SocketCacheEntryBytes(p_entry));
+    SocketCacheLink(p_shard, p_entry);
+
+    pthread_mutex_unlock(&p_shard->mtx);
+
+    return SERVER_SOCKET_CACHE_SUCCESS;
+}
+
+/// @brief Drops the response stored under a key (if any).
+/// @param key Key.
+/// @param key_size Key size.
+/// @return 1 if a response was dropped, 0 if there was none, < 0 if the cache is disabled.
+int ServerSocketCacheInvalidate(const char* key, const unsigned long key_size)
+{
+    if(!p_cache_shards)
+        return SERVER_SOCKET_CACHE_ERR_DISABLED;
+
+    uint64_t hash = SocketCacheHash(key, key_size);
+    SOCKET_CACHE_SHARD* p_shard = SocketCacheShard(hash);
+
+    pthread_mutex_lock(&p_shard->mtx);
+
+    SOCKET_CACHE_ENTRY* p_entry = SocketCacheFind(p_shard, hash, key, key_size);
+
+    if(p_entry)
+        SocketCacheUnlink(p_shard, p_entry);
+
+    pthread_mutex_unlock(&p_shard->mtx);
+
+    return (p_entry ? SERVER_SOCKET_CACHE_HIT : SERVER_SOCKET_CACHE_MISS);
+}
+
+/// @brief Writes the response stored under a key straight from the cache (no copy on the library's side).
+/// @param client_socket Client socket.
+/// @param key Key.
+/// @param key_size Key size.
+/// @return 1 if the whole response was written, 0 if there is none (or the cache is disabled), < 0 if writing failed.
+int ServerSocketWriteCached(int client_socket, const char* key, const unsigned long key_size)
+{
+    if(!p_cache_shards)
+        return SERVER_SOCKET_CACHE_MISS;
+
+    SOCKET_CACHE_ENTRY* p_entry = SocketCacheLookup(key, key_size);
+
+    if(!p_entry)
+        return SERVER_SOCKET_CACHE_MISS;
+
+    unsigned long response_size;
+    const char* response = SocketCacheEntryResponse(p_entry, &response_size);
+    unsigned long written = 0;
+    int write_cached = SERVER_SOCKET_CACHE_HIT;
+
+    while(written < response_size)
+    {
+        int write_to_socket = ServerSocketWrite(client_socket, response + written, response_size - written);
+
+        if(write_to_socket > 0)
+        {
+            written += write_to_socket;
+            continue;
+        }
+
+        if(write_to_socket == 0 || ServerSocketRetryWrite(client_socket) < 0)
+        {
+            write_cached = SERVER_SOCKET_CACHE_ERR_WRITE;
+            break;
+        }
+    }
+
+    SocketCacheEntryRelease(p_entry);
+
+    return write_cached;
+}
+
+/// @brief Frees every cached response, as well as shards. Responses still referenced are freed once released.
+void SocketFreeCacheResources(void)
+{
+    if(!p_cache_shards)
+        return;
+
+    for(int shard_idx = 0; shard_idx < SOCKET_CACHE_SHARDS_NUM; shard_idx++)
+    {
+        SOCKET_CACHE_SHARD* p_shard = &p_cache_shards[shard_idx];
+
+        pthread_mutex_lock(&p_shard->mtx);
+
+        while(p_shard->p_hand)
+            SocketCacheUnlink(p_shard, p_shard->p_hand);
+
+        pthread_mutex_unlock(&p_shard->mtx);
+
+        free(p_shard->p_buckets);
+        pthread_mutex_destroy(&p_shard->mtx);
+    }
+
+    free(p_cache_shards);
+    p_cache_shards = NULL;
+}
+
+/*************************************/
@@ -0,0 +1,34 @@
+#ifndef SERVER_SOCKET_CACHE_H
+#define SERVER_SOCKET_CACHE_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+typedef struct SOCKET_CACHE_ENTRY SOCKET_CACHE_ENTRY;
+
+/**********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketCacheEnabled(void);
+int SocketSetupCache(void);
+SOCKET_CACHE_ENTRY* SocketCacheLookup(const char* key, unsigned long key_size);
+const char* SocketCacheEntryResponse(const SOCKET_CACHE_ENTRY* p_entry, unsigned long* p_response_size);
+void SocketCacheEntryRelease(SOCKET_CACHE_ENTRY* p_entry);
+unsigned long SocketCacheBytes(void);
+void SocketFreeCacheResources(void);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,640 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "ServerSocketCompress.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketShm.h"
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketSSL.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_COMPRESS_SUCCESS          0
+#define SERVER_SOCKET_COMPRESS_ERR_ALGORITHM    -1
+#define SERVER_SOCKET_COMPRESS_ERR_ALLOC        -2
+#define SERVER_SOCKET_COMPRESS_ERR_WRITE        -3
+#define SERVER_SOCKET_COMPRESS_ERR_FRAME        -4
+#define SERVER_SOCKET_COMPRESS_ERR_NOT_WORTH    -5
+#define SERVER_SOCKET_COMPRESS_ERR_TRANSPORT    -6
+
+#define SOCKET_COMPRESS_DEFAULT_LEVEL           Z_DEFAULT_COMPRESSION
+#define SOCKET_COMPRESS_DEFAULT_MIN_SIZE        128
+#define SOCKET_COMPRESS_WINDOW_BITS             (-MAX_WBITS)    // Raw deflate (no zlib header nor checksum).
+#define SOCKET_COMPRESS_MEM_LEVEL               8
+#define SOCKET_COMPRESS_TRAILER_SIZE            4               // Empty stored block ending every sync flush (00 00 FF FF).
+#define SOCKET_COMPRESS_MAX_CACHED_CTXS         64
+#define SOCKET_COMPRESS_TX_FRAME_SIZE           (SERVER_SOCKET_COMPRESS_HEADER_SIZE + SERVER_SOCKET_COMPRESS_MAX_FRAME + SOCKET_COMPRESS_TRAILER_SIZE)
+#define SOCKET_COMPRESS_RX_BUFFER_SIZE          (SERVER_SOCKET_COMPRESS_HEADER_SIZE + SERVER_SOCKET_COMPRESS_MAX_FRAME)
+
+#define SERVER_SOCKET_MSG_COMPRESS_CTX_NOK      "Could not set up compression context for socket <%d>."
+#define SERVER_SOCKET_MSG_COMPRESS_BAD_FRAME    "Malformed compressed frame received from socket <%d>."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Per-connection compression state. Both streams carry on across frames, so small similar messages
+/// compress against the ones sent before them.
+typedef struct SOCKET_COMPRESS_CTX
+{
+    z_stream                    deflater;
+    z_stream                    inflater;
+    int                         level;
+    unsigned char*              p_tx_frame;     // Frame being sent, header included.
+    unsigned char*              p_rx_buffer;    // Received data, starting with the frame being delivered.
+    unsigned long               rx_used;        // Amount of bytes in the RX buffer.
+    unsigned long               rx_fed;         // Payload bytes of the current frame delivered (or handed to the inflater).
+    bool                        rx_started;     // Current frame's flags have been handled.
+    bool                        rx_trailer_fed; // Sync flush trailer has been handed to the inflater.
+    struct SOCKET_COMPRESS_CTX* next_free;
+} SOCKET_COMPRESS_CTX;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static int              compress_level      = SOCKET_COMPRESS_DEFAULT_LEVEL;
+static unsigned long    compress_min_size   = SOCKET_COMPRESS_DEFAULT_MIN_SIZE;
+
+static const unsigned char sync_flush_trailer[SOCKET_COMPRESS_TRAILER_SIZE] = {0x00, 0x00, 0xFF, 0xFF};
+
+/// @brief Context owned by the connection served by the current thread.
+static __thread SOCKET_COMPRESS_CTX* p_thread_ctx = NULL;
+
+/// @brief Contexts released by closed connections, kept so their (rather big) buffers and zlib states can be reused.
+static SOCKET_COMPRESS_CTX* p_free_ctxs     = NULL;
+static int                  free_ctxs_num   = 0;
+static pthread_mutex_t      free_ctxs_mtx   = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread bool socket_compress_active = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static SOCKET_COMPRESS_CTX* SocketCompressCreateCtx(void);
+static void SocketCompressDestroyCtx(SOCKET_COMPRESS_CTX* p_ctx);
+static SOCKET_COMPRESS_CTX* SocketCompressTakeCtx(void);
+static void SocketCompressAccountIO(int io_result, SERVER_SOCKET_CNT bytes_cnt, SERVER_SOCKET_HIST bytes_hist);
+static unsigned long SocketCompressFrameSize(const unsigned char* p_frame);
+static bool SocketCompressFrameReady(const SOCKET_COMPRESS_CTX* p_ctx);
+static void SocketCompressNextFrame(SOCKET_COMPRESS_CTX* p_ctx);
+static int SocketCompressDeliver(SOCKET_COMPRESS_CTX* p_ctx, char* rx_buffer, unsigned long rx_buffer_size);
+static long SocketCompressDeflate(SOCKET_COMPRESS_CTX* p_ctx, const struct iovec* p_iov, int iov_idx, unsigned long iov_offset, unsigned long input_size);
+static int SocketCompressSend(int client_socket, const unsigned char* p_frame, unsigned long frame_size);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Allocates a context and sets both zlib streams up with current settings.
+/// @return New context, NULL if it could not be set up.
+static SOCKET_COMPRESS_CTX* SocketCompressCreateCtx(void)
+{
+    SOCKET_COMPRESS_CTX* p_ctx = calloc(1, sizeof(SOCKET_COMPRESS_CTX));
+
+    if(!p_ctx)
+        return NULL;
+
+    p_ctx->level        = compress_level;
+    p_ctx->p_tx_frame   = malloc(SOCKET_COMPRESS_TX_FRAME_SIZE);
+    p_ctx->p_rx_buffer  = malloc(SOCKET_COMPRESS_RX_BUFFER_SIZE);
+
+    bool deflater_ready = (deflateInit2(&p_ctx->deflater, p_ctx->level, Z_DEFLATED, SOCKET_COMPRESS_WINDOW_BITS, SOCKET_COMPRESS_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK);
+    bool inflater_ready = (inflateInit2(&p_ctx->inflater, SOCKET_COMPRESS_WINDOW_BITS) == Z_OK);
+
+    if(p_ctx->p_tx_frame && p_ctx->p_rx_buffer && deflater_ready && inflater_ready)
+        return p_ctx;
+
+    if(deflater_ready)
+        deflateEnd(&p_ctx->deflater);
+
+    if(inflater_ready)
+        inflateEnd(&p_ctx->inflater);
+
+    free(p_ctx->p_tx_frame);
+    free(p_ctx->p_rx_buffer);
+    free(p_ctx);
+
+    return NULL;
+}
+
+/// @brief Frees a context.
+/// @param p_ctx Target context.
+static void SocketCompressDestroyCtx(SOCKET_COMPRESS_CTX* p_ctx)
+{
+    deflateEnd(&p_ctx->deflater);
+    inflateEnd(&p_ctx->inflater);
+    free(p_ctx->p_tx_frame);
+    free(p_ctx->p_rx_buffer);
+    free(p_ctx);
+}
+
+/// @brief Takes a cached context, or creates a new one if there is none.
+/// @return Context, NULL if it could not be set up.
+static SOCKET_COMPRESS_CTX* SocketCompressTakeCtx(void)
+{
+    SOCKET_COMPRESS_CTX* p_ctx = NULL;
+
+    pthread_mutex_lock(&free_ctxs_mtx);
+
+    // Contexts set up before the compression level was changed are not reused.
+    while(p_free_ctxs && !p_ctx)
+    {
+        SOCKET_COMPRESS_CTX* p_free_ctx = p_free_ctxs;
+        p_free_ctxs = p_free_ctx->next_free;
+        free_ctxs_num--;
+
+        if(p_free_ctx->level == compress_level)
+            p_ctx = p_free_ctx;
+        else
+            SocketCompressDestroyCtx(p_free_ctx);
+    }
+
+    pthread_mutex_unlock(&free_ctxs_mtx);
+
+    return (p_ctx ? p_ctx : SocketCompressCreateCtx());
+}
+
+/// @brief Updates I/O statistics (and pushes idle deadline forward) after a read/write operation on the wire.
+/// @param io_result Value returned by the read/write operation.
+/// @param bytes_cnt Counter to add transferred bytes to.
+/// @param bytes_hist Histogram to record transferred bytes into.
+static void SocketCompressAccountIO(const int io_result, const SERVER_SOCKET_CNT bytes_cnt, const SERVER_SOCKET_HIST bytes_hist)
+{
+    if(io_result > 0)
+    {
+        SocketStatsCount(bytes_cnt, io_result);
+        SocketStatsRecord(bytes_hist, io_result);
+        SocketTimerTouch();
+        SocketBufTuneTransferred(io_result);
+    }
+    else if(io_result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+}
+
+/// @brief Decodes frame payload size.
+/// @param p_frame Frame, header included.
+/// @return Payload size.
+static unsigned long SocketCompressFrameSize(const unsigned char* p_frame)
+{
+    return ((unsigned long)p_frame[1] << 24) | ((unsigned long)p_frame[2] << 16) | ((unsigned long)p_frame[3] << 8) | p_frame[4];
+}
+
+/// @brief Tells whether the frame at the beginning of the RX buffer has been fully received.
+/// @param p_ctx Connection context.
+/// @return True if it is complete, false otherwise.
+static bool SocketCompressFrameReady(const SOCKET_COMPRESS_CTX* p_ctx)
+{
+    return (p_ctx->rx_used >= SERVER_SOCKET_COMPRESS_HEADER_SIZE &&
+            p_ctx->rx_used - SERVER_SOCKET_COMPRESS_HEADER_SIZE >= SocketCompressFrameSize(p_ctx->p_rx_buffer));
+}
+
+/// @brief Drops the frame at the beginning of the RX buffer once it has been fully delivered, moving whatever came after it to the front.
+/// @param p_ctx Connection context.
+static void SocketCompressNextFrame(SOCKET_COMPRESS_CTX* p_ctx)
+{
+    unsigned long frame_size = SERVER_SOCKET_COMPRESS_HEADER_SIZE + SocketCompressFrameSize(p_ctx->p_rx_buffer);
+
+    p_ctx->rx_used -= frame_size;
+    memmove(p_ctx->p_rx_buffer, p_ctx->p_rx_buffer + frame_size, p_ctx->rx_used);
+
+    p_ctx->rx_fed = 0;
+    p_ctx->rx_started = false;
+    p_ctx->rx_trailer_fed = false;
+}
+
+/// @brief Delivers (part of) the payload of the complete frame at the beginning of the RX buffer, inflating it if needed.
+/// Deflated payloads may inflate to more than the RX buffer can take, in which case the rest is delivered on next calls.
+/// @param p_ctx Connection context.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes delivered, 0 if the frame turned out to be empty, < 0 if it is malformed.
+static int SocketCompressDeliver(SOCKET_COMPRESS_CTX* p_ctx, char* rx_buffer, const unsigned long rx_buffer_size)
+{
+    unsigned char flags = p_ctx->p_rx_buffer[0];
+    unsigned char* p_payload = p_ctx->p_rx_buffer + SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+    unsigned long payload_size = SocketCompressFrameSize(p_ctx->p_rx_buffer);
+    z_stream* p_inflater = &p_ctx->inflater;
+
+    if(!p_ctx->rx_started && (flags & SERVER_SOCKET_COMPRESS_FLAG_RESET))
+        inflateReset(p_inflater);
+
+    p_ctx->rx_started = true;
+
+    if(!(flags & SERVER_SOCKET_COMPRESS_FLAG_DEFLATE))
+    {
+        unsigned long to_deliver = payload_size - p_ctx->rx_fed;
+
+        if(to_deliver > rx_buffer_size)
+            to_deliver = rx_buffer_size;
+
+        memcpy(rx_buffer, p_payload + p_ctx->rx_fed, to_deliver);
+        p_ctx->rx_fed += to_deliver;
+
+        if(p_ctx->rx_fed == payload_size)
+            SocketCompressNextFrame(p_ctx);
+
+        return (int)to_deliver;
+    }
+
+    p_inflater->next_out = (unsigned char*)rx_buffer;
+    p_inflater->avail_out = rx_buffer_size;
+
+    // The payload is handed to the inflater first, then the sync flush trailer the sender stripped off.
+    while(p_inflater->avail_out > 0)
+    {
+        if(p_inflater->avail_in == 0)
+        {
+            if(p_ctx->rx_fed < payload_size)
+            {
+                p_inflater->next_in = p_payload + p_ctx->rx_fed;
+                p_inflater->avail_in = payload_size - p_ctx->rx_fed;
+                p_ctx->rx_fed = payload_size;
+            }
+            else if(!p_ctx->rx_trailer_fed)
+            {
+                p_inflater->next_in = (unsigned char*)sync_flush_trailer;
+                p_inflater->avail_in = sizeof(sync_flush_trailer);
+                p_ctx->rx_trailer_fed = true;
+            }
+        }
+
+        // Inflater is called even if there is no input left, as it may still hold output the RX buffer could not take last time.
+        int inflate_payload = inflate(p_inflater, Z_SYNC_FLUSH);
+
+        // Senders finishing their stream start a new one straight away.
+        if(inflate_payload == Z_STREAM_END)
+            inflateReset(p_inflater);
+        else if(inflate_payload == Z_BUF_ERROR)
+            break;
+        else if(inflate_payload != Z_OK)
+            return SERVER_SOCKET_COMPRESS_ERR_FRAME;
+    }
+
+    int delivered = (int)(rx_buffer_size - p_inflater->avail_out);
+
+    // Room left in the RX buffer means nothing is pending inside the inflater.
+    if(p_ctx->rx_trailer_fed && p_inflater->avail_in == 0 && p_inflater->avail_out > 0)
+        SocketCompressNextFrame(p_ctx);
+    else if(delivered == 0)
+        return SERVER_SOCKET_COMPRESS_ERR_FRAME;
+
+    return delivered;
+}
+
+/// @brief Compresses data spread over several chunks into the TX frame, as a continuation of the connection's deflate stream.
+/// If compressed data would not be smaller, the stream is restarted instead (so the receiver must restart its own too).
+/// @param p_ctx Connection context.
+/// @param p_iov Data chunks.
+/// @param iov_idx First chunk.
+/// @param iov_offset Offset into the first chunk.
+/// @param input_size Amount of bytes to be compressed (a frame worth at most).
+/// @return Compressed payload size (sync flush trailer stripped), < 0 if it was not worth it.
+static long SocketCompressDeflate(SOCKET_COMPRESS_CTX* p_ctx, const struct iovec* p_iov, int iov_idx, unsigned long iov_offset, const unsigned long input_size)
+{
+    z_stream* p_deflater = &p_ctx->deflater;
+
+    // Any output reaching the input size (trailer apart) is not worth sending, so there is no point in producing more.
+    unsigned long max_output = input_size - 1 + SOCKET_COMPRESS_TRAILER_SIZE;
+    unsigned long remaining = input_size;
+
+    p_deflater->next_out = p_ctx->p_tx_frame + SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+    p_deflater->avail_out = max_output;
+
+    while(remaining > 0)
+    {
+        unsigned long chunk_size = p_iov[iov_idx].iov_len - iov_offset;
+
+        if(chunk_size > remaining)
+            chunk_size = remaining;
+
+        remaining -= chunk_size;
+
+        p_deflater->next_in = (unsigned char*)p_iov[iov_idx].iov_base + iov_offset;
+        p_deflater->avail_in = chunk_size;
+
+        int deflate_chunk = deflate(p_deflater, (remaining == 0 ? Z_SYNC_FLUSH : Z_NO_FLUSH));
+
+        if(deflate_chunk == Z_STREAM_ERROR || p_deflater->avail_in > 0 || p_deflater->avail_out == 0)
+        {
+            deflateReset(p_deflater);
+            return SERVER_SOCKET_COMPRESS_ERR_NOT_WORTH;
+        }
+
+        iov_idx++;
+        iov_offset = 0;
+    }
+
+    return (long)(max_output - p_deflater->avail_out) - SOCKET_COMPRESS_TRAILER_SIZE;
+}
+
+/// @brief Sends a whole frame. Frames cannot be cut short, as the receiver would lose track of them otherwise.
+/// @param client_socket Client socket.
+/// @param p_frame Frame, header included.
+/// @param frame_size Frame size.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketCompressSend(const int client_socket, const unsigned char* p_frame, const unsigned long frame_size)
+{
+    unsigned long written = 0;
+
+    while(written < frame_size)
+    {
+        int write_to_socket;
+
+        if(!ServerSocketIsSecure())
+            write_to_socket = write(client_socket, p_frame + written, frame_size - written);
+        else
+            write_to_socket = ServerSocketSSLWrite((const char*)p_frame + written, frame_size - written);
+
+        SocketCompressAccountIO(write_to_socket, SERVER_SOCKET_CNT_BYTES_OUT, SERVER_SOCKET_HIST_WRITE_BYTES);
+
+        if(write_to_socket <= 0)
+        {
+            if(write_to_socket == 0 || ServerSocketRetryWrite(client_socket) < 0)
+                return SERVER_SOCKET_COMPRESS_ERR_WRITE;
+
+            continue;
+        }
+
+        written += write_to_socket;
+    }
+
+    return SERVER_SOCKET_COMPRESS_SUCCESS;
+}
+
+/// @brief Sets compression parameters. To be called before ServerSocketRun.
+/// @param level zlib compression level (1 fastest to 9 smallest, -1 for zlib's default).
+/// @param min_size Writes smaller than this are sent uncompressed.
+void ServerSocketSetCompression(const int level, const unsigned long min_size)
+{
+    compress_level = (level >= Z_DEFAULT_COMPRESSION && level <= Z_BEST_COMPRESSION ? level : SOCKET_COMPRESS_DEFAULT_LEVEL);
+    compress_min_size = min_size;
+}
+
+/// @brief Enables compression for the current connection. To be called from the interaction function.
+/// @param client_socket Client socket.
+/// @param algorithm Compression algorithm.
+/// @return 0 if succeeded, < 0 if the algorithm is not supported or no context could be set up.
+int ServerSocketEnableCompression(int client_socket, SERVER_SOCKET_COMPRESSION algorithm)
+{
+    if(algorithm == SERVER_SOCKET_COMPRESSION_NONE)
+        return (socket_compress_active ? SERVER_SOCKET_COMPRESS_ERR_ALGORITHM : SERVER_SOCKET_COMPRESS_SUCCESS);
+
+    if(algorithm != SERVER_SOCKET_COMPRESSION_DEFLATE)
+        return SERVER_SOCKET_COMPRESS_ERR_ALGORITHM;
+
+    if(socket_compress_active)
+        return SERVER_SOCKET_COMPRESS_SUCCESS;
+
+    // Shared-memory rings never touch the wire, so there is nothing worth compressing.
+    if(SocketShmActive())
+        return SERVER_SOCKET_COMPRESS_ERR_TRANSPORT;
+
+    p_thread_ctx = SocketCompressTakeCtx();
+
+    if(!p_thread_ctx)
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_COMPRESS_CTX_NOK, client_socket);
+        return SERVER_SOCKET_COMPRESS_ERR_ALLOC;
+    }
+
+    socket_compress_active = true;
+
+    // Broadcasts have to be compressed as well, so only the serving thread may write them from now on.
+    SocketBroadcastOwnerOnly();
+
+    return SERVER_SOCKET_COMPRESS_SUCCESS;
+}
+
+/// @brief Reads from a compressed connection: frames are received, then their payload is delivered (inflated if needed).
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes delivered if > 0, 0 if client got disconnected, < 0 if no data could be read or a malformed frame was received.
+int SocketCompressRead(const int client_socket, char* rx_buffer, const unsigned long rx_buffer_size)
+{
+    SOCKET_COMPRESS_CTX* p_ctx = p_thread_ctx;
+
+    while(true)
+    {
+        if(SocketCompressFrameReady(p_ctx))
+        {
+            int deliver_payload = SocketCompressDeliver(p_ctx, rx_buffer, rx_buffer_size);
+
+            if(deliver_payload > 0)
+                SocketStatsCount(SERVER_SOCKET_CNT_PAYLOAD_BYTES_IN, deliver_payload);
+
+            if(deliver_payload < 0)
+            {
+                SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_COMPRESS_BAD_FRAME, client_socket);
+                errno = EPROTO;
+            }
+
+            if(deliver_payload != 0)
+                return deliver_payload;
+
+            continue;
+        }
+
+        if(p_ctx->rx_used >= SERVER_SOCKET_COMPRESS_HEADER_SIZE && SocketCompressFrameSize(p_ctx->p_rx_buffer) > SERVER_SOCKET_COMPRESS_MAX_FRAME)
+        {
+            SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_COMPRESS_BAD_FRAME, client_socket);
+            errno = EMSGSIZE;
+            return SERVER_SOCKET_COMPRESS_ERR_FRAME;
+        }
+
+        // Whatever follows the current frame is read too, so small frames do not take a read each.
+        int read_from_socket;
+        char* p_free = (char*)p_ctx->p_rx_buffer + p_ctx->rx_used;
+        unsigned long free_space = SOCKET_COMPRESS_RX_BUFFER_SIZE - p_ctx->rx_used;
+
+        if(!ServerSocketIsSecure())
+            read_from_socket = read(client_socket, p_free, free_space);
+        else
+            read_from_socket = ServerSocketSSLRead(p_free, free_space);
+
+        SocketCompressAccountIO(read_from_socket, SERVER_SOCKET_CNT_BYTES_IN, SERVER_SOCKET_HIST_READ_BYTES);
+
+        // Non-blocking sockets give up here if the frame is still incomplete, and carry on with it on next call.
+        if(read_from_socket <= 0)
+            return read_from_socket;
+
+        p_ctx->rx_used += read_from_socket;
+    }
+}
+
+/// @brief Writes to a compressed connection. Data is cut into frames, each one deflated unless it is too small
+/// or does not compress, and every frame is sent whole.
+/// @param client_socket Client socket.
+/// @param p_iov Data chunks, all of them sent as a single stream of bytes.
+/// @param iov_num Amount of chunks.
+/// @return Amount of bytes written (all of them) if succeeded, < 0 otherwise.
+int SocketCompressWritev(const int client_socket, const struct iovec* p_iov, const int iov_num)
+{
+    SOCKET_COMPRESS_CTX* p_ctx = p_thread_ctx;
+    unsigned long total = 0;
+    unsigned long iov_offset = 0;
+    int iov_idx = 0;
+
+    while(iov_idx < iov_num)
+    {
+        // Gather as many bytes as a frame can take.
+        unsigned long input_size = 0;
+
+        for(int chunk_idx = iov_idx; chunk_idx < iov_num && input_size < SERVER_SOCKET_COMPRESS_MAX_FRAME; chunk_idx++)
+            input_size += p_iov[chunk_idx].iov_len - (chunk_idx == iov_idx ? iov_offset : 0);
+
+        if(input_size > SERVER_SOCKET_COMPRESS_MAX_FRAME)
+            input_size = SERVER_SOCKET_COMPRESS_MAX_FRAME;
+
+        if(input_size == 0)
+            break;
+
+        unsigned char flags = 0;
+        long payload_size = SERVER_SOCKET_COMPRESS_ERR_NOT_WORTH;
+
+        if(input_size >= compress_min_size)
+        {
+            payload_size = SocketCompressDeflate(p_ctx, p_iov, iov_idx, iov_offset, input_size);
+            flags = (payload_size >= 0 ? SERVER_SOCKET_COMPRESS_FLAG_DEFLATE : SERVER_SOCKET_COMPRESS_FLAG_RESET);
+        }
+
+        // Data is sent as is, after moving past it.
+        unsigned long remaining = input_size;
+        unsigned char* p_raw = p_ctx->p_tx_frame + SERVER_SOCKET_COMPRESS_HEADER_SIZE;
+
+        while(remaining > 0)
+        {
+            unsigned long chunk_size = p_iov[iov_idx].iov_len - iov_offset;
+
+            if(chunk_size > remaining)
+                chunk_size = remaining;
+
+            if(payload_size < 0)
+            {
+                memcpy(p_raw, (const char*)p_iov[iov_idx].iov_base + iov_offset, chunk_size);
+                p_raw += chunk_size;
+            }
+
+            remaining -= chunk_size;
+            iov_offset += chunk_size;
+
+            if(iov_offset == p_iov[iov_idx].iov_len)
+            {
+                iov_idx++;
+                iov_offset = 0;
+            }
+        }
+
+        if(payload_size < 0)
+            payload_size = input_size;
+
+        p_ctx->p_tx_frame[0] = flags;
+        p_ctx->p_tx_frame[1] = (unsigned char)(payload_size >> 24);
+        p_ctx->p_tx_frame[2] = (unsigned char)(payload_size >> 16);
+        p_ctx->p_tx_frame[3] = (unsigned char)(payload_size >> 8);
+        p_ctx->p_tx_frame[4] = (unsigned char)payload_size;
+
+        if(SocketCompressSend(client_socket, p_ctx->p_tx_frame, SERVER_SOCKET_COMPRESS_HEADER_SIZE + payload_size) < 0)
+            return SERVER_SOCKET_COMPRESS_ERR_WRITE;
+
+        SocketStatsCount(SERVER_SOCKET_CNT_PAYLOAD_BYTES_OUT, input_size);
+        total += input_size;
+    }
+
+    return (int)total;
+}
+
+/// @brief Tells whether data is ready to be delivered without reading from the socket.
+/// @return True if a complete frame has been received already, false otherwise.
+bool SocketCompressPending(void)
+{
+    return (socket_compress_active && SocketCompressFrameReady(p_thread_ctx));
+}
+
+/// @brief Releases the context of the connection served by the current thread. To be called once the connection is over.
+void SocketCompressRelease(void)
+{
+    SOCKET_COMPRESS_CTX* p_ctx = p_thread_ctx;
+
+    socket_compress_active = false;
+
+    if(!p_ctx)
+        return;
+
+    p_thread_ctx = NULL;
+
+    deflateReset(&p_ctx->deflater);
+    inflateReset(&p_ctx->inflater);
+    p_ctx->inflater.avail_in = 0;
+    p_ctx->rx_used = 0;
+    p_ctx->rx_fed = 0;
+    p_ctx->rx_started = false;
+    p_ctx->rx_trailer_fed = false;
+
+    pthread_mutex_lock(&free_ctxs_mtx);
+
+    if(free_ctxs_num < SOCKET_COMPRESS_MAX_CACHED_CTXS)
+    {
+        p_ctx->next_free = p_free_ctxs;
+        p_free_ctxs = p_ctx;
+        free_ctxs_num++;
+        p_ctx = NULL;
+    }
+
+    pthread_mutex_unlock(&free_ctxs_mtx);
+
+    if(p_ctx)
+        SocketCompressDestroyCtx(p_ctx);
+}
+
+/// @brief Frees every cached context.
+void SocketFreeCompressResources(void)
+{
+    pthread_mutex_lock(&free_ctxs_mtx);
+
+    while(p_free_ctxs)
+    {
+        SOCKET_COMPRESS_CTX* p_ctx = p_free_ctxs;
+        p_free_ctxs = p_ctx->next_free;
+        SocketCompressDestroyCtx(p_ctx);
+    }
+
+    free_ctxs_num = 0;
+
+    pthread_mutex_unlock(&free_ctxs_mtx);
+}
+
+/*************************************/
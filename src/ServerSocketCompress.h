@@ -0,0 +1,47 @@
+#ifndef SERVER_SOCKET_COMPRESS_H
+#define SERVER_SOCKET_COMPRESS_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+#include <sys/uio.h>
+
+/************************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Tells whether the connection served by the current thread is compressed.
+extern __thread bool socket_compress_active;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+int SocketCompressRead(int client_socket, char* rx_buffer, unsigned long rx_buffer_size);
+int SocketCompressWritev(int client_socket, const struct iovec* p_iov, int iov_num);
+bool SocketCompressPending(void);
+void SocketCompressRelease(void);
+void SocketFreeCompressResources(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Tells whether reads and writes on the current thread go through the compression layer. Cheap enough for every call.
+/// @return True if compression is enabled for the current connection, false otherwise.
+static inline bool SocketCompressActive(void)
+{
+    return socket_compress_active;
+}
+
+/*************************************/
+
+#endif
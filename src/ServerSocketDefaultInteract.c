@@ -4,7 +4,7 @@
 
 #include <netinet/in.h>     // INET_ADDRSTRLEN.
 #include <openssl/ssl.h>
-#include <unistd.h>
+#include "ServerSocketLog.h"
 #include "SeverityLog_api.h"
 #include "ServerSocket_api.h"
 
@@ -16,6 +16,7 @@
 
 #define SERVER_SOCKET_LEN_RX_BUFFER             256     // RX buffer size.
 #define SERVER_SOCKET_LEN_TX_BUFFER             256     // TX buffer size.
+#define SERVER_SOCKET_READ_IDLE_US              1000    // Data is considered complete once the client stays silent for this long.
 
 #define SERVER_SOCKET_MSG_DATA_READ_FROM_CLIENT "Data read from client: <%s>."
 #define SERVER_SOCKET_MSG_GREETING              "Hello client! Your IP address is: <%s>."
@@ -27,21 +28,22 @@
 /**** Private function prototypes ****/
 /*************************************/
 
-static void ServerSocketShowReadData(char* rx_buffer);
+static void ServerSocketShowReadData(char* rx_buffer, unsigned long read_size);
 
 /*************************************/
 
 /// @brief Displays read data.
 /// @param rx_buffer Reception buffer.
-static void ServerSocketShowReadData(char* rx_buffer)
+/// @param read_size Amount of bytes read into it, so its length does not need to be computed.
+static void ServerSocketShowReadData(char* rx_buffer, unsigned long read_size)
 {
-    if(strlen(rx_buffer) > 0 && rx_buffer[strlen(rx_buffer) - 1] == '\n')
-        rx_buffer[strlen(rx_buffer) - 1] = 0;
+    if(read_size > 0 && rx_buffer[read_size - 1] == '\n')
+        rx_buffer[--read_size] = 0;
 
-    if(strlen(rx_buffer) > 0 && rx_buffer[strlen(rx_buffer) - 1] == '\r')
-        rx_buffer[strlen(rx_buffer) - 1] = 0;
+    if(read_size > 0 && rx_buffer[read_size - 1] == '\r')
+        rx_buffer[--read_size] = 0;
 
-    if(strlen(rx_buffer) > 0)
+    if(read_size > 0)
     {
         SVRTY_LOG_INF(SERVER_SOCKET_MSG_DATA_READ_FROM_CLIENT, rx_buffer);
     }
@@ -59,42 +61,43 @@ int SocketDefaultInteractFn(int client_socket)
     char rx_buffer[SERVER_SOCKET_LEN_RX_BUFFER];
     memset(rx_buffer, 0, sizeof(rx_buffer));
 
-    ssize_t read_from_socket = -1;
+    int read_from_socket;
     bool something_read = false;
 
-    while( (read_from_socket >= 0) || (something_read == false) )
+    // Wait (with no CPU usage) for the client to send anything, then keep on reading until it stays silent.
+    // It is assumed that all the data that was meant to be read has already been read by then. Reads following a full
+    // buffer get the same idle time for their first byte, so late segments are not taken for a new request.
+    // The buffer keeps a trailing null character, so read data can be displayed as a string.
+    do
     {
-        read_from_socket = SERVER_SOCKET_READ(client_socket, rx_buffer);
+        long first_byte_timeout_us = (something_read ? SERVER_SOCKET_READ_IDLE_US : SERVER_SOCKET_WAIT_FOREVER);
 
-        // Check if the client is still connected, or if no data has been received.
+        read_from_socket = ServerSocketReadUntilIdle(   client_socket                                   ,
+                                                        rx_buffer                                       ,
+                                                        sizeof(rx_buffer) - 1                           ,
+                                                        SERVER_SOCKET_READ_IDLE_US                      ,
+                                                        first_byte_timeout_us                           );
+
+        // Check if the client is still connected.
         if(read_from_socket == 0)
         {
-            SVRTY_LOG_WNG(SERVER_SOCKET_MSG_CLIENT_DISCONNECTED, client_IP_addr);
+            SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_CLIENT_DISCONNECTED, client_IP_addr);
             break;
         }
 
-        // If no data has been found in the rx buffer but it has been found previously, then exit.
-        // It is assumed that all the data that was meant to be read has already been read.
         if(read_from_socket < 0)
-        {
-            if(something_read)
-                break;
-            
-            continue;
-        }
+            break;
 
-        // If any data has been received, then set the something_read flag and display it on console.
-        // Remove possible ending new line and carriage return characters first.
+        // Display read data. Remove possible ending new line and carriage return characters first.
         something_read = true;
         
-        ServerSocketShowReadData(rx_buffer);
+        ServerSocketShowReadData(rx_buffer, read_from_socket);
 
         // Clean the buffer after reading.
         memset(rx_buffer, 0, read_from_socket);
 
-        // Wait for a millisecond before trying to read again.
-        usleep(1000);
-    }
+    // A full buffer means there may be more data to be read.
+    } while(read_from_socket == sizeof(rx_buffer) - 1);
 
     // Send a message to the client as soon as it is accepted.
     char tx_buffer[SERVER_SOCKET_LEN_TX_BUFFER];
@@ -6,10 +6,25 @@
 #include <unistd.h>         // Write, sleep.
 #include <string.h>         // strlen
 #include <signal.h>         // Shutdown signal.
+#include <errno.h>          // Tell accept timeouts from actual errors.
 #include "ServerSocketUse.h"
 #include "ServerSocketManageThreads.h"
 #include "ServerSocketSSL.h"
 #include "ServerSocketDefaultInteract.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketMetrics.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketFraming.h"
+#include "ServerSocketBatch.h"
+#include "ServerSocketHandoff.h"
+#include "ServerSocketAffinity.h"
+#include "ServerSocketStacks.h"
+#include "ServerSocketCompress.h"
+#include "ServerSocketCache.h"
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketReaper.h"
+#include "ServerSocketPriority.h"
+#include "ServerSocketLog.h"
 #include "ServerSocket_api.h"
 #include "SeverityLog_api.h"
 #include "SignalHandler_api.h"
@@ -31,6 +46,12 @@
 #define SERVER_SOCKET_MSG_BIND_OK               "Socket file descriptor binded."
 #define SERVER_SOCKET_MSG_LISTEN_NOK            "Socket listen failed."
 #define SERVER_SOCKET_MSG_LISTEN_OK             "Socket listen succeeded."
+#define SERVER_SOCKET_MSG_METRICS_NOK           "Metrics listener could not be launched, going on without it."
+#define SERVER_SOCKET_MSG_TIMERS_NOK            "Timers could not be launched, going on without deadlines."
+#define SERVER_SOCKET_MSG_REAPER_NOK            "Reaper could not be launched, closing connections inline."
+#define SERVER_SOCKET_MSG_HANDOFF_NOK           "Could not listen for successors, hot restart will not be possible."
+#define SERVER_SOCKET_MSG_AFFINITY_NOK          "CPU affinity could not be set, going on without it."
+#define SERVER_SOCKET_MSG_DRAIN_NOK             "<%d> connections were still open after draining."
 #define SERVER_SOCKET_MSG_ACCEPT_NOK            "Accept failed."
 #define SERVER_SOCKET_MSG_ACCEPT_OK             "Accept succeeded."
 #define SERVER_SOCKET_MANAGE_THREADS_NOK        "Server instance creation failed."
@@ -50,14 +71,24 @@
 
 typedef enum
 {
-    CREATE_FD = 0       ,
+    INHERIT = 0         ,
+    CREATE_FD           ,
     SETUP_SSL           ,
     OPTIONS             ,
     BIND                ,
     LISTEN              ,
+    METRICS             ,
+    TIMERS              ,
+    CACHE               ,
+    BROADCAST           ,
+    REAPER              ,
+    HANDOFF             ,
+    AFFINITY            ,
     ACCEPT              ,
+    PRIORITY            ,
     MANAGE_THREADS      ,
     REFUSE              ,
+    DRAIN               ,
     CLOSE               ,
 
 } SOCKET_FSM;
@@ -94,9 +125,16 @@ static int SocketStateBind( int socket_desc             ,
                             sa_family_t address_family  ,
                             in_addr_t allowed_IPs       );
 static int SocketStateListen(int socket_desc, int max_conn_num);
-static int SocketStateAccept(int socket_desc, bool non_blocking);
-static int SocketStateManageThreads(int client_socket);
+static int SocketStateMetrics(bool reuse_address, bool reuse_port);
+static int SocketStateTimers(void);
+static int SocketStateReaper(void);
+static int SocketStateHandoff(int socket_desc);
+static int SocketStateAffinity(int socket_desc, bool reuse_port);
+static int SocketStateAccept(int socket_desc, bool non_blocking, unsigned long* p_accept_ns);
+static int SocketStatePriority(int client_socket);
+static int SocketStateManageThreads(int client_socket, int priority_class, unsigned long accept_ns);
 static int SocketStateRefuse(int client_socket);
+static int SocketStateDrain(int socket_desc);
 
 /*************************************/
 
@@ -115,8 +153,18 @@ static void SocketCleanup(void)
 
     SVRTY_LOG_DBG(SERVER_SOCKET_MSG_CLEANUP);
 
+    SocketFreeHandoffResources();
+    SocketFreeMetricsResources();
+    SocketFreeTimersResources();
     SocketFreeThreadsResources();
+    SocketFreeReaperResources();
+    SocketFreeStacksResources();
     SocketFreeSSLResources();
+    SocketFreeFramingResources();
+    SocketFreeCompressResources();
+    SocketFreeCacheResources();
+    SocketFreeBroadcastResources();
+    SocketFreeLogResources();
 
     exit(EXIT_SUCCESS);
 }
@@ -221,28 +269,113 @@ static int SocketStateListen(int socket_desc, int max_conn_num)
     return listen;
 }
 
+/// @brief Launch metrics listener.
+/// @param reuse_address Reuse address, does not hold the address after socket is closed.
+/// @param reuse_port Reuse port, does not hold the port after socket is closed.
+/// @return < 0 if metrics listener could not be launched.
+static int SocketStateMetrics(bool reuse_address, bool reuse_port)
+{
+    int launch_metrics = SocketLaunchMetrics(reuse_address, reuse_port);
+
+    if(launch_metrics < 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_METRICS_NOK);
+
+    return launch_metrics;
+}
+
+/// @brief Launch timers thread, so per-connection deadlines are enforced.
+/// @return < 0 if timers could not be launched.
+static int SocketStateTimers(void)
+{
+    int launch_timers = SocketLaunchTimers();
+
+    if(launch_timers < 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_TIMERS_NOK);
+
+    return launch_timers;
+}
+
+/// @brief Launch reaper thread, so connections are torn down off their serving threads.
+/// @return < 0 if the reaper could not be launched.
+static int SocketStateReaper(void)
+{
+    int launch_reaper = SocketLaunchReaper();
+
+    if(launch_reaper < 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_REAPER_NOK);
+
+    return launch_reaper;
+}
+
+/// @brief Start listening for successors (hot restart), telling the predecessor (if any) to start draining.
+/// @param socket_desc Listening socket.
+/// @return < 0 if successors could not be listened for.
+static int SocketStateHandoff(int socket_desc)
+{
+    int handoff_listen = SocketHandoffListen(socket_desc);
+
+    if(handoff_listen < 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_HANDOFF_NOK);
+
+    return handoff_listen;
+}
+
+/// @brief Pin accepting thread and prepare serving threads placement.
+/// @param socket_desc Listening socket.
+/// @param reuse_port Tells whether the port is shared by several listeners.
+/// @return < 0 if CPU affinity could not be set.
+static int SocketStateAffinity(int socket_desc, bool reuse_port)
+{
+    int affinity_setup = SocketAffinitySetup(socket_desc, reuse_port);
+
+    if(affinity_setup < 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_AFFINITY_NOK);
+
+    return affinity_setup;
+}
+
 /// @brief Accept an incoming connection.
 /// @param socket_desc Socket file descriptor.
 /// @param non_blocking Tells whether or not is the socket meant to be non-blocking.
+/// @param p_accept_ns Target variable to which the time the connection was accepted at is written.
 /// @return < 0 if it failed to accept the connection.
-static int SocketStateAccept(int socket_desc, bool non_blocking)
+static int SocketStateAccept(int socket_desc, bool non_blocking, unsigned long* p_accept_ns)
 {
     int client_socket = SocketAccept(socket_desc, non_blocking);
     
     if(client_socket >= 0)
-        SVRTY_LOG_INF(SERVER_SOCKET_MSG_ACCEPT_OK);
+    {
+        *p_accept_ns = SocketStatsNowNs();
+        SocketStatsCount(SERVER_SOCKET_CNT_ACCEPTS, 1);
+        SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_ACCEPT_OK);
+    }
+    else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        SocketStatsCount(SERVER_SOCKET_CNT_ACCEPT_ERRORS, 1);
     
     return client_socket;
 }
 
-static int SocketStateManageThreads(int client_socket)
+/// @brief Classify the accepted client and admit it into its priority class.
+/// @param client_socket Client socket descriptor.
+/// @return Class the client was admitted into, < 0 if its class is full.
+static int SocketStatePriority(int client_socket)
+{
+    return SocketPriorityAdmit(client_socket);
+}
+
+/// @brief Launch a server instance for the accepted client.
+/// @param client_socket Client socket descriptor.
+/// @param priority_class Class the client was admitted into, SOCKET_PRIORITY_NO_CLASS if there is none.
+/// @param accept_ns Time at which the connection was accepted.
+/// @return < 0 if no server instance could be launched.
+static int SocketStateManageThreads(int client_socket, int priority_class, unsigned long accept_ns)
 {
-    int new_server_instance = SocketLaunchServerInstance(client_socket);
+    int new_server_instance = SocketLaunchServerInstance(client_socket, priority_class, accept_ns);
     
     if(new_server_instance < 0)
-        SVRTY_LOG_ERR(SERVER_SOCKET_MANAGE_THREADS_NOK);
+        SOCKET_LOG_ERR_RL(SERVER_SOCKET_MANAGE_THREADS_NOK);
     else
-        SVRTY_LOG_INF(SERVER_SOCKET_MANAGE_THREADS_OK);
+        SOCKET_LOG_INF_RL(SERVER_SOCKET_MANAGE_THREADS_OK);
     
     return new_server_instance;
 }
@@ -252,6 +385,8 @@ static int SocketStateManageThreads(int client_socket)
 /// @return < 0 if any error happened while trying to close the socket.
 static int SocketStateRefuse(int client_socket)
 {
+    SocketStatsCount(SERVER_SOCKET_CNT_REFUSALS, 1);
+
     char refusal_msg[SERVER_SOCKET_LEN_MSG_REFUSE] = {};
     sprintf(refusal_msg, SERVER_SOCKET_MSG_REFUSE, SERVER_SOCKET_SECONDS_AFTER_REFUSAL);
 
@@ -266,6 +401,21 @@ static int SocketStateRefuse(int client_socket)
     return close_socket;
 }
 
+/// @brief Stop accepting connections (a successor accepts them from now on), then let active ones end.
+/// @param socket_desc Listening socket.
+/// @return Amount of connections which could not be drained.
+static int SocketStateDrain(int socket_desc)
+{
+    CloseSocket(socket_desc);
+
+    int drain = SocketDrainThreads(SocketHandoffDrainTimeoutMs());
+
+    if(drain > 0)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_DRAIN_NOK, drain);
+
+    return drain;
+}
+
 /// @brief Function to be called on library load.
 /// @param  
 static void __attribute__((constructor)) ServerSocketLoad(void)
@@ -293,7 +443,7 @@ static void __attribute__((destructor)) ServerSocketUnload(void)
 /// @param secure Enable secure communication (TLS).
 /// @param cert_path Path to server certificate.
 /// @param key_path Path to server private key.
-/// @param CustomSocketStateInteract Custom function to interact with client once connection is established.
+/// @param CustomSocketStateInteract Custom function to interact with client once connection is established (ignored if a batch handler is set).
 /// @return 0 always, exit sending failure signal if SIGINT signal handler could not be properly set.
 int ServerSocketRun(int server_port                                     ,
                     int max_conn_num                                    ,
@@ -310,12 +460,17 @@ int ServerSocketRun(int server_port                                     ,
                     const char* pkey_path                               ,
                     int (*CustomSocketStateInteract)(int client_socket) )
 {
-    SOCKET_FSM socket_fsm = CREATE_FD;
+    SOCKET_FSM socket_fsm = INHERIT;
     int socket_desc;
+    bool inherited = false;
     int client_socket;
+    int priority_class = SOCKET_PRIORITY_NO_CLASS;
+    unsigned long accept_ns = 0;
     int (*SocketStateInteract)(int client_socket)  = SocketDefaultInteractFn;
 
-    if(CustomSocketStateInteract != NULL)
+    if(SocketBatchEnabled())
+        SocketStateInteract = SocketBatchInteract;
+    else if(CustomSocketStateInteract != NULL)
         SocketStateInteract = CustomSocketStateInteract;
 
     int setup_threads = SocketSetupThreads(max_conn_num, secure, non_blocking, SocketStateInteract);
@@ -332,6 +487,17 @@ int ServerSocketRun(int server_port                                     ,
     {
         switch (socket_fsm)
         {
+            // Take the listening socket over from a running server if hot restart is enabled
+            case INHERIT:
+            {
+                socket_desc = SocketHandoffInherit();
+                inherited = (socket_desc >= 0);
+
+                // Inherited socket is already bound and listening, but options may have changed
+                socket_fsm = (inherited ? OPTIONS : CREATE_FD);
+            }
+            break;
+
             // Create socket file descriptor
             case CREATE_FD:
             {
@@ -360,14 +526,14 @@ int ServerSocketRun(int server_port                                     ,
             {
                 if(!secure)
                 {
-                    socket_fsm = BIND;
+                    socket_fsm = (inherited ? METRICS : BIND);
                     continue;
                 }
                 
                 if(SocketStateSetupSSL(cert_path, pkey_path) < 0)
                     socket_fsm = CLOSE;
                 else
-                    socket_fsm = BIND;
+                    socket_fsm = (inherited ? METRICS : BIND);
 
             }
             break;
@@ -387,17 +553,116 @@ int ServerSocketRun(int server_port                                     ,
                     max_conn_num = 1;
 
                 if(SocketStateListen(socket_desc, max_conn_num) >= 0)
-                    socket_fsm = ACCEPT;
+                    socket_fsm = METRICS;
+            }
+            break;
+
+            // Serve metrics on a separate port if required (the server keeps running even if it fails)
+            case METRICS:
+            {
+                if(SocketMetricsEnabled())
+                    SocketStateMetrics(reuse_address, reuse_port);
+
+                socket_fsm = TIMERS;
+            }
+            break;
+
+            // Enforce per-connection deadlines if required (the server keeps running even if it fails)
+            case TIMERS:
+            {
+                if(SocketTimersEnabled())
+                    SocketStateTimers();
+
+                socket_fsm = CACHE;
+            }
+            break;
+
+            // Allocate the response cache if required (the server keeps running without it if it fails)
+            case CACHE:
+            {
+                SocketSetupCache();
+
+                socket_fsm = BROADCAST;
+            }
+            break;
+
+            // Allocate the broadcast table if required (the server keeps running without broadcasts if it fails)
+            case BROADCAST:
+            {
+                SocketSetupBroadcast();
+
+                socket_fsm = REAPER;
+            }
+            break;
+
+            // Tear connections down on a dedicated thread if required (they are closed inline if it fails)
+            case REAPER:
+            {
+                if(SocketReaperEnabled())
+                    SocketStateReaper();
+
+                socket_fsm = HANDOFF;
+            }
+            break;
+
+            // Listen for successors if hot restart is enabled (the server keeps running even if it fails)
+            case HANDOFF:
+            {
+                if(SocketHandoffEnabled())
+                    SocketStateHandoff(socket_desc);
+
+                socket_fsm = AFFINITY;
+            }
+            break;
+
+            // Pin threads if required, once every helper thread has been launched (the server keeps running even if it fails)
+            case AFFINITY:
+            {
+                if(SocketAffinityEnabled())
+                    SocketStateAffinity(socket_desc, reuse_port);
+
+                socket_fsm = ACCEPT;
             }
             break;
 
             // Wait until an incoming connection shows up
             case ACCEPT:
             {
-                client_socket = SocketStateAccept(socket_desc, non_blocking);
+                // Successors are waited for along with clients, so the socket is only accepted from once it is ready
+                if(SocketHandoffEnabled())
+                {
+                    int handoff_poll = SocketHandoffPoll(socket_desc);
+
+                    if(handoff_poll == SOCKET_HANDOFF_DRAIN)
+                        socket_fsm = DRAIN;
+
+                    if(handoff_poll != SOCKET_HANDOFF_ACCEPT)
+                        break;
+                }
+
+                client_socket = SocketStateAccept(socket_desc, non_blocking, &accept_ns);
 
                 if(client_socket >= 0)
+                    socket_fsm = PRIORITY;
+            }
+            break;
+
+            // Classify the connection if priority classes are enabled, refusing it if its class is full
+            case PRIORITY:
+            {
+                if(!SocketPriorityEnabled())
+                {
+                    priority_class = SOCKET_PRIORITY_NO_CLASS;
+                    socket_fsm = MANAGE_THREADS;
+                    continue;
+                }
+
+                priority_class = SocketStatePriority(client_socket);
+
+                if(priority_class >= 0)
                     socket_fsm = MANAGE_THREADS;
+                else
+                    socket_fsm = REFUSE;
             }
             break;
 
@@ -405,12 +670,16 @@ int ServerSocketRun(int server_port                                     ,
             // Should manage threads instead of processes:
             case MANAGE_THREADS:
             {
-                int manage_threads = SocketStateManageThreads(client_socket);
+                int manage_threads = SocketStateManageThreads(client_socket, priority_class, accept_ns);
 
                 if(manage_threads >= 0)
                     socket_fsm = ACCEPT;
                 else
+                {
+                    // The connection never got to its class.
+                    SocketPriorityLeave(priority_class);
                     socket_fsm = REFUSE;
+                }
             }
             break;
 
@@ -423,6 +692,15 @@ int ServerSocketRun(int server_port                                     ,
             }
             break;
 
+            // A successor took over: stop accepting and let active connections end
+            case DRAIN:
+            {
+                SocketStateDrain(socket_desc);
+
+                socket_fsm = CLOSE;
+            }
+            break;
+
             case CLOSE:
             {
                 SocketCleanup();
@@ -0,0 +1,524 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // memfd_create.
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "ServerSocketFraming.h"
+#include "ServerSocketScan.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_FRAMING_ERR_RING          -1
+#define SERVER_SOCKET_FRAMING_ERR_TOO_LONG      -2
+#define SERVER_SOCKET_FRAMING_ERR_BAD_HEADER    -3
+#define SERVER_SOCKET_FRAMING_ERR_NULL_PTR      -4
+
+#define SOCKET_FRAMING_HEADER_INCOMPLETE        0
+#define SOCKET_FRAMING_VARINT_MAX_LEN           10  // 64-bit values.
+#define SOCKET_FRAMING_VARINT_PAYLOAD_MASK      0x7F
+#define SOCKET_FRAMING_VARINT_MORE_FLAG         0x80
+#define SOCKET_FRAMING_DEFAULT_RING_SIZE        65536
+#define SOCKET_FRAMING_MAX_CACHED_RINGS         64
+
+#define SOCKET_FRAMING_LINE_DELIMITER       '\n'
+#define SOCKET_FRAMING_LINE_CR              '\r'
+
+#define SOCKET_FRAMING_RING_NAME                "server_socket_ring"
+
+#define SERVER_SOCKET_MSG_FRAMING_RING_NOK      "Could not map message ring buffer: <%s>."
+#define SERVER_SOCKET_MSG_FRAMING_TOO_LONG      "Message of <%lu> bytes does not fit into <%lu> bytes ring buffer."
+#define SERVER_SOCKET_MSG_FRAMING_LINE_TOO_LONG "Line does not fit into <%lu> bytes ring buffer."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Per-connection ring buffer. Its memory is mapped twice back to back, so any message stored in it can be
+/// accessed as a contiguous block (no matter if it wraps around the end of the ring).
+typedef struct SOCKET_FRAMING_RING
+{
+    char*                       p_buffer;
+    unsigned long               size;       // Power of two, multiple of page size.
+    unsigned long               head;       // Total amount of bytes consumed so far.
+    unsigned long               tail;       // Total amount of bytes read so far.
+    unsigned long               delivered;  // Bytes taken by the latest delivered message (consumed on next call).
+    unsigned long               scanned;    // Total amount of bytes already searched for a line delimiter.
+    struct SOCKET_FRAMING_RING* next_free;
+} SOCKET_FRAMING_RING;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static SERVER_SOCKET_FRAME_HEADER   frame_header    = SERVER_SOCKET_FRAME_U32_BE;
+static unsigned long                ring_size       = SOCKET_FRAMING_DEFAULT_RING_SIZE;
+
+/// @brief Ring owned by the connection served by the current thread.
+static __thread SOCKET_FRAMING_RING* p_thread_ring = NULL;
+
+/// @brief Rings released by closed connections, kept so mapping them again can be spared.
+static SOCKET_FRAMING_RING* p_free_rings    = NULL;
+static int                  free_rings_num  = 0;
+static pthread_mutex_t      free_rings_mtx  = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static SOCKET_FRAMING_RING* SocketFramingMapRing(void);
+static void SocketFramingUnmapRing(SOCKET_FRAMING_RING* p_ring);
+static SOCKET_FRAMING_RING* SocketFramingGetRing(void);
+static int SocketFramingParseHeader(const unsigned char* p_data, const unsigned long available, unsigned long* p_message_size);
+static int SocketFramingNextMessage(SOCKET_FRAMING_RING* p_ring, SERVER_SOCKET_MESSAGE* p_message);
+static int SocketFramingNextLine(SOCKET_FRAMING_RING* p_ring, SERVER_SOCKET_MESSAGE* p_line);
+static int SocketFramingFill(int client_socket, SOCKET_FRAMING_RING* p_ring, long timeout_us);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Creates a ring buffer by mapping the same memory file twice, one mapping right after the other.
+/// @return Pointer to the ring, NULL if it could not be mapped.
+static SOCKET_FRAMING_RING* SocketFramingMapRing(void)
+{
+    SOCKET_FRAMING_RING* p_ring = calloc(1, sizeof(SOCKET_FRAMING_RING));
+
+    if(!p_ring)
+        return NULL;
+
+    p_ring->size = ring_size;
+    p_ring->p_buffer = MAP_FAILED;
+
+    int ring_fd = memfd_create(SOCKET_FRAMING_RING_NAME, MFD_CLOEXEC);
+
+    // Reserve the whole address range first, so both halves surely end up next to each other.
+    if(ring_fd >= 0 && ftruncate(ring_fd, p_ring->size) == 0)
+        p_ring->p_buffer = mmap(NULL, 2 * p_ring->size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if( p_ring->p_buffer != MAP_FAILED &&
+        (   mmap(p_ring->p_buffer               , p_ring->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, ring_fd, 0) == MAP_FAILED ||
+            mmap(p_ring->p_buffer + p_ring->size, p_ring->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, ring_fd, 0) == MAP_FAILED ))
+    {
+        munmap(p_ring->p_buffer, 2 * p_ring->size);
+        p_ring->p_buffer = MAP_FAILED;
+    }
+
+    if(p_ring->p_buffer == MAP_FAILED)
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_FRAMING_RING_NOK, strerror(errno));
+
+    // Mappings keep the memory alive on their own.
+    if(ring_fd >= 0)
+        close(ring_fd);
+
+    if(p_ring->p_buffer == MAP_FAILED)
+    {
+        free(p_ring);
+        return NULL;
+    }
+
+    return p_ring;
+}
+
+/// @brief Unmaps and frees a ring buffer.
+/// @param p_ring Target ring.
+static void SocketFramingUnmapRing(SOCKET_FRAMING_RING* p_ring)
+{
+    munmap(p_ring->p_buffer, 2 * p_ring->size);
+    free(p_ring);
+}
+
+/// @brief Retrieves the ring of the connection served by the current thread, taking one if it does not have any yet.
+/// @return Pointer to the ring, NULL if no ring could be mapped.
+static SOCKET_FRAMING_RING* SocketFramingGetRing(void)
+{
+    if(p_thread_ring)
+        return p_thread_ring;
+
+    pthread_mutex_lock(&free_rings_mtx);
+
+    // Rings mapped before the ring size was changed are not reused.
+    while(p_free_rings && !p_thread_ring)
+    {
+        SOCKET_FRAMING_RING* p_ring = p_free_rings;
+        p_free_rings = p_ring->next_free;
+        free_rings_num--;
+
+        if(p_ring->size == ring_size)
+            p_thread_ring = p_ring;
+        else
+            SocketFramingUnmapRing(p_ring);
+    }
+
+    pthread_mutex_unlock(&free_rings_mtx);
+
+    if(!p_thread_ring)
+        p_thread_ring = SocketFramingMapRing();
+
+    return p_thread_ring;
+}
+
+/// @brief Decodes a length prefix.
+/// @param p_data Received data, starting with the length prefix.
+/// @param available Amount of received bytes.
+/// @param p_message_size Target variable to which message size (length prefix excluded) is written.
+/// @return Length prefix size if it is complete, 0 if more data is needed, < 0 if it is malformed.
+static int SocketFramingParseHeader(const unsigned char* p_data, const unsigned long available, unsigned long* p_message_size)
+{
+    switch(frame_header)
+    {
+        case SERVER_SOCKET_FRAME_U16_BE:
+        case SERVER_SOCKET_FRAME_U16_LE:
+        {
+            if(available < 2)
+                return SOCKET_FRAMING_HEADER_INCOMPLETE;
+
+            *p_message_size = (frame_header == SERVER_SOCKET_FRAME_U16_BE ? (p_data[0] << 8) | p_data[1] : (p_data[1] << 8) | p_data[0]);
+
+            return 2;
+        }
+
+        case SERVER_SOCKET_FRAME_U32_BE:
+        case SERVER_SOCKET_FRAME_U32_LE:
+        {
+            if(available < 4)
+                return SOCKET_FRAMING_HEADER_INCOMPLETE;
+
+            if(frame_header == SERVER_SOCKET_FRAME_U32_BE)
+                *p_message_size = ((unsigned long)p_data[0] << 24) | ((unsigned long)p_data[1] << 16) | ((unsigned long)p_data[2] << 8) | p_data[3];
+            else
+                *p_message_size = ((unsigned long)p_data[3] << 24) | ((unsigned long)p_data[2] << 16) | ((unsigned long)p_data[1] << 8) | p_data[0];
+
+            return 4;
+        }
+
+        case SERVER_SOCKET_FRAME_VARINT:
+        {
+            unsigned long message_size = 0;
+
+            for(int byte_idx = 0; byte_idx < SOCKET_FRAMING_VARINT_MAX_LEN; byte_idx++)
+            {
+                if((unsigned long)byte_idx >= available)
+                    return SOCKET_FRAMING_HEADER_INCOMPLETE;
+
+                message_size |= (unsigned long)(p_data[byte_idx] & SOCKET_FRAMING_VARINT_PAYLOAD_MASK) << (7 * byte_idx);
+
+                if(!(p_data[byte_idx] & SOCKET_FRAMING_VARINT_MORE_FLAG))
+                {
+                    *p_message_size = message_size;
+                    return byte_idx + 1;
+                }
+            }
+
+            return SERVER_SOCKET_FRAMING_ERR_BAD_HEADER;
+        }
+
+        default:
+        break;
+    }
+
+    return SERVER_SOCKET_FRAMING_ERR_BAD_HEADER;
+}
+
+/// @brief Takes the next complete message already found in the ring, if any. Data is not overwritten until the ring
+/// is filled again, so views of previously delivered messages stay valid until then.
+/// @param p_ring Connection ring.
+/// @param p_message Target message view.
+/// @return 1 if a message was delivered, 0 if more data is needed, < 0 if a malformed or too long message was found.
+static int SocketFramingNextMessage(SOCKET_FRAMING_RING* p_ring, SERVER_SOCKET_MESSAGE* p_message)
+{
+    // The message delivered last time is not needed anymore.
+    p_ring->head += p_ring->delivered;
+    p_ring->delivered = 0;
+
+    unsigned long used = p_ring->tail - p_ring->head;
+    unsigned long message_size = 0;
+    const char* p_head = p_ring->p_buffer + (p_ring->head & (p_ring->size - 1));
+
+    int header_size = SocketFramingParseHeader((const unsigned char*)p_head, used, &message_size);
+
+    if(header_size < 0)
+        errno = EPROTO;
+
+    if(header_size <= 0)
+        return header_size;
+
+    if(message_size > p_ring->size - header_size)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_FRAMING_TOO_LONG, message_size, p_ring->size);
+        errno = EPROTO;
+        return SERVER_SOCKET_FRAMING_ERR_TOO_LONG;
+    }
+
+    if(header_size + message_size > used)
+        return 0;
+
+    p_message->data = p_head + header_size;
+    p_message->size = message_size;
+    p_ring->delivered = header_size + message_size;
+
+    return 1;
+}
+
+/// @brief Takes the next complete line already found in the ring, if any. Bytes searched by previous calls are not searched again,
+/// so lines coming in small pieces are scanned once in total. Data is not overwritten until the ring is filled again.
+/// @param p_ring Connection ring.
+/// @param p_line Target line view, delimiter (and carriage return before it, if any) excluded.
+/// @return 1 if a line was delivered, 0 if more data is needed, < 0 if the ring is full with no delimiter in it.
+static int SocketFramingNextLine(SOCKET_FRAMING_RING* p_ring, SERVER_SOCKET_MESSAGE* p_line)
+{
+    p_ring->head += p_ring->delivered;
+    p_ring->delivered = 0;
+
+    if(p_ring->scanned < p_ring->head)
+        p_ring->scanned = p_ring->head;
+
+    char* p_head = p_ring->p_buffer + (p_ring->head & (p_ring->size - 1));
+    const char* p_delimiter = SocketScanFind(p_head + (p_ring->scanned - p_ring->head), p_ring->tail - p_ring->scanned, SOCKET_FRAMING_LINE_DELIMITER);
+
+    if(!p_delimiter)
+    {
+        p_ring->scanned = p_ring->tail;
+
+        if(p_ring->tail - p_ring->head == p_ring->size)
+        {
+            SVRTY_LOG_ERR(SERVER_SOCKET_MSG_FRAMING_LINE_TOO_LONG, p_ring->size);
+            return SERVER_SOCKET_FRAMING_ERR_TOO_LONG;
+        }
+
+        return 0;
+    }
+
+    unsigned long line_size = p_delimiter - p_head;
+
+    p_ring->delivered = line_size + 1;
+
+    if(line_size > 0 && p_head[line_size - 1] == SOCKET_FRAMING_LINE_CR)
+        line_size--;
+
+    // Delimiters are consumed anyway, so lines can be null-terminated in place.
+    p_head[line_size] = 0;
+
+    p_line->data = p_head;
+    p_line->size = line_size;
+
+    return 1;
+}
+
+/// @brief Reads as much data as the ring can take. Thanks to the mirrored mapping, free space is contiguous,
+/// so a single read may fill all of it.
+/// @param client_socket Client socket.
+/// @param p_ring Connection ring, not full.
+/// @param timeout_us Maximum time to wait for data, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeout.
+/// @return Amount of bytes read, 0 if client got disconnected, < 0 if any error happened.
+static int SocketFramingFill(const int client_socket, SOCKET_FRAMING_RING* p_ring, const long timeout_us)
+{
+    char* p_tail = p_ring->p_buffer + (p_ring->tail & (p_ring->size - 1));
+    unsigned long free_space = p_ring->size - (p_ring->tail - p_ring->head);
+    int read_from_socket;
+
+    if(timeout_us < 0)
+        read_from_socket = ServerSocketRead(client_socket, p_tail, free_space);
+    else
+        read_from_socket = ServerSocketReadAtLeast(client_socket, p_tail, free_space, 1, timeout_us);
+
+    if(read_from_socket > 0)
+        p_ring->tail += read_from_socket;
+
+    return read_from_socket;
+}
+
+/// @brief Sets the message framing used by ServerSocketReadMessage. To be called before ServerSocketRun.
+/// @param header Length prefix format.
+/// @param ring_buffer_size Per-connection ring buffer size (rounded up to a power of two, at least a page).
+void ServerSocketSetFraming(const SERVER_SOCKET_FRAME_HEADER header, const unsigned long ring_buffer_size)
+{
+    unsigned long page_size = sysconf(_SC_PAGESIZE);
+    unsigned long size = page_size;
+
+    while(size < ring_buffer_size)
+        size <<= 1;
+
+    frame_header = header;
+    ring_size = size;
+}
+
+/// @brief Retrieves the next complete message sent by the client.
+/// Every message found in the ring is delivered before reading from the socket again, and each read fills
+/// as much of the ring as possible. Messages are not copied: the returned view points into the ring buffer.
+/// @param client_socket Client socket.
+/// @param p_message Target view. Valid until the next call (or until the connection is closed).
+/// @param timeout_us Maximum time to wait for data on each read, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeout.
+/// @return 1 if a message was delivered, 0 if client got disconnected, < 0 if any error happened
+/// (including incomplete messages on timeout, malformed length prefixes and messages not fitting into the ring).
+int ServerSocketReadMessage(int client_socket, SERVER_SOCKET_MESSAGE* p_message, long timeout_us)
+{
+    if(!p_message)
+        return SERVER_SOCKET_FRAMING_ERR_NULL_PTR;
+
+    SOCKET_FRAMING_RING* p_ring = SocketFramingGetRing();
+
+    if(!p_ring)
+        return SERVER_SOCKET_FRAMING_ERR_RING;
+
+    while(true)
+    {
+        int next_message = SocketFramingNextMessage(p_ring, p_message);
+
+        if(next_message != 0)
+            return next_message;
+
+        int fill_ring = SocketFramingFill(client_socket, p_ring, timeout_us);
+
+        if(fill_ring <= 0)
+            return fill_ring;
+    }
+}
+
+/// @brief Retrieves the next complete line sent by the client, on the same ring buffer as ServerSocketReadMessage
+/// (so both are not meant to be used on the same connection). Lines are not copied: the returned view points into the ring.
+/// @param client_socket Client socket.
+/// @param p_line Target view, with neither the line feed nor a carriage return before it, null-terminated.
+/// Valid until the next call (or until the connection is closed).
+/// @param timeout_us Maximum time to wait for data on each read, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeout.
+/// @return 1 if a line was delivered, 0 if client got disconnected (an unterminated last line is dropped),
+/// < 0 if any error happened (including incomplete lines on timeout and lines not fitting into the ring).
+int ServerSocketReadLine(int client_socket, SERVER_SOCKET_MESSAGE* p_line, long timeout_us)
+{
+    if(!p_line)
+        return SERVER_SOCKET_FRAMING_ERR_NULL_PTR;
+
+    SOCKET_FRAMING_RING* p_ring = SocketFramingGetRing();
+
+    if(!p_ring)
+        return SERVER_SOCKET_FRAMING_ERR_RING;
+
+    while(true)
+    {
+        int next_line = SocketFramingNextLine(p_ring, p_line);
+
+        if(next_line != 0)
+            return next_line;
+
+        int fill_ring = SocketFramingFill(client_socket, p_ring, timeout_us);
+
+        if(fill_ring <= 0)
+            return fill_ring;
+    }
+}
+
+/// @brief Retrieves every complete message available after (at most) one read from the client.
+/// Every view stays valid until the next call.
+/// @param client_socket Client socket.
+/// @param p_messages Target message views.
+/// @param max_messages Maximum amount of messages to be retrieved.
+/// @param timeout_us Maximum time to wait for data on each read, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeouts.
+/// @return Amount of messages retrieved, 0 if client got disconnected, SOCKET_FRAMING_ERR_PROTOCOL if a malformed or too long
+/// message was found (which would be found again on every call), < 0 if any other error happened.
+int SocketFramingReadBatch(const int client_socket, SERVER_SOCKET_MESSAGE* p_messages, const int max_messages, const long timeout_us)
+{
+    SOCKET_FRAMING_RING* p_ring = SocketFramingGetRing();
+
+    if(!p_ring)
+        return SERVER_SOCKET_FRAMING_ERR_RING;
+
+    int next_message;
+
+    while((next_message = SocketFramingNextMessage(p_ring, &p_messages[0])) == 0)
+    {
+        int fill_ring = SocketFramingFill(client_socket, p_ring, timeout_us);
+
+        if(fill_ring <= 0)
+            return fill_ring;
+    }
+
+    if(next_message < 0)
+        return SOCKET_FRAMING_ERR_PROTOCOL;
+
+    int messages_num = 1;
+
+    // Malformed messages are left for the next call to report.
+    while(messages_num < max_messages && SocketFramingNextMessage(p_ring, &p_messages[messages_num]) > 0)
+        messages_num++;
+
+    return messages_num;
+}
+
+/// @brief Tells whether the ring of the connection served by the current thread holds data not delivered yet, so the next
+/// message (or line) may not have to be waited for on the socket.
+/// @return True if undelivered data is buffered, false otherwise.
+bool SocketFramingPending(void)
+{
+    SOCKET_FRAMING_RING* p_ring = p_thread_ring;
+
+    return (p_ring && p_ring->tail - p_ring->head > p_ring->delivered);
+}
+
+/// @brief Releases the ring of the connection served by the current thread. To be called once the connection is over.
+void SocketFramingRelease(void)
+{
+    SOCKET_FRAMING_RING* p_ring = p_thread_ring;
+
+    if(!p_ring)
+        return;
+
+    p_thread_ring = NULL;
+
+    p_ring->head = 0;
+    p_ring->tail = 0;
+    p_ring->delivered = 0;
+    p_ring->scanned = 0;
+
+    pthread_mutex_lock(&free_rings_mtx);
+
+    if(free_rings_num < SOCKET_FRAMING_MAX_CACHED_RINGS)
+    {
+        p_ring->next_free = p_free_rings;
+        p_free_rings = p_ring;
+        free_rings_num++;
+        p_ring = NULL;
+    }
+
+    pthread_mutex_unlock(&free_rings_mtx);
+
+    if(p_ring)
+        SocketFramingUnmapRing(p_ring);
+}
+
+/// @brief Unmaps every cached ring.
+void SocketFreeFramingResources(void)
+{
+    pthread_mutex_lock(&free_rings_mtx);
+
+    while(p_free_rings)
+    {
+        SOCKET_FRAMING_RING* p_ring = p_free_rings;
+        p_free_rings = p_ring->next_free;
+        SocketFramingUnmapRing(p_ring);
+    }
+
+    free_rings_num = 0;
+
+    pthread_mutex_unlock(&free_rings_mtx);
+}
+
+/*************************************/
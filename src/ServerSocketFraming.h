@@ -0,0 +1,33 @@
+#ifndef SERVER_SOCKET_FRAMING_H
+#define SERVER_SOCKET_FRAMING_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include "ServerSocket_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+// Malformed or too long message found by SocketFramingReadBatch. Read functions never return it, so it cannot be mistaken
+// for a read timeout (errno is set to EPROTO as well).
+#define SOCKET_FRAMING_ERR_PROTOCOL     -1000
+
+/************************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+int SocketFramingReadBatch(int client_socket, SERVER_SOCKET_MESSAGE* p_messages, int max_messages, long timeout_us);
+bool SocketFramingPending(void);
+void SocketFramingRelease(void);
+void SocketFreeFramingResources(void);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,358 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // accept4, SO_PEERCRED, MSG_CMSG_CLOEXEC.
+#include <errno.h>
+#include <poll.h>               // Wait for clients and successors at once.
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "ServerSocketHandoff.h"
+#include "ServerSocketUse.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_HANDOFF_SUCCESS               0
+#define SERVER_SOCKET_HANDOFF_ERR_DISABLED          -1
+#define SERVER_SOCKET_HANDOFF_ERR_SOCKET            -2
+#define SERVER_SOCKET_HANDOFF_ERR_CONNECT           -3
+#define SERVER_SOCKET_HANDOFF_ERR_RECEIVE           -4
+#define SERVER_SOCKET_HANDOFF_ERR_BIND              -5
+#define SERVER_SOCKET_HANDOFF_ERR_POLL              -6
+
+#define SERVER_SOCKET_HANDOFF_BACKLOG               4
+#define SERVER_SOCKET_HANDOFF_RECEIVE_TIMEOUT_S     5
+#define SERVER_SOCKET_HANDOFF_MSG_FD                'F'     // Listening socket attached.
+#define SERVER_SOCKET_HANDOFF_MSG_READY             'R'     // Successor is accepting connections.
+
+#define SERVER_SOCKET_MSG_HANDOFF_COLD_START        "No running server found at <%s>, starting from scratch."
+#define SERVER_SOCKET_MSG_HANDOFF_INHERITED         "Listening socket inherited from running server at <%s>."
+#define SERVER_SOCKET_MSG_HANDOFF_RECEIVE_NOK       "Running server at <%s> did not hand its listening socket over."
+#define SERVER_SOCKET_MSG_HANDOFF_BIND_NOK          "Could not listen for successors at <%s>: <%s>."
+#define SERVER_SOCKET_MSG_HANDOFF_LISTEN_OK         "Listening for successors at <%s>."
+#define SERVER_SOCKET_MSG_HANDOFF_PEER_NOK          "Refusing handoff to a process owned by another user (UID: <%d>)."
+#define SERVER_SOCKET_MSG_HANDOFF_CRED_NOK          "Refusing handoff, successor credentials unknown: <%s>."
+#define SERVER_SOCKET_MSG_HANDOFF_SENT              "Listening socket handed over, waiting for successor to be ready."
+#define SERVER_SOCKET_MSG_HANDOFF_ABORTED           "Successor went away before accepting connections, going on accepting."
+#define SERVER_SOCKET_MSG_HANDOFF_READY             "Successor is accepting connections, draining."
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+/// @brief Path of the UNIX socket successors connect to, empty if hot restart is disabled.
+static char handoff_path[sizeof(((struct sockaddr_un*)0)->sun_path)] = {0};
+static unsigned long handoff_drain_timeout_ms = 0;
+
+/// @brief UNIX socket successors connect to.
+static int handoff_listener = -1;
+/// @brief Connection to the predecessor (until ready is reported) or to the successor (until it reports ready).
+static int handoff_peer = -1;
+/// @brief Set once the listening socket belongs to a successor, so its UNIX socket path is not removed on cleanup.
+static bool handoff_done = false;
+static bool handoff_draining = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static struct sockaddr_un SocketHandoffAddress(void);
+static void SocketHandoffAcceptSuccessor(int socket_desc);
+static int SocketHandoffCheckSuccessor(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Builds handoff UNIX socket address.
+/// @return Handoff UNIX socket address.
+static struct sockaddr_un SocketHandoffAddress(void)
+{
+    struct sockaddr_un handoff_address = { .sun_family = AF_UNIX };
+
+    memcpy(handoff_address.sun_path, handoff_path, sizeof(handoff_address.sun_path));
+
+    return handoff_address;
+}
+
+/// @brief Accepts a successor and hands the listening socket over. Successors owned by other users are refused,
+/// and so are further successors while one is already starting.
+/// @param socket_desc Listening socket.
+static void SocketHandoffAcceptSuccessor(const int socket_desc)
+{
+    int successor = accept4(handoff_listener, NULL, NULL, SOCK_CLOEXEC);
+
+    if(successor < 0)
+        return;
+
+    struct ucred successor_cred = {0};
+    socklen_t successor_cred_len = sizeof(successor_cred);
+
+    if(getsockopt(successor, SOL_SOCKET, SO_PEERCRED, &successor_cred, &successor_cred_len) < 0)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_HANDOFF_CRED_NOK, strerror(errno));
+        CloseSocket(successor);
+        return;
+    }
+
+    if(successor_cred.uid != getuid())
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_HANDOFF_PEER_NOK, (int)successor_cred.uid);
+        CloseSocket(successor);
+        return;
+    }
+
+    if(handoff_peer >= 0)
+    {
+        CloseSocket(successor);
+        return;
+    }
+
+    handoff_peer = successor;
+
+    if(SocketSendDescriptor(handoff_peer, SERVER_SOCKET_HANDOFF_MSG_FD, socket_desc) < 0)
+    {
+        CloseSocket(handoff_peer);
+        handoff_peer = -1;
+        return;
+    }
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_HANDOFF_SENT);
+}
+
+/// @brief Checks whether the successor reported being ready or went away.
+/// @return SOCKET_HANDOFF_DRAIN if the successor is ready, SOCKET_HANDOFF_IDLE otherwise.
+static int SocketHandoffCheckSuccessor(void)
+{
+    char msg = 0;
+
+    ssize_t read_from_successor = read(handoff_peer, &msg, sizeof(msg));
+
+    if(read_from_successor < 0 && errno == EINTR)
+        return SOCKET_HANDOFF_IDLE;
+
+    // Successor may have died (bad certificate, crash...) before accepting anything, so keep on serving.
+    if(read_from_successor != sizeof(msg) || msg != SERVER_SOCKET_HANDOFF_MSG_READY)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_HANDOFF_ABORTED);
+        CloseSocket(handoff_peer);
+        handoff_peer = -1;
+        return SOCKET_HANDOFF_IDLE;
+    }
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_HANDOFF_READY);
+
+    CloseSocket(handoff_peer);
+    handoff_peer = -1;
+    handoff_done = true;
+    __atomic_store_n(&handoff_draining, true, __ATOMIC_RELAXED);
+
+    return SOCKET_HANDOFF_DRAIN;
+}
+
+/// @brief Enables hot restart. To be called before ServerSocketRun.
+/// @param path UNIX socket path used to hand the listening socket over, NULL to disable hot restart (default).
+/// @param drain_timeout_ms Maximum time for connections to end on their own once a successor took over.
+void ServerSocketSetHotRestart(const char* path, const unsigned long drain_timeout_ms)
+{
+    memset(handoff_path, 0, sizeof(handoff_path));
+
+    if(path)
+        strncpy(handoff_path, path, sizeof(handoff_path) - 1);
+
+    handoff_drain_timeout_ms = drain_timeout_ms;
+}
+
+/// @brief Tells whether the server is draining (a successor took over and no more connections are being accepted).
+/// @return True if draining, false otherwise.
+bool ServerSocketIsDraining(void)
+{
+    return __atomic_load_n(&handoff_draining, __ATOMIC_RELAXED);
+}
+
+/// @brief Tells whether hot restart is enabled or not.
+/// @return True if hot restart is enabled, false otherwise.
+bool SocketHandoffEnabled(void)
+{
+    return (handoff_path[0] != 0);
+}
+
+/// @brief Tries to take the listening socket over from a running server.
+/// @return Inherited listening socket, < 0 if there was no running server or it did not hand its socket over.
+int SocketHandoffInherit(void)
+{
+    if(!SocketHandoffEnabled())
+        return SERVER_SOCKET_HANDOFF_ERR_DISABLED;
+
+    struct sockaddr_un handoff_address = SocketHandoffAddress();
+
+    handoff_peer = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if(handoff_peer < 0)
+        return SERVER_SOCKET_HANDOFF_ERR_SOCKET;
+
+    if(connect(handoff_peer, (struct sockaddr*)&handoff_address, sizeof(handoff_address)) < 0)
+    {
+        SVRTY_LOG_INF(SERVER_SOCKET_MSG_HANDOFF_COLD_START, handoff_path);
+        CloseSocket(handoff_peer);
+        handoff_peer = -1;
+        return SERVER_SOCKET_HANDOFF_ERR_CONNECT;
+    }
+
+    // Do not hang forever if the running server is stuck.
+    struct timeval receive_timeout = { .tv_sec = SERVER_SOCKET_HANDOFF_RECEIVE_TIMEOUT_S };
+    setsockopt(handoff_peer, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+
+    char msg = 0;
+    struct iovec msg_iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+
+    union
+    {
+        char            buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr  align;
+    } control = {0};
+
+    struct msghdr handoff_msg =
+    {
+        .msg_iov        = &msg_iov                  ,
+        .msg_iovlen     = 1                         ,
+        .msg_control    = control.buffer            ,
+        .msg_controllen = sizeof(control.buffer)    ,
+    };
+
+    ssize_t receive = recvmsg(handoff_peer, &handoff_msg, MSG_CMSG_CLOEXEC);
+    struct cmsghdr* p_cmsg = CMSG_FIRSTHDR(&handoff_msg);
+    int socket_desc = -1;
+
+    if(receive == sizeof(msg) && msg == SERVER_SOCKET_HANDOFF_MSG_FD && p_cmsg &&
+       p_cmsg->cmsg_level == SOL_SOCKET && p_cmsg->cmsg_type == SCM_RIGHTS && p_cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+        memcpy(&socket_desc, CMSG_DATA(p_cmsg), sizeof(int));
+
+    if(socket_desc < 0)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_HANDOFF_RECEIVE_NOK, handoff_path);
+        CloseSocket(handoff_peer);
+        handoff_peer = -1;
+        return SERVER_SOCKET_HANDOFF_ERR_RECEIVE;
+    }
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_HANDOFF_INHERITED, handoff_path);
+
+    return socket_desc;
+}
+
+/// @brief Starts listening for successors, then tells the predecessor (if any) it can stop accepting connections.
+/// The listening socket is made non-blocking, as it is shared with successors and predecessors.
+/// @param socket_desc Listening socket.
+/// @return 0 if succeeded, < 0 otherwise (hot restart will not be possible, but the server keeps running).
+int SocketHandoffListen(const int socket_desc)
+{
+    if(!SocketHandoffEnabled())
+        return SERVER_SOCKET_HANDOFF_ERR_DISABLED;
+
+    SocketSetNonBlocking(socket_desc);
+
+    struct sockaddr_un handoff_address = SocketHandoffAddress();
+    int handoff_listen = SERVER_SOCKET_HANDOFF_SUCCESS;
+
+    // Predecessor's path (if any) is taken over, predecessor keeps its already accepted successor connection.
+    unlink(handoff_path);
+
+    handoff_listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(handoff_listener < 0                                                                                 ||
+       bind(handoff_listener, (struct sockaddr*)&handoff_address, sizeof(handoff_address)) < 0             ||
+       listen(handoff_listener, SERVER_SOCKET_HANDOFF_BACKLOG) < 0                                         )
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_HANDOFF_BIND_NOK, handoff_path, strerror(errno));
+
+        if(handoff_listener >= 0)
+            CloseSocket(handoff_listener);
+
+        handoff_listener = -1;
+        handoff_listen = SERVER_SOCKET_HANDOFF_ERR_BIND;
+    }
+    else
+        SVRTY_LOG_INF(SERVER_SOCKET_MSG_HANDOFF_LISTEN_OK, handoff_path);
+
+    if(handoff_peer >= 0)
+    {
+        char msg = SERVER_SOCKET_HANDOFF_MSG_READY;
+        write(handoff_peer, &msg, sizeof(msg));
+        CloseSocket(handoff_peer);
+        handoff_peer = -1;
+    }
+
+    return handoff_listen;
+}
+
+/// @brief Waits for either a client to be accepted, a successor to connect or a successor to be ready.
+/// Successor events are handled right away.
+/// @param socket_desc Listening socket.
+/// @return SOCKET_HANDOFF_ACCEPT if a client can be accepted, SOCKET_HANDOFF_DRAIN if the successor took over,
+/// SOCKET_HANDOFF_IDLE if there is nothing to do yet, < 0 if any error happened.
+int SocketHandoffPoll(const int socket_desc)
+{
+    struct pollfd handoff_poll_fds[] =
+    {
+        { .fd = socket_desc,        .events = POLLIN },
+        { .fd = handoff_listener,   .events = POLLIN },
+        { .fd = handoff_peer,       .events = POLLIN },
+    };
+
+    if(poll(handoff_poll_fds, sizeof(handoff_poll_fds) / sizeof(handoff_poll_fds[0]), -1) < 0)
+        return (errno == EINTR ? SOCKET_HANDOFF_IDLE : SERVER_SOCKET_HANDOFF_ERR_POLL);
+
+    if(handoff_poll_fds[2].revents && SocketHandoffCheckSuccessor() == SOCKET_HANDOFF_DRAIN)
+        return SOCKET_HANDOFF_DRAIN;
+
+    if(handoff_poll_fds[1].revents)
+        SocketHandoffAcceptSuccessor(socket_desc);
+
+    if(handoff_poll_fds[0].revents)
+        return SOCKET_HANDOFF_ACCEPT;
+
+    return SOCKET_HANDOFF_IDLE;
+}
+
+/// @brief Retrieves the maximum time for connections to end on their own while draining.
+/// @return Drain timeout in milliseconds.
+unsigned long SocketHandoffDrainTimeoutMs(void)
+{
+    return handoff_drain_timeout_ms;
+}
+
+/// @brief Frees resources priorly allocated by handoff submodule. UNIX socket path is removed unless a successor owns it.
+void SocketFreeHandoffResources(void)
+{
+    if(handoff_peer >= 0)
+        CloseSocket(handoff_peer);
+
+    if(handoff_listener >= 0)
+    {
+        CloseSocket(handoff_listener);
+
+        if(!handoff_done)
+            unlink(handoff_path);
+    }
+
+    handoff_peer = -1;
+    handoff_listener = -1;
+}
+
+/*************************************/
@@ -0,0 +1,35 @@
+#ifndef SERVER_SOCKET_HANDOFF_H
+#define SERVER_SOCKET_HANDOFF_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/***********************************/
+/******** Define statements ********/
+/***********************************/
+
+#define SOCKET_HANDOFF_IDLE     0   // Nothing to be accepted yet.
+#define SOCKET_HANDOFF_ACCEPT   1   // Listening socket is ready to accept a connection.
+#define SOCKET_HANDOFF_DRAIN    2   // Successor is accepting connections, time to drain.
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketHandoffEnabled(void);
+int SocketHandoffInherit(void);
+int SocketHandoffListen(int socket_desc);
+int SocketHandoffPoll(int socket_desc);
+unsigned long SocketHandoffDrainTimeoutMs(void);
+void SocketFreeHandoffResources(void);
+
+/*************************************/
+
+#endif
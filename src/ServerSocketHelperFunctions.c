@@ -2,10 +2,28 @@
 /******** Include statements ********/
 /************************************/
 
+#define _GNU_SOURCE         // ppoll.
 #include <arpa/inet.h>      // sockaddr_in, inet_addr
 #include <stdlib.h>         // EXIT_FAILURE
 #include <unistd.h>
+#include <errno.h>          // Tell timeouts from actual errors.
+#include <fcntl.h>          // Tell non-blocking sockets apart.
+#include <poll.h>           // Wait for readiness instead of sleeping.
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>     // recv (MSG_PEEK).
+#include "ServerSocketHelperFunctions.h"
 #include "ServerSocketSSL.h"
+#include "ServerSocketManageThreads.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocketBusyPoll.h"
+#include "ServerSocketScan.h"
+#include "ServerSocketCompress.h"
+#include "ServerSocketShm.h"
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketLowat.h"
 #include "SeverityLog_api.h"
 #include "ServerSocket_api.h"
 
@@ -24,9 +42,45 @@
 
 #define SERVER_SOCKET_HELPER_ERR_INSUFFICIENT_RX_BUFFER_SIZE    -1
 #define SERVER_SOCKET_HELPER_ERR_INSUFFICIENT_TX_BUFFER_SIZE    -2
+#define SERVER_SOCKET_HELPER_ERR_READ_TIMEOUT                   -3
+#define SERVER_SOCKET_HELPER_ERR_WAIT                           -4
+#define SERVER_SOCKET_HELPER_SUCCESS                            0
+
+#define SERVER_SOCKET_HELPER_US_PER_SEC                         1000000L
+#define SERVER_SOCKET_HELPER_NS_PER_US                          1000L
 
 /***********************************/
 
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static void ServerSocketAccountIO(const int io_result, const SERVER_SOCKET_CNT bytes_cnt, const SERVER_SOCKET_HIST bytes_hist);
+static long ServerSocketNowUs(void);
+static long ServerSocketRemainingUs(const long deadline_us);
+static long ServerSocketOptTimeoutUs(const int client_socket, const int optname);
+static int ServerSocketPeek(const int client_socket, char* rx_buffer, const unsigned long rx_buffer_size);
+static bool ServerSocketRetryRead(void);
+
+/*************************************/
+
+/// @brief Updates I/O statistics (and pushes idle deadline forward) after a read/write operation.
+/// @param io_result Value returned by the read/write operation.
+/// @param bytes_cnt Counter to add transferred bytes to.
+/// @param bytes_hist Histogram to record transferred bytes into.
+static void ServerSocketAccountIO(const int io_result, const SERVER_SOCKET_CNT bytes_cnt, const SERVER_SOCKET_HIST bytes_hist)
+{
+    if(io_result > 0)
+    {
+        SocketStatsCount(bytes_cnt, io_result);
+        SocketStatsRecord(bytes_hist, io_result);
+        SocketTimerTouch();
+        SocketBufTuneTransferred(io_result);
+    }
+    else if(io_result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+}
+
 /// @brief Get client's IP address.
 /// @param client_socket Client socket.
 /// @param client_IPv4 Target string to which client IPv4 address is meant to be copied.
@@ -54,10 +108,39 @@ int ServerSocketRead(int client_socket, char* rx_buffer, unsigned long rx_buffer
         exit(EXIT_FAILURE);
     }
 
+    // Shared-memory connections wait on their ring, the socket is only there to tell whether the client is gone.
+    if(SocketShmActive())
+        return SocketShmRead(client_socket, rx_buffer, rx_buffer_size);
+
+    // Low-latency connections spin until data shows up, so the read below does not have to sleep and be woken up.
+    if(SocketBusyPollActive() && !SocketCompressPending())
+        SocketBusyPollSpin(client_socket, SERVER_SOCKET_WAIT_FOREVER);
+
+    // Connections getting broadcasts write them while waiting for data, blocking reads could not be woken up for that.
+    if(SocketBroadcastAttached() && !SocketCompressPending() && !(ServerSocketIsSecure() && ServerSocketSSLPending()))
+    {
+        int wait_readable = SocketBroadcastWaitReadable(client_socket, SocketBroadcastRxTimeoutUs());
+
+        if(wait_readable <= 0)
+        {
+            if(wait_readable == 0)
+                errno = EAGAIN;
+
+            ServerSocketAccountIO(SERVER_SOCKET_HELPER_ERR_WAIT, SERVER_SOCKET_CNT_BYTES_IN, SERVER_SOCKET_HIST_READ_BYTES);
+            return SERVER_SOCKET_HELPER_ERR_WAIT;
+        }
+    }
+
+    // Compressed connections account for their own I/O, as bytes on the wire are not the ones handed over.
+    if(SocketCompressActive())
+        return SocketCompressRead(client_socket, rx_buffer, rx_buffer_size);
+
     if(!ServerSocketIsSecure())
         read_from_socket = read(client_socket, rx_buffer, rx_buffer_size);
     else
         read_from_socket = ServerSocketSSLRead(rx_buffer, rx_buffer_size);
+
+    ServerSocketAccountIO(read_from_socket, SERVER_SOCKET_CNT_BYTES_IN, SERVER_SOCKET_HIST_READ_BYTES);
     
     return read_from_socket;
 }
@@ -78,10 +161,420 @@ int ServerSocketWrite(int client_socket, const char* tx_buffer, unsigned long tx
         exit(EXIT_FAILURE);
     }
 
+    if(SocketShmActive() || SocketCompressActive())
+    {
+        struct iovec tx_iov = {.iov_base = (void*)tx_buffer, .iov_len = tx_buffer_size};
+        return (SocketShmActive() ? SocketShmWritev(client_socket, &tx_iov, 1) : SocketCompressWritev(client_socket, &tx_iov, 1));
+    }
+
+    // Connections with a low-water mark account for their own I/O, as they write in several steps.
+    if(SocketLowatActive())
+        return SocketLowatWrite(client_socket, tx_buffer, tx_buffer_size, ServerSocketIsSecure());
+
     if(!ServerSocketIsSecure())
         write_to_socket = write(client_socket, tx_buffer, tx_buffer_size);
     else
         write_to_socket = ServerSocketSSLWrite(tx_buffer, tx_buffer_size);
+
+    ServerSocketAccountIO(write_to_socket, SERVER_SOCKET_CNT_BYTES_OUT, SERVER_SOCKET_HIST_WRITE_BYTES);
     
     return write_to_socket;
 }
+
+/// @brief Reads from a plain connection's socket, with no transport checks.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes read if read > 0, < 0 if no data could be read, 0 if client got disconnected.
+int ServerSocketReadPlain(int client_socket, char* rx_buffer, unsigned long rx_buffer_size)
+{
+    int read_from_socket = read(client_socket, rx_buffer, rx_buffer_size);
+
+    ServerSocketAccountIO(read_from_socket, SERVER_SOCKET_CNT_BYTES_IN, SERVER_SOCKET_HIST_READ_BYTES);
+
+    return read_from_socket;
+}
+
+/// @brief Writes to a plain connection's socket, with no transport checks.
+/// @param client_socket Client socket.
+/// @param tx_buffer TX buffer.
+/// @param tx_buffer_size TX buffer size.
+/// @return < 0 if any error happens, number of bytes sent otherwise.
+int ServerSocketWritePlain(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size)
+{
+    int write_to_socket = send(client_socket, tx_buffer, tx_buffer_size, MSG_NOSIGNAL);
+
+    ServerSocketAccountIO(write_to_socket, SERVER_SOCKET_CNT_BYTES_OUT, SERVER_SOCKET_HIST_WRITE_BYTES);
+
+    return write_to_socket;
+}
+
+/// @brief Reads from a TLS connection's SSL object, with no transport checks.
+/// @param client_socket Client socket (unused, the SSL object belongs to the serving thread).
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes read if read > 0, < 0 if no data could be read, 0 if client got disconnected.
+int ServerSocketReadTLS(int client_socket, char* rx_buffer, unsigned long rx_buffer_size)
+{
+    (void)client_socket;
+
+    int read_from_socket = SSL_read(*SocketGetCurrentThreadSSLObj(), rx_buffer, rx_buffer_size);
+
+    ServerSocketAccountIO(read_from_socket, SERVER_SOCKET_CNT_BYTES_IN, SERVER_SOCKET_HIST_READ_BYTES);
+
+    return read_from_socket;
+}
+
+/// @brief Writes to a TLS connection's SSL object, with no transport checks.
+/// @param client_socket Client socket (unused, the SSL object belongs to the serving thread).
+/// @param tx_buffer TX buffer.
+/// @param tx_buffer_size TX buffer size.
+/// @return < 0 if any error happens, number of bytes sent otherwise.
+int ServerSocketWriteTLS(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size)
+{
+    (void)client_socket;
+
+    int write_to_socket = SSL_write(*SocketGetCurrentThreadSSLObj(), tx_buffer, tx_buffer_size);
+
+    ServerSocketAccountIO(write_to_socket, SERVER_SOCKET_CNT_BYTES_OUT, SERVER_SOCKET_HIST_WRITE_BYTES);
+
+    return write_to_socket;
+}
+
+/// @brief Current monotonic time.
+/// @return Microseconds.
+static long ServerSocketNowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * SERVER_SOCKET_HELPER_US_PER_SEC + now.tv_nsec / SERVER_SOCKET_HELPER_NS_PER_US;
+}
+
+/// @brief Computes the time left until a deadline.
+/// @param deadline_us Deadline, SERVER_SOCKET_WAIT_FOREVER if there is none.
+/// @return Microseconds left (0 if already expired), SERVER_SOCKET_WAIT_FOREVER if there is no deadline.
+static long ServerSocketRemainingUs(const long deadline_us)
+{
+    if(deadline_us == SERVER_SOCKET_WAIT_FOREVER)
+        return SERVER_SOCKET_WAIT_FOREVER;
+
+    long remaining_us = deadline_us - ServerSocketNowUs();
+
+    return (remaining_us > 0 ? remaining_us : 0);
+}
+
+/// @brief Waits until the client socket is readable (data, EOF or error), or already decrypted (or decompressed) data is pending.
+/// Shared-memory connections wait for their ring instead.
+/// @param client_socket Client socket.
+/// @param timeout_us Maximum time to wait for, < 0 (SERVER_SOCKET_WAIT_FOREVER) to wait with no limit.
+/// @return > 0 if readable, 0 if timed out, < 0 if any error happened.
+int ServerSocketWaitReadable(const int client_socket, long timeout_us)
+{
+    if(SocketShmActive())
+        return SocketShmWaitReadable(client_socket, timeout_us);
+
+    if(ServerSocketIsSecure() && ServerSocketSSLPending())
+        return 1;
+
+    if(SocketCompressPending())
+        return 1;
+
+    // Low-latency connections spin first, only blocking for whatever time is left once the spin budget ran out.
+    if(SocketBusyPollActive())
+    {
+        if(SocketBusyPollSpin(client_socket, timeout_us) > 0)
+            return 1;
+
+        if(timeout_us >= 0)
+            timeout_us = (timeout_us > SocketBusyPollSpinUs() ? timeout_us - SocketBusyPollSpinUs() : 0);
+    }
+
+    // Connections getting broadcasts write them meanwhile.
+    if(SocketBroadcastAttached())
+        return SocketBroadcastWaitReadable(client_socket, timeout_us);
+
+    struct pollfd client_poll_fd =
+    {
+        .fd     = client_socket,
+        .events = POLLIN,
+    };
+
+    struct timespec timeout =
+    {
+        .tv_sec     = timeout_us / SERVER_SOCKET_HELPER_US_PER_SEC,
+        .tv_nsec    = (timeout_us % SERVER_SOCKET_HELPER_US_PER_SEC) * SERVER_SOCKET_HELPER_NS_PER_US,
+    };
+
+    int wait_readable;
+
+    do
+    {
+        wait_readable = ppoll(&client_poll_fd, 1, (timeout_us < 0 ? NULL : &timeout), NULL);
+    } while(wait_readable < 0 && errno == EINTR);
+
+    return wait_readable;
+}
+
+/// @brief Gets one of the timeouts set on the socket, regardless of whether it is blocking or not.
+/// @param client_socket Client socket.
+/// @param optname SO_RCVTIMEO or SO_SNDTIMEO.
+/// @return Timeout, SERVER_SOCKET_WAIT_FOREVER if there is none.
+static long ServerSocketOptTimeoutUs(const int client_socket, const int optname)
+{
+    struct timeval timeout;
+    socklen_t timeout_len = sizeof(timeout);
+
+    if(getsockopt(client_socket, SOL_SOCKET, optname, &timeout, &timeout_len) < 0 || (timeout.tv_sec == 0 && timeout.tv_usec == 0))
+        return SERVER_SOCKET_WAIT_FOREVER;
+
+    return timeout.tv_sec * SERVER_SOCKET_HELPER_US_PER_SEC + timeout.tv_usec;
+}
+
+/// @brief Gets the time a blocking read or write on the socket would wait for, so waits done by the library behave as the
+/// socket does.
+/// @param client_socket Client socket.
+/// @param optname SO_RCVTIMEO or SO_SNDTIMEO.
+/// @return Timeout, 0 for non-blocking sockets, SERVER_SOCKET_WAIT_FOREVER if there is none.
+long ServerSocketGetTimeoutUs(const int client_socket, const int optname)
+{
+    if(fcntl(client_socket, F_GETFL) & O_NONBLOCK)
+        return 0;
+
+    return ServerSocketOptTimeoutUs(client_socket, optname);
+}
+
+/// @brief Waits until the client socket is writable.
+/// @param client_socket Client socket.
+/// @param timeout_us Maximum time to wait for, < 0 (SERVER_SOCKET_WAIT_FOREVER) to wait with no limit.
+/// @return > 0 if writable, 0 if timed out, < 0 if any error happened (including the connection being reset or hung up).
+int ServerSocketWaitWritable(const int client_socket, const long timeout_us)
+{
+    struct pollfd client_poll_fd =
+    {
+        .fd     = client_socket,
+        .events = POLLOUT,
+    };
+
+    struct timespec timeout =
+    {
+        .tv_sec     = timeout_us / SERVER_SOCKET_HELPER_US_PER_SEC,
+        .tv_nsec    = (timeout_us % SERVER_SOCKET_HELPER_US_PER_SEC) * SERVER_SOCKET_HELPER_NS_PER_US,
+    };
+
+    int wait_writable;
+
+    do
+    {
+        wait_writable = ppoll(&client_poll_fd, 1, (timeout_us < 0 ? NULL : &timeout), NULL);
+    } while(wait_writable < 0 && errno == EINTR);
+
+    if(wait_writable > 0 && (client_poll_fd.revents & (POLLERR | POLLHUP)))
+        return SERVER_SOCKET_HELPER_ERR_WAIT;
+
+    return wait_writable;
+}
+
+/// @brief Tells whether a failed write, which has to be completed (e.g. responses partly written already), is worth retrying,
+/// waiting for the socket to be writable first if needed. Blocking sockets have already waited for their send timeout within
+/// the write, so they are only retried if interrupted. Non-blocking ones wait for as long as the send timeout set on them
+/// allows (with no limit if there is none).
+/// @param client_socket Client socket.
+/// @return 0 if the write can be retried, < 0 otherwise (errno set to EAGAIN if time ran out).
+int ServerSocketRetryWrite(const int client_socket)
+{
+    if(errno == EINTR)
+        return SERVER_SOCKET_HELPER_SUCCESS;
+
+    if((errno != EAGAIN && errno != EWOULDBLOCK) || !(fcntl(client_socket, F_GETFL) & O_NONBLOCK))
+        return SERVER_SOCKET_HELPER_ERR_WAIT;
+
+    int wait_writable = ServerSocketWaitWritable(client_socket, ServerSocketOptTimeoutUs(client_socket, SO_SNDTIMEO));
+
+    if(wait_writable <= 0)
+    {
+        if(wait_writable == 0)
+            errno = EAGAIN;
+
+        return SERVER_SOCKET_HELPER_ERR_WAIT;
+    }
+
+    return SERVER_SOCKET_HELPER_SUCCESS;
+}
+
+/// @brief Reads from client socket without removing read data from it.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes available if > 0, 0 if client got disconnected, < 0 if no data could be read.
+static int ServerSocketPeek(const int client_socket, char* rx_buffer, const unsigned long rx_buffer_size)
+{
+    if(SocketShmActive())
+        return SocketShmPeek(client_socket, rx_buffer, rx_buffer_size);
+
+    // Compressed data is only inflated once read, so there is nothing meaningful to peek at.
+    if(SocketCompressActive())
+    {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    if(!ServerSocketIsSecure())
+        return recv(client_socket, rx_buffer, rx_buffer_size, MSG_PEEK);
+
+    return ServerSocketSSLPeek(rx_buffer, rx_buffer_size);
+}
+
+/// @brief Tells whether a failed read is worth retrying once the socket gets readable again.
+/// @return True if the read just would have blocked or got interrupted, false if it actually failed.
+static bool ServerSocketRetryRead(void)
+{
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+/// @brief Reads at least a given amount of bytes, waiting for the socket to be readable in between reads.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size (maximum amount of bytes to be read).
+/// @param min_size Minimum amount of bytes to be read (capped to rx_buffer_size).
+/// @param timeout_us Maximum time to wait for in total, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes read (< min_size if time ran out or client got disconnected meanwhile),
+/// 0 if client got disconnected before sending anything, < 0 if nothing was read on time or any error happened.
+int ServerSocketReadAtLeast(int client_socket, char* rx_buffer, unsigned long rx_buffer_size, unsigned long min_size, long timeout_us)
+{
+    long deadline_us = (timeout_us < 0 ? SERVER_SOCKET_WAIT_FOREVER : ServerSocketNowUs() + timeout_us);
+    unsigned long total = 0;
+
+    if(min_size > rx_buffer_size)
+        min_size = rx_buffer_size;
+
+    do
+    {
+        int wait_readable = ServerSocketWaitReadable(client_socket, ServerSocketRemainingUs(deadline_us));
+
+        if(wait_readable <= 0)
+        {
+            if(wait_readable == 0)
+                errno = ETIMEDOUT;
+
+            break;
+        }
+
+        int read_from_socket = ServerSocketRead(client_socket, rx_buffer + total, rx_buffer_size - total);
+
+        if(read_from_socket == 0)
+            return total;
+
+        if(read_from_socket < 0)
+        {
+            if(ServerSocketRetryRead())
+                continue;
+
+            break;
+        }
+
+        total += read_from_socket;
+    } while(total < min_size);
+
+    return (total > 0 ? (int)total : SERVER_SOCKET_HELPER_ERR_READ_TIMEOUT);
+}
+
+/// @brief Reads until no more data arrives for a given time, or until RX buffer gets full.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size (maximum amount of bytes to be read).
+/// @param idle_us Time without new data after which reading is over.
+/// @param timeout_us Maximum time to wait for the first byte, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes read, 0 if client got disconnected before sending anything,
+/// < 0 if nothing was read on time or any error happened.
+int ServerSocketReadUntilIdle(int client_socket, char* rx_buffer, unsigned long rx_buffer_size, long idle_us, long timeout_us)
+{
+    long deadline_us = (timeout_us < 0 ? SERVER_SOCKET_WAIT_FOREVER : ServerSocketNowUs() + timeout_us);
+    unsigned long total = 0;
+
+    do
+    {
+        int wait_readable = ServerSocketWaitReadable(client_socket, (total > 0 ? idle_us : ServerSocketRemainingUs(deadline_us)));
+
+        if(wait_readable <= 0)
+        {
+            if(wait_readable == 0)
+                errno = ETIMEDOUT;
+
+            break;
+        }
+
+        int read_from_socket = ServerSocketRead(client_socket, rx_buffer + total, rx_buffer_size - total);
+
+        if(read_from_socket == 0)
+            return total;
+
+        if(read_from_socket < 0)
+        {
+            if(ServerSocketRetryRead())
+                continue;
+
+            break;
+        }
+
+        total += read_from_socket;
+    } while(total < rx_buffer_size);
+
+    return (total > 0 ? (int)total : SERVER_SOCKET_HELPER_ERR_READ_TIMEOUT);
+}
+
+/// @brief Reads until a delimiter is found (delimiter included), or until RX buffer gets full.
+/// Data is peeked first, so bytes following the delimiter are left in the socket for the next read.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size (maximum amount of bytes to be read).
+/// @param delimiter Delimiter character.
+/// @param timeout_us Maximum time to wait for in total, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes read (last one not being the delimiter if time ran out, client got disconnected or buffer got full),
+/// 0 if client got disconnected before sending anything, < 0 if nothing was read on time or any error happened.
+int ServerSocketReadUntilDelimiter(int client_socket, char* rx_buffer, unsigned long rx_buffer_size, char delimiter, long timeout_us)
+{
+    long deadline_us = (timeout_us < 0 ? SERVER_SOCKET_WAIT_FOREVER : ServerSocketNowUs() + timeout_us);
+    unsigned long total = 0;
+
+    do
+    {
+        int wait_readable = ServerSocketWaitReadable(client_socket, ServerSocketRemainingUs(deadline_us));
+
+        if(wait_readable <= 0)
+        {
+            if(wait_readable == 0)
+                errno = ETIMEDOUT;
+
+            break;
+        }
+
+        int peek_socket = ServerSocketPeek(client_socket, rx_buffer + total, rx_buffer_size - total);
+
+        if(peek_socket == 0)
+            return total;
+
+        if(peek_socket < 0)
+        {
+            if(ServerSocketRetryRead())
+                continue;
+
+            break;
+        }
+
+        const char* p_delimiter = SocketScanFind(rx_buffer + total, peek_socket, delimiter);
+        unsigned long to_read = (p_delimiter ? (unsigned long)(p_delimiter - (rx_buffer + total)) + 1 : (unsigned long)peek_socket);
+
+        // Peeked data is already there, so this read does not block.
+        int read_from_socket = ServerSocketRead(client_socket, rx_buffer + total, to_read);
+
+        if(read_from_socket <= 0)
+            break;
+
+        total += read_from_socket;
+
+        if(p_delimiter && (unsigned long)read_from_socket == to_read)
+            break;
+    } while(total < rx_buffer_size);
+
+    return (total > 0 ? (int)total : SERVER_SOCKET_HELPER_ERR_READ_TIMEOUT);
+}
@@ -0,0 +1,15 @@
+#ifndef SERVER_SOCKET_HELPER_FUNCTIONS_H
+#define SERVER_SOCKET_HELPER_FUNCTIONS_H
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+long ServerSocketGetTimeoutUs(int client_socket, int optname);
+int ServerSocketWaitReadable(int client_socket, long timeout_us);
+int ServerSocketWaitWritable(int client_socket, long timeout_us);
+int ServerSocketRetryWrite(int client_socket);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,409 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ServerSocketLog.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SOCKET_LOG_RING_SIZE            64      // Records per thread, must be a power of 2.
+#define SOCKET_LOG_LINE_SIZE            512
+#define SOCKET_LOG_DRAIN_MIN_PERIOD_US  1000
+#define SOCKET_LOG_DRAIN_MAX_PERIOD_US  64000   // Idle drain thread backs off up to this period.
+#define SOCKET_LOG_NS_PER_US            1000
+#define SOCKET_LOG_US_PER_S             1000000
+#define SOCKET_LOG_CONVERSIONS          "diouxXcsp"
+
+#define SOCKET_LOG_MSG_DROPPED          "<%lu> log messages dropped, logging thread could not keep up."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Deferred log message. Formatting happens in the logging thread.
+typedef struct
+{
+    const char* fmt;
+    int level;
+    SOCKET_LOG_ARG args[SOCKET_LOG_MAX_ARGS];
+} SOCKET_LOG_RECORD;
+
+/// @brief Single-producer single-consumer ring, owned by one thread at a time.
+typedef struct SOCKET_LOG_RING
+{
+    SOCKET_LOG_RECORD records[SOCKET_LOG_RING_SIZE];
+    unsigned long head;                 // Written by the logging thread only.
+    unsigned long tail;                 // Written by the owner thread only.
+    unsigned long dropped;
+    bool orphaned;                      // Owner thread is gone, ring can be recycled once drained.
+    struct SOCKET_LOG_RING* next;       // Every ring ever allocated.
+    struct SOCKET_LOG_RING* next_free;  // Rings ready to be reused.
+} SOCKET_LOG_RING;
+
+/**********************************/
+
+/***************************************/
+/********** Private variables **********/
+/***************************************/
+
+static __thread SOCKET_LOG_RING* p_thread_ring;
+
+static SOCKET_LOG_RING* p_rings;
+static SOCKET_LOG_RING* p_free_rings;
+static pthread_mutex_t rings_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static pthread_t log_thread;
+static bool log_thread_running;
+static bool log_stop;
+
+/***************************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static void SocketLogLaunch(void);
+static void SocketLogReleaseRing(void* p_ring);
+static SOCKET_LOG_RING* SocketLogGetRing(void);
+static void SocketLogFormat(char* line, const unsigned long line_size, const SOCKET_LOG_RECORD* p_record);
+static void SocketLogWrite(const int level, const char* fmt, const SOCKET_LOG_ARG* args);
+static bool SocketLogDrain(void);
+static void* SocketLogRoutine(void* arg);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Launches the logging thread. Called once, when the first ring is requested.
+static void SocketLogLaunch(void)
+{
+    sigset_t all_signals;
+    sigset_t previous_signals;
+
+    pthread_key_create(&ring_key, SocketLogReleaseRing);
+
+    // Signals are meant to be handled by server threads, never by the logging one.
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous_signals);
+
+    log_thread_running = (pthread_create(&log_thread, NULL, SocketLogRoutine, NULL) == 0);
+
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+}
+
+/// @brief Thread-specific data destructor: hands the ring back to the logging thread.
+/// @param p_ring Ring owned by the exiting thread.
+static void SocketLogReleaseRing(void* p_ring)
+{
+    p_thread_ring = NULL;
+    __atomic_store_n(&((SOCKET_LOG_RING*)p_ring)->orphaned, true, __ATOMIC_RELEASE);
+}
+
+/// @brief Gets the calling thread's ring, taking a recycled one (or allocating a new one) the first time.
+/// @return Thread's ring, NULL if asynchronous logging is not available.
+static SOCKET_LOG_RING* SocketLogGetRing(void)
+{
+    if(p_thread_ring != NULL)
+        return p_thread_ring;
+
+    pthread_once(&log_once, SocketLogLaunch);
+
+    if(!log_thread_running || __atomic_load_n(&log_stop, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    pthread_mutex_lock(&rings_mtx);
+
+    SOCKET_LOG_RING* p_ring = p_free_rings;
+
+    if(p_ring != NULL)
+        p_free_rings = p_ring->next_free;
+    else if((p_ring = calloc(1, sizeof(SOCKET_LOG_RING))) != NULL)
+    {
+        p_ring->next = p_rings;
+        __atomic_store_n(&p_rings, p_ring, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&rings_mtx);
+
+    if(p_ring == NULL)
+        return NULL;
+
+    __atomic_store_n(&p_ring->orphaned, false, __ATOMIC_RELEASE);
+    pthread_setspecific(ring_key, p_ring);
+    p_thread_ring = p_ring;
+
+    return p_ring;
+}
+
+/// @brief Renders a record. Only integer, character, pointer and string conversions are supported.
+/// @param line Target line.
+/// @param line_size Target line size.
+/// @param p_record Record.
+static void SocketLogFormat(char* line, const unsigned long line_size, const SOCKET_LOG_RECORD* p_record)
+{
+    const char* p_fmt = p_record->fmt;
+    unsigned long used = 0;
+    int arg_idx = 0;
+
+    while(*p_fmt != 0 && used < line_size - 1)
+    {
+        if(*p_fmt != '%' || p_fmt[1] == '%')
+        {
+            line[used++] = *p_fmt;
+            p_fmt += (*p_fmt == '%' ? 2 : 1);
+            continue;
+        }
+
+        unsigned long spec_len = strcspn(p_fmt + 1, SOCKET_LOG_CONVERSIONS) + 2;
+        char spec[16];
+
+        if(p_fmt[spec_len - 1] == 0 || spec_len >= sizeof(spec) || arg_idx >= SOCKET_LOG_MAX_ARGS)
+            break;
+
+        memcpy(spec, p_fmt, spec_len);
+        spec[spec_len] = 0;
+
+        const SOCKET_LOG_ARG* p_arg = &p_record->args[arg_idx++];
+        bool is_long = (spec[spec_len - 2] == 'l');
+        int printed;
+
+        switch(spec[spec_len - 1])
+        {
+            case 's':
+                printed = snprintf(line + used, line_size - used, spec, p_arg->str);
+            break;
+
+            case 'p':
+                printed = snprintf(line + used, line_size - used, spec, (void*)p_arg->num);
+            break;
+
+            case 'd':
+            case 'i':
+            case 'c':
+                printed = (is_long ? snprintf(line + used, line_size - used, spec, p_arg->num) :
+                                     snprintf(line + used, line_size - used, spec, (int)p_arg->num));
+            break;
+
+            default:
+                printed = (is_long ? snprintf(line + used, line_size - used, spec, (unsigned long)p_arg->num) :
+                                     snprintf(line + used, line_size - used, spec, (unsigned int)p_arg->num));
+            break;
+        }
+
+        if(printed < 0)
+            break;
+
+        used += printed;
+        if(used >= line_size)
+            used = line_size - 1;
+
+        p_fmt += spec_len;
+    }
+
+    line[used] = 0;
+}
+
+/// @brief Writes a message through the severity log library.
+/// @param level Log level.
+/// @param fmt Format string.
+/// @param args Captured arguments.
+static void SocketLogWrite(const int level, const char* fmt, const SOCKET_LOG_ARG* args)
+{
+    SOCKET_LOG_RECORD record = {.fmt = fmt, .level = level};
+    char line[SOCKET_LOG_LINE_SIZE];
+
+    memcpy(record.args, args, sizeof(record.args));
+    SocketLogFormat(line, sizeof(line), &record);
+
+    switch(level)
+    {
+        case SERVER_SOCKET_LOG_LEVEL_ERR:   SVRTY_LOG_ERR("%s", line);  break;
+        case SERVER_SOCKET_LOG_LEVEL_WNG:   SVRTY_LOG_WNG("%s", line);  break;
+        case SERVER_SOCKET_LOG_LEVEL_INF:   SVRTY_LOG_INF("%s", line);  break;
+        default:                            SVRTY_LOG_DBG("%s", line);  break;
+    }
+}
+
+/// @brief Drains every ring once, recycling the ones whose owner thread is gone.
+/// @return True if any message was written, false otherwise.
+static bool SocketLogDrain(void)
+{
+    bool drained = false;
+
+    for(SOCKET_LOG_RING* p_ring = __atomic_load_n(&p_rings, __ATOMIC_ACQUIRE); p_ring != NULL; p_ring = p_ring->next)
+    {
+        // Read the flag first: once it is set, the owner pushes nothing else.
+        bool orphaned = __atomic_load_n(&p_ring->orphaned, __ATOMIC_ACQUIRE);
+        unsigned long tail = __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE);
+        unsigned long head = p_ring->head;
+
+        for(; head != tail; head++)
+        {
+            SOCKET_LOG_RECORD* p_record = &p_ring->records[head & (SOCKET_LOG_RING_SIZE - 1)];
+            SocketLogWrite(p_record->level, p_record->fmt, p_record->args);
+            drained = true;
+        }
+
+        __atomic_store_n(&p_ring->head, head, __ATOMIC_RELEASE);
+
+        unsigned long dropped = __atomic_exchange_n(&p_ring->dropped, 0, __ATOMIC_RELAXED);
+        if(dropped > 0)
+            SocketLogWrite(SERVER_SOCKET_LOG_LEVEL_WNG, SOCKET_LOG_MSG_DROPPED, (const SOCKET_LOG_ARG[SOCKET_LOG_MAX_ARGS]){SocketLogArgNum(dropped)});
+
+        if(orphaned)
+        {
+            p_ring->orphaned = false;
+
+            pthread_mutex_lock(&rings_mtx);
+            p_ring->next_free = p_free_rings;
+            p_free_rings = p_ring;
+            pthread_mutex_unlock(&rings_mtx);
+        }
+    }
+
+    return drained;
+}
+
+/// @brief Logging thread: drains rings, backing off while there is nothing to write.
+/// @param arg Unused.
+/// @return NULL.
+static void* SocketLogRoutine(void* arg)
+{
+    unsigned long period_us = SOCKET_LOG_DRAIN_MIN_PERIOD_US;
+
+    while(!__atomic_load_n(&log_stop, __ATOMIC_ACQUIRE))
+    {
+        if(SocketLogDrain())
+            period_us = SOCKET_LOG_DRAIN_MIN_PERIOD_US;
+        else if(period_us < SOCKET_LOG_DRAIN_MAX_PERIOD_US)
+            period_us *= 2;
+
+        struct timespec period = {.tv_sec = period_us / SOCKET_LOG_US_PER_S, .tv_nsec = (period_us % SOCKET_LOG_US_PER_S) * SOCKET_LOG_NS_PER_US};
+        nanosleep(&period, NULL);
+    }
+
+    return NULL;
+}
+
+/// @brief Captures a string argument.
+/// @param str String, truncated (and ending with an ellipsis) if it does not fit.
+/// @return Captured argument.
+SOCKET_LOG_ARG SocketLogArgStr(const char* str)
+{
+    SOCKET_LOG_ARG arg;
+
+    if(str == NULL)
+        str = "(null)";
+
+    size_t str_len = strnlen(str, sizeof(arg.str));
+
+    if(str_len < sizeof(arg.str))
+    {
+        memcpy(arg.str, str, str_len + 1);
+        return arg;
+    }
+
+    size_t kept_len = sizeof(arg.str) - sizeof(SOCKET_LOG_STR_ELLIPSIS);
+
+    memcpy(arg.str, str, kept_len);
+    memcpy(arg.str + kept_len, SOCKET_LOG_STR_ELLIPSIS, sizeof(SOCKET_LOG_STR_ELLIPSIS));
+
+    return arg;
+}
+
+/// @brief Captures a numeric argument.
+/// @param num Number.
+/// @return Captured argument.
+SOCKET_LOG_ARG SocketLogArgNum(long num)
+{
+    return (SOCKET_LOG_ARG){.num = num};
+}
+
+/// @brief Tells whether or not a rate-limited call site is allowed to log within the current second.
+/// @param p_rate Call site's rate limiting state.
+/// @param p_suppressed Target to which the amount of messages suppressed during previous seconds is copied.
+/// @return True if the message is meant to be logged, false otherwise.
+bool SocketLogRateAllow(SOCKET_LOG_RATE* p_rate, unsigned long* p_suppressed)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    unsigned long window_s = __atomic_load_n(&p_rate->window_s, __ATOMIC_RELAXED);
+    *p_suppressed = 0;
+
+    // First caller within a new second resets the budget.
+    if(window_s != (unsigned long)now.tv_sec &&
+       __atomic_compare_exchange_n(&p_rate->window_s, &window_s, now.tv_sec, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&p_rate->count, 0, __ATOMIC_RELAXED);
+        *p_suppressed = __atomic_exchange_n(&p_rate->suppressed, 0, __ATOMIC_RELAXED);
+    }
+
+    if(__atomic_add_fetch(&p_rate->count, 1, __ATOMIC_RELAXED) <= SERVER_SOCKET_LOG_RATE_PER_S)
+        return true;
+
+    __atomic_add_fetch(&p_rate->suppressed, 1, __ATOMIC_RELAXED);
+
+    return false;
+}
+
+/// @brief Queues a message to the calling thread's ring. Never blocks: messages are dropped (and counted) if the ring is full.
+/// Messages are written synchronously if the logging thread is not available.
+/// @param level Log level.
+/// @param fmt Format string. It must be a string literal, as it is read later on by the logging thread.
+/// @param args Captured arguments.
+void SocketLogPush(const int level, const char* fmt, const SOCKET_LOG_ARG* args)
+{
+    SOCKET_LOG_RING* p_ring = SocketLogGetRing();
+
+    if(p_ring == NULL || __atomic_load_n(&log_stop, __ATOMIC_RELAXED))
+    {
+        SocketLogWrite(level, fmt, args);
+        return;
+    }
+
+    unsigned long tail = p_ring->tail;
+
+    if(tail - __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE) >= SOCKET_LOG_RING_SIZE)
+    {
+        __atomic_add_fetch(&p_ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    SOCKET_LOG_RECORD* p_record = &p_ring->records[tail & (SOCKET_LOG_RING_SIZE - 1)];
+    p_record->fmt = fmt;
+    p_record->level = level;
+    memcpy(p_record->args, args, sizeof(p_record->args));
+
+    __atomic_store_n(&p_ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/// @brief Stops the logging thread, then writes every pending message.
+void SocketFreeLogResources(void)
+{
+    if(!log_thread_running || __atomic_exchange_n(&log_stop, true, __ATOMIC_ACQ_REL))
+        return;
+
+    pthread_join(log_thread, NULL);
+
+    SocketLogDrain();
+}
+
+/*************************************/
@@ -0,0 +1,145 @@
+#ifndef SERVER_SOCKET_LOG_H
+#define SERVER_SOCKET_LOG_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_LOG_LEVEL_NONE    0
+#define SERVER_SOCKET_LOG_LEVEL_ERR     1
+#define SERVER_SOCKET_LOG_LEVEL_WNG     2
+#define SERVER_SOCKET_LOG_LEVEL_INF     3
+#define SERVER_SOCKET_LOG_LEVEL_DBG     4
+
+// Hot-path messages above this level are compiled out (arguments are not even evaluated).
+#ifndef SERVER_SOCKET_LOG_LEVEL
+#define SERVER_SOCKET_LOG_LEVEL         SERVER_SOCKET_LOG_LEVEL_INF
+#endif
+
+// Maximum amount of messages per second logged from each rate-limited call site.
+#ifndef SERVER_SOCKET_LOG_RATE_PER_S
+#define SERVER_SOCKET_LOG_RATE_PER_S    10
+#endif
+
+#define SOCKET_LOG_MAX_ARGS             4
+#define SOCKET_LOG_STR_ARG_SIZE         128 // Strings are copied, so strerror() text and paths fit. Longer ones end with an ellipsis.
+#define SOCKET_LOG_STR_ELLIPSIS         "..."
+
+/// @brief Captures an argument by value: strings are copied, anything else is widened to long.
+#define SOCKET_LOG_ARG_OF(arg)      _Generic((arg)                          ,   \
+                                             char*          : SocketLogArgStr,  \
+                                             const char*    : SocketLogArgStr,  \
+                                             default        : SocketLogArgNum)(arg)
+
+#define SOCKET_LOG_ARGS_0()
+#define SOCKET_LOG_ARGS_1(a)            SOCKET_LOG_ARG_OF(a)
+#define SOCKET_LOG_ARGS_2(a, b)         SOCKET_LOG_ARG_OF(a), SOCKET_LOG_ARG_OF(b)
+#define SOCKET_LOG_ARGS_3(a, b, c)      SOCKET_LOG_ARG_OF(a), SOCKET_LOG_ARG_OF(b), SOCKET_LOG_ARG_OF(c)
+#define SOCKET_LOG_ARGS_4(a, b, c, d)   SOCKET_LOG_ARG_OF(a), SOCKET_LOG_ARG_OF(b), SOCKET_LOG_ARG_OF(c), SOCKET_LOG_ARG_OF(d)
+#define SOCKET_LOG_ARGS_SELECT(_1, _2, _3, _4, selected, ...) selected
+#define SOCKET_LOG_ARGS(...)            SOCKET_LOG_ARGS_SELECT(__VA_ARGS__ __VA_OPT__(,)                        \
+                                                               SOCKET_LOG_ARGS_4, SOCKET_LOG_ARGS_3,            \
+                                                               SOCKET_LOG_ARGS_2, SOCKET_LOG_ARGS_1,            \
+                                                               SOCKET_LOG_ARGS_0)(__VA_ARGS__)
+
+#define SOCKET_LOG_PUSH(level, fmt, ...)                                                                        \
+        SocketLogPush(level, fmt, (const SOCKET_LOG_ARG[SOCKET_LOG_MAX_ARGS]){ SOCKET_LOG_ARGS(__VA_ARGS__) })
+
+/// @brief Logs at most SERVER_SOCKET_LOG_RATE_PER_S messages per second from the call site,
+/// then reports how many were suppressed once the next one gets through.
+#define SOCKET_LOG_PUSH_RATE_LIMITED(level, fmt, ...)                                                           \
+        do                                                                                                      \
+        {                                                                                                       \
+            static SOCKET_LOG_RATE socket_log_rate;                                                             \
+            unsigned long socket_log_suppressed;                                                                \
+                                                                                                                \
+            if(SocketLogRateAllow(&socket_log_rate, &socket_log_suppressed))                                    \
+            {                                                                                                   \
+                if(socket_log_suppressed > 0)                                                                   \
+                    SOCKET_LOG_PUSH(level, SOCKET_LOG_MSG_SUPPRESSED, socket_log_suppressed, fmt);              \
+                                                                                                                \
+                SOCKET_LOG_PUSH(level, fmt, ##__VA_ARGS__);                                                     \
+            }                                                                                                   \
+        } while(0)
+
+#define SOCKET_LOG_MSG_SUPPRESSED       "<%lu> messages suppressed by rate limit: <%s...>."
+
+#define SOCKET_LOG_DISABLED(...)        do {} while(0)
+
+#if SERVER_SOCKET_LOG_LEVEL >= SERVER_SOCKET_LOG_LEVEL_ERR
+#define SOCKET_LOG_ERR(fmt, ...)        SOCKET_LOG_PUSH(SERVER_SOCKET_LOG_LEVEL_ERR, fmt, ##__VA_ARGS__)
+#define SOCKET_LOG_ERR_RL(fmt, ...)     SOCKET_LOG_PUSH_RATE_LIMITED(SERVER_SOCKET_LOG_LEVEL_ERR, fmt, ##__VA_ARGS__)
+#else
+#define SOCKET_LOG_ERR                  SOCKET_LOG_DISABLED
+#define SOCKET_LOG_ERR_RL               SOCKET_LOG_DISABLED
+#endif
+
+#if SERVER_SOCKET_LOG_LEVEL >= SERVER_SOCKET_LOG_LEVEL_WNG
+#define SOCKET_LOG_WNG(fmt, ...)        SOCKET_LOG_PUSH(SERVER_SOCKET_LOG_LEVEL_WNG, fmt, ##__VA_ARGS__)
+#define SOCKET_LOG_WNG_RL(fmt, ...)     SOCKET_LOG_PUSH_RATE_LIMITED(SERVER_SOCKET_LOG_LEVEL_WNG, fmt, ##__VA_ARGS__)
+#else
+#define SOCKET_LOG_WNG                  SOCKET_LOG_DISABLED
+#define SOCKET_LOG_WNG_RL               SOCKET_LOG_DISABLED
+#endif
+
+#if SERVER_SOCKET_LOG_LEVEL >= SERVER_SOCKET_LOG_LEVEL_INF
+#define SOCKET_LOG_INF(fmt, ...)        SOCKET_LOG_PUSH(SERVER_SOCKET_LOG_LEVEL_INF, fmt, ##__VA_ARGS__)
+#define SOCKET_LOG_INF_RL(fmt, ...)     SOCKET_LOG_PUSH_RATE_LIMITED(SERVER_SOCKET_LOG_LEVEL_INF, fmt, ##__VA_ARGS__)
+#else
+#define SOCKET_LOG_INF                  SOCKET_LOG_DISABLED
+#define SOCKET_LOG_INF_RL               SOCKET_LOG_DISABLED
+#endif
+
+#if SERVER_SOCKET_LOG_LEVEL >= SERVER_SOCKET_LOG_LEVEL_DBG
+#define SOCKET_LOG_DBG(fmt, ...)        SOCKET_LOG_PUSH(SERVER_SOCKET_LOG_LEVEL_DBG, fmt, ##__VA_ARGS__)
+#define SOCKET_LOG_DBG_RL(fmt, ...)     SOCKET_LOG_PUSH_RATE_LIMITED(SERVER_SOCKET_LOG_LEVEL_DBG, fmt, ##__VA_ARGS__)
+#else
+#define SOCKET_LOG_DBG                  SOCKET_LOG_DISABLED
+#define SOCKET_LOG_DBG_RL               SOCKET_LOG_DISABLED
+#endif
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Captured log argument. The format string tells which member is meant to be used.
+typedef union
+{
+    long num;
+    char str[SOCKET_LOG_STR_ARG_SIZE];
+} SOCKET_LOG_ARG;
+
+/// @brief Per call site rate limiting state.
+typedef struct
+{
+    unsigned long window_s;
+    unsigned long count;
+    unsigned long suppressed;
+} SOCKET_LOG_RATE;
+
+/**********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+SOCKET_LOG_ARG SocketLogArgStr(const char* str);
+SOCKET_LOG_ARG SocketLogArgNum(long num);
+bool SocketLogRateAllow(SOCKET_LOG_RATE* p_rate, unsigned long* p_suppressed);
+void SocketLogPush(const int level, const char* fmt, const SOCKET_LOG_ARG* args);
+void SocketFreeLogResources(void);
+
+/*************************************/
+
+#endif
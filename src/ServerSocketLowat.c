@@ -0,0 +1,200 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <errno.h>
+#include <netinet/in.h>         // IPPROTO_TCP
+#include <netinet/tcp.h>        // TCP_NOTSENT_LOWAT
+#include <sys/socket.h>
+#include "ServerSocketLowat.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketSSL.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_LOWAT_SUCCESS         0
+#define SERVER_SOCKET_LOWAT_ERR_ALLOC       -1
+#define SERVER_SOCKET_LOWAT_ERR_DROPPED     -2
+#define SERVER_SOCKET_LOWAT_ERR_WRITE       -3
+
+#define SOCKET_LOWAT_DISABLED               0
+
+#define SERVER_SOCKET_MSG_LOWAT_OPT_NOK     "Could not set unsent data low-water mark on socket <%d>, writing as usual."
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long lowat_bytes = SOCKET_LOWAT_DISABLED;
+
+/// @brief Send timeout of the current connection, so waiting for it to be writable behaves as a blocking write did.
+static __thread long lowat_tx_timeout_us;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread bool socket_lowat_active = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int SocketLowatWaitWritable(int client_socket);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Waits until the kernel holds less unsent data than the low-water mark (the socket is only reported writable then).
+/// @param client_socket Client socket.
+/// @return > 0 if writable, 0 if timed out, < 0 if any error happened.
+static int SocketLowatWaitWritable(const int client_socket)
+{
+    int wait_writable = ServerSocketWaitWritable(client_socket, 0);
+
+    if(wait_writable != 0)
+        return wait_writable;
+
+    SocketStatsCount(SERVER_SOCKET_CNT_LOWAT_WAITS, 1);
+
+    return ServerSocketWaitWritable(client_socket, lowat_tx_timeout_us);
+}
+
+/// @brief Sets the unsent data low-water mark of client sockets. To be called before ServerSocketRun.
+/// @param lowat Unsent bytes the kernel holds per connection, at most, 0 to disable (default).
+void ServerSocketSetNotSentLowat(const unsigned long lowat)
+{
+    lowat_bytes = lowat;
+}
+
+/// @brief Writes a message ahead of whatever the connection's serving thread has not written yet.
+/// @param client_socket Client socket.
+/// @param data Message data (copied).
+/// @param size Message size.
+/// @return 0 if the message was written or queued, < 0 if broadcasting is disabled, it could not be allocated or it was dropped.
+int ServerSocketWriteUrgent(int client_socket, const char* data, const unsigned long size)
+{
+    SERVER_SOCKET_BUFFER* p_buffer = ServerSocketBufferCreate(data, size);
+
+    if(!p_buffer)
+        return SERVER_SOCKET_LOWAT_ERR_ALLOC;
+
+    int broadcast = ServerSocketBroadcast(p_buffer, &client_socket, 1);
+
+    ServerSocketBufferRelease(p_buffer);
+
+    if(broadcast < 0)
+        return broadcast;
+
+    return (broadcast > 0 ? SERVER_SOCKET_LOWAT_SUCCESS : SERVER_SOCKET_LOWAT_ERR_DROPPED);
+}
+
+/// @brief Sets the low-water mark on the connection served by the current thread, so its writes get fed to the kernel
+/// as it drains them instead of piling up in its send buffer.
+/// @param client_socket Client socket.
+void SocketLowatAttach(const int client_socket)
+{
+    if(lowat_bytes == SOCKET_LOWAT_DISABLED)
+        return;
+
+    int lowat = (int)lowat_bytes;
+
+    if(setsockopt(client_socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) < 0)
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_LOWAT_OPT_NOK, client_socket);
+        return;
+    }
+
+    lowat_tx_timeout_us = ServerSocketGetTimeoutUs(client_socket, SO_SNDTIMEO);
+    socket_lowat_active = true;
+}
+
+/// @brief Writes to the current connection one low-water mark's worth at a time, each time the kernel has drained its
+/// unsent data below it. Messages queued meanwhile (see ServerSocketWriteUrgent) are written first, so they only wait
+/// for what the kernel already holds rather than for every byte written before them.
+/// @param client_socket Client socket.
+/// @param tx_buffer TX buffer.
+/// @param tx_buffer_size TX buffer size.
+/// @param secure True for TLS connections.
+/// @return > 0 equaling the amount of bytes written, 0 if client got disconnected, < 0 if any error happened.
+int SocketLowatWrite(const int client_socket, const char* tx_buffer, const unsigned long tx_buffer_size, const bool secure)
+{
+    if(SocketBroadcastAttached() && SocketBroadcastWritePending(client_socket) < 0)
+        return SERVER_SOCKET_LOWAT_ERR_WRITE;
+
+    unsigned long written = 0;
+    int write_to_socket = 0;
+
+    while(written < tx_buffer_size)
+    {
+        int wait_writable = SocketLowatWaitWritable(client_socket);
+
+        if(wait_writable <= 0)
+        {
+            if(wait_writable == 0)
+                errno = EAGAIN;
+
+            write_to_socket = SERVER_SOCKET_LOWAT_ERR_WRITE;
+            break;
+        }
+
+        unsigned long chunk_size = tx_buffer_size - written;
+
+        if(chunk_size > lowat_bytes)
+            chunk_size = lowat_bytes;
+
+        if(!secure)
+            write_to_socket = send(client_socket, tx_buffer + written, chunk_size, MSG_DONTWAIT);
+        else
+            write_to_socket = ServerSocketSSLWrite(tx_buffer + written, chunk_size);
+
+        if(write_to_socket <= 0)
+        {
+            // Writable sockets may still be short of memory.
+            if(write_to_socket < 0 && !secure && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                continue;
+
+            if(write_to_socket < 0)
+                SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+
+            break;
+        }
+
+        SocketStatsCount(SERVER_SOCKET_CNT_BYTES_OUT, write_to_socket);
+        SocketStatsRecord(SERVER_SOCKET_HIST_WRITE_BYTES, write_to_socket);
+        SocketTimerTouch();
+        SocketBufTuneTransferred(write_to_socket);
+
+        written += write_to_socket;
+    }
+
+    return (written > 0 ? (int)written : write_to_socket);
+}
+
+/// @brief Stops feeding writes of the current connection at the low-water mark pace. To be called once it is over.
+void SocketLowatRelease(void)
+{
+    socket_lowat_active = false;
+}
+
+/*************************************/
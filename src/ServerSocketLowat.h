@@ -0,0 +1,44 @@
+#ifndef SERVER_SOCKET_LOWAT_H
+#define SERVER_SOCKET_LOWAT_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Tells whether the connection served by the current thread keeps its unsent data under the low-water mark.
+extern __thread bool socket_lowat_active;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+void SocketLowatAttach(int client_socket);
+int SocketLowatWrite(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size, bool secure);
+void SocketLowatRelease(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Tells whether writes on the current thread are meant to wait for unsent data to drain first. Cheap enough for every write.
+/// @return True if low-water mark mode is enabled for the current connection, false otherwise.
+static inline bool SocketLowatActive(void)
+{
+    return socket_lowat_active;
+}
+
+/*************************************/
+
+#endif
@@ -6,10 +6,29 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>             // usleep.
+#include <sys/socket.h>         // Shut remaining connections down when draining.
 #include <openssl/ssl.h>
 #include "ServerSocketSSL.h"
 #include "ServerSocketUse.h"
 #include "ServerSocketManageThreads.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketFraming.h"
+#include "ServerSocketBatch.h"
+#include "ServerSocketAffinity.h"
+#include "ServerSocketBusyPoll.h"
+#include "ServerSocketLowat.h"
+#include "ServerSocketStacks.h"
+#include "ServerSocketCompress.h"
+#include "ServerSocketShm.h"
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocketReaper.h"
+#include "ServerSocketPriority.h"
+#include "ServerSocketZeroCopy.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
 #include "SeverityLog_api.h"
 #include "MutexGuard_api.h"
 
@@ -34,6 +53,12 @@
 #define SERVER_SOCKET_MSG_JOINING_THREAD            "Joining thread with ID: <%lu>."
 #define SERVER_SOCKET_MSG_ERR_THREAD_JOIN           "An error happened while joining thread with ID: <%lu>."
 #define SERVER_SOCKET_MSG_ERR_MTX_LOCK              "Could not lock mutex: <%x>."
+#define SERVER_SOCKET_MSG_DRAINING                  "Draining <%d> connections (up to <%lu> ms)."
+#define SERVER_SOCKET_MSG_HANDLER_ERROR             "Handler gave up on client socket <%d>: <%s>. Closing connection."
+#define SERVER_SOCKET_MSG_DRAIN_SHUTDOWN            "Drain timeout expired, shutting <%d> connections down."
+
+#define SERVER_SOCKET_DRAIN_POLL_US                 10000   // How often active connections are counted while draining.
+#define SERVER_SOCKET_DRAIN_SHUTDOWN_GRACE_MS       1000    // Time for threads to close shut down connections.
 
 #define SERVER_SOCKET_MSG_SSL_HANDSHAKE_NOK "SSL handshake failed."
 #define SERVER_SOCKET_MSG_SSL_HANDSHAKE_OK  "SSL handshake succeeded."
@@ -67,7 +92,12 @@ typedef struct
 /// @brief Arguments to be received by each socket instance. 
 typedef struct
 {
+    int thread_idx;
     int client_socket;
+    int priority_class;
+    unsigned long accept_ns;
+    SOCKET_TIMER* p_timer;
+    SOCKET_STACK* p_stack;
     SERVER_SOCKET_THREAD_COMMON_ARGS* thread_common_args;
 } SERVER_SOCKET_THREAD_ARGS;
 
@@ -77,9 +107,18 @@ typedef struct
     pthread_t thread;
     bool active;
     SSL* p_ssl;
+    SOCKET_TIMER timer;
     SERVER_SOCKET_THREAD_ARGS thread_args;
 } SERVER_SOCKET_THREAD_DATA;
 
+/// @brief Arguments handed over to the connection scope function, to be passed back to SocketServeRequests.
+typedef struct
+{
+    int client_socket;
+    int (*interact_fn)(int client_socket);
+    bool served;
+} SERVER_SOCKET_SERVE_ARGS;
+
 
 /**********************************/
 
@@ -89,12 +128,16 @@ typedef struct
 
 /// @brief Server instances counter.
 static int server_instances_num = 0;
+/// @brief Active server instances counter.
+static int server_instances_active = 0;
 /// @brief Server instances data storing array.
 static SERVER_SOCKET_THREAD_DATA* server_instances_data = NULL;
 /// @brief Server socket common arguments storing variable pointer.
 static SERVER_SOCKET_THREAD_COMMON_ARGS* server_instances_common_args = NULL;
 /// @brief Mutex Guard type variable to handle concurrent read/write operations involving server_instances_data.
 static MTX_GRD_CREATE(mtx_thread_array);
+/// @brief Connection scope function, NULL if requests are served straight away.
+static SERVER_SOCKET_SCOPE_FN connection_scope_fn = NULL;
 
 /***********************************/
 
@@ -103,11 +146,16 @@ static MTX_GRD_CREATE(mtx_thread_array);
 /*************************************/
 
 static int SocketStateSSLHandshake(const int client_socket, const bool non_blocking);
-static int SocketStateClose(const int client_socket);
-static int SocketThreadDataClean(const int client_socket);
+static int SocketStateInteract(const int client_socket, int (*interact_fn)(int client_socket));
+static void SocketServeRequests(void* p_serve_args);
+static int SocketStateClose(const int client_socket, SSL* p_ssl, const unsigned long accept_ns);
+static int SocketThreadDataClean(const int thread_idx, SSL** pp_ssl);
 static void* ServerSocketThreadRoutine(void* args);
 static void SocketFreeThreadsData();
 static int SocketKillAllThreads();
+static int SocketSpawnServerInstance(int client_socket, int priority_class, unsigned long accept_ns, const pthread_attr_t* p_thread_attr, SOCKET_STACK* p_stack);
+static void SocketWaitActiveThreads(unsigned long timeout_ms);
+static int SocketShutdownAllClients(void);
 
 /*************************************/
 
@@ -121,39 +169,96 @@ static int SocketKillAllThreads();
 /// @return 0 if handhsake was successfully performed, < 0 otherwise.
 static int SocketStateSSLHandshake(const int client_socket, const bool non_blocking)
 {
+    unsigned long handshake_start_ns = SocketStatsNowNs();
+
     int ssl_handshake = ServerSocketSSLHandshake(client_socket, non_blocking);
 
+    SocketStatsRecord(SERVER_SOCKET_HIST_HANDSHAKE, SocketStatsNowNs() - handshake_start_ns);
+
     if(ssl_handshake < 0)
-        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_SSL_HANDSHAKE_NOK);
+    {
+        SocketStatsCount(SERVER_SOCKET_CNT_HANDSHAKE_FAILURES, 1);
+        SOCKET_LOG_ERR_RL(SERVER_SOCKET_MSG_SSL_HANDSHAKE_NOK);
+    }
     else
-        SVRTY_LOG_INF(SERVER_SOCKET_MSG_SSL_HANDSHAKE_OK);
+        SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_SSL_HANDSHAKE_OK);
 
     return ssl_handshake;
 }
 
-/// @brief Close socket.
+/// @brief Interact with client.
+/// @param client_socket Client socket instance.
+/// @param interact_fn Interaction function.
+/// @return Interaction function's return value (> 0 if interaction is meant to go on).
+static int SocketStateInteract(const int client_socket, int (*interact_fn)(int client_socket))
+{
+    SocketTimerStage(SOCKET_TIMER_STAGE_REQUEST);
+
+    // Scheduled connections wait for their request and a run slot first, which is not part of the interaction itself.
+    SocketPriorityBegin(client_socket);
+
+    unsigned long interact_start_ns = SocketStatsNowNs();
+
+    int interact = interact_fn(client_socket);
+
+    SocketStatsRecord(SERVER_SOCKET_HIST_INTERACT, SocketStatsNowNs() - interact_start_ns);
+
+    SocketPriorityEnd();
+
+    // Request/response connections may never transfer enough to be sampled otherwise.
+    SocketBufTuneSample(client_socket);
+
+    return interact;
+}
+
+/// @brief Serves every request of the connection, for the connection scope function to call.
+/// @param p_serve_args Serve arguments (SERVER_SOCKET_SERVE_ARGS).
+static void SocketServeRequests(void* p_serve_args)
+{
+    SERVER_SOCKET_SERVE_ARGS* p_args = (SERVER_SOCKET_SERVE_ARGS*)p_serve_args;
+
+    // Requests are only served once, even if the scope function calls back again.
+    if(p_args->served)
+        return;
+
+    p_args->served = true;
+
+    while(SocketStateInteract(p_args->client_socket, p_args->interact_fn) > 0);
+}
+
+/// @brief Close socket, or hand it over to the reaper if deferred close is enabled.
 /// @param client_socket Socket file descriptor.
+/// @param p_ssl Connection's SSL object (freed or handed over), NULL if there is none.
+/// @param accept_ns Time at which the connection was accepted.
 /// @return < 0 if it failed to close the socket.
-static int SocketStateClose(const int client_socket)
+static int SocketStateClose(const int client_socket, SSL* p_ssl, const unsigned long accept_ns)
 {
+    if(SocketReaperDefer(client_socket, p_ssl) == SERVER_SOCKET_MANAGE_THREADS_SUCCESS)
+    {
+        SocketStatsRecord(SERVER_SOCKET_HIST_LIFETIME, SocketStatsNowNs() - accept_ns);
+        return SERVER_SOCKET_MANAGE_THREADS_SUCCESS;
+    }
+
+    ServerSocketFreeSSL(p_ssl);
+
     int close = CloseSocket(client_socket);
+
+    SocketStatsRecord(SERVER_SOCKET_HIST_LIFETIME, SocketStatsNowNs() - accept_ns);
     
     if(close < 0)
-        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_CLOSE_NOK, client_socket, pthread_self());
+        SOCKET_LOG_ERR_RL(SERVER_SOCKET_MSG_CLOSE_NOK, client_socket, pthread_self());
     else
-        SVRTY_LOG_INF(SERVER_SOCKET_MSG_CLOSE_OK, client_socket, pthread_self());
+        SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_CLOSE_OK, client_socket, pthread_self());
 
     return close;    
 }
 
-/// @brief Clean data associated to every active thread.
-/// @param client_socket Target socket instance.
+/// @brief Gives a thread's spot back, taking its SSL object over so the spot can be reused before the connection is torn down.
+/// @param thread_idx Spot of the current thread.
+/// @param pp_ssl Target variable to which the spot's SSL object (if any) is written.
 /// @return 0 if succeeded, < 0 otherwise.
-static int SocketThreadDataClean(const int client_socket)
-{ 
-    // Iterate through SERVER_SOCKET_THREAD_DATA looking for a thread which client socket value matches the current one,
-    // erase all related data afterwards.
-
+static int SocketThreadDataClean(const int thread_idx, SSL** pp_ssl)
+{
     MTX_GRD_LOCK_SC(&mtx_thread_array, p_mtx_thread_array);
 
     if(!p_mtx_thread_array)
@@ -162,17 +267,14 @@ static int SocketThreadDataClean(const int client_socket)
         return SERVER_SOCKET_MTX_LOCK_FAILURE;
     }
 
-    for(int thread_idx = 0; thread_idx < server_instances_num; thread_idx++)
-    {
-        if(server_instances_data[thread_idx].thread_args.client_socket == client_socket)
-        {
-            ServerSocketFreeSSL(server_instances_data[thread_idx].p_ssl);
-            server_instances_data[thread_idx] = (SERVER_SOCKET_THREAD_DATA){0};
-            return SERVER_SOCKET_MANAGE_THREADS_SUCCESS;
-        }
-    }
+    if(!server_instances_data[thread_idx].active)
+        return SERVER_SOCKET_DATA_CLEAN_FAILURE;
 
-    return SERVER_SOCKET_DATA_CLEAN_FAILURE;
+    *pp_ssl = server_instances_data[thread_idx].p_ssl;
+    server_instances_data[thread_idx] = (SERVER_SOCKET_THREAD_DATA){0};
+    __atomic_sub_fetch(&server_instances_active, 1, __ATOMIC_RELAXED);
+
+    return SERVER_SOCKET_MANAGE_THREADS_SUCCESS;
 }
 
 /// @brief Common thread routine to be executed by every instantiated thread.
@@ -182,7 +284,11 @@ static void* ServerSocketThreadRoutine(void* args)
 {
     SERVER_SOCKET_THREAD_ARGS* conn_handle_args = (SERVER_SOCKET_THREAD_ARGS*)args;
     
+    int thread_idx      = conn_handle_args->thread_idx;
     int client_socket   = conn_handle_args->client_socket;
+    int priority_class  = conn_handle_args->priority_class;
+    unsigned long accept_ns = conn_handle_args->accept_ns;
+    SOCKET_STACK* p_stack = conn_handle_args->p_stack;
     bool secure         = conn_handle_args->thread_common_args->secure;
     bool non_blocking   = conn_handle_args->thread_common_args->non_blocking;
     
@@ -196,6 +302,14 @@ static void* ServerSocketThreadRoutine(void* args)
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
 
+    SocketStatsRecord(SERVER_SOCKET_HIST_ACCEPT_TO_DISPATCH, SocketStatsNowNs() - accept_ns);
+
+    SocketTimerArm(conn_handle_args->p_timer, client_socket, secure ? SOCKET_TIMER_STAGE_HANDSHAKE : SOCKET_TIMER_STAGE_REQUEST);
+    SocketBroadcastAttach(client_socket, secure);
+    SocketBufTuneAttach(client_socket);
+    SocketLowatAttach(client_socket);
+    SocketPriorityAttach(client_socket, priority_class);
+
     while(keep_routine_alive)
     {
         switch(conn_handle_fsm)
@@ -219,7 +333,15 @@ static void* ServerSocketThreadRoutine(void* args)
             // Interact with client
             case INTERACT:
             {
-                if(interact_fn(client_socket) > 0)
+                // Scoped connections serve every request within a single call, so they are over once it returns.
+                if(connection_scope_fn)
+                {
+                    SERVER_SOCKET_SERVE_ARGS serve_args = {.client_socket = client_socket, .interact_fn = interact_fn};
+
+                    connection_scope_fn(client_socket, SocketServeRequests, &serve_args);
+                    conn_handle_fsm = CLOSE_CLIENT;
+                }
+                else if(SocketStateInteract(client_socket, interact_fn) > 0)
                     conn_handle_fsm = INTERACT;
                 else
                     conn_handle_fsm = CLOSE_CLIENT;
@@ -229,8 +351,24 @@ static void* ServerSocketThreadRoutine(void* args)
             // Close client socket instance if required
             case CLOSE_CLIENT:
             {
-                SocketThreadDataClean(client_socket);
-                SocketStateClose(client_socket);
+                // Timer goes first: slot data is about to be wiped, and the socket must not be closed while queued.
+                SocketTimerCancel();
+                SocketBroadcastDetach();
+
+                // Zero-copy receive windows hold a reference to the socket, which would otherwise outlive its descriptor.
+                SocketZeroCopyRelease();
+
+                SSL* p_ssl = NULL;
+                SocketThreadDataClean(thread_idx, &p_ssl);
+                SocketStateClose(client_socket, p_ssl, accept_ns);
+                SocketFramingRelease();
+                SocketBatchRelease();
+                SocketBusyPollRelease();
+                SocketCompressRelease();
+                SocketShmRelease();
+                SocketBufTuneRelease();
+                SocketLowatRelease();
+                SocketPriorityRelease();
 
                 keep_routine_alive = false;
             }
@@ -238,7 +376,12 @@ static void* ServerSocketThreadRoutine(void* args)
         }
     }
 
-    pthread_detach(pthread_self());
+    // Cached stacks are reused once their thread has been joined, so their threads are not detached.
+    if(p_stack)
+        SocketStackRetire(p_stack);
+    else
+        pthread_detach(pthread_self());
+
     pthread_exit(NULL);
 }
 
@@ -311,6 +454,53 @@ static int SocketKillAllThreads(void)
     return SERVER_SOCKET_MANAGE_THREADS_SUCCESS;
 }
 
+/// @brief Waits for every server instance to finish on its own.
+/// @param timeout_ms Maximum time to wait for.
+static void SocketWaitActiveThreads(const unsigned long timeout_ms)
+{
+    for(unsigned long waited_us = 0; SocketGetActiveServerInstancesNum() > 0 && waited_us < timeout_ms * 1000; waited_us += SERVER_SOCKET_DRAIN_POLL_US)
+        usleep(SERVER_SOCKET_DRAIN_POLL_US);
+}
+
+/// @brief Shuts every active client connection down, so serving threads wake up and close it themselves.
+/// @return Amount of connections shut down, < 0 if any error happened.
+static int SocketShutdownAllClients(void)
+{
+    int shutdown_num = 0;
+
+    MTX_GRD_LOCK_SC(&mtx_thread_array, p_mtx_thread_array);
+
+    if(!p_mtx_thread_array)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_ERR_MTX_LOCK, pthread_self());
+        return SERVER_SOCKET_MTX_LOCK_FAILURE;
+    }
+
+    for(int thread_idx = 0; thread_idx < server_instances_num; thread_idx++)
+        if(server_instances_data[thread_idx].active)
+        {
+            shutdown(server_instances_data[thread_idx].thread_args.client_socket, SHUT_RDWR);
+            shutdown_num++;
+        }
+
+    return shutdown_num;
+}
+
+/// @brief Sets a function wrapping every connection's requests. To be called before ServerSocketRun.
+/// @param scope_fn Connection scope function, NULL to serve requests straight away (default).
+void ServerSocketSetConnectionScope(const SERVER_SOCKET_SCOPE_FN scope_fn)
+{
+    connection_scope_fn = scope_fn;
+}
+
+/// @brief Logs an error which made a connection's handler give up.
+/// @param client_socket Client socket.
+/// @param reason What went wrong.
+void ServerSocketReportHandlerError(const int client_socket, const char* reason)
+{
+    SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_HANDLER_ERROR, client_socket, reason ? reason : "");
+}
+
 /// @brief Performs thread managing submodule's setup.
 /// @param max_conn_num Maximum number of handleable connections.
 /// @param secure Tells whether the socket is secure or nor (TLS/SSL).
@@ -339,10 +529,14 @@ int SocketSetupThreads(const int max_conn_num, const bool secure, const bool non
     return SERVER_SOCKET_MANAGE_THREADS_SUCCESS;
 }
 
-/// @brief Launches server socket instance.
+/// @brief Takes a free spot and launches a server instance on it.
 /// @param client_socket Target client-oriented server socket instance.
+/// @param priority_class Class the connection was admitted into, SOCKET_PRIORITY_NO_CLASS if there is none.
+/// @param accept_ns Time at which the connection was accepted.
+/// @param p_thread_attr Thread attributes, NULL for default ones.
+/// @param p_stack Cached stack set in thread attributes, NULL if there is none.
 /// @return 0 if succeeded, < 0 otherwise.
-int SocketLaunchServerInstance(const int client_socket)
+static int SocketSpawnServerInstance(const int client_socket, const int priority_class, const unsigned long accept_ns, const pthread_attr_t* p_thread_attr, SOCKET_STACK* p_stack)
 {
     MTX_GRD_LOCK_SC(&mtx_thread_array, p_mtx_thread_array);
 
@@ -359,29 +553,64 @@ int SocketLaunchServerInstance(const int client_socket)
         {
             server_instances_data[thread_idx].active = true;
 
+            server_instances_data[thread_idx].thread_args.thread_idx = thread_idx;
             server_instances_data[thread_idx].thread_args.client_socket = client_socket;
+            server_instances_data[thread_idx].thread_args.priority_class = priority_class;
+            server_instances_data[thread_idx].thread_args.accept_ns = accept_ns;
+            server_instances_data[thread_idx].thread_args.p_timer = &server_instances_data[thread_idx].timer;
+            server_instances_data[thread_idx].thread_args.p_stack = p_stack;
             server_instances_data[thread_idx].thread_args.thread_common_args = server_instances_common_args;
 
             int thread_creation_status = pthread_create(&server_instances_data[thread_idx].thread       ,
-                                                        NULL                                            ,
+                                                        p_thread_attr                                   ,
                                                         ServerSocketThreadRoutine                       ,
                                                         &server_instances_data[thread_idx].thread_args  );
 
-            if(thread_creation_status < 0)
+            // pthread_create returns a positive error number, and the spot must be given back then.
+            if(thread_creation_status != 0)
             {
-                SVRTY_LOG_WNG(SERVER_SOCKET_MSG_ERR_CREATE_THREAD, strerror(thread_creation_status));
+                server_instances_data[thread_idx] = (SERVER_SOCKET_THREAD_DATA){0};
+                SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_ERR_CREATE_THREAD, strerror(thread_creation_status));
                 return SERVER_SOCKET_MANAGE_THREAD_CREATION_FAILURE;
             }
             
-            SVRTY_LOG_INF(SERVER_SOCKET_MSG_THREAD_CREATION_SUCCESS, client_socket, server_instances_data[thread_idx].thread);
+            __atomic_add_fetch(&server_instances_active, 1, __ATOMIC_RELAXED);
+
+            SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_THREAD_CREATION_SUCCESS, client_socket, server_instances_data[thread_idx].thread);
             return SERVER_SOCKET_MANAGE_THREADS_SUCCESS;
         }
     }
     
-    SVRTY_LOG_WNG(SERVER_SOCKET_MSG_ERR_NO_FREE_SPOTS, server_instances_num);
+    SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_ERR_NO_FREE_SPOTS, server_instances_num);
     return SERVER_SOCKET_MANAGE_THREAD_NO_FREE_SPOTS;
 }
 
+/// @brief Launches server socket instance.
+/// @param client_socket Target client-oriented server socket instance.
+/// @param priority_class Class the connection was admitted into, SOCKET_PRIORITY_NO_CLASS if there is none.
+/// @param accept_ns Time at which the connection was accepted.
+/// @return 0 if succeeded, < 0 otherwise.
+int SocketLaunchServerInstance(const int client_socket, const int priority_class, const unsigned long accept_ns)
+{
+    // Thread placement only depends on the connection, so it is worked out before locking.
+    pthread_attr_t thread_attr;
+    pthread_attr_init(&thread_attr);
+
+    SOCKET_STACK* p_stack = NULL;
+
+    bool affinity_attr_set  = (SocketAffinityWorkerAttr(client_socket, &thread_attr) > 0);
+    bool stacks_attr_set    = (SocketStacksThreadAttr(&thread_attr, &p_stack) > 0);
+
+    int spawn_server_instance = SocketSpawnServerInstance(client_socket, priority_class, accept_ns, (affinity_attr_set || stacks_attr_set) ? &thread_attr : NULL, p_stack);
+
+    if(spawn_server_instance < 0 && p_stack)
+        SocketStackRelease(p_stack);
+
+    pthread_attr_destroy(&thread_attr);
+
+    return spawn_server_instance;
+}
+
 /// @brief Retrieves current thread's SSL object (if any) based on thread's ID.
 /// @return SSL object belonging to current thread (if any).
 SSL** SocketGetCurrentThreadSSLObj(void)
@@ -396,10 +625,44 @@ SSL** SocketGetCurrentThreadSSLObj(void)
     return NULL;
 }
 
+/// @brief Retrieves the amount of server instances currently serving a client.
+/// @return Active server instances number.
+int SocketGetActiveServerInstancesNum(void)
+{
+    return __atomic_load_n(&server_instances_active, __ATOMIC_RELAXED);
+}
+
+/// @brief Lets active connections end on their own (no more connections are expected to be accepted).
+/// Connections still open once the timeout expires are shut down, so their threads close them instead of being cancelled.
+/// @param timeout_ms Maximum time for connections to end on their own.
+/// @return Amount of connections which were still open after being shut down.
+int SocketDrainThreads(const unsigned long timeout_ms)
+{
+    if(server_instances_data == NULL)
+        return 0;
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_DRAINING, SocketGetActiveServerInstancesNum(), timeout_ms);
+
+    SocketWaitActiveThreads(timeout_ms);
+
+    if(SocketGetActiveServerInstancesNum() > 0)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_DRAIN_SHUTDOWN, SocketGetActiveServerInstancesNum());
+        SocketShutdownAllClients();
+        SocketWaitActiveThreads(SERVER_SOCKET_DRAIN_SHUTDOWN_GRACE_MS);
+    }
+
+    return SocketGetActiveServerInstancesNum();
+}
+
 /// @brief Frees resources priorly allocated by threads managing submodule.
 /// @return 0 if succeeded, < 0 otherwise.
 int SocketFreeThreadsResources(void)
 {
+    // Threads are let close their connections first: one cancelled while waiting for the thread array would never be joined.
+    if(server_instances_data != NULL && SocketShutdownAllClients() > 0)
+        SocketWaitActiveThreads(SERVER_SOCKET_DRAIN_SHUTDOWN_GRACE_MS);
+
     int kill_threads = SocketKillAllThreads();
     SocketFreeThreadsData();
     MTX_GRD_DESTROY(&mtx_thread_array);
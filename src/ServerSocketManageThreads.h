@@ -15,9 +15,11 @@
 /************************************/
 
 int SocketSetupThreads(int max_conn_num, bool secure, bool non_blocking, int (*interact_fn)(int client_socket));
-int SocketLaunchServerInstance(int client_socket);
+int SocketLaunchServerInstance(int client_socket, int priority_class, unsigned long accept_ns);
 int SocketFreeThreadsResources(void);
 SSL** SocketGetCurrentThreadSSLObj(void);
+int SocketGetActiveServerInstancesNum(void);
+int SocketDrainThreads(unsigned long timeout_ms);
 
 /************************************/
 
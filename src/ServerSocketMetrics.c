@@ -0,0 +1,494 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>               // Wait for scraper's request.
+#include <stdarg.h>
+#include <stdio.h>              // vsnprintf.
+#include <string.h>
+#include <time.h>               // Request deadline.
+#include <unistd.h>
+#include <arpa/inet.h>          // inet_pton.
+#include <sys/socket.h>
+#include "ServerSocketMetrics.h"
+#include "ServerSocketUse.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_METRICS_SUCCESS           0
+#define SERVER_SOCKET_METRICS_ERR_SOCKET        -1
+#define SERVER_SOCKET_METRICS_ERR_BIND          -2
+#define SERVER_SOCKET_METRICS_ERR_LISTEN        -3
+#define SERVER_SOCKET_METRICS_ERR_THREAD        -4
+#define SERVER_SOCKET_METRICS_ERR_WRITE         -5
+#define SERVER_SOCKET_METRICS_ERR_ADDRESS       -6
+
+#define SERVER_SOCKET_METRICS_DISABLED          0
+#define SERVER_SOCKET_METRICS_BACKLOG           16
+#define SERVER_SOCKET_METRICS_REQUEST_TIMEOUT_MS 5000    // Whole request, from accept to last byte sent.
+#define SERVER_SOCKET_METRICS_BACKOFF_MIN_MS    10
+#define SERVER_SOCKET_METRICS_BACKOFF_MAX_MS    1000
+#define SERVER_SOCKET_METRICS_LEN_RX_BUFFER     1024
+#define SERVER_SOCKET_METRICS_LEN_TX_BUFFER     4096
+#define SERVER_SOCKET_METRICS_NS_PER_SEC        1e9
+#define SERVER_SOCKET_METRICS_NS_PER_MS         1000000L
+#define SERVER_SOCKET_METRICS_US_PER_SEC        1e6
+
+#define SERVER_SOCKET_METRICS_REQUEST_GET       "GET "
+#define SERVER_SOCKET_METRICS_RESPONSE_OK       "HTTP/1.1 200 OK\r\n"                               \
+                                                "Content-Type: text/plain; version=0.0.4\r\n"       \
+                                                "Connection: close\r\n\r\n"
+#define SERVER_SOCKET_METRICS_RESPONSE_NOK      "HTTP/1.1 405 Method Not Allowed\r\n"               \
+                                                "Allow: GET\r\n"                                    \
+                                                "Content-Length: 0\r\n"                             \
+                                                "Connection: close\r\n\r\n"
+
+#define SERVER_SOCKET_MSG_METRICS_SOCKET_NOK    "Could not create metrics socket."
+#define SERVER_SOCKET_MSG_METRICS_BIND_NOK      "Could not bind metrics socket to <%s:%d>."
+#define SERVER_SOCKET_MSG_METRICS_LISTEN_NOK    "Metrics socket listen failed."
+#define SERVER_SOCKET_MSG_METRICS_THREAD_NOK    "Could not create metrics thread: <%s>."
+#define SERVER_SOCKET_MSG_METRICS_OK            "Serving metrics on <%s:%d>."
+#define SERVER_SOCKET_MSG_METRICS_CLEANUP       "Cleaning up metrics listener."
+#define SERVER_SOCKET_MSG_METRICS_ACCEPT_NOK    "Metrics socket accept failed: <%s>, backing off for <%d> ms."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Response writer. Text is rendered into a fixed buffer which is flushed to the scraper whenever it gets full.
+typedef struct
+{
+    int     client_socket;
+    int     status;
+    long    deadline_ns;        // Whole request (reading included) must be over by then, monotonic clock.
+    size_t  tx_buffer_len;
+    char    tx_buffer[SERVER_SOCKET_METRICS_LEN_TX_BUFFER];
+} SERVER_SOCKET_METRICS_WRITER;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static int          metrics_port            = SERVER_SOCKET_METRICS_DISABLED;
+static in_addr_t    metrics_address         = INADDR_LOOPBACK;  // Host byte order.
+static int          metrics_socket          = -1;
+static pthread_t    metrics_thread;
+static bool         metrics_thread_running  = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static long SocketMetricsNowNs(void);
+static bool SocketMetricsWait(const int client_socket, const short events, const long deadline_ns);
+static void SocketMetricsFlush(SERVER_SOCKET_METRICS_WRITER* p_writer);
+static void SocketMetricsPrintf(SERVER_SOCKET_METRICS_WRITER* p_writer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static void SocketMetricsRenderCounter(SERVER_SOCKET_METRICS_WRITER* p_writer, const char* name, const char* type, const char* help, const unsigned long value);
+static void SocketMetricsRenderSummary(SERVER_SOCKET_METRICS_WRITER* p_writer, const char* name, const char* help, const SERVER_SOCKET_HIST_STATS* p_hist_stats, const double scale);
+static void SocketMetricsRender(SERVER_SOCKET_METRICS_WRITER* p_writer);
+static void SocketMetricsServeScraper(const int client_socket);
+static void SocketMetricsCloseScraper(void* p_client_socket);
+static int SocketMetricsAccept(int* p_backoff_ms);
+static void* SocketMetricsThreadRoutine(void* args);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Gets monotonic time.
+/// @return Current monotonic time, in ns.
+static long SocketMetricsNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long)now.tv_sec * (long)SERVER_SOCKET_METRICS_NS_PER_SEC + now.tv_nsec;
+}
+
+/// @brief Waits for the scraper socket to get ready, no later than the request deadline.
+/// @param client_socket Scraper socket.
+/// @param events Events to wait for (POLLIN or POLLOUT).
+/// @param deadline_ns Request deadline, monotonic clock.
+/// @return True if the socket got ready in time, false otherwise.
+static bool SocketMetricsWait(const int client_socket, const short events, const long deadline_ns)
+{
+    struct pollfd scraper_poll_fd =
+    {
+        .fd     = client_socket,
+        .events = events,
+    };
+
+    while(true)
+    {
+        long remaining_ns = deadline_ns - SocketMetricsNowNs();
+
+        if(remaining_ns <= 0)
+            return false;
+
+        // Round up, so the last fraction of a ms is not spun on.
+        int poll_status = poll(&scraper_poll_fd, 1, (int)((remaining_ns + SERVER_SOCKET_METRICS_NS_PER_MS - 1) / SERVER_SOCKET_METRICS_NS_PER_MS));
+
+        if(poll_status > 0)
+            return true;
+
+        if(poll_status < 0 && errno != EINTR)
+            return false;
+    }
+}
+
+/// @brief Sends whatever has been rendered so far to the scraper. Sends do not block, so a scraper which stops reading
+/// cannot keep the metrics thread past the request deadline.
+/// @param p_writer Response writer.
+static void SocketMetricsFlush(SERVER_SOCKET_METRICS_WRITER* p_writer)
+{
+    size_t written = 0;
+
+    while(p_writer->status == SERVER_SOCKET_METRICS_SUCCESS && written < p_writer->tx_buffer_len)
+    {
+        ssize_t write_to_socket = send(p_writer->client_socket, p_writer->tx_buffer + written, p_writer->tx_buffer_len - written, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if(write_to_socket < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            if(!SocketMetricsWait(p_writer->client_socket, POLLOUT, p_writer->deadline_ns))
+                p_writer->status = SERVER_SOCKET_METRICS_ERR_WRITE;
+        }
+        else if(write_to_socket <= 0)
+            p_writer->status = SERVER_SOCKET_METRICS_ERR_WRITE;
+        else
+            written += write_to_socket;
+    }
+
+    p_writer->tx_buffer_len = 0;
+}
+
+/// @brief Renders formatted text into the response, flushing the buffer first if the text does not fit.
+/// @param p_writer Response writer.
+/// @param format Format string.
+static void SocketMetricsPrintf(SERVER_SOCKET_METRICS_WRITER* p_writer, const char* format, ...)
+{
+    for(int attempt = 0; attempt < 2 && p_writer->status == SERVER_SOCKET_METRICS_SUCCESS; attempt++)
+    {
+        size_t free_space = sizeof(p_writer->tx_buffer) - p_writer->tx_buffer_len;
+
+        va_list args;
+        va_start(args, format);
+        int printed = vsnprintf(p_writer->tx_buffer + p_writer->tx_buffer_len, free_space, format, args);
+        va_end(args);
+
+        if(printed >= 0 && (size_t)printed < free_space)
+        {
+            p_writer->tx_buffer_len += printed;
+            return;
+        }
+
+        SocketMetricsFlush(p_writer);
+    }
+}
+
+/// @brief Renders a single-valued metric (counter or gauge).
+/// @param p_writer Response writer.
+/// @param name Metric name.
+/// @param type Metric type.
+/// @param help Metric description.
+/// @param value Metric value.
+static void SocketMetricsRenderCounter(SERVER_SOCKET_METRICS_WRITER* p_writer, const char* name, const char* type, const char* help, const unsigned long value)
+{
+    SocketMetricsPrintf(p_writer, "# HELP %s %s\n# TYPE %s %s\n%s %lu\n", name, help, name, type, name, value);
+}
+
+/// @brief Renders a histogram as a summary.
+/// @param p_writer Response writer.
+/// @param name Metric name.
+/// @param help Metric description.
+/// @param p_hist_stats Histogram summary.
+/// @param scale Divisor to convert recorded values into the metric's unit.
+static void SocketMetricsRenderSummary(SERVER_SOCKET_METRICS_WRITER* p_writer, const char* name, const char* help, const SERVER_SOCKET_HIST_STATS* p_hist_stats, const double scale)
+{
+    SocketMetricsPrintf(p_writer, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+    SocketMetricsPrintf(p_writer, "%s{quantile=\"0.5\"} %.9g\n"  , name, p_hist_stats->p50  / scale);
+    SocketMetricsPrintf(p_writer, "%s{quantile=\"0.9\"} %.9g\n"  , name, p_hist_stats->p90  / scale);
+    SocketMetricsPrintf(p_writer, "%s{quantile=\"0.99\"} %.9g\n" , name, p_hist_stats->p99  / scale);
+    SocketMetricsPrintf(p_writer, "%s{quantile=\"0.999\"} %.9g\n", name, p_hist_stats->p999 / scale);
+    SocketMetricsPrintf(p_writer, "%s_sum %.9g\n%s_count %lu\n", name, p_hist_stats->sum / scale, name, p_hist_stats->count);
+}
+
+/// @brief Renders every metric in Prometheus text format.
+/// @param p_writer Response writer.
+static void SocketMetricsRender(SERVER_SOCKET_METRICS_WRITER* p_writer)
+{
+    SERVER_SOCKET_STATS stats;
+    ServerSocketGetStats(&stats);
+
+    SocketMetricsRenderCounter(p_writer, "server_socket_active_connections"        , "gauge"  , "Server instances currently serving a client."           , stats.active_connections          );
+    SocketMetricsRenderCounter(p_writer, "server_socket_accepts_total"             , "counter", "Accepted connections."                                  , stats.accepts                     );
+    SocketMetricsRenderCounter(p_writer, "server_socket_refusals_total"            , "counter", "Connections refused due to lack of free instances."     , stats.refusals                    );
+    SocketMetricsRenderCounter(p_writer, "server_socket_accept_errors_total"       , "counter", "Failed accept calls."                                   , stats.accept_errors               );
+    SocketMetricsRenderCounter(p_writer, "server_socket_handshake_failures_total"  , "counter", "Failed TLS handshakes."                                 , stats.handshake_failures          );
+    SocketMetricsRenderCounter(p_writer, "server_socket_io_errors_total"           , "counter", "Failed reads and writes."                               , stats.io_errors                   );
+    SocketMetricsRenderCounter(p_writer, "server_socket_bytes_in_total"            , "counter", "Bytes read from clients."                               , stats.bytes_in                    );
+    SocketMetricsRenderCounter(p_writer, "server_socket_bytes_out_total"           , "counter", "Bytes written to clients."                              , stats.bytes_out                   );
+    SocketMetricsRenderCounter(p_writer, "server_socket_timeouts_total"            , "counter", "Connections shut down due to an expired deadline."      , stats.timeouts                    );
+    SocketMetricsRenderCounter(p_writer, "server_socket_payload_bytes_in_total"    , "counter", "Bytes handed to compressed connections' handlers."     , stats.payload_bytes_in            );
+    SocketMetricsRenderCounter(p_writer, "server_socket_payload_bytes_out_total"   , "counter", "Bytes written by compressed connections' handlers."    , stats.payload_bytes_out           );
+    SocketMetricsRenderCounter(p_writer, "server_socket_cache_hits_total"          , "counter", "Requests answered from the response cache."             , stats.cache_hits                  );
+    SocketMetricsRenderCounter(p_writer, "server_socket_cache_misses_total"        , "counter", "Response cache lookups which found nothing."            , stats.cache_misses                );
+    SocketMetricsRenderCounter(p_writer, "server_socket_cache_evictions_total"     , "counter", "Responses evicted from the cache (expired ones included).", stats.cache_evictions           );
+    SocketMetricsRenderCounter(p_writer, "server_socket_cache_bytes"               , "gauge"  , "Memory taken by cached responses."                      , stats.cache_bytes                 );
+    SocketMetricsRenderCounter(p_writer, "server_socket_shm_upgrades_total"        , "counter", "Connections upgraded to shared-memory rings."           , stats.shm_upgrades                );
+    SocketMetricsRenderCounter(p_writer, "server_socket_broadcast_drops_total"     , "counter", "Broadcasts dropped by connections with full queues."    , stats.broadcast_drops             );
+    SocketMetricsRenderCounter(p_writer, "server_socket_buffer_resizes_total"      , "counter", "Socket buffers resized after their connection's BDP."   , stats.buffer_resizes              );
+    SocketMetricsRenderCounter(p_writer, "server_socket_lowat_waits_total"         , "counter", "Writes waiting for unsent data to drain (low-water)."   , stats.lowat_waits                 );
+    SocketMetricsRenderCounter(p_writer, "server_socket_tls_shutdown_timeouts_total", "counter", "Client close_notify waits which hit their deadline."    , stats.tls_shutdown_timeouts       );
+    SocketMetricsRenderCounter(p_writer, "server_socket_class_refusals_total"      , "counter", "Connections refused because their class was full."      , stats.class_refusals              );
+    SocketMetricsRenderCounter(p_writer, "server_socket_zerocopy_bytes_in_total"   , "counter", "Bytes received into mapped pages instead of copied."    , stats.zerocopy_bytes_in           );
+    SocketMetricsRenderCounter(p_writer, "server_socket_tls_connections"           , "gauge"  , "Connections currently owning an SSL object."            , stats.mem_stats.tls_connections   );
+    SocketMetricsRenderCounter(p_writer, "server_socket_tls_heap_bytes"            , "gauge"  , "OpenSSL heap bytes held by TLS connections."            , stats.mem_stats.tls_heap_bytes    );
+
+    SocketMetricsRenderSummary(p_writer, "server_socket_accept_to_dispatch_seconds", "Time from accept to server instance start."   , &stats.accept_to_dispatch_ns  , SERVER_SOCKET_METRICS_NS_PER_SEC);
+    SocketMetricsRenderSummary(p_writer, "server_socket_handshake_seconds"         , "TLS handshake duration."                      , &stats.handshake_ns           , SERVER_SOCKET_METRICS_NS_PER_SEC);
+    SocketMetricsRenderSummary(p_writer, "server_socket_interact_seconds"          , "Interaction function call duration."          , &stats.interact_ns            , SERVER_SOCKET_METRICS_NS_PER_SEC);
+    SocketMetricsRenderSummary(p_writer, "server_socket_connection_lifetime_seconds", "Time from accept to connection close."       , &stats.lifetime_ns            , SERVER_SOCKET_METRICS_NS_PER_SEC);
+    SocketMetricsRenderSummary(p_writer, "server_socket_read_bytes"                , "Bytes per successful read."                   , &stats.read_bytes             , 1.0);
+    SocketMetricsRenderSummary(p_writer, "server_socket_write_bytes"               , "Bytes per successful write."                  , &stats.write_bytes            , 1.0);
+    SocketMetricsRenderSummary(p_writer, "server_socket_rtt_seconds"               , "Smoothed RTT per buffer tuning sample."       , &stats.rtt_us                 , SERVER_SOCKET_METRICS_US_PER_SEC);
+    SocketMetricsRenderSummary(p_writer, "server_socket_bdp_bytes"                 , "BDP per buffer tuning sample."                , &stats.bdp_bytes              , 1.0);
+    SocketMetricsRenderSummary(p_writer, "server_socket_teardown_seconds"          , "From reaper hand-over to descriptor closed."  , &stats.teardown_ns            , SERVER_SOCKET_METRICS_NS_PER_SEC);
+    SocketMetricsRenderSummary(p_writer, "server_socket_schedule_wait_seconds"     , "From request ready to run slot taken."        , &stats.schedule_wait_ns       , SERVER_SOCKET_METRICS_NS_PER_SEC);
+}
+
+/// @brief Reads scraper's request, then replies to it. The whole exchange shares a single deadline, however slowly the
+/// scraper trickles its request in or drains the reply.
+/// @param client_socket Scraper socket.
+static void SocketMetricsServeScraper(const int client_socket)
+{
+    char rx_buffer[SERVER_SOCKET_METRICS_LEN_RX_BUFFER] = {0};
+    size_t rx_buffer_len = 0;
+
+    SERVER_SOCKET_METRICS_WRITER writer =
+    {
+        .client_socket  = client_socket,
+        .status         = SERVER_SOCKET_METRICS_SUCCESS,
+        .deadline_ns    = SocketMetricsNowNs() + SERVER_SOCKET_METRICS_REQUEST_TIMEOUT_MS * SERVER_SOCKET_METRICS_NS_PER_MS,
+        .tx_buffer_len  = 0,
+    };
+
+    // Read until the end of request headers is found, giving up on slow or oversized requests.
+    while(rx_buffer_len < sizeof(rx_buffer) - 1 && !strstr(rx_buffer, "\r\n\r\n"))
+    {
+        if(!SocketMetricsWait(client_socket, POLLIN, writer.deadline_ns))
+            return;
+
+        ssize_t read_from_socket = recv(client_socket, rx_buffer + rx_buffer_len, sizeof(rx_buffer) - 1 - rx_buffer_len, MSG_DONTWAIT);
+
+        if(read_from_socket < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            continue;
+
+        if(read_from_socket <= 0)
+            return;
+
+        rx_buffer_len += read_from_socket;
+    }
+
+    if(strncmp(rx_buffer, SERVER_SOCKET_METRICS_REQUEST_GET, strlen(SERVER_SOCKET_METRICS_REQUEST_GET)) != 0)
+    {
+        SocketMetricsPrintf(&writer, "%s", SERVER_SOCKET_METRICS_RESPONSE_NOK);
+        SocketMetricsFlush(&writer);
+        return;
+    }
+
+    SocketMetricsPrintf(&writer, "%s", SERVER_SOCKET_METRICS_RESPONSE_OK);
+    SocketMetricsRender(&writer);
+    SocketMetricsFlush(&writer);
+}
+
+/// @brief Closes scraper socket. Thread cleanup handler as well, so scrapers are not leaked if the thread gets cancelled
+/// while replying.
+/// @param p_client_socket Pointer to scraper socket.
+static void SocketMetricsCloseScraper(void* p_client_socket)
+{
+    int client_socket = *(int*)p_client_socket;
+
+    shutdown(client_socket, SHUT_RDWR);
+    CloseSocket(client_socket);
+}
+
+/// @brief Waits for a scraper to connect, then accepts it. Errors other than interrupted or aborted connections (e.g. running
+/// out of descriptors) would fail again right away, so they are backed off from instead, doubling the delay each time.
+/// @param p_backoff_ms Current back-off delay, reset once a scraper is accepted.
+/// @return Scraper socket, < 0 if none could be accepted.
+static int SocketMetricsAccept(int* p_backoff_ms)
+{
+    struct pollfd metrics_poll_fd =
+    {
+        .fd     = metrics_socket,
+        .events = POLLIN,
+    };
+
+    if(poll(&metrics_poll_fd, 1, -1) <= 0)
+        return -1;
+
+    int client_socket = accept(metrics_socket, NULL, NULL);
+
+    if(client_socket >= 0)
+    {
+        *p_backoff_ms = SERVER_SOCKET_METRICS_BACKOFF_MIN_MS;
+        return client_socket;
+    }
+
+    if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+        return -1;
+
+    SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_METRICS_ACCEPT_NOK, strerror(errno), *p_backoff_ms);
+
+    // Cancellation point, same as the poll above.
+    poll(NULL, 0, *p_backoff_ms);
+
+    if(*p_backoff_ms < SERVER_SOCKET_METRICS_BACKOFF_MAX_MS)
+        *p_backoff_ms *= 2;
+
+    return -1;
+}
+
+/// @brief Metrics listener thread routine. Serves scrapers one at a time, away from client serving threads.
+/// @param args Unused.
+/// @return NULL always.
+static void* SocketMetricsThreadRoutine(void* args)
+{
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+
+    int backoff_ms = SERVER_SOCKET_METRICS_BACKOFF_MIN_MS;
+
+    while(true)
+    {
+        int client_socket = SocketMetricsAccept(&backoff_ms);
+
+        if(client_socket < 0)
+            continue;
+
+        pthread_cleanup_push(SocketMetricsCloseScraper, &client_socket);
+
+        SocketMetricsServeScraper(client_socket);
+
+        pthread_cleanup_pop(1);
+    }
+
+    return NULL;
+}
+
+/// @brief Sets the port metrics are meant to be served on. To be called before ServerSocketRun.
+/// @param port Metrics port, 0 to disable metrics listener.
+void ServerSocketSetMetricsPort(const int port)
+{
+    metrics_port = port;
+}
+
+/// @brief Sets the address the metrics listener binds to. To be called before ServerSocketRun.
+/// @param address IPv4 address in dotted notation, "0.0.0.0" to accept scrapers from anywhere. Loopback by default.
+/// @return 0 if succeeded, < 0 if the address could not be parsed.
+int ServerSocketSetMetricsAddress(const char* address)
+{
+    struct in_addr parsed_address;
+
+    if(!address || inet_pton(AF_INET, address, &parsed_address) != 1)
+        return SERVER_SOCKET_METRICS_ERR_ADDRESS;
+
+    metrics_address = ntohl(parsed_address.s_addr);
+
+    return SERVER_SOCKET_METRICS_SUCCESS;
+}
+
+/// @brief Tells whether the metrics listener has been requested or not.
+/// @return True if a metrics port has been set, false otherwise.
+bool SocketMetricsEnabled(void)
+{
+    return (metrics_port != SERVER_SOCKET_METRICS_DISABLED);
+}
+
+/// @brief Creates metrics listening socket, then launches metrics thread.
+/// @param reuse_address Reuse address, does not hold the address after socket is closed.
+/// @param reuse_port Reuse port, does not hold the port after socket is closed.
+/// @return 0 if succeeded, < 0 otherwise.
+int SocketLaunchMetrics(const bool reuse_address, const bool reuse_port)
+{
+    metrics_socket = CreateSocketDescriptor(AF_INET, SOCK_STREAM, IPPROTO_IP);
+
+    if(metrics_socket < 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_METRICS_SOCKET_NOK);
+        return SERVER_SOCKET_METRICS_ERR_SOCKET;
+    }
+
+    SocketOptions(metrics_socket, reuse_address, reuse_port, 0, 0, 0, 0);
+
+    struct in_addr bind_address = { .s_addr = htonl(metrics_address) };
+    char bind_address_str[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &bind_address, bind_address_str, sizeof(bind_address_str));
+
+    if(BindSocket(metrics_socket, metrics_port, AF_INET, bind_address.s_addr) < 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_METRICS_BIND_NOK, bind_address_str, metrics_port);
+        SocketFreeMetricsResources();
+        return SERVER_SOCKET_METRICS_ERR_BIND;
+    }
+
+    if(SocketListen(metrics_socket, SERVER_SOCKET_METRICS_BACKLOG) < 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_METRICS_LISTEN_NOK);
+        SocketFreeMetricsResources();
+        return SERVER_SOCKET_METRICS_ERR_LISTEN;
+    }
+
+    int thread_creation_status = pthread_create(&metrics_thread, NULL, SocketMetricsThreadRoutine, NULL);
+
+    if(thread_creation_status != 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_METRICS_THREAD_NOK, strerror(thread_creation_status));
+        SocketFreeMetricsResources();
+        return SERVER_SOCKET_METRICS_ERR_THREAD;
+    }
+
+    metrics_thread_running = true;
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_METRICS_OK, bind_address_str, metrics_port);
+
+    return SERVER_SOCKET_METRICS_SUCCESS;
+}
+
+/// @brief Stops metrics thread, then closes metrics listening socket.
+void SocketFreeMetricsResources(void)
+{
+    if(metrics_thread_running)
+    {
+        SVRTY_LOG_DBG(SERVER_SOCKET_MSG_METRICS_CLEANUP);
+
+        pthread_cancel(metrics_thread);
+        pthread_join(metrics_thread, NULL);
+        metrics_thread_running = false;
+    }
+
+    if(metrics_socket >= 0)
+    {
+        CloseSocket(metrics_socket);
+        metrics_socket = -1;
+    }
+}
+
+/*************************************/
@@ -0,0 +1,22 @@
+#ifndef SERVER_SOCKET_METRICS_H
+#define SERVER_SOCKET_METRICS_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketMetricsEnabled(void);
+int SocketLaunchMetrics(bool reuse_address, bool reuse_port);
+void SocketFreeMetricsResources(void);
+
+/*************************************/
+
+#endif
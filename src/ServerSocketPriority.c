@@ -0,0 +1,509 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>          // inet_pton.
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "ServerSocketPriority.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketFraming.h"
+#include "ServerSocketBusyPoll.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_PRIORITY_SUCCESS          0
+#define SERVER_SOCKET_PRIORITY_ERR_CLASS        -1
+#define SERVER_SOCKET_PRIORITY_ERR_WEIGHT       -2
+#define SERVER_SOCKET_PRIORITY_ERR_ADDRESS      -3
+#define SERVER_SOCKET_PRIORITY_ERR_RULES_FULL   -4
+#define SERVER_SOCKET_PRIORITY_ERR_CLASS_FULL   -5
+#define SERVER_SOCKET_PRIORITY_ERR_NULL_PTR     -6
+
+#define SOCKET_PRIORITY_DEFAULT_CLASS           0
+#define SOCKET_PRIORITY_DEFAULT_WEIGHT          1
+#define SOCKET_PRIORITY_NO_LIMIT                0
+#define SOCKET_PRIORITY_MAX_RULES               64
+#define SOCKET_PRIORITY_MAX_PREFIX_LEN          32
+#define SOCKET_PRIORITY_LEN_ADDRESS             16      // Longest dotted IPv4 address, null character included.
+#define SOCKET_PRIORITY_STRIDE_SCALE            (1UL << 20)
+
+#define SERVER_SOCKET_MSG_PRIORITY_CLASS_FULL   "Class <%d> already holds <%d> connections, refusing connection."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Serving thread waiting for a run slot. Lives on the waiting thread's stack.
+typedef struct SOCKET_PRIORITY_WAITER
+{
+    struct SOCKET_PRIORITY_WAITER*  next;
+    pthread_cond_t                  cond;
+    int                             priority_class;
+    bool                            granted;        // Slot handed over by the thread which gave it back.
+} SOCKET_PRIORITY_WAITER;
+
+/// @brief Priority class.
+typedef struct
+{
+    unsigned int            weight;
+    int                     max_conn;       // SOCKET_PRIORITY_NO_LIMIT for no limit other than the server's.
+    int                     active_conn;    // Accessed atomically.
+    unsigned long           pass;           // Virtual time of its next run slot (stride scheduling). Guarded by priority_mtx.
+    SOCKET_PRIORITY_WAITER* p_head;         // Threads waiting for a run slot, oldest first. Guarded by priority_mtx.
+    SOCKET_PRIORITY_WAITER* p_tail;
+    unsigned long           refusals;       // Figures below are accessed atomically.
+    unsigned long           interactions;
+    unsigned long           waits;
+    unsigned long           wait_ns;
+    unsigned long           max_wait_ns;
+} SOCKET_PRIORITY_CLASS;
+
+/// @brief Peer address rule.
+typedef struct
+{
+    in_addr_t   network;    // Host byte order.
+    in_addr_t   mask;       // Host byte order.
+    int         priority_class;
+} SOCKET_PRIORITY_RULE;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static bool priority_enabled = false;
+
+static SOCKET_PRIORITY_CLASS priority_classes[SERVER_SOCKET_PRIORITY_CLASSES] =
+{
+    [0 ... SERVER_SOCKET_PRIORITY_CLASSES - 1] = { .weight = SOCKET_PRIORITY_DEFAULT_WEIGHT },
+};
+
+static SOCKET_PRIORITY_RULE priority_rules[SOCKET_PRIORITY_MAX_RULES];
+static int                  priority_rules_num      = 0;
+static int                  (*priority_classifier_fn)(int client_socket) = NULL;
+
+/// @brief Run slots (interactions running at once), 0 if interactions are not scheduled.
+static unsigned int         priority_run_slots      = 0;
+
+/// @brief Scheduler state, guarded by priority_mtx.
+static unsigned int         priority_running        = 0;
+static unsigned int         priority_waiting        = 0;
+static unsigned long        priority_vtime          = 0;    // Pass of the latest class a slot was handed to.
+static pthread_mutex_t      priority_mtx            = PTHREAD_MUTEX_INITIALIZER;
+
+/// @brief Class of the connection served by the current thread, its receive timeout and whether it holds a run slot.
+static __thread int         priority_thread_class   = SOCKET_PRIORITY_NO_CLASS;
+static __thread long        priority_rx_timeout_us;
+static __thread bool        priority_slot_held      = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int SocketPriorityClassify(int client_socket);
+static int SocketPriorityWaitRequest(int client_socket);
+static void SocketPriorityHandOver(void);
+static void SocketPriorityWaitCleanup(void* args);
+static void SocketPriorityAtomicMax(unsigned long* p_target, unsigned long value);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Works out the class of a connection: classifier's verdict first, then the first matching peer address rule.
+/// @param client_socket Client socket.
+/// @return Class, the default one (0) if nothing matched.
+static int SocketPriorityClassify(const int client_socket)
+{
+    if(priority_classifier_fn)
+    {
+        int classifier_class = priority_classifier_fn(client_socket);
+
+        if(classifier_class >= 0 && classifier_class < SERVER_SOCKET_PRIORITY_CLASSES)
+            return classifier_class;
+    }
+
+    if(priority_rules_num == 0)
+        return SOCKET_PRIORITY_DEFAULT_CLASS;
+
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+
+    if(getpeername(client_socket, (struct sockaddr*)&peer, &peer_len) < 0 || peer.sin_family != AF_INET)
+        return SOCKET_PRIORITY_DEFAULT_CLASS;
+
+    in_addr_t peer_address = ntohl(peer.sin_addr.s_addr);
+
+    for(int rule_idx = 0; rule_idx < priority_rules_num; rule_idx++)
+        if((peer_address & priority_rules[rule_idx].mask) == priority_rules[rule_idx].network)
+            return priority_rules[rule_idx].priority_class;
+
+    return SOCKET_PRIORITY_DEFAULT_CLASS;
+}
+
+/// @brief Waits until the next request of the current connection is there (or at least its first bytes), up to the
+/// socket's receive timeout. Data already buffered by the library (decrypted, decompressed or framed) counts as well.
+/// @param client_socket Client socket.
+/// @return > 0 if there is something to be read, 0 if timed out, < 0 if any error happened.
+static int SocketPriorityWaitRequest(const int client_socket)
+{
+    // Framed connections may have whole requests buffered already, which the socket knows nothing about.
+    if(SocketFramingPending())
+        return 1;
+
+    return ServerSocketWaitReadable(client_socket, priority_rx_timeout_us);
+}
+
+/// @brief Gives a run slot back, handing it straight over to the waiting class with the lowest pass (stride scheduling):
+/// each class moves its pass forward by the inverse of its weight whenever it gets a slot, so backlogged classes get slots
+/// in proportion to their weights. To be called with priority_mtx locked.
+static void SocketPriorityHandOver(void)
+{
+    SOCKET_PRIORITY_CLASS* p_next_class = NULL;
+
+    for(int class_idx = 0; class_idx < SERVER_SOCKET_PRIORITY_CLASSES; class_idx++)
+        if(priority_classes[class_idx].p_head && (!p_next_class || priority_classes[class_idx].pass < p_next_class->pass))
+            p_next_class = &priority_classes[class_idx];
+
+    if(!p_next_class)
+    {
+        priority_running--;
+        return;
+    }
+
+    SOCKET_PRIORITY_WAITER* p_waiter = p_next_class->p_head;
+
+    p_next_class->p_head = p_waiter->next;
+
+    if(!p_next_class->p_head)
+        p_next_class->p_tail = NULL;
+
+    priority_vtime = p_next_class->pass;
+    p_next_class->pass += SOCKET_PRIORITY_STRIDE_SCALE / p_next_class->weight;
+    priority_waiting--;
+
+    p_waiter->granted = true;
+    pthread_cond_signal(&p_waiter->cond);
+}
+
+/// @brief Leaves the run slot queue if the waiting thread gets cancelled (priority_mtx is locked again by then),
+/// passing the slot on if it was already handed over.
+/// @param args Waiter (SOCKET_PRIORITY_WAITER).
+static void SocketPriorityWaitCleanup(void* args)
+{
+    SOCKET_PRIORITY_WAITER* p_waiter = (SOCKET_PRIORITY_WAITER*)args;
+    SOCKET_PRIORITY_CLASS* p_class = &priority_classes[p_waiter->priority_class];
+
+    if(p_waiter->granted)
+        SocketPriorityHandOver();
+    else
+    {
+        SOCKET_PRIORITY_WAITER* p_prev = NULL;
+
+        for(SOCKET_PRIORITY_WAITER* p_iter = p_class->p_head; p_iter && p_iter != p_waiter; p_iter = p_iter->next)
+            p_prev = p_iter;
+
+        if(p_prev)
+            p_prev->next = p_waiter->next;
+        else
+            p_class->p_head = p_waiter->next;
+
+        if(p_class->p_tail == p_waiter)
+            p_class->p_tail = p_prev;
+
+        priority_waiting--;
+    }
+
+    pthread_mutex_unlock(&priority_mtx);
+    pthread_cond_destroy(&p_waiter->cond);
+}
+
+/// @brief Atomically stores value into target if it is greater than target's current value.
+/// @param p_target Target variable.
+/// @param value Candidate value.
+static void SocketPriorityAtomicMax(unsigned long* p_target, const unsigned long value)
+{
+    unsigned long current = __atomic_load_n(p_target, __ATOMIC_RELAXED);
+
+    while(value > current && !__atomic_compare_exchange_n(p_target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/// @brief Sets a priority class up. To be called before ServerSocketRun.
+/// @param class_id Class, from 0 (connections matching no rule) to SERVER_SOCKET_PRIORITY_CLASSES - 1.
+/// @param weight Share of run slots the class gets while others wait for them too (1 by default).
+/// @param max_conn Connections the class may hold at once, 0 for no limit other than the server's (default).
+/// @return 0 if succeeded, < 0 if the class does not exist or the weight is 0.
+int ServerSocketSetPriorityClass(const int class_id, const unsigned int weight, const int max_conn)
+{
+    if(class_id < 0 || class_id >= SERVER_SOCKET_PRIORITY_CLASSES)
+        return SERVER_SOCKET_PRIORITY_ERR_CLASS;
+
+    if(weight == 0 || weight > SOCKET_PRIORITY_STRIDE_SCALE)
+        return SERVER_SOCKET_PRIORITY_ERR_WEIGHT;
+
+    priority_classes[class_id].weight   = weight;
+    priority_classes[class_id].max_conn = (max_conn > 0 ? max_conn : SOCKET_PRIORITY_NO_LIMIT);
+    priority_enabled = true;
+
+    return SERVER_SOCKET_PRIORITY_SUCCESS;
+}
+
+/// @brief Adds a peer address rule. To be called before ServerSocketRun.
+/// @param peer_cidr IPv4 network in CIDR notation ("10.1.0.0/16"), a single address if no prefix length is given.
+/// @param class_id Class connections from that network belong to.
+/// @return 0 if succeeded, < 0 if the class does not exist, the network is malformed or there are too many rules (64).
+int ServerSocketAddPriorityRule(const char* peer_cidr, const int class_id)
+{
+    if(class_id < 0 || class_id >= SERVER_SOCKET_PRIORITY_CLASSES)
+        return SERVER_SOCKET_PRIORITY_ERR_CLASS;
+
+    if(!peer_cidr)
+        return SERVER_SOCKET_PRIORITY_ERR_NULL_PTR;
+
+    if(priority_rules_num >= SOCKET_PRIORITY_MAX_RULES)
+        return SERVER_SOCKET_PRIORITY_ERR_RULES_FULL;
+
+    char address[SOCKET_PRIORITY_LEN_ADDRESS] = {0};
+    const char* p_prefix = strchr(peer_cidr, '/');
+    size_t address_len = (p_prefix ? (size_t)(p_prefix - peer_cidr) : strlen(peer_cidr));
+    int prefix_len = SOCKET_PRIORITY_MAX_PREFIX_LEN;
+    struct in_addr network;
+
+    if(address_len >= sizeof(address))
+        return SERVER_SOCKET_PRIORITY_ERR_ADDRESS;
+
+    memcpy(address, peer_cidr, address_len);
+
+    if(p_prefix)
+    {
+        char* p_end = NULL;
+        prefix_len = (int)strtol(p_prefix + 1, &p_end, 10);
+
+        if(p_end == p_prefix + 1 || *p_end != 0 || prefix_len < 0 || prefix_len > SOCKET_PRIORITY_MAX_PREFIX_LEN)
+            return SERVER_SOCKET_PRIORITY_ERR_ADDRESS;
+    }
+
+    if(inet_pton(AF_INET, address, &network) != 1)
+        return SERVER_SOCKET_PRIORITY_ERR_ADDRESS;
+
+    in_addr_t mask = (prefix_len == 0 ? 0 : ~(in_addr_t)0 << (SOCKET_PRIORITY_MAX_PREFIX_LEN - prefix_len));
+
+    priority_rules[priority_rules_num++] = (SOCKET_PRIORITY_RULE)
+    {
+        .network        = ntohl(network.s_addr) & mask,
+        .mask           = mask,
+        .priority_class = class_id,
+    };
+
+    priority_enabled = true;
+
+    return SERVER_SOCKET_PRIORITY_SUCCESS;
+}
+
+/// @brief Sets a connection classifier. To be called before ServerSocketRun.
+/// @param classifier_fn Classifier, NULL to rely on peer address rules only (default).
+void ServerSocketSetPriorityClassifier(int (*classifier_fn)(int client_socket))
+{
+    priority_classifier_fn = classifier_fn;
+
+    if(classifier_fn)
+        priority_enabled = true;
+}
+
+/// @brief Sets weighted fair scheduling of interactions up. To be called before ServerSocketRun.
+/// @param run_slots Interactions running at once, 0 not to schedule them (default).
+void ServerSocketSetPriorityScheduling(const unsigned int run_slots)
+{
+    priority_run_slots = run_slots;
+
+    if(run_slots > 0)
+        priority_enabled = true;
+}
+
+/// @brief Retrieves a priority class' figures. Can be called at any time without stopping traffic.
+/// @param class_id Class.
+/// @param p_priority_stats Target structure to which figures are meant to be copied.
+/// @return 0 if succeeded, < 0 if the class does not exist.
+int ServerSocketGetPriorityStats(const int class_id, SERVER_SOCKET_PRIORITY_STATS* p_priority_stats)
+{
+    if(class_id < 0 || class_id >= SERVER_SOCKET_PRIORITY_CLASSES)
+        return SERVER_SOCKET_PRIORITY_ERR_CLASS;
+
+    if(!p_priority_stats)
+        return SERVER_SOCKET_PRIORITY_ERR_NULL_PTR;
+
+    SOCKET_PRIORITY_CLASS* p_class = &priority_classes[class_id];
+
+    p_priority_stats->active_connections    = __atomic_load_n(&p_class->active_conn , __ATOMIC_RELAXED);
+    p_priority_stats->refusals              = __atomic_load_n(&p_class->refusals    , __ATOMIC_RELAXED);
+    p_priority_stats->interactions          = __atomic_load_n(&p_class->interactions, __ATOMIC_RELAXED);
+    p_priority_stats->waits                 = __atomic_load_n(&p_class->waits       , __ATOMIC_RELAXED);
+    p_priority_stats->wait_ns               = __atomic_load_n(&p_class->wait_ns     , __ATOMIC_RELAXED);
+    p_priority_stats->max_wait_ns           = __atomic_load_n(&p_class->max_wait_ns , __ATOMIC_RELAXED);
+
+    return SERVER_SOCKET_PRIORITY_SUCCESS;
+}
+
+/// @brief Tells whether connections are meant to be classified.
+/// @return True if any priority setting was made, false otherwise.
+bool SocketPriorityEnabled(void)
+{
+    return priority_enabled;
+}
+
+/// @brief Classifies a freshly accepted connection and admits it into its class, unless the class is full.
+/// To be called by the accepting thread.
+/// @param client_socket Client socket.
+/// @return Class the connection was admitted into, < 0 if it has to be refused.
+int SocketPriorityAdmit(const int client_socket)
+{
+    int priority_class = SocketPriorityClassify(client_socket);
+    SOCKET_PRIORITY_CLASS* p_class = &priority_classes[priority_class];
+
+    int active_conn = __atomic_add_fetch(&p_class->active_conn, 1, __ATOMIC_RELAXED);
+
+    if(p_class->max_conn != SOCKET_PRIORITY_NO_LIMIT && active_conn > p_class->max_conn)
+    {
+        __atomic_sub_fetch(&p_class->active_conn, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&p_class->refusals, 1, __ATOMIC_RELAXED);
+        SocketStatsCount(SERVER_SOCKET_CNT_CLASS_REFUSALS, 1);
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_PRIORITY_CLASS_FULL, priority_class, p_class->max_conn);
+        return SERVER_SOCKET_PRIORITY_ERR_CLASS_FULL;
+    }
+
+    return priority_class;
+}
+
+/// @brief Gives a connection's place in its class back.
+/// @param priority_class Class the connection was admitted into, SOCKET_PRIORITY_NO_CLASS if there is none.
+void SocketPriorityLeave(const int priority_class)
+{
+    if(priority_class != SOCKET_PRIORITY_NO_CLASS)
+        __atomic_sub_fetch(&priority_classes[priority_class].active_conn, 1, __ATOMIC_RELAXED);
+}
+
+/// @brief Binds the connection served by the current thread to its class.
+/// @param client_socket Client socket.
+/// @param priority_class Class the connection was admitted into, SOCKET_PRIORITY_NO_CLASS if there is none.
+void SocketPriorityAttach(const int client_socket, const int priority_class)
+{
+    priority_thread_class = priority_class;
+
+    if(priority_class != SOCKET_PRIORITY_NO_CLASS && priority_run_slots > 0)
+        priority_rx_timeout_us = ServerSocketGetTimeoutUs(client_socket, SO_RCVTIMEO);
+}
+
+/// @brief Takes a run slot for the next interaction of the current connection, once its request is there, so connections
+/// waiting for their clients never hold one. If every slot is taken, waits until one is handed over to its class.
+/// Requests which do not show up within the socket's receive timeout are left to the interaction function, unscheduled.
+/// @param client_socket Client socket.
+void SocketPriorityBegin(const int client_socket)
+{
+    // Low-latency connections have CPUs of their own, so they are never held back.
+    if(priority_run_slots == 0 || priority_thread_class == SOCKET_PRIORITY_NO_CLASS || SocketBusyPollActive())
+        return;
+
+    if(SocketPriorityWaitRequest(client_socket) <= 0)
+        return;
+
+    SOCKET_PRIORITY_CLASS* p_class = &priority_classes[priority_thread_class];
+
+    __atomic_add_fetch(&p_class->interactions, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&priority_mtx);
+
+    if(priority_running < priority_run_slots && priority_waiting == 0)
+    {
+        priority_running++;
+        pthread_mutex_unlock(&priority_mtx);
+
+        priority_slot_held = true;
+        SocketStatsRecord(SERVER_SOCKET_HIST_SCHEDULE_WAIT, 0);
+        return;
+    }
+
+    unsigned long wait_start_ns = SocketStatsNowNs();
+
+    SOCKET_PRIORITY_WAITER waiter =
+    {
+        .next           = NULL,
+        .priority_class = priority_thread_class,
+        .granted        = false,
+    };
+
+    pthread_cond_init(&waiter.cond, NULL);
+
+    // Classes which were not waiting get no credit for the time they were idle.
+    if(!p_class->p_head && p_class->pass < priority_vtime)
+        p_class->pass = priority_vtime;
+
+    if(p_class->p_tail)
+        p_class->p_tail->next = &waiter;
+    else
+        p_class->p_head = &waiter;
+
+    p_class->p_tail = &waiter;
+    priority_waiting++;
+
+    pthread_cleanup_push(SocketPriorityWaitCleanup, &waiter);
+
+    while(!waiter.granted)
+        pthread_cond_wait(&waiter.cond, &priority_mtx);
+
+    pthread_cleanup_pop(0);
+
+    pthread_mutex_unlock(&priority_mtx);
+    pthread_cond_destroy(&waiter.cond);
+
+    priority_slot_held = true;
+
+    unsigned long wait_ns = SocketStatsNowNs() - wait_start_ns;
+
+    __atomic_add_fetch(&p_class->waits, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&p_class->wait_ns, wait_ns, __ATOMIC_RELAXED);
+    SocketPriorityAtomicMax(&p_class->max_wait_ns, wait_ns);
+    SocketStatsRecord(SERVER_SOCKET_HIST_SCHEDULE_WAIT, wait_ns);
+}
+
+/// @brief Gives the run slot taken for the current interaction back (if any). To be called once it is over.
+void SocketPriorityEnd(void)
+{
+    if(!priority_slot_held)
+        return;
+
+    priority_slot_held = false;
+
+    pthread_mutex_lock(&priority_mtx);
+    SocketPriorityHandOver();
+    pthread_mutex_unlock(&priority_mtx);
+}
+
+/// @brief Gives the place of the connection served by the current thread in its class back. To be called once it is over.
+void SocketPriorityRelease(void)
+{
+    SocketPriorityEnd();
+    SocketPriorityLeave(priority_thread_class);
+
+    priority_thread_class = SOCKET_PRIORITY_NO_CLASS;
+}
+
+/*************************************/
@@ -0,0 +1,35 @@
+#ifndef SERVER_SOCKET_PRIORITY_H
+#define SERVER_SOCKET_PRIORITY_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+/// @brief Class of connections accepted while priority classes are disabled.
+#define SOCKET_PRIORITY_NO_CLASS    -1
+
+/************************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketPriorityEnabled(void);
+int SocketPriorityAdmit(int client_socket);
+void SocketPriorityLeave(int priority_class);
+void SocketPriorityAttach(int client_socket, int priority_class);
+void SocketPriorityBegin(int client_socket);
+void SocketPriorityEnd(void);
+void SocketPriorityRelease(void);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,577 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <signal.h>             // Keep signals away from the reaper thread.
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>        // Serving threads wake the reaper up.
+#include <sys/ioctl.h>
+#include <linux/sockios.h>       // SIOCOUTQ, tell whether lingering connections are done sending.
+#include <sys/socket.h>
+#include <openssl/err.h>
+#include "ServerSocketReaper.h"
+#include "ServerSocketSSL.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_REAPER_SUCCESS        0
+#define SERVER_SOCKET_REAPER_ERR_DISABLED   -1
+#define SERVER_SOCKET_REAPER_ERR_ALLOC      -2
+#define SERVER_SOCKET_REAPER_ERR_EVENT      -3
+#define SERVER_SOCKET_REAPER_ERR_THREAD     -4
+
+#define SOCKET_REAPER_DEFAULT_LINGER        -1
+#define SOCKET_REAPER_MIN_CAPACITY          64
+#define SOCKET_REAPER_DRAIN_SIZE            4096    // Bytes read at a time while waiting for the client's close_notify.
+#define SOCKET_REAPER_MAX_DRAIN_READS       16      // Reads per wake-up, so a chatty client cannot hold the reaper up.
+#define SOCKET_REAPER_NS_PER_MS             1000000UL
+#define SOCKET_REAPER_NS_PER_S              1000000000UL
+#define SOCKET_REAPER_LINGER_CHECK_MS       10      // Acknowledgements raise no poll event, so lingering connections are checked this often.
+
+#define SERVER_SOCKET_MSG_REAPER_THREAD_NOK "Could not create reaper thread: <%s>, closing connections inline."
+#define SERVER_SOCKET_MSG_REAPER_OK         "Deferred close enabled (TLS shutdown: <%lu> ms, linger: <%d> s)."
+#define SERVER_SOCKET_MSG_REAPER_CLEANUP    "Cleaning up reaper."
+#define SERVER_SOCKET_MSG_REAPER_CLOSE_NOK  "An error happened while closing socket <%d> (reaper)."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Connection whose resources are yet to be torn down.
+typedef struct
+{
+    int             client_socket;
+    SSL*            p_ssl;
+    unsigned long   handed_ns;      // Time its serving thread handed it over.
+    unsigned long   deadline_ns;    // Time it stops waiting for the client's close_notify (or for its data to be acknowledged).
+    bool            lingering;      // Waiting for its unsent data to be acknowledged rather than for a close_notify.
+} SOCKET_REAPER_CONN;
+
+/// @brief Growable array of connections.
+typedef struct
+{
+    SOCKET_REAPER_CONN* p_conns;
+    unsigned long       num;
+    unsigned long       capacity;
+} SOCKET_REAPER_LIST;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static bool             reaper_enabled      = false;
+static unsigned long    reaper_shutdown_ms  = 0;
+static int              reaper_linger_s     = SOCKET_REAPER_DEFAULT_LINGER;
+
+/// @brief Connections handed over by serving threads, guarded by reaper_mtx.
+static SOCKET_REAPER_LIST   reaper_inbox;
+static pthread_mutex_t      reaper_mtx          = PTHREAD_MUTEX_INITIALIZER;
+
+/// @brief Connections waiting for their client's close_notify, and those to be torn down. Only touched by the reaper.
+static SOCKET_REAPER_LIST   reaper_waiting;
+static SOCKET_REAPER_LIST   reaper_done;
+static struct pollfd*       p_reaper_poll_fds   = NULL;
+static unsigned long        reaper_poll_fds_capacity = 0;
+
+static int              reaper_event_fd     = -1;
+static pthread_t        reaper_thread;
+static bool             reaper_thread_running = false;
+static bool             reaper_stop         = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int SocketReaperListAppend(SOCKET_REAPER_LIST* p_list, const SOCKET_REAPER_CONN* p_conn);
+static void SocketReaperListFree(SOCKET_REAPER_LIST* p_list);
+static void SocketReaperDone(const SOCKET_REAPER_CONN* p_conn);
+static void SocketReaperShutdown(SOCKET_REAPER_CONN* p_conn);
+static bool SocketReaperDrain(SOCKET_REAPER_CONN* p_conn);
+static unsigned long SocketReaperUnsent(int client_socket);
+static bool SocketReaperLinger(SOCKET_REAPER_CONN* p_conn, unsigned long now_ns);
+static void SocketReaperTearDown(void);
+static int SocketReaperPollTimeoutMs(void);
+static void SocketReaperWait(void);
+static void* SocketReaperRoutine(void* args);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Appends a connection to a list, growing it if needed.
+/// @param p_list List.
+/// @param p_conn Connection (copied).
+/// @return 0 if succeeded, < 0 if the list could not grow.
+static int SocketReaperListAppend(SOCKET_REAPER_LIST* p_list, const SOCKET_REAPER_CONN* p_conn)
+{
+    if(p_list->num == p_list->capacity)
+    {
+        unsigned long capacity = (p_list->capacity ? 2 * p_list->capacity : SOCKET_REAPER_MIN_CAPACITY);
+        SOCKET_REAPER_CONN* p_conns = realloc(p_list->p_conns, capacity * sizeof(SOCKET_REAPER_CONN));
+
+        if(!p_conns)
+            return SERVER_SOCKET_REAPER_ERR_ALLOC;
+
+        p_list->p_conns = p_conns;
+        p_list->capacity = capacity;
+    }
+
+    p_list->p_conns[p_list->num++] = *p_conn;
+
+    return SERVER_SOCKET_REAPER_SUCCESS;
+}
+
+/// @brief Frees a list's memory.
+/// @param p_list List.
+static void SocketReaperListFree(SOCKET_REAPER_LIST* p_list)
+{
+    free(p_list->p_conns);
+    *p_list = (SOCKET_REAPER_LIST){0};
+}
+
+/// @brief Queues a connection for the next teardown batch, tearing it down right away if it cannot be queued.
+/// @param p_conn Connection.
+static void SocketReaperDone(const SOCKET_REAPER_CONN* p_conn)
+{
+    if(SocketReaperListAppend(&reaper_done, p_conn) == SERVER_SOCKET_REAPER_SUCCESS)
+        return;
+
+    ServerSocketFreeSSL(p_conn->p_ssl);
+    close(p_conn->client_socket);
+}
+
+/// @brief Starts tearing a connection down: TLS connections send their close_notify, then wait for the client's one
+/// (without blocking) until their deadline, the rest is torn down straight away.
+/// @param p_conn Connection.
+static void SocketReaperShutdown(SOCKET_REAPER_CONN* p_conn)
+{
+    bool wait_client = false;
+
+    if(p_conn->p_ssl)
+    {
+        fcntl(p_conn->client_socket, F_SETFL, fcntl(p_conn->client_socket, F_GETFL) | O_NONBLOCK);
+
+        // Clients which already sent their close_notify (or are gone) are done with after ours.
+        int ssl_shutdown = SSL_shutdown(p_conn->p_ssl);
+
+        wait_client = (reaper_shutdown_ms > 0 && (ssl_shutdown == 0 || (ssl_shutdown < 0 && SSL_get_error(p_conn->p_ssl, ssl_shutdown) == SSL_ERROR_WANT_READ)));
+
+        // Failed shutdowns (e.g. after a failed handshake) leave errors behind, which belong to no one.
+        ERR_clear_error();
+    }
+
+    if(wait_client)
+    {
+        p_conn->deadline_ns = p_conn->handed_ns + reaper_shutdown_ms * SOCKET_REAPER_NS_PER_MS;
+
+        if(SocketReaperListAppend(&reaper_waiting, p_conn) == SERVER_SOCKET_REAPER_SUCCESS)
+            return;
+    }
+
+    SocketReaperDone(p_conn);
+}
+
+/// @brief Reads (and drops) whatever a client sent before its close_notify.
+/// @param p_conn Connection waiting for its client's close_notify.
+/// @return True if the connection is done with (close_notify received, client gone or failed), false if it is still waiting.
+static bool SocketReaperDrain(SOCKET_REAPER_CONN* p_conn)
+{
+    char drained[SOCKET_REAPER_DRAIN_SIZE];
+
+    for(int read_idx = 0; read_idx < SOCKET_REAPER_MAX_DRAIN_READS; read_idx++)
+    {
+        int ssl_read = SSL_read(p_conn->p_ssl, drained, sizeof(drained));
+
+        if(ssl_read > 0)
+            continue;
+
+        bool waiting = (SSL_get_error(p_conn->p_ssl, ssl_read) == SSL_ERROR_WANT_READ);
+
+        ERR_clear_error();
+
+        return !waiting;
+    }
+
+    return false;
+}
+
+/// @brief Tells how much of the data sent on a socket has not been acknowledged yet.
+/// @param client_socket Client socket.
+/// @return Unacknowledged bytes, 0 if unknown.
+static unsigned long SocketReaperUnsent(const int client_socket)
+{
+    int unsent = 0;
+
+    if(ioctl(client_socket, SIOCOUTQ, &unsent) < 0 || unsent < 0)
+        return 0;
+
+    return (unsigned long)unsent;
+}
+
+/// @brief Lingers on a connection without blocking, as SO_LINGER would make close() block the reaper: its write side is
+/// shut down, and it waits (along with connections waiting for their close_notify) for its data to be acknowledged.
+/// @param p_conn Connection done with.
+/// @param now_ns Current time.
+/// @return True if the connection lingers, false if it can be closed straight away (nothing left to send, or out of memory).
+static bool SocketReaperLinger(SOCKET_REAPER_CONN* p_conn, const unsigned long now_ns)
+{
+    // Connections being torn down because the server is stopping are not waited for anymore.
+    if(__atomic_load_n(&reaper_stop, __ATOMIC_ACQUIRE))
+        return false;
+
+    shutdown(p_conn->client_socket, SHUT_WR);
+
+    if(SocketReaperUnsent(p_conn->client_socket) == 0)
+        return false;
+
+    SOCKET_REAPER_CONN lingering = *p_conn;
+
+    lingering.p_ssl         = NULL;
+    lingering.deadline_ns   = now_ns + (unsigned long)reaper_linger_s * SOCKET_REAPER_NS_PER_S;
+    lingering.lingering     = true;
+
+    if(SocketReaperListAppend(&reaper_waiting, &lingering) < 0)
+        return false;
+
+    // close_notify was already sent (if any), so the SSL object is not needed anymore.
+    ServerSocketFreeSSL(p_conn->p_ssl);
+
+    return true;
+}
+
+/// @brief Tears down every connection done with at once: lingering options, SSL objects and descriptors.
+/// Connections meant to linger (linger_s > 0) wait for their data to be acknowledged first, then get reset if it was not.
+static void SocketReaperTearDown(void)
+{
+    unsigned long now_ns = SocketStatsNowNs();
+
+    for(unsigned long done_idx = 0; done_idx < reaper_done.num; done_idx++)
+    {
+        SOCKET_REAPER_CONN* p_conn = &reaper_done.p_conns[done_idx];
+
+        if(reaper_linger_s > 0 && !p_conn->lingering && SocketReaperLinger(p_conn, now_ns))
+            continue;
+
+        if(reaper_linger_s == 0 || (p_conn->lingering && SocketReaperUnsent(p_conn->client_socket) > 0))
+        {
+            struct linger linger = {.l_onoff = 1, .l_linger = 0};
+            setsockopt(p_conn->client_socket, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+        }
+
+
+        ServerSocketFreeSSL(p_conn->p_ssl);
+
+        if(close(p_conn->client_socket) < 0)
+        {
+            SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+            SOCKET_LOG_ERR_RL(SERVER_SOCKET_MSG_REAPER_CLOSE_NOK, p_conn->client_socket);
+        }
+
+        SocketStatsRecord(SERVER_SOCKET_HIST_TEARDOWN, now_ns - p_conn->handed_ns);
+    }
+
+    reaper_done.num = 0;
+}
+
+/// @brief Works out how long the reaper may sleep for.
+/// @return Time until the earliest close_notify deadline, rounded up, -1 if no connection is waiting.
+static int SocketReaperPollTimeoutMs(void)
+{
+    if(reaper_waiting.num == 0)
+        return -1;
+
+    unsigned long now_ns = SocketStatsNowNs();
+    unsigned long earliest_ns = reaper_waiting.p_conns[0].deadline_ns;
+    bool lingering = false;
+
+    for(unsigned long waiting_idx = 0; waiting_idx < reaper_waiting.num; waiting_idx++)
+    {
+        if(reaper_waiting.p_conns[waiting_idx].deadline_ns < earliest_ns)
+            earliest_ns = reaper_waiting.p_conns[waiting_idx].deadline_ns;
+
+        lingering |= reaper_waiting.p_conns[waiting_idx].lingering;
+    }
+
+    if(earliest_ns <= now_ns)
+        return 0;
+
+    int timeout_ms = (int)((earliest_ns - now_ns + SOCKET_REAPER_NS_PER_MS - 1) / SOCKET_REAPER_NS_PER_MS);
+
+    return (lingering && timeout_ms > SOCKET_REAPER_LINGER_CHECK_MS ? SOCKET_REAPER_LINGER_CHECK_MS : timeout_ms);
+}
+
+/// @brief Waits for handed over connections or for clients' close_notify, then moves every connection done with
+/// (answered, gone or past its deadline) to the done list.
+static void SocketReaperWait(void)
+{
+    // Event descriptor first, then one entry per waiting connection.
+    struct pollfd event_poll_fd;
+    struct pollfd* p_poll_fds = p_reaper_poll_fds;
+    unsigned long poll_fds_num = reaper_waiting.num + 1;
+
+    if(poll_fds_num > reaper_poll_fds_capacity)
+    {
+        struct pollfd* p_grown_poll_fds = realloc(p_reaper_poll_fds, (reaper_waiting.capacity + 1) * sizeof(struct pollfd));
+
+        if(p_grown_poll_fds)
+        {
+            p_reaper_poll_fds = p_grown_poll_fds;
+            reaper_poll_fds_capacity = reaper_waiting.capacity + 1;
+            p_poll_fds = p_grown_poll_fds;
+        }
+        else if(reaper_poll_fds_capacity == 0)
+        {
+            p_poll_fds = &event_poll_fd;
+            poll_fds_num = 1;
+        }
+        else
+            poll_fds_num = reaper_poll_fds_capacity;
+    }
+
+    // Out of memory: connections which do not fit stop waiting for their client, and are closed before the reaper sleeps.
+    if(poll_fds_num - 1 < reaper_waiting.num)
+    {
+        for(unsigned long waiting_idx = poll_fds_num - 1; waiting_idx < reaper_waiting.num; waiting_idx++)
+            SocketReaperDone(&reaper_waiting.p_conns[waiting_idx]);
+
+        reaper_waiting.num = poll_fds_num - 1;
+        SocketReaperTearDown();
+    }
+
+    p_poll_fds[0] = (struct pollfd){.fd = reaper_event_fd, .events = POLLIN};
+
+    // Lingering connections only report errors and hang-ups: whatever their client still sends is of no interest.
+    for(unsigned long poll_idx = 1; poll_idx < poll_fds_num; poll_idx++)
+    {
+        const SOCKET_REAPER_CONN* p_conn = &reaper_waiting.p_conns[poll_idx - 1];
+        p_poll_fds[poll_idx] = (struct pollfd){.fd = p_conn->client_socket, .events = (p_conn->lingering ? 0 : POLLIN)};
+    }
+
+    int poll_fds = poll(p_poll_fds, poll_fds_num, SocketReaperPollTimeoutMs());
+
+    if(poll_fds > 0 && (p_poll_fds[0].revents & POLLIN))
+    {
+        eventfd_t events;
+        eventfd_read(reaper_event_fd, &events);
+    }
+
+    unsigned long now_ns = SocketStatsNowNs();
+    unsigned long kept_num = 0;
+
+    // Waiting connections are compacted in place, keeping their order.
+    for(unsigned long waiting_idx = 0; waiting_idx < reaper_waiting.num; waiting_idx++)
+    {
+        SOCKET_REAPER_CONN* p_conn = &reaper_waiting.p_conns[waiting_idx];
+        bool done = false;
+
+        if(poll_fds > 0 && waiting_idx + 1 < poll_fds_num && p_poll_fds[waiting_idx + 1].revents)
+            done = ((p_poll_fds[waiting_idx + 1].revents & (POLLERR | POLLHUP | POLLNVAL)) || (!p_conn->lingering && SocketReaperDrain(p_conn)));
+
+        if(!done && p_conn->lingering)
+            done = (SocketReaperUnsent(p_conn->client_socket) == 0);
+
+        if(!done && p_conn->deadline_ns <= now_ns)
+        {
+            if(!p_conn->lingering)
+                SocketStatsCount(SERVER_SOCKET_CNT_TLS_SHUTDOWN_TIMEOUTS, 1);
+
+            done = true;
+        }
+
+        if(done)
+            SocketReaperDone(p_conn);
+        else
+            reaper_waiting.p_conns[kept_num++] = *p_conn;
+    }
+
+    reaper_waiting.num = kept_num;
+}
+
+/// @brief Reaper thread routine: takes every connection handed over at once, and tears down the ones done with in batches.
+/// @param args Unused.
+/// @return NULL.
+static void* SocketReaperRoutine(void* args)
+{
+    SOCKET_REAPER_LIST taken = {0};
+
+    while(true)
+    {
+        bool stop = __atomic_load_n(&reaper_stop, __ATOMIC_ACQUIRE);
+
+        // Lists are swapped, so serving threads never wait for connections to be shut down.
+        pthread_mutex_lock(&reaper_mtx);
+
+        SOCKET_REAPER_LIST handed = reaper_inbox;
+        reaper_inbox = taken;
+
+        pthread_mutex_unlock(&reaper_mtx);
+
+        for(unsigned long handed_idx = 0; handed_idx < handed.num; handed_idx++)
+            SocketReaperShutdown(&handed.p_conns[handed_idx]);
+
+        taken = handed;
+        taken.num = 0;
+
+        // Clients are not waited for anymore once the server is stopping.
+        if(stop)
+        {
+            for(unsigned long waiting_idx = 0; waiting_idx < reaper_waiting.num; waiting_idx++)
+                SocketReaperDone(&reaper_waiting.p_conns[waiting_idx]);
+
+            reaper_waiting.num = 0;
+            SocketReaperTearDown();
+            break;
+        }
+
+        SocketReaperTearDown();
+        SocketReaperWait();
+        SocketReaperTearDown();
+    }
+
+    SocketReaperListFree(&taken);
+
+    return NULL;
+}
+
+/// @brief Sets deferred close up. To be called before ServerSocketRun.
+/// @param deferred True to hand connections over to the reaper thread once over, false to close them inline (default).
+/// @param shutdown_ms Time TLS connections wait for the client's close_notify after sending theirs, 0 not to wait.
+/// @param linger_s Time connections wait for their unsent data to be acknowledged before being reset (without blocking the
+/// reaper), 0 to reset connections, < 0 to keep system defaults.
+void ServerSocketSetDeferredClose(const bool deferred, const unsigned long shutdown_ms, const int linger_s)
+{
+    reaper_enabled      = deferred;
+    reaper_shutdown_ms  = shutdown_ms;
+    reaper_linger_s     = linger_s;
+}
+
+/// @brief Tells whether connections are meant to be torn down by the reaper thread.
+/// @return True if deferred close is enabled, false otherwise.
+bool SocketReaperEnabled(void)
+{
+    return reaper_enabled;
+}
+
+/// @brief Launches reaper thread.
+/// @return 0 if succeeded, < 0 otherwise.
+int SocketLaunchReaper(void)
+{
+    sigset_t all_signals;
+    sigset_t previous_signals;
+
+    reaper_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if(reaper_event_fd < 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_REAPER_THREAD_NOK, strerror(errno));
+        return SERVER_SOCKET_REAPER_ERR_EVENT;
+    }
+
+    __atomic_store_n(&reaper_stop, false, __ATOMIC_RELAXED);
+
+    // Signals are meant to be handled by the main thread, so the thread inherits a fully blocked mask. SIGPIPE included:
+    // sending close_notify to a client which reset the connection just fails then.
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous_signals);
+
+    int thread_creation_status = pthread_create(&reaper_thread, NULL, SocketReaperRoutine, NULL);
+
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+
+    if(thread_creation_status != 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_REAPER_THREAD_NOK, strerror(thread_creation_status));
+        close(reaper_event_fd);
+        reaper_event_fd = -1;
+        return SERVER_SOCKET_REAPER_ERR_THREAD;
+    }
+
+    __atomic_store_n(&reaper_thread_running, true, __ATOMIC_RELEASE);
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_REAPER_OK, reaper_shutdown_ms, reaper_linger_s);
+
+    return SERVER_SOCKET_REAPER_SUCCESS;
+}
+
+/// @brief Hands a connection over to the reaper thread, which shuts it down, frees its SSL object and closes it.
+/// Its descriptor stays open until then, so it cannot be reused by a connection accepted meanwhile.
+/// @param client_socket Client socket.
+/// @param p_ssl SSL object (taken over), NULL if there is none.
+/// @return 0 if handed over, < 0 if the caller is meant to tear the connection down itself.
+int SocketReaperDefer(const int client_socket, SSL* p_ssl)
+{
+    if(!__atomic_load_n(&reaper_thread_running, __ATOMIC_ACQUIRE))
+        return SERVER_SOCKET_REAPER_ERR_DISABLED;
+
+    SOCKET_REAPER_CONN conn =
+    {
+        .client_socket  = client_socket,
+        .p_ssl          = p_ssl,
+        .handed_ns      = SocketStatsNowNs(),
+    };
+
+    pthread_mutex_lock(&reaper_mtx);
+
+    bool wake_reaper = (reaper_inbox.num == 0);
+    int append = SocketReaperListAppend(&reaper_inbox, &conn);
+
+    pthread_mutex_unlock(&reaper_mtx);
+
+    if(append < 0)
+        return append;
+
+    // The reaper takes every connection handed over at once, so only the first one after that has to wake it up.
+    if(wake_reaper)
+        eventfd_write(reaper_event_fd, 1);
+
+    return SERVER_SOCKET_REAPER_SUCCESS;
+}
+
+/// @brief Stops reaper thread, tearing down every connection still handed over without waiting for clients anymore.
+/// To be called once serving threads are gone.
+void SocketFreeReaperResources(void)
+{
+    if(!__atomic_load_n(&reaper_thread_running, __ATOMIC_ACQUIRE))
+        return;
+
+    SVRTY_LOG_DBG(SERVER_SOCKET_MSG_REAPER_CLEANUP);
+
+    __atomic_store_n(&reaper_thread_running, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&reaper_stop, true, __ATOMIC_RELEASE);
+    eventfd_write(reaper_event_fd, 1);
+    pthread_join(reaper_thread, NULL);
+
+    close(reaper_event_fd);
+    reaper_event_fd = -1;
+
+    SocketReaperListFree(&reaper_inbox);
+    SocketReaperListFree(&reaper_waiting);
+    SocketReaperListFree(&reaper_done);
+    free(p_reaper_poll_fds);
+    p_reaper_poll_fds = NULL;
+    reaper_poll_fds_capacity = 0;
+}
+
+/*************************************/
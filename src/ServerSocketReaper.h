@@ -0,0 +1,24 @@
+#ifndef SERVER_SOCKET_REAPER_H
+#define SERVER_SOCKET_REAPER_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+#include <openssl/ssl.h>
+
+/************************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+bool SocketReaperEnabled(void);
+int SocketLaunchReaper(void);
+int SocketReaperDefer(int client_socket, SSL* p_ssl);
+void SocketFreeReaperResources(void);
+
+/*************************************/
+
+#endif
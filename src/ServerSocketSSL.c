@@ -4,10 +4,15 @@
 
 #include <openssl/ssl.h>        // OpenSSL.
 #include <openssl/err.h>        // OpenSSL errors.
+#include <openssl/crypto.h>     // OpenSSL memory functions.
+#include <malloc.h>             // malloc_usable_size.
+#include <poll.h>               // Wait for client data before creating SSL object.
+#include <sys/socket.h>         // Get socket RX timeout.
 #include "ServerSocketSSL.h"
 #include "ServerSocketUse.h"    // Set/Unset O_NONBLOCK flag.
 #include "ServerSocketSSL.h"
 #include "ServerSocketManageThreads.h"  // Get current thread's SSL object (if any).
+#include "ServerSocket_api.h"
 #include "SeverityLog_api.h"
 
 /************************************/
@@ -23,10 +28,13 @@
 #define SERVER_SOCKET_MSG_CLEANING_UP_SSL       "Cleaning up server SSL data."
 
 #define SERVER_SOCKET_MSG_SSL_EQUAL_PATHS   "Path for certificate is the same as for private key."
+#define SERVER_SOCKET_MSG_SSL_LOW_MEMORY    "TLS low-memory mode enabled."
+#define SERVER_SOCKET_MSG_SSL_NO_MEM_HOOKS  "Could not set OpenSSL memory functions, TLS memory accounting disabled."
 
 #define SERVER_SOCKET_SSL_HANDSHAKE_SUCCESS 0
 #define SERVER_SOCKET_SSL_HANDSHAKE_ERR     -1
 #define SERVER_SOCKET_SSL_ACCEPT_SUCCESS    1
+#define SERVER_SOCKET_SSL_READ_TIMEOUT      -1
 
 #define SERVER_SOCKET_SETUP_SSL_SUCCESS             0
 #define SERVER_SOCKET_SETUP_SSL_NULL_SSL            -1
@@ -34,6 +42,14 @@
 #define SERVER_SOCKET_SETUP_SSL_ERR_LOAD_CERT       -3
 #define SERVER_SOCKET_SETUP_SSL_ERR_LOAD_PRIV_KEY   -4
 #define SERVER_SOCKET_SETUP_SSL_EQUAL_PATHS         -5
+#define SERVER_SOCKET_SETUP_SSL_CLIENT_GONE         -6
+
+#define SERVER_SOCKET_MEM_STATS_SUCCESS             0
+#define SERVER_SOCKET_MEM_STATS_NULL_PTR            -1
+#define SERVER_SOCKET_MEM_STATS_NO_ACCOUNTING       -2
+#define SERVER_SOCKET_MEM_STATS_HOOKS_NOK           -3
+
+#define SERVER_SOCKET_POLL_INFINITE                 -1
 
 /************************************/
 
@@ -43,6 +59,20 @@
 
 static SSL_CTX* ctx         = NULL;
 static bool     is_secure   = false;
+static bool     low_memory  = false;
+
+/// @brief Current connection's socket settings, as found during its handshake.
+static __thread bool    ssl_non_blocking    = false;
+static __thread int     ssl_rx_timeout_ms   = SERVER_SOCKET_POLL_INFINITE;
+
+/// @brief Tells whether OpenSSL allocations are being accounted for.
+static bool             ssl_mem_accounting  = false;
+/// @brief OpenSSL heap bytes currently allocated.
+static unsigned long    ssl_heap_bytes      = 0;
+/// @brief OpenSSL heap bytes allocated once SSL context was set up (not related to any connection).
+static unsigned long    ssl_ctx_heap_bytes  = 0;
+/// @brief SSL objects currently alive.
+static unsigned long    ssl_objects_num     = 0;
 
 /***********************************/
 
@@ -52,6 +82,11 @@ static bool     is_secure   = false;
 
 static SSL_CTX** ServerSocketGetPointerToSSLContext(void);
 static void ServerSocketSetSecure(bool secure);
+static void* ServerSocketSSLMalloc(size_t size, const char* file, int line);
+static void* ServerSocketSSLRealloc(void* p_mem, size_t size, const char* file, int line);
+static void ServerSocketSSLFree(void* p_mem, const char* file, int line);
+static int ServerSocketSSLGetRXTimeout(const int client_socket);
+static int ServerSocketSSLWaitForClientData(const int client_socket, const int timeout_ms);
 
 /*************************************/
 
@@ -74,6 +109,147 @@ static void ServerSocketSetSecure(const bool secure)
     is_secure = secure;
 }
 
+/// @brief OpenSSL malloc replacement, keeps track of OpenSSL heap usage.
+/// @param size Amount of bytes to be allocated.
+/// @param file Source file the allocation was requested from (unused).
+/// @param line Source line the allocation was requested from (unused).
+/// @return Pointer to allocated memory, NULL if allocation failed.
+static void* ServerSocketSSLMalloc(size_t size, const char* file, int line)
+{
+    void* p_mem = malloc(size);
+
+    if(p_mem)
+        __atomic_add_fetch(&ssl_heap_bytes, malloc_usable_size(p_mem), __ATOMIC_RELAXED);
+
+    return p_mem;
+}
+
+/// @brief OpenSSL realloc replacement, keeps track of OpenSSL heap usage.
+/// @param p_mem Previously allocated memory (if any).
+/// @param size New size.
+/// @param file Source file the allocation was requested from (unused).
+/// @param line Source line the allocation was requested from (unused).
+/// @return Pointer to reallocated memory, NULL if reallocation failed.
+static void* ServerSocketSSLRealloc(void* p_mem, size_t size, const char* file, int line)
+{
+    if(size == 0)
+    {
+        ServerSocketSSLFree(p_mem, file, line);
+        return NULL;
+    }
+
+    size_t prev_size = (p_mem ? malloc_usable_size(p_mem) : 0);
+
+    void* p_new_mem = realloc(p_mem, size);
+
+    if(!p_new_mem)
+        return NULL;
+
+    __atomic_sub_fetch(&ssl_heap_bytes, prev_size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ssl_heap_bytes, malloc_usable_size(p_new_mem), __ATOMIC_RELAXED);
+
+    return p_new_mem;
+}
+
+/// @brief OpenSSL free replacement, keeps track of OpenSSL heap usage.
+/// @param p_mem Memory to be freed.
+/// @param file Source file the deallocation was requested from (unused).
+/// @param line Source line the deallocation was requested from (unused).
+static void ServerSocketSSLFree(void* p_mem, const char* file, int line)
+{
+    if(!p_mem)
+        return;
+
+    __atomic_sub_fetch(&ssl_heap_bytes, malloc_usable_size(p_mem), __ATOMIC_RELAXED);
+
+    free(p_mem);
+}
+
+/// @brief Retrieves client socket's RX timeout (inherited from the listening socket).
+/// @param client_socket Client socket.
+/// @return RX timeout in milliseconds, < 0 if no timeout has been set.
+static int ServerSocketSSLGetRXTimeout(const int client_socket)
+{
+    struct timeval rx_timeout = {0};
+    socklen_t rx_timeout_len = sizeof(rx_timeout);
+
+    if(getsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &rx_timeout, &rx_timeout_len) < 0 || (!rx_timeout.tv_sec && !rx_timeout.tv_usec))
+        return SERVER_SOCKET_POLL_INFINITE;
+
+    return rx_timeout.tv_sec * 1000 + (rx_timeout.tv_usec + 999) / 1000;
+}
+
+/// @brief Waits until the client sends any data, so that no SSL object or buffer is held while waiting for silent clients.
+/// @param client_socket Client socket.
+/// @param timeout_ms Maximum time to wait for, < 0 to wait forever.
+/// @return 0 if there is anything to be read (including EOF), < 0 if no data arrived on time.
+static int ServerSocketSSLWaitForClientData(const int client_socket, const int timeout_ms)
+{
+    struct pollfd client_poll_fd =
+    {
+        .fd     = client_socket,
+        .events = POLLIN,
+    };
+
+    if(poll(&client_poll_fd, 1, timeout_ms) <= 0)
+        return SERVER_SOCKET_SETUP_SSL_CLIENT_GONE;
+
+    return 0;
+}
+
+/// @brief Enables TLS low-memory mode. To be called before ServerSocketRun.
+/// @param low_memory_mode True to enable low-memory mode, false otherwise.
+void ServerSocketSetTLSLowMemory(const bool low_memory_mode)
+{
+    low_memory = low_memory_mode;
+}
+
+/// @brief Enables OpenSSL heap accounting (see ServerSocketGetMemStats) by installing OpenSSL memory functions. To be called
+/// before ServerSocketRun, and before anything else in the process uses OpenSSL: the allocator cannot be replaced afterwards.
+/// @param accounting True to enable accounting, false to leave OpenSSL's allocator untouched (default).
+/// @return 0 if succeeded, < 0 if OpenSSL already allocated memory.
+int ServerSocketSetTLSMemAccounting(const bool accounting)
+{
+    if(!accounting || ssl_mem_accounting)
+        return SERVER_SOCKET_MEM_STATS_SUCCESS;
+
+    ssl_mem_accounting = (CRYPTO_set_mem_functions(ServerSocketSSLMalloc, ServerSocketSSLRealloc, ServerSocketSSLFree) == 1);
+
+    if(!ssl_mem_accounting)
+    {
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_SSL_NO_MEM_HOOKS);
+        return SERVER_SOCKET_MEM_STATS_HOOKS_NOK;
+    }
+
+    return SERVER_SOCKET_MEM_STATS_SUCCESS;
+}
+
+/// @brief Retrieves TLS memory usage figures.
+/// @param p_mem_stats Target structure to which figures are meant to be copied.
+/// @return 0 if succeeded, < 0 if OpenSSL heap accounting is not available.
+int ServerSocketGetMemStats(SERVER_SOCKET_MEM_STATS* p_mem_stats)
+{
+    if(!p_mem_stats)
+        return SERVER_SOCKET_MEM_STATS_NULL_PTR;
+
+    *p_mem_stats = (SERVER_SOCKET_MEM_STATS){0};
+
+    p_mem_stats->tls_connections = __atomic_load_n(&ssl_objects_num, __ATOMIC_RELAXED);
+
+    if(!ssl_mem_accounting)
+        return SERVER_SOCKET_MEM_STATS_NO_ACCOUNTING;
+
+    unsigned long heap_bytes = __atomic_load_n(&ssl_heap_bytes, __ATOMIC_RELAXED);
+
+    if(heap_bytes > ssl_ctx_heap_bytes)
+        p_mem_stats->tls_heap_bytes = heap_bytes - ssl_ctx_heap_bytes;
+
+    if(p_mem_stats->tls_connections > 0)
+        p_mem_stats->tls_bytes_per_conn = p_mem_stats->tls_heap_bytes / p_mem_stats->tls_connections;
+
+    return SERVER_SOCKET_MEM_STATS_SUCCESS;
+}
+
 /// @brief Tells whether socket is secure or not.
 /// @return True if security is enabled, false otherwise.
 bool ServerSocketIsSecure(void)
@@ -124,6 +300,15 @@ int ServerSocketSSLSetup(const char* restrict cert_path, const char* restrict pr
         return SERVER_SOCKET_SETUP_SSL_ERR_LOAD_PRIV_KEY;
     }
 
+    // Release read/write buffers as soon as they are empty, so idle connections only keep their SSL state.
+    if(low_memory)
+    {
+        SSL_CTX_set_mode(*(ServerSocketGetPointerToSSLContext()), SSL_MODE_RELEASE_BUFFERS);
+        SVRTY_LOG_INF(SERVER_SOCKET_MSG_SSL_LOW_MEMORY);
+    }
+
+    ssl_ctx_heap_bytes = __atomic_load_n(&ssl_heap_bytes, __ATOMIC_RELAXED);
+
     ServerSocketSetSecure(true);
 
     return SERVER_SOCKET_SETUP_SSL_SUCCESS;
@@ -139,12 +324,25 @@ int ServerSocketSSLHandshake(const int client_socket, const bool non_blocking)
     
     if(!dp_ssl)
         return SERVER_SOCKET_SETUP_SSL_NULL_SSL;
+
+    // In low-memory mode, do not create the SSL object until the client has something to say.
+    ssl_non_blocking    = non_blocking;
+    ssl_rx_timeout_ms   = ServerSocketSSLGetRXTimeout(client_socket);
+
+    if(low_memory)
+    {
+        int wait_for_data = ServerSocketSSLWaitForClientData(client_socket, ssl_rx_timeout_ms);
+        if(wait_for_data < 0)
+            return wait_for_data;
+    }
     
     *dp_ssl = SSL_new(*(ServerSocketGetPointerToSSLContext()));
 
     if(!*dp_ssl)
         return SERVER_SOCKET_SETUP_SSL_NULL_SSL;
 
+    __atomic_add_fetch(&ssl_objects_num, 1, __ATOMIC_RELAXED);
+
     if(!(SSL_set_fd(*dp_ssl, client_socket)))
         return SERVER_SOCKET_SETUP_SSL_NULL_SSL;
 
@@ -177,6 +375,11 @@ int ServerSocketSSLRead(char* restrict rx_buffer, const unsigned long rx_buffer_
 {
     SSL** restrict dp_ssl = SocketGetCurrentThreadSSLObj();
 
+    // Blocking inside SSL_read would keep the read buffer allocated for as long as the connection stays idle.
+    if(low_memory && !ssl_non_blocking && !SSL_has_pending(*dp_ssl))
+        if(ServerSocketSSLWaitForClientData(SSL_get_fd(*dp_ssl), ssl_rx_timeout_ms) < 0)
+            return SERVER_SOCKET_SSL_READ_TIMEOUT;
+
     return SSL_read(*dp_ssl, rx_buffer, rx_buffer_size);
 }
 
@@ -191,6 +394,26 @@ int ServerSocketSSLWrite(const char* restrict tx_buffer, const unsigned long tx_
     return SSL_write(*dp_ssl, tx_buffer, tx_buffer_size);
 }
 
+/// @brief Reads decrypted data without removing it from the connection.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes available if > 0, 0 if client got disconnected, < 0 if no data could be read.
+int ServerSocketSSLPeek(char* restrict rx_buffer, const unsigned long rx_buffer_size)
+{
+    SSL** restrict dp_ssl = SocketGetCurrentThreadSSLObj();
+
+    return SSL_peek(*dp_ssl, rx_buffer, rx_buffer_size);
+}
+
+/// @brief Tells whether decrypted data is already waiting to be read, so there is no need to wait for the socket.
+/// @return True if any decrypted byte is pending, false otherwise.
+bool ServerSocketSSLPending(void)
+{
+    SSL** restrict dp_ssl = SocketGetCurrentThreadSSLObj();
+
+    return (dp_ssl && *dp_ssl && SSL_pending(*dp_ssl) > 0);
+}
+
 /// @brief Frees previously allocated SSL resources.
 void SocketFreeSSLResources(void)
 {
@@ -220,6 +443,8 @@ void ServerSocketFreeSSL(SSL* p_ssl)
     
     SSL_free(p_ssl);
     p_ssl = NULL;
+
+    __atomic_sub_fetch(&ssl_objects_num, 1, __ATOMIC_RELAXED);
 }
 
 /*************************************/
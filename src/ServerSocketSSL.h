@@ -19,6 +19,8 @@ int ServerSocketSSLSetup(const char* restrict cert_path, const char* restrict pr
 int ServerSocketSSLHandshake(const int client_socket, const bool non_blocking);
 int ServerSocketSSLRead(char* restrict rx_buffer, const unsigned long rx_buffer_size);
 int ServerSocketSSLWrite(const char* restrict tx_buffer, const unsigned long tx_buffer_size);
+int ServerSocketSSLPeek(char* restrict rx_buffer, const unsigned long rx_buffer_size);
+bool ServerSocketSSLPending(void);
 void ServerSocketFreeSSL(SSL* p_ssl);
 void SocketFreeSSLResources(void);
 
@@ -0,0 +1,189 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <string.h>             // memchr.
+#include "ServerSocketScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>          // SSE2 and AVX2 intrinsics (enabled per function, so no build flag is needed).
+#define SOCKET_SCAN_X86
+#endif
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SOCKET_SCAN_SSE2_BLOCK  16
+#define SOCKET_SCAN_AVX2_BLOCK  32
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Delimiter search implementation.
+typedef const char* (*SOCKET_SCAN_FN)(const char* p_data, unsigned long size, char delimiter);
+
+/**********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static const char* SocketScanFindScalar(const char* p_data, unsigned long size, char delimiter);
+static const char* SocketScanFindLibC(const char* p_data, unsigned long size, char delimiter);
+#ifdef SOCKET_SCAN_X86
+static const char* SocketScanFindSSE2(const char* p_data, unsigned long size, char delimiter);
+static const char* SocketScanFindAVX2(const char* p_data, unsigned long size, char delimiter);
+#endif
+static const char* SocketScanResolve(const char* p_data, unsigned long size, char delimiter);
+
+/*************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+/// @brief Implementation picked for the running CPU, resolved on first use.
+static SOCKET_SCAN_FN scan_fn = SocketScanResolve;
+
+/***********************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Searches for a delimiter byte by byte. Used for data shorter than a SIMD block.
+/// @param p_data Data to be searched.
+/// @param size Amount of bytes to be searched.
+/// @param delimiter Delimiter character.
+/// @return Pointer to the first delimiter, NULL if there is none.
+static const char* SocketScanFindScalar(const char* p_data, const unsigned long size, const char delimiter)
+{
+    for(unsigned long offset = 0; offset < size; offset++)
+    {
+        if(p_data[offset] == delimiter)
+            return p_data + offset;
+    }
+
+    return NULL;
+}
+
+/// @brief Searches for a delimiter with the C library, which is usually vectorized on platforms with no implementation here.
+/// @param p_data Data to be searched.
+/// @param size Amount of bytes to be searched.
+/// @param delimiter Delimiter character.
+/// @return Pointer to the first delimiter, NULL if there is none.
+static const char* SocketScanFindLibC(const char* p_data, const unsigned long size, const char delimiter)
+{
+    return memchr(p_data, delimiter, size);
+}
+
+#ifdef SOCKET_SCAN_X86
+
+/// @brief Searches for a delimiter 16 bytes at a time.
+/// @param p_data Data to be searched.
+/// @param size Amount of bytes to be searched.
+/// @param delimiter Delimiter character.
+/// @return Pointer to the first delimiter, NULL if there is none.
+__attribute__((target("sse2")))
+static const char* SocketScanFindSSE2(const char* p_data, const unsigned long size, const char delimiter)
+{
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    unsigned long offset = 0;
+
+    for(; offset + SOCKET_SCAN_SSE2_BLOCK <= size; offset += SOCKET_SCAN_SSE2_BLOCK)
+    {
+        // One bit per byte, set where the delimiter is.
+        int matches = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p_data + offset)), delimiters));
+
+        if(matches)
+            return p_data + offset + __builtin_ctz(matches);
+    }
+
+    if(offset == size)
+        return NULL;
+
+    if(size < SOCKET_SCAN_SSE2_BLOCK)
+        return SocketScanFindScalar(p_data, size, delimiter);
+
+    // The tail is searched with a last block ending right at the end of data, bytes already searched being masked out.
+    unsigned int searched = offset - (size - SOCKET_SCAN_SSE2_BLOCK);
+    unsigned int matches = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p_data + size - SOCKET_SCAN_SSE2_BLOCK)), delimiters)) >> searched;
+
+    return (matches ? p_data + offset + __builtin_ctz(matches) : NULL);
+}
+
+/// @brief Searches for a delimiter 32 bytes at a time.
+/// @param p_data Data to be searched.
+/// @param size Amount of bytes to be searched.
+/// @param delimiter Delimiter character.
+/// @return Pointer to the first delimiter, NULL if there is none.
+__attribute__((target("avx2")))
+static const char* SocketScanFindAVX2(const char* p_data, const unsigned long size, const char delimiter)
+{
+    const __m256i delimiters = _mm256_set1_epi8(delimiter);
+    unsigned long offset = 0;
+
+    for(; offset + SOCKET_SCAN_AVX2_BLOCK <= size; offset += SOCKET_SCAN_AVX2_BLOCK)
+    {
+        unsigned int matches = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p_data + offset)), delimiters));
+
+        if(matches)
+            return p_data + offset + __builtin_ctz(matches);
+    }
+
+    if(offset == size)
+        return NULL;
+
+    if(size < SOCKET_SCAN_AVX2_BLOCK)
+        return SocketScanFindSSE2(p_data, size, delimiter);
+
+    // Same as SSE2 tails (see SocketScanFindSSE2).
+    unsigned int searched = offset - (size - SOCKET_SCAN_AVX2_BLOCK);
+    unsigned int matches = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p_data + size - SOCKET_SCAN_AVX2_BLOCK)), delimiters)) >> searched;
+
+    return (matches ? p_data + offset + __builtin_ctz(matches) : NULL);
+}
+
+#endif
+
+/// @brief Picks the fastest implementation the running CPU supports, then searches with it.
+/// Every thread resolves the same one, so racing on the first use is harmless.
+/// @param p_data Data to be searched.
+/// @param size Amount of bytes to be searched.
+/// @param delimiter Delimiter character.
+/// @return Pointer to the first delimiter, NULL if there is none.
+static const char* SocketScanResolve(const char* p_data, const unsigned long size, const char delimiter)
+{
+    SOCKET_SCAN_FN resolved_fn = SocketScanFindLibC;
+
+#ifdef SOCKET_SCAN_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2"))
+        resolved_fn = SocketScanFindAVX2;
+    else if(__builtin_cpu_supports("sse2"))
+        resolved_fn = SocketScanFindSSE2;
+#endif
+
+    __atomic_store_n(&scan_fn, resolved_fn, __ATOMIC_RELAXED);
+
+    return resolved_fn(p_data, size, delimiter);
+}
+
+/// @brief Searches for a delimiter with the fastest implementation the running CPU supports.
+/// @param p_data Data to be searched.
+/// @param size Amount of bytes to be searched.
+/// @param delimiter Delimiter character.
+/// @return Pointer to the first delimiter, NULL if there is none.
+const char* SocketScanFind(const char* p_data, const unsigned long size, const char delimiter)
+{
+    return __atomic_load_n(&scan_fn, __ATOMIC_RELAXED)(p_data, size, delimiter);
+}
+
+/*************************************/
@@ -0,0 +1,12 @@
+#ifndef SERVER_SOCKET_SCAN_H
+#define SERVER_SOCKET_SCAN_H
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+const char* SocketScanFind(const char* p_data, unsigned long size, char delimiter);
+
+/*************************************/
+
+#endif
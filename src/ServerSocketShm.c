@@ -0,0 +1,793 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // memfd_create, POLLRDHUP.
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>              // Seals, so the client cannot resize the region under the server.
+#include <poll.h>               // Tell whether the client is gone while parked.
+#include <stddef.h>             // offsetof.
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/random.h>         // Side channel token.
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/un.h>             // Side channel the region is handed over through.
+#include "ServerSocketShm.h"
+#include "ServerSocketUse.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketCompress.h"
+#include "ServerSocketBroadcast.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_SHM_SUCCESS               0
+#define SERVER_SOCKET_SHM_ERR_DISABLED          -1
+#define SERVER_SOCKET_SHM_ERR_PEER              -2
+#define SERVER_SOCKET_SHM_ERR_COMPRESS          -3
+#define SERVER_SOCKET_SHM_ERR_REGION            -4
+#define SERVER_SOCKET_SHM_ERR_REPLY             -5
+#define SERVER_SOCKET_SHM_ERR_WRITE             -6
+#define SERVER_SOCKET_SHM_ERR_PROTOCOL          -7
+#define SERVER_SOCKET_SHM_ERR_CHANNEL           -8
+
+#define SOCKET_SHM_AVAILABLE_TIMEOUT            -1
+#define SOCKET_SHM_AVAILABLE_PROTOCOL           -2
+
+#define SOCKET_SHM_REGION_NAME                  "server_socket_shm"
+#define SOCKET_SHM_MAX_RING_SIZE                (1UL << 30)     // Reads and writes report sizes as int.
+#define SOCKET_SHM_DEFAULT_SPIN_US              20
+#define SOCKET_SHM_SPINS_PER_CLOCK_READ         64
+#define SOCKET_SHM_LIVENESS_SLICE_US            100000          // Parked threads check the socket at least this often.
+#define SOCKET_SHM_CHANNEL_TIMEOUT_US           1000000         // Client's time to collect the region once replied to.
+#define SOCKET_SHM_LOOPBACK_NET                 0x7F000000U     // 127.0.0.0/8
+#define SOCKET_SHM_LOOPBACK_MASK                0xFF000000U
+#define SOCKET_SHM_US_PER_SEC                   1000000L
+#define SOCKET_SHM_NS_PER_US                    1000L
+#define SOCKET_SHM_US_PER_MS                    1000L
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SOCKET_SHM_CPU_RELAX()                  __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define SOCKET_SHM_CPU_RELAX()                  __asm__ __volatile__("yield")
+#else
+#define SOCKET_SHM_CPU_RELAX()
+#endif
+
+#define SERVER_SOCKET_MSG_SHM_NOT_LOCAL         "Shared-memory upgrade refused to non-local socket <%d>."
+#define SERVER_SOCKET_MSG_SHM_REGION_NOK        "Could not set up shared-memory region for socket <%d>."
+#define SERVER_SOCKET_MSG_SHM_CHANNEL_NOK       "Client on socket <%d> did not collect its shared-memory region."
+#define SERVER_SOCKET_MSG_SHM_PROTOCOL_NOK      "Ring positions corrupted by client on socket <%d>, closing connection."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Shared-memory state of the connection served by the current thread.
+typedef struct
+{
+    SERVER_SOCKET_SHM_HEADER*   p_header;
+    SERVER_SOCKET_SHM_RING*     p_rx_ring;      // Client to server.
+    SERVER_SOCKET_SHM_RING*     p_tx_ring;      // Server to client.
+    char*                       p_rx_data;
+    char*                       p_tx_data;
+    unsigned long               ring_size;
+    unsigned long               map_size;
+    int                         memfd;          // Only kept open until handed over to the client.
+    long                        rx_timeout_us;  // Socket's own timeouts, SERVER_SOCKET_WAIT_FOREVER if there is none.
+    long                        tx_timeout_us;
+    bool                        peer_gone;      // Socket got hung up, even if the client did not flag the region as closed.
+    bool                        protocol_error; // Client left ring positions further apart than the ring size.
+} SOCKET_SHM_CONN;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long    shm_ring_size   = 0;
+static long             shm_spin_us     = SOCKET_SHM_DEFAULT_SPIN_US;
+
+static __thread SOCKET_SHM_CONN thread_conn;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread bool socket_shm_active = false;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static long SocketShmNowUs(void);
+static bool SocketShmPeerIsLocal(int client_socket);
+static int SocketShmMapRegion(SOCKET_SHM_CONN* p_conn);
+static void SocketShmUnmapRegion(SOCKET_SHM_CONN* p_conn);
+static int SocketShmOpenChannel(SERVER_SOCKET_SHM_REPLY* p_reply);
+static int SocketShmSendRegion(const SOCKET_SHM_CONN* p_conn, int channel, const unsigned char* token);
+static void SocketShmBump(unsigned int* p_seq);
+static void SocketShmNotify(unsigned int* p_parked, unsigned int* p_seq);
+static bool SocketShmClientClosed(const SOCKET_SHM_CONN* p_conn);
+static bool SocketShmSocketHungUp(int client_socket);
+static bool SocketShmPositionsValid(SOCKET_SHM_CONN* p_conn, int client_socket, unsigned long long head, unsigned long long tail);
+static int SocketShmWait(int client_socket, unsigned long long* p_position, unsigned long long position, unsigned int* p_seq, unsigned int* p_parked, long timeout_us);
+static long SocketShmAvailable(int client_socket, long timeout_us);
+static void SocketShmCopyOut(const SOCKET_SHM_CONN* p_conn, char* rx_buffer, unsigned long long tail, unsigned long size);
+static void SocketShmAccountIO(int io_result, SERVER_SOCKET_CNT bytes_cnt, SERVER_SOCKET_HIST bytes_hist);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Current monotonic time.
+/// @return Microseconds.
+static long SocketShmNowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * SOCKET_SHM_US_PER_SEC + now.tv_nsec / SOCKET_SHM_NS_PER_US;
+}
+
+/// @brief Tells whether the client connected from this very host.
+/// @param client_socket Client socket.
+/// @return True if the peer address is a loopback one, false otherwise.
+static bool SocketShmPeerIsLocal(const int client_socket)
+{
+    struct sockaddr_in client;
+    socklen_t client_len = sizeof(client);
+
+    if(getpeername(client_socket, (struct sockaddr*)&client, &client_len) < 0 || client.sin_family != AF_INET)
+        return false;
+
+    return ((ntohl(client.sin_addr.s_addr) & SOCKET_SHM_LOOPBACK_MASK) == SOCKET_SHM_LOOPBACK_NET);
+}
+
+/// @brief Creates and maps the region. memfd pages are zero-filled, so only the header needs to be set.
+/// @param p_conn Connection state.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketShmMapRegion(SOCKET_SHM_CONN* p_conn)
+{
+    p_conn->ring_size   = shm_ring_size;
+    p_conn->map_size    = SERVER_SOCKET_SHM_HEADER_SIZE + 2 * shm_ring_size;
+    p_conn->memfd       = memfd_create(SOCKET_SHM_REGION_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if(p_conn->memfd < 0)
+        return SERVER_SOCKET_SHM_ERR_REGION;
+
+    void* p_region = MAP_FAILED;
+
+    if(ftruncate(p_conn->memfd, p_conn->map_size) == 0 &&
+       fcntl(p_conn->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0)
+        p_region = mmap(NULL, p_conn->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, p_conn->memfd, 0);
+
+    if(p_region == MAP_FAILED)
+    {
+        close(p_conn->memfd);
+        return SERVER_SOCKET_SHM_ERR_REGION;
+    }
+
+    p_conn->p_header    = p_region;
+    p_conn->p_rx_ring   = &p_conn->p_header->to_server;
+    p_conn->p_tx_ring   = &p_conn->p_header->to_client;
+    p_conn->p_rx_data   = (char*)p_region + SERVER_SOCKET_SHM_HEADER_SIZE;
+    p_conn->p_tx_data   = p_conn->p_rx_data + p_conn->ring_size;
+    p_conn->peer_gone   = false;
+    p_conn->protocol_error = false;
+
+    p_conn->p_header->magic     = SERVER_SOCKET_SHM_MAGIC;
+    p_conn->p_header->version   = SERVER_SOCKET_SHM_VERSION;
+    p_conn->p_header->ring_size = p_conn->ring_size;
+
+    return SERVER_SOCKET_SHM_SUCCESS;
+}
+
+/// @brief Unmaps the region, closing the memfd if it was not handed over.
+/// @param p_conn Connection state.
+static void SocketShmUnmapRegion(SOCKET_SHM_CONN* p_conn)
+{
+    munmap(p_conn->p_header, p_conn->map_size);
+
+    if(p_conn->memfd >= 0)
+        close(p_conn->memfd);
+
+    p_conn->p_header = NULL;
+    p_conn->memfd = -1;
+}
+
+/// @brief Opens the one-shot side channel the region is handed over through: a UNIX socket listening on an abstract name
+/// picked by the kernel (autobind). Names are visible to every local process, so the reply carries a random token as well.
+/// @param p_reply Reply, filled in with channel's name and token.
+/// @return Listening side channel, < 0 if it could not be opened.
+static int SocketShmOpenChannel(SERVER_SOCKET_SHM_REPLY* p_reply)
+{
+    int channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if(channel < 0)
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+
+    struct sockaddr_un channel_address = { .sun_family = AF_UNIX };
+    socklen_t channel_address_len = sizeof(channel_address);
+
+    if(bind(channel, (struct sockaddr*)&channel_address, sizeof(sa_family_t)) < 0 ||
+       listen(channel, 1) < 0 ||
+       getsockname(channel, (struct sockaddr*)&channel_address, &channel_address_len) < 0 ||
+       getrandom(p_reply->token, sizeof(p_reply->token), 0) != sizeof(p_reply->token))
+    {
+        close(channel);
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+    }
+
+    // Abstract names start with a NUL byte, which is left out of the reply.
+    size_t channel_len = channel_address_len - offsetof(struct sockaddr_un, sun_path) - 1;
+
+    if(channel_address_len <= offsetof(struct sockaddr_un, sun_path) || channel_len > sizeof(p_reply->channel))
+    {
+        close(channel);
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+    }
+
+    memcpy(p_reply->channel, channel_address.sun_path + 1, channel_len);
+    p_reply->channel_len = channel_len;
+
+    return channel;
+}
+
+/// @brief Waits for the client to connect to the side channel and prove it got the reply, then passes it the region's
+/// descriptor. Only the first connection is taken, and only for SOCKET_SHM_CHANNEL_TIMEOUT_US.
+/// @param p_conn Connection state.
+/// @param channel Listening side channel.
+/// @param token Token the client has to present.
+/// @return 0 if succeeded, < 0 otherwise.
+static int SocketShmSendRegion(const SOCKET_SHM_CONN* p_conn, const int channel, const unsigned char* token)
+{
+    long deadline_us = SocketShmNowUs() + SOCKET_SHM_CHANNEL_TIMEOUT_US;
+
+    struct pollfd channel_poll_fd =
+    {
+        .fd     = channel,
+        .events = POLLIN,
+    };
+
+    if(poll(&channel_poll_fd, 1, SOCKET_SHM_CHANNEL_TIMEOUT_US / SOCKET_SHM_US_PER_MS) <= 0)
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+
+    int peer = accept4(channel, NULL, NULL, SOCK_CLOEXEC);
+
+    if(peer < 0)
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+
+    long remaining_us = deadline_us - SocketShmNowUs();
+    struct timeval receive_timeout =
+    {
+        .tv_sec     = (remaining_us > 0 ? remaining_us : 1) / SOCKET_SHM_US_PER_SEC,
+        .tv_usec    = (remaining_us > 0 ? remaining_us : 1) % SOCKET_SHM_US_PER_SEC,
+    };
+
+    unsigned char received_token[SERVER_SOCKET_SHM_TOKEN_SIZE];
+    int send_status = SERVER_SOCKET_SHM_ERR_CHANNEL;
+
+    if(setsockopt(peer, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout)) == 0 &&
+       recv(peer, received_token, sizeof(received_token), MSG_WAITALL) == sizeof(received_token) &&
+       memcmp(received_token, token, sizeof(received_token)) == 0 &&
+       SocketSendDescriptor(peer, SERVER_SOCKET_SHM_MSG_REGION, p_conn->memfd) == 0)
+        send_status = SERVER_SOCKET_SHM_SUCCESS;
+
+    close(peer);
+
+    return send_status;
+}
+
+/// @brief Bumps a futex word and wakes whoever is parked on it.
+/// @param p_seq Futex word.
+static void SocketShmBump(unsigned int* p_seq)
+{
+    __atomic_fetch_add(p_seq, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, p_seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/// @brief Wakes the other side up after a position was published, only if it is parked: busy rings never enter the kernel.
+/// @param p_parked Other side's parked flag.
+/// @param p_seq Futex word the other side is parked on.
+static void SocketShmNotify(unsigned int* p_parked, unsigned int* p_seq)
+{
+    // Pairs with the fence between setting the parked flag and checking the position again, so either the other side
+    // sees the new position or this side sees the flag.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(p_parked, __ATOMIC_RELAXED))
+        SocketShmBump(p_seq);
+}
+
+/// @brief Tells whether the client is done with the rings.
+/// @param p_conn Connection state.
+/// @return True if the client closed the region or hung the socket up, false otherwise.
+static bool SocketShmClientClosed(const SOCKET_SHM_CONN* p_conn)
+{
+    return (p_conn->peer_gone || p_conn->protocol_error || __atomic_load_n(&p_conn->p_header->client_closed, __ATOMIC_ACQUIRE));
+}
+
+/// @brief Checks ring positions read from shared memory, which the client can write to. Positions further apart than the
+/// ring size would make copies run past the ring, so the connection is shut down instead (and stays failed).
+/// @param p_conn Connection state.
+/// @param client_socket Client socket.
+/// @param head Producer position.
+/// @param tail Consumer position.
+/// @return True if no more than the ring size lies between both positions, false otherwise.
+static bool SocketShmPositionsValid(SOCKET_SHM_CONN* p_conn, const int client_socket, const unsigned long long head, const unsigned long long tail)
+{
+    if(head - tail <= p_conn->ring_size)
+        return true;
+
+    if(!p_conn->protocol_error)
+    {
+        p_conn->protocol_error = true;
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_SHM_PROTOCOL_NOK, client_socket);
+        SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+        shutdown(client_socket, SHUT_RDWR);
+    }
+
+    return false;
+}
+
+/// @brief Tells whether the socket got hung up, by the client (which may have died without closing the region)
+/// or by a timer (idle or lifetime deadline, shutdown).
+/// @param client_socket Client socket.
+/// @return True if hung up, false otherwise.
+static bool SocketShmSocketHungUp(const int client_socket)
+{
+    struct pollfd client_poll_fd =
+    {
+        .fd     = client_socket,
+        .events = POLLRDHUP,
+    };
+
+    return (poll(&client_poll_fd, 1, 0) > 0 && (client_poll_fd.revents & (POLLRDHUP | POLLHUP | POLLERR)));
+}
+
+/// @brief Waits for the other side to move its position: spins for a while first, then parks on the futex word,
+/// waking up every now and then to check whether the client is still there.
+/// @param client_socket Client socket.
+/// @param p_position Other side's position.
+/// @param position Position value being waited to change.
+/// @param p_seq Futex word the other side bumps when this side is parked.
+/// @param p_parked This side's parked flag.
+/// @param timeout_us Maximum time to wait for, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return > 0 if the position moved or the client is gone, 0 if timed out.
+static int SocketShmWait(const int client_socket, unsigned long long* p_position, const unsigned long long position, unsigned int* p_seq, unsigned int* p_parked, const long timeout_us)
+{
+    SOCKET_SHM_CONN* p_conn = &thread_conn;
+    long now_us = SocketShmNowUs();
+    long spin_us = (timeout_us >= 0 && timeout_us < shm_spin_us ? timeout_us : shm_spin_us);
+    long spin_deadline_us = now_us + spin_us;
+    long deadline_us = (timeout_us >= 0 ? now_us + timeout_us : SERVER_SOCKET_WAIT_FOREVER);
+
+    for(unsigned int spins = 1; spin_us > 0; spins++)
+    {
+        if(__atomic_load_n(p_position, __ATOMIC_ACQUIRE) != position || SocketShmClientClosed(p_conn))
+            return 1;
+
+        SOCKET_SHM_CPU_RELAX();
+
+        if(spins % SOCKET_SHM_SPINS_PER_CLOCK_READ == 0 && SocketShmNowUs() >= spin_deadline_us)
+            break;
+    }
+
+    while(true)
+    {
+        unsigned int seq = __atomic_load_n(p_seq, __ATOMIC_ACQUIRE);
+
+        __atomic_store_n(p_parked, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if(__atomic_load_n(p_position, __ATOMIC_ACQUIRE) != position || SocketShmClientClosed(p_conn))
+        {
+            __atomic_store_n(p_parked, 0, __ATOMIC_RELAXED);
+            return 1;
+        }
+
+        long slice_us = SOCKET_SHM_LIVENESS_SLICE_US;
+
+        if(deadline_us != SERVER_SOCKET_WAIT_FOREVER)
+        {
+            long remaining_us = deadline_us - SocketShmNowUs();
+
+            if(remaining_us <= 0)
+            {
+                __atomic_store_n(p_parked, 0, __ATOMIC_RELAXED);
+                return 0;
+            }
+
+            if(remaining_us < slice_us)
+                slice_us = remaining_us;
+        }
+
+        struct timespec slice =
+        {
+            .tv_sec     = slice_us / SOCKET_SHM_US_PER_SEC,
+            .tv_nsec    = (slice_us % SOCKET_SHM_US_PER_SEC) * SOCKET_SHM_NS_PER_US,
+        };
+
+        long futex_wait = syscall(SYS_futex, p_seq, FUTEX_WAIT, seq, &slice, NULL, 0);
+
+        __atomic_store_n(p_parked, 0, __ATOMIC_RELAXED);
+
+        // Only quiet rings pay for a liveness check.
+        if(futex_wait < 0 && errno == ETIMEDOUT && SocketShmSocketHungUp(client_socket))
+            p_conn->peer_gone = true;
+    }
+}
+
+/// @brief Waits for data on the client-to-server ring.
+/// @param client_socket Client socket.
+/// @param timeout_us Maximum time to wait for, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes available if > 0 (never more than the ring size), 0 if the client is gone (and every byte it sent
+/// was read), SOCKET_SHM_AVAILABLE_TIMEOUT if timed out, SOCKET_SHM_AVAILABLE_PROTOCOL if the client corrupted ring positions.
+static long SocketShmAvailable(const int client_socket, const long timeout_us)
+{
+    SERVER_SOCKET_SHM_RING* p_ring = thread_conn.p_rx_ring;
+    unsigned long long tail = __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED);
+    unsigned long long head = __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE);
+
+    if(thread_conn.protocol_error)
+        return SOCKET_SHM_AVAILABLE_PROTOCOL;
+
+    if(head == tail)
+    {
+        if(SocketShmClientClosed(&thread_conn))
+            return 0;
+
+        int wait = SocketShmWait(client_socket, &p_ring->head, tail, &p_ring->data_seq, &p_ring->consumer_parked, timeout_us);
+
+        head = __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE);
+
+        if(head == tail)
+            return (wait > 0 ? 0 : SOCKET_SHM_AVAILABLE_TIMEOUT);
+    }
+
+    if(!SocketShmPositionsValid(&thread_conn, client_socket, head, tail))
+        return SOCKET_SHM_AVAILABLE_PROTOCOL;
+
+    return (long)(head - tail);
+}
+
+/// @brief Copies data out of the client-to-server ring, wrapping around its end if needed.
+/// @param p_conn Connection state.
+/// @param rx_buffer RX buffer.
+/// @param tail Position to copy from.
+/// @param size Amount of bytes to copy.
+static void SocketShmCopyOut(const SOCKET_SHM_CONN* p_conn, char* rx_buffer, const unsigned long long tail, const unsigned long size)
+{
+    unsigned long offset = tail & (p_conn->ring_size - 1);
+    unsigned long first_size = p_conn->ring_size - offset;
+
+    if(first_size > size)
+        first_size = size;
+
+    memcpy(rx_buffer, p_conn->p_rx_data + offset, first_size);
+    memcpy(rx_buffer + first_size, p_conn->p_rx_data, size - first_size);
+}
+
+/// @brief Updates I/O statistics (and pushes idle deadline forward) after a read/write operation on the rings.
+/// @param io_result Value returned by the read/write operation.
+/// @param bytes_cnt Counter to add transferred bytes to.
+/// @param bytes_hist Histogram to record transferred bytes into.
+static void SocketShmAccountIO(const int io_result, const SERVER_SOCKET_CNT bytes_cnt, const SERVER_SOCKET_HIST bytes_hist)
+{
+    if(io_result > 0)
+    {
+        SocketStatsCount(bytes_cnt, io_result);
+        SocketStatsRecord(bytes_hist, io_result);
+        SocketTimerTouch();
+    }
+}
+
+/// @brief Sets shared-memory transport parameters. To be called before ServerSocketRun.
+/// @param ring_size Size of each ring (rounded up to a power of two, at least a page), 0 to disable the transport.
+/// @param spin_us Time an empty (or full) ring is polled for before parking.
+void ServerSocketSetSharedMemory(const unsigned long ring_size, const unsigned long spin_us)
+{
+    unsigned long size = sysconf(_SC_PAGESIZE);
+
+    while(size < ring_size && size < SOCKET_SHM_MAX_RING_SIZE)
+        size <<= 1;
+
+    shm_ring_size = (ring_size > 0 ? size : 0);
+
+    // With a single CPU, the other side cannot move while this one spins.
+    shm_spin_us = (sysconf(_SC_NPROCESSORS_ONLN) > 1 ? (long)spin_us : 0);
+}
+
+/// @brief Upgrades the current connection to shared-memory rings. To be called from the interaction function.
+/// @param client_socket Client socket.
+/// @return 0 if succeeded, < 0 otherwise.
+int ServerSocketEnableSharedMemory(int client_socket)
+{
+    SOCKET_SHM_CONN* p_conn = &thread_conn;
+
+    if(shm_ring_size == 0)
+        return SERVER_SOCKET_SHM_ERR_DISABLED;
+
+    if(socket_shm_active)
+        return SERVER_SOCKET_SHM_SUCCESS;
+
+    // Compressed frames are meant for the wire, rings do not need them.
+    if(SocketCompressActive())
+        return SERVER_SOCKET_SHM_ERR_COMPRESS;
+
+    if(!SocketShmPeerIsLocal(client_socket))
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_SHM_NOT_LOCAL, client_socket);
+        return SERVER_SOCKET_SHM_ERR_PEER;
+    }
+
+    if(SocketShmMapRegion(p_conn) < 0)
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_SHM_REGION_NOK, client_socket);
+        return SERVER_SOCKET_SHM_ERR_REGION;
+    }
+
+    SERVER_SOCKET_SHM_REPLY reply =
+    {
+        .magic      = SERVER_SOCKET_SHM_MAGIC,
+        .version    = SERVER_SOCKET_SHM_VERSION,
+        .map_size   = p_conn->map_size,
+    };
+
+    int channel = SocketShmOpenChannel(&reply);
+
+    if(channel < 0)
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_SHM_REGION_NOK, client_socket);
+        SocketShmUnmapRegion(p_conn);
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+    }
+
+    // Reply goes through the current transport (TLS included): the rings only take over once it is out.
+    if(ServerSocketWrite(client_socket, (const char*)&reply, sizeof(reply)) != sizeof(reply))
+    {
+        close(channel);
+        SocketShmUnmapRegion(p_conn);
+        return SERVER_SOCKET_SHM_ERR_REPLY;
+    }
+
+    int send_status = SocketShmSendRegion(p_conn, channel, reply.token);
+    close(channel);
+
+    if(send_status < 0)
+    {
+        SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_SHM_CHANNEL_NOK, client_socket);
+        SocketShmUnmapRegion(p_conn);
+        return SERVER_SOCKET_SHM_ERR_CHANNEL;
+    }
+
+    // Client holds its own descriptor now, the mapping keeps the region alive on this side.
+    close(p_conn->memfd);
+    p_conn->memfd = -1;
+
+    p_conn->rx_timeout_us = ServerSocketGetTimeoutUs(client_socket, SO_RCVTIMEO);
+    p_conn->tx_timeout_us = ServerSocketGetTimeoutUs(client_socket, SO_SNDTIMEO);
+
+    // Broadcasts are not written to the rings, as clients only watch them once attached.
+    SocketBroadcastDetach();
+
+    socket_shm_active = true;
+    SocketStatsCount(SERVER_SOCKET_CNT_SHM_UPGRADES, 1);
+
+    return SERVER_SOCKET_SHM_SUCCESS;
+}
+
+/// @brief Reads from the client-to-server ring, waiting for data as a blocking socket read would.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes read if > 0, 0 if client got disconnected, < 0 if no data could be read (errno EAGAIN, or EPROTO
+/// if the client corrupted ring positions).
+int SocketShmRead(const int client_socket, char* rx_buffer, const unsigned long rx_buffer_size)
+{
+    SOCKET_SHM_CONN* p_conn = &thread_conn;
+    SERVER_SOCKET_SHM_RING* p_ring = p_conn->p_rx_ring;
+    long available = SocketShmAvailable(client_socket, p_conn->rx_timeout_us);
+
+    if(available == SOCKET_SHM_AVAILABLE_PROTOCOL)
+    {
+        errno = EPROTO;
+        return SERVER_SOCKET_SHM_ERR_PROTOCOL;
+    }
+
+    if(available <= 0)
+    {
+        if(available < 0)
+            errno = EAGAIN;
+
+        return (int)available;
+    }
+
+    unsigned long read_size = ((unsigned long)available < rx_buffer_size ? (unsigned long)available : rx_buffer_size);
+    unsigned long long tail = __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED);
+
+    SocketShmCopyOut(p_conn, rx_buffer, tail, read_size);
+
+    __atomic_store_n(&p_ring->tail, tail + read_size, __ATOMIC_RELEASE);
+    SocketShmNotify(&p_ring->producer_parked, &p_ring->space_seq);
+
+    SocketShmAccountIO((int)read_size, SERVER_SOCKET_CNT_BYTES_IN, SERVER_SOCKET_HIST_READ_BYTES);
+
+    return (int)read_size;
+}
+
+/// @brief Reads from the client-to-server ring without consuming read data.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return Amount of bytes available if > 0, 0 if client got disconnected, < 0 if no data could be read (errno EAGAIN, or
+/// EPROTO if the client corrupted ring positions).
+int SocketShmPeek(const int client_socket, char* rx_buffer, const unsigned long rx_buffer_size)
+{
+    SOCKET_SHM_CONN* p_conn = &thread_conn;
+    long available = SocketShmAvailable(client_socket, p_conn->rx_timeout_us);
+
+    if(available == SOCKET_SHM_AVAILABLE_PROTOCOL)
+    {
+        errno = EPROTO;
+        return SERVER_SOCKET_SHM_ERR_PROTOCOL;
+    }
+
+    if(available <= 0)
+    {
+        if(available < 0)
+            errno = EAGAIN;
+
+        return (int)available;
+    }
+
+    unsigned long peek_size = ((unsigned long)available < rx_buffer_size ? (unsigned long)available : rx_buffer_size);
+
+    SocketShmCopyOut(p_conn, rx_buffer, __atomic_load_n(&p_conn->p_rx_ring->tail, __ATOMIC_RELAXED), peek_size);
+
+    return (int)peek_size;
+}
+
+/// @brief Writes to the server-to-client ring, waiting for space as a blocking socket write would.
+/// Everything is written unless the client is gone or stops consuming for longer than the socket's send timeout.
+/// @param client_socket Client socket.
+/// @param p_iov Data chunks, all of them sent as a single stream of bytes.
+/// @param iov_num Amount of chunks.
+/// @return Amount of bytes written (all of them) if succeeded, < 0 otherwise.
+int SocketShmWritev(const int client_socket, const struct iovec* p_iov, const int iov_num)
+{
+    SOCKET_SHM_CONN* p_conn = &thread_conn;
+    SERVER_SOCKET_SHM_RING* p_ring = p_conn->p_tx_ring;
+    unsigned long long head = __atomic_load_n(&p_ring->head, __ATOMIC_RELAXED);
+    unsigned long total = 0;
+    unsigned long iov_offset = 0;
+    int iov_idx = 0;
+
+    while(iov_idx < iov_num)
+    {
+        if(p_conn->protocol_error)
+        {
+            errno = EPROTO;
+            return SERVER_SOCKET_SHM_ERR_PROTOCOL;
+        }
+
+        if(SocketShmClientClosed(p_conn))
+        {
+            errno = EPIPE;
+            SocketStatsCount(SERVER_SOCKET_CNT_IO_ERRORS, 1);
+            return SERVER_SOCKET_SHM_ERR_WRITE;
+        }
+
+        unsigned long long tail = __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE);
+
+        if(!SocketShmPositionsValid(p_conn, client_socket, head, tail))
+            continue;
+
+        unsigned long free_space = p_conn->ring_size - (unsigned long)(head - tail);
+
+        if(free_space == 0)
+        {
+            if(SocketShmWait(client_socket, &p_ring->tail, tail, &p_ring->space_seq, &p_ring->producer_parked, p_conn->tx_timeout_us) == 0)
+            {
+                errno = EAGAIN;
+                return SERVER_SOCKET_SHM_ERR_WRITE;
+            }
+
+            continue;
+        }
+
+        // Fill as much free space as possible before publishing, so the client gets woken up once per batch of chunks.
+        while(iov_idx < iov_num && free_space > 0)
+        {
+            unsigned long chunk_size = p_iov[iov_idx].iov_len - iov_offset;
+            unsigned long offset = head & (p_conn->ring_size - 1);
+
+            if(chunk_size > free_space)
+                chunk_size = free_space;
+
+            if(chunk_size > p_conn->ring_size - offset)
+                chunk_size = p_conn->ring_size - offset;
+
+            memcpy(p_conn->p_tx_data + offset, (const char*)p_iov[iov_idx].iov_base + iov_offset, chunk_size);
+
+            head += chunk_size;
+            free_space -= chunk_size;
+            total += chunk_size;
+            iov_offset += chunk_size;
+
+            if(iov_offset == p_iov[iov_idx].iov_len)
+            {
+                iov_idx++;
+                iov_offset = 0;
+            }
+        }
+
+        __atomic_store_n(&p_ring->head, head, __ATOMIC_RELEASE);
+        SocketShmNotify(&p_ring->consumer_parked, &p_ring->data_seq);
+    }
+
+    SocketShmAccountIO((int)total, SERVER_SOCKET_CNT_BYTES_OUT, SERVER_SOCKET_HIST_WRITE_BYTES);
+
+    return (int)total;
+}
+
+/// @brief Waits until data is available on the client-to-server ring, or the client is gone.
+/// @param client_socket Client socket.
+/// @param timeout_us Maximum time to wait for, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return > 0 if readable, 0 if timed out, < 0 if the client corrupted ring positions (errno EPROTO).
+int SocketShmWaitReadable(const int client_socket, const long timeout_us)
+{
+    long available = SocketShmAvailable(client_socket, timeout_us);
+
+    if(available == SOCKET_SHM_AVAILABLE_PROTOCOL)
+    {
+        errno = EPROTO;
+        return SERVER_SOCKET_SHM_ERR_PROTOCOL;
+    }
+
+    return (available >= 0 ? 1 : 0);
+}
+
+/// @brief Flags the region as closed, wakes the client up if it is parked, and unmaps the region.
+/// To be called once the connection is over.
+void SocketShmRelease(void)
+{
+    SOCKET_SHM_CONN* p_conn = &thread_conn;
+
+    if(!socket_shm_active)
+        return;
+
+    socket_shm_active = false;
+
+    __atomic_store_n(&p_conn->p_header->server_closed, 1, __ATOMIC_RELEASE);
+
+    SocketShmBump(&p_conn->p_tx_ring->data_seq);
+    SocketShmBump(&p_conn->p_rx_ring->space_seq);
+
+    SocketShmUnmapRegion(p_conn);
+}
+
+/*************************************/
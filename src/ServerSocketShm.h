@@ -0,0 +1,47 @@
+#ifndef SERVER_SOCKET_SHM_H
+#define SERVER_SOCKET_SHM_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+#include <sys/uio.h>
+
+/************************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Tells whether the connection served by the current thread goes through shared-memory rings.
+extern __thread bool socket_shm_active;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+int SocketShmRead(int client_socket, char* rx_buffer, unsigned long rx_buffer_size);
+int SocketShmPeek(int client_socket, char* rx_buffer, unsigned long rx_buffer_size);
+int SocketShmWritev(int client_socket, const struct iovec* p_iov, int iov_num);
+int SocketShmWaitReadable(int client_socket, long timeout_us);
+void SocketShmRelease(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Tells whether reads and writes on the current thread go through shared-memory rings. Cheap enough for every call.
+/// @return True if the current connection has been upgraded, false otherwise.
+static inline bool SocketShmActive(void)
+{
+    return socket_shm_active;
+}
+
+/*************************************/
+
+#endif
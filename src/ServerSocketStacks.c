@@ -0,0 +1,272 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>             // Page size.
+#include <limits.h>             // PTHREAD_STACK_MIN.
+#include <sys/mman.h>
+#include "ServerSocketStacks.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_STACKS_SUCCESS        0
+#define SERVER_SOCKET_STACKS_ERR_ATTR       -1
+#define SERVER_SOCKET_STACKS_ERR_ALLOC      -2
+
+#define SOCKET_STACKS_DISABLED              0
+
+#define SERVER_SOCKET_MSG_STACK_TOO_SMALL   "Serving thread stack size <%lu> is below the minimum, using <%lu> instead."
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Thread stack, guard area included (at its lowest addresses).
+struct SOCKET_STACK
+{
+    struct SOCKET_STACK*    next;
+    void*                   p_mapping;
+    size_t                  mapping_size;
+    pthread_t               thread;         // Thread which last ran on it, to be joined before reusing it.
+};
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static size_t       stacks_stack_size   = SOCKET_STACKS_DISABLED;
+static size_t       stacks_guard_size   = 0;
+static unsigned int stacks_cache_size   = 0;
+
+/// @brief Stacks ready to be reused.
+static SOCKET_STACK*    p_free_stacks       = NULL;
+static unsigned int     free_stacks_num     = 0;
+/// @brief Stacks whose thread is done serving but may still be running on them.
+static SOCKET_STACK*    p_retired_stacks    = NULL;
+static pthread_mutex_t  stacks_mtx          = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static size_t SocketStacksPageAlign(size_t size);
+static SOCKET_STACK* SocketStackCreate(void);
+static void SocketStackDestroy(SOCKET_STACK* p_stack);
+static void SocketStacksReap(void);
+static SOCKET_STACK* SocketStackTake(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Rounds a size up to a whole amount of memory pages.
+/// @param size Size in bytes.
+/// @return Page aligned size.
+static size_t SocketStacksPageAlign(const size_t size)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    return (size + page_size - 1) & ~(page_size - 1);
+}
+
+/// @brief Maps a new stack. Pages are only backed by memory once touched, and the guard area is made inaccessible.
+/// @return New stack, NULL if it could not be mapped.
+static SOCKET_STACK* SocketStackCreate(void)
+{
+    SOCKET_STACK* p_stack = malloc(sizeof(SOCKET_STACK));
+
+    if(!p_stack)
+        return NULL;
+
+    p_stack->mapping_size = stacks_guard_size + stacks_stack_size;
+    p_stack->p_mapping = mmap(NULL, p_stack->mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+
+    if(p_stack->p_mapping == MAP_FAILED || (stacks_guard_size > 0 && mprotect(p_stack->p_mapping, stacks_guard_size, PROT_NONE) < 0))
+    {
+        if(p_stack->p_mapping != MAP_FAILED)
+            munmap(p_stack->p_mapping, p_stack->mapping_size);
+
+        free(p_stack);
+        return NULL;
+    }
+
+    return p_stack;
+}
+
+/// @brief Unmaps a stack.
+/// @param p_stack Target stack, whose thread must be already joined.
+static void SocketStackDestroy(SOCKET_STACK* p_stack)
+{
+    munmap(p_stack->p_mapping, p_stack->mapping_size);
+    free(p_stack);
+}
+
+/// @brief Joins every thread done serving, then caches their stacks (or unmaps them if the cache is full).
+static void SocketStacksReap(void)
+{
+    pthread_mutex_lock(&stacks_mtx);
+    SOCKET_STACK* p_retired = p_retired_stacks;
+    p_retired_stacks = NULL;
+    pthread_mutex_unlock(&stacks_mtx);
+
+    while(p_retired)
+    {
+        SOCKET_STACK* p_next = p_retired->next;
+
+        // Threads retire their stack right before exiting, so this does not wait long.
+        pthread_join(p_retired->thread, NULL);
+
+        SocketStackRelease(p_retired);
+
+        p_retired = p_next;
+    }
+}
+
+/// @brief Takes a cached stack, or maps a new one if there is none.
+/// @return Stack, NULL if it could not be mapped.
+static SOCKET_STACK* SocketStackTake(void)
+{
+    SocketStacksReap();
+
+    pthread_mutex_lock(&stacks_mtx);
+
+    SOCKET_STACK* p_stack = p_free_stacks;
+
+    if(p_stack)
+    {
+        p_free_stacks = p_stack->next;
+        free_stacks_num--;
+    }
+
+    pthread_mutex_unlock(&stacks_mtx);
+
+    return (p_stack ? p_stack : SocketStackCreate());
+}
+
+/// @brief Sets serving threads' profile. To be called before ServerSocketRun.
+/// @param stack_size Stack size (raised to SERVER_SOCKET_MIN_STACK_SIZE if smaller), 0 to use system defaults (default).
+/// @param guard_size Guard area below each stack.
+/// @param stack_cache_size Amount of stacks kept for reuse once their connection is over, 0 to let the C library manage them.
+void ServerSocketSetThreadProfile(const unsigned long stack_size, const unsigned long guard_size, const unsigned int stack_cache_size)
+{
+    unsigned long min_stack_size = (SERVER_SOCKET_MIN_STACK_SIZE > PTHREAD_STACK_MIN ? SERVER_SOCKET_MIN_STACK_SIZE : PTHREAD_STACK_MIN);
+
+    // Smaller stacks crash serving threads on their deepest paths (TLS handshakes) rather than failing anything up front.
+    if(stack_size > 0 && stack_size < min_stack_size)
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_STACK_TOO_SMALL, stack_size, min_stack_size);
+
+    stacks_stack_size   = (stack_size > 0 ? SocketStacksPageAlign(stack_size < min_stack_size ? min_stack_size : stack_size) : SOCKET_STACKS_DISABLED);
+    stacks_guard_size   = SocketStacksPageAlign(guard_size);
+    stacks_cache_size   = stack_cache_size;
+}
+
+/// @brief Sets serving thread's stack attributes according to the thread profile.
+/// @param p_attr Initialized thread attributes to be set.
+/// @param pp_stack Target variable to which the cached stack (if any) is written. It must be given back by the thread
+/// once it is over (SocketStackRetire), the thread not being detached then, or straight away if the thread could not be created.
+/// @return 1 if attributes were set, 0 if default attributes are fine, < 0 if any error happened.
+int SocketStacksThreadAttr(pthread_attr_t* p_attr, SOCKET_STACK** pp_stack)
+{
+    *pp_stack = NULL;
+
+    if(stacks_stack_size == SOCKET_STACKS_DISABLED)
+        return 0;
+
+    if(stacks_cache_size == 0)
+    {
+        if(pthread_attr_setstacksize(p_attr, stacks_stack_size) != 0 || pthread_attr_setguardsize(p_attr, stacks_guard_size) != 0)
+            return SERVER_SOCKET_STACKS_ERR_ATTR;
+
+        return 1;
+    }
+
+    SOCKET_STACK* p_stack = SocketStackTake();
+
+    if(!p_stack)
+        return SERVER_SOCKET_STACKS_ERR_ALLOC;
+
+    if(pthread_attr_setstack(p_attr, (char*)p_stack->p_mapping + stacks_guard_size, stacks_stack_size) != 0)
+    {
+        SocketStackRelease(p_stack);
+        return SERVER_SOCKET_STACKS_ERR_ATTR;
+    }
+
+    *pp_stack = p_stack;
+
+    return 1;
+}
+
+/// @brief Gives a stack back from the thread running on it. To be called right before exiting, instead of detaching.
+/// Threads which retired earlier are reaped first, so stacks do not wait for the next connection to be reused or unmapped.
+/// @param p_stack Stack the current thread runs on.
+void SocketStackRetire(SOCKET_STACK* p_stack)
+{
+    // Only threads retired before this point are joined, and they never join this one, so threads cannot join each other.
+    SocketStacksReap();
+
+    p_stack->thread = pthread_self();
+
+    pthread_mutex_lock(&stacks_mtx);
+    p_stack->next = p_retired_stacks;
+    p_retired_stacks = p_stack;
+    pthread_mutex_unlock(&stacks_mtx);
+}
+
+/// @brief Caches a stack no thread runs on, or unmaps it if the cache is full.
+/// @param p_stack Target stack.
+void SocketStackRelease(SOCKET_STACK* p_stack)
+{
+    pthread_mutex_lock(&stacks_mtx);
+
+    bool cached = (free_stacks_num < stacks_cache_size);
+
+    if(cached)
+    {
+        p_stack->next = p_free_stacks;
+        p_free_stacks = p_stack;
+        free_stacks_num++;
+    }
+
+    pthread_mutex_unlock(&stacks_mtx);
+
+    if(!cached)
+        SocketStackDestroy(p_stack);
+}
+
+/// @brief Frees resources priorly allocated by stacks submodule. To be called once serving threads are over.
+void SocketFreeStacksResources(void)
+{
+    SocketStacksReap();
+
+    pthread_mutex_lock(&stacks_mtx);
+
+    while(p_free_stacks)
+    {
+        SOCKET_STACK* p_next = p_free_stacks->next;
+        SocketStackDestroy(p_free_stacks);
+        p_free_stacks = p_next;
+    }
+
+    free_stacks_num = 0;
+
+    pthread_mutex_unlock(&stacks_mtx);
+}
+
+/*************************************/
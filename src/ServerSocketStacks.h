@@ -0,0 +1,32 @@
+#ifndef SERVER_SOCKET_STACKS_H
+#define SERVER_SOCKET_STACKS_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Cached thread stack.
+typedef struct SOCKET_STACK SOCKET_STACK;
+
+/**********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+int SocketStacksThreadAttr(pthread_attr_t* p_attr, SOCKET_STACK** pp_stack);
+void SocketStackRetire(SOCKET_STACK* p_stack);
+void SocketStackRelease(SOCKET_STACK* p_stack);
+void SocketFreeStacksResources(void);
+
+/*************************************/
+
+#endif
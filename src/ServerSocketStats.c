@@ -0,0 +1,287 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#define _GNU_SOURCE             // sched_getcpu.
+#include <sched.h>
+#include <time.h>               // clock_gettime.
+#include <string.h>
+#include "ServerSocketStats.h"
+#include "ServerSocketManageThreads.h"  // Active server instances.
+#include "ServerSocketCache.h"          // Cached bytes.
+#include "ServerSocket_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_STATS_SUCCESS         0
+#define SERVER_SOCKET_STATS_NULL_PTR        -1
+
+/// @brief Shards the statistics are spread across (one per CPU, CPUs beyond this number share them).
+#define SERVER_SOCKET_STATS_SHARDS_NUM      64
+
+/// @brief Histogram layout: values below 2^SUB_BUCKET_BITS are recorded exactly, then every power of two
+/// is split into 2^SUB_BUCKET_BITS linear sub-buckets, so the relative error never exceeds 1 / 2^(SUB_BUCKET_BITS + 1).
+#define SERVER_SOCKET_HIST_SUB_BUCKET_BITS  5
+#define SERVER_SOCKET_HIST_SUB_BUCKETS      (1UL << SERVER_SOCKET_HIST_SUB_BUCKET_BITS)
+#define SERVER_SOCKET_HIST_BUCKETS          ((64 - SERVER_SOCKET_HIST_SUB_BUCKET_BITS + 1) * SERVER_SOCKET_HIST_SUB_BUCKETS)
+
+#define SERVER_SOCKET_CACHE_LINE_SIZE       64
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief HDR-style histogram.
+typedef struct
+{
+    unsigned long count;
+    unsigned long sum;
+    unsigned long min_inv;  // Bitwise-inverted minimum, so that both min and max can be kept with atomic max (0 means no samples).
+    unsigned long max;
+    unsigned long buckets[SERVER_SOCKET_HIST_BUCKETS];
+} SERVER_SOCKET_HISTOGRAM;
+
+/// @brief Statistics shard. Every CPU writes to its own one, so writers hardly ever share cache lines.
+typedef struct __attribute__((aligned(SERVER_SOCKET_CACHE_LINE_SIZE)))
+{
+    unsigned long counters[SERVER_SOCKET_CNT_NUM];
+    SERVER_SOCKET_HISTOGRAM hists[SERVER_SOCKET_HIST_NUM];
+} SERVER_SOCKET_STATS_SHARD;
+
+/**********************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+/// @brief Statistics shards. Statically allocated: pages belonging to unused shards are never touched.
+static SERVER_SOCKET_STATS_SHARD stats_shards[SERVER_SOCKET_STATS_SHARDS_NUM];
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static SERVER_SOCKET_STATS_SHARD* SocketStatsGetShard(void);
+static unsigned long SocketStatsBucketIdx(const unsigned long value);
+static unsigned long SocketStatsBucketValue(const unsigned long bucket_idx);
+static void SocketStatsAtomicMax(unsigned long* p_target, const unsigned long value);
+static void SocketStatsMergeHist(const SERVER_SOCKET_HIST hist, SERVER_SOCKET_HIST_STATS* p_hist_stats);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Retrieves the shard belonging to the CPU the calling thread is running on.
+/// @return Pointer to statistics shard.
+static SERVER_SOCKET_STATS_SHARD* SocketStatsGetShard(void)
+{
+    int cpu = sched_getcpu();
+
+    if(cpu < 0)
+        cpu = 0;
+
+    return &stats_shards[cpu % SERVER_SOCKET_STATS_SHARDS_NUM];
+}
+
+/// @brief Calculates the bucket a value belongs to.
+/// @param value Value to be recorded.
+/// @return Bucket index.
+static unsigned long SocketStatsBucketIdx(const unsigned long value)
+{
+    if(value < SERVER_SOCKET_HIST_SUB_BUCKETS)
+        return value;
+
+    int shift = (63 - __builtin_clzl(value)) - SERVER_SOCKET_HIST_SUB_BUCKET_BITS;
+
+    return (shift + 1) * SERVER_SOCKET_HIST_SUB_BUCKETS + ((value >> shift) & (SERVER_SOCKET_HIST_SUB_BUCKETS - 1));
+}
+
+/// @brief Calculates the value a bucket stands for (its midpoint).
+/// @param bucket_idx Bucket index.
+/// @return Value represented by the bucket.
+static unsigned long SocketStatsBucketValue(const unsigned long bucket_idx)
+{
+    if(bucket_idx < SERVER_SOCKET_HIST_SUB_BUCKETS)
+        return bucket_idx;
+
+    unsigned long shift     = bucket_idx / SERVER_SOCKET_HIST_SUB_BUCKETS - 1;
+    unsigned long sub_idx   = bucket_idx % SERVER_SOCKET_HIST_SUB_BUCKETS;
+    unsigned long lowest    = (SERVER_SOCKET_HIST_SUB_BUCKETS + sub_idx) << shift;
+
+    return lowest + ((1UL << shift) >> 1);
+}
+
+/// @brief Atomically stores value into target if it is greater than target's current value.
+/// @param p_target Target variable.
+/// @param value Candidate value.
+static void SocketStatsAtomicMax(unsigned long* p_target, const unsigned long value)
+{
+    unsigned long current = __atomic_load_n(p_target, __ATOMIC_RELAXED);
+
+    while(value > current && !__atomic_compare_exchange_n(p_target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/// @brief Merges a histogram across every shard, then summarizes it.
+/// @param hist Target histogram.
+/// @param p_hist_stats Target summary.
+static void SocketStatsMergeHist(const SERVER_SOCKET_HIST hist, SERVER_SOCKET_HIST_STATS* p_hist_stats)
+{
+    unsigned long min_inv = 0;
+
+    *p_hist_stats = (SERVER_SOCKET_HIST_STATS){0};
+
+    for(int shard_idx = 0; shard_idx < SERVER_SOCKET_STATS_SHARDS_NUM; shard_idx++)
+    {
+        SERVER_SOCKET_HISTOGRAM* p_hist = &stats_shards[shard_idx].hists[hist];
+
+        if(__atomic_load_n(&p_hist->count, __ATOMIC_RELAXED) == 0)
+            continue;
+
+        p_hist_stats->sum += __atomic_load_n(&p_hist->sum, __ATOMIC_RELAXED);
+
+        unsigned long shard_min_inv = __atomic_load_n(&p_hist->min_inv, __ATOMIC_RELAXED);
+        unsigned long shard_max     = __atomic_load_n(&p_hist->max    , __ATOMIC_RELAXED);
+
+        if(shard_min_inv > min_inv)
+            min_inv = shard_min_inv;
+
+        if(shard_max > p_hist_stats->max)
+            p_hist_stats->max = shard_max;
+
+        // Count is calculated out of buckets, so that percentiles stay consistent even if samples keep being recorded meanwhile.
+        for(unsigned long bucket_idx = 0; bucket_idx < SERVER_SOCKET_HIST_BUCKETS; bucket_idx++)
+            p_hist_stats->count += __atomic_load_n(&p_hist->buckets[bucket_idx], __ATOMIC_RELAXED);
+    }
+
+    if(p_hist_stats->count == 0)
+        return;
+
+    p_hist_stats->min = ~min_inv;
+
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    unsigned long* p_percentiles[] = {&p_hist_stats->p50, &p_hist_stats->p90, &p_hist_stats->p99, &p_hist_stats->p999};
+    const int quantiles_num = sizeof(quantiles) / sizeof(quantiles[0]);
+
+    unsigned long cumulative = 0;
+    int quantile_idx = 0;
+
+    // Shards are summed bucket by bucket rather than merged into a local copy first, which would take ~15KB of the caller's
+    // (possibly small) stack. Buckets only grow, so every percentile is still reached if samples were recorded meanwhile.
+    for(unsigned long bucket_idx = 0; bucket_idx < SERVER_SOCKET_HIST_BUCKETS && quantile_idx < quantiles_num; bucket_idx++)
+    {
+        for(int shard_idx = 0; shard_idx < SERVER_SOCKET_STATS_SHARDS_NUM; shard_idx++)
+            cumulative += __atomic_load_n(&stats_shards[shard_idx].hists[hist].buckets[bucket_idx], __ATOMIC_RELAXED);
+
+        while(quantile_idx < quantiles_num && cumulative > 0 && cumulative >= quantiles[quantile_idx] * p_hist_stats->count)
+        {
+            unsigned long value = SocketStatsBucketValue(bucket_idx);
+
+            if(value < p_hist_stats->min)
+                value = p_hist_stats->min;
+            if(value > p_hist_stats->max)
+                value = p_hist_stats->max;
+
+            *p_percentiles[quantile_idx++] = value;
+        }
+    }
+}
+
+/// @brief Retrieves monotonic time.
+/// @return Current monotonic time in nanoseconds.
+unsigned long SocketStatsNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long)now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+/// @brief Increases a counter.
+/// @param cnt Target counter.
+/// @param value Amount to be added.
+void SocketStatsCount(const SERVER_SOCKET_CNT cnt, const unsigned long value)
+{
+    __atomic_add_fetch(&SocketStatsGetShard()->counters[cnt], value, __ATOMIC_RELAXED);
+}
+
+/// @brief Records a sample into a histogram.
+/// @param hist Target histogram.
+/// @param value Sample value.
+void SocketStatsRecord(const SERVER_SOCKET_HIST hist, const unsigned long value)
+{
+    SERVER_SOCKET_HISTOGRAM* p_hist = &SocketStatsGetShard()->hists[hist];
+
+    __atomic_add_fetch(&p_hist->buckets[SocketStatsBucketIdx(value)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&p_hist->sum, value, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&p_hist->count, 1, __ATOMIC_RELAXED);
+
+    SocketStatsAtomicMax(&p_hist->min_inv, ~value);
+    SocketStatsAtomicMax(&p_hist->max, value);
+}
+
+/// @brief Retrieves server runtime statistics. Can be called at any time without stopping traffic.
+/// @param p_stats Target structure to which statistics are meant to be copied.
+/// @return 0 if succeeded, < 0 otherwise.
+int ServerSocketGetStats(SERVER_SOCKET_STATS* p_stats)
+{
+    if(!p_stats)
+        return SERVER_SOCKET_STATS_NULL_PTR;
+
+    unsigned long counters[SERVER_SOCKET_CNT_NUM] = {0};
+
+    for(int shard_idx = 0; shard_idx < SERVER_SOCKET_STATS_SHARDS_NUM; shard_idx++)
+        for(int cnt = 0; cnt < SERVER_SOCKET_CNT_NUM; cnt++)
+            counters[cnt] += __atomic_load_n(&stats_shards[shard_idx].counters[cnt], __ATOMIC_RELAXED);
+
+    *p_stats = (SERVER_SOCKET_STATS){0};
+
+    p_stats->accepts            = counters[SERVER_SOCKET_CNT_ACCEPTS            ];
+    p_stats->refusals           = counters[SERVER_SOCKET_CNT_REFUSALS           ];
+    p_stats->accept_errors      = counters[SERVER_SOCKET_CNT_ACCEPT_ERRORS      ];
+    p_stats->handshake_failures = counters[SERVER_SOCKET_CNT_HANDSHAKE_FAILURES ];
+    p_stats->io_errors          = counters[SERVER_SOCKET_CNT_IO_ERRORS          ];
+    p_stats->bytes_in           = counters[SERVER_SOCKET_CNT_BYTES_IN           ];
+    p_stats->bytes_out          = counters[SERVER_SOCKET_CNT_BYTES_OUT          ];
+    p_stats->timeouts           = counters[SERVER_SOCKET_CNT_TIMEOUTS           ];
+    p_stats->payload_bytes_in   = counters[SERVER_SOCKET_CNT_PAYLOAD_BYTES_IN   ];
+    p_stats->payload_bytes_out  = counters[SERVER_SOCKET_CNT_PAYLOAD_BYTES_OUT  ];
+    p_stats->cache_hits         = counters[SERVER_SOCKET_CNT_CACHE_HITS         ];
+    p_stats->cache_misses       = counters[SERVER_SOCKET_CNT_CACHE_MISSES       ];
+    p_stats->cache_evictions    = counters[SERVER_SOCKET_CNT_CACHE_EVICTIONS    ];
+    p_stats->cache_bytes        = SocketCacheBytes();
+    p_stats->shm_upgrades       = counters[SERVER_SOCKET_CNT_SHM_UPGRADES       ];
+    p_stats->broadcast_drops    = counters[SERVER_SOCKET_CNT_BROADCAST_DROPS    ];
+    p_stats->buffer_resizes     = counters[SERVER_SOCKET_CNT_BUFFER_RESIZES     ];
+    p_stats->lowat_waits        = counters[SERVER_SOCKET_CNT_LOWAT_WAITS        ];
+    p_stats->tls_shutdown_timeouts = counters[SERVER_SOCKET_CNT_TLS_SHUTDOWN_TIMEOUTS];
+    p_stats->class_refusals     = counters[SERVER_SOCKET_CNT_CLASS_REFUSALS     ];
+    p_stats->zerocopy_bytes_in  = counters[SERVER_SOCKET_CNT_ZEROCOPY_BYTES_IN  ];
+    p_stats->active_connections = SocketGetActiveServerInstancesNum();
+
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_ACCEPT_TO_DISPATCH  , &p_stats->accept_to_dispatch_ns   );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_HANDSHAKE           , &p_stats->handshake_ns            );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_INTERACT            , &p_stats->interact_ns             );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_READ_BYTES          , &p_stats->read_bytes              );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_WRITE_BYTES         , &p_stats->write_bytes             );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_LIFETIME            , &p_stats->lifetime_ns             );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_RTT                 , &p_stats->rtt_us                  );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_BDP                 , &p_stats->bdp_bytes               );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_TEARDOWN            , &p_stats->teardown_ns             );
+    SocketStatsMergeHist(SERVER_SOCKET_HIST_SCHEDULE_WAIT       , &p_stats->schedule_wait_ns        );
+
+    ServerSocketGetMemStats(&p_stats->mem_stats);
+
+    return SERVER_SOCKET_STATS_SUCCESS;
+}
+
+/*************************************/
@@ -0,0 +1,66 @@
+#ifndef SERVER_SOCKET_STATS_H
+#define SERVER_SOCKET_STATS_H
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Recorded histograms.
+typedef enum
+{
+    SERVER_SOCKET_HIST_ACCEPT_TO_DISPATCH = 0   ,
+    SERVER_SOCKET_HIST_HANDSHAKE                ,
+    SERVER_SOCKET_HIST_INTERACT                 ,
+    SERVER_SOCKET_HIST_READ_BYTES               ,
+    SERVER_SOCKET_HIST_WRITE_BYTES              ,
+    SERVER_SOCKET_HIST_LIFETIME                 ,
+    SERVER_SOCKET_HIST_RTT                      ,
+    SERVER_SOCKET_HIST_BDP                      ,
+    SERVER_SOCKET_HIST_TEARDOWN                 ,
+    SERVER_SOCKET_HIST_SCHEDULE_WAIT            ,
+
+    SERVER_SOCKET_HIST_NUM                      ,
+
+} SERVER_SOCKET_HIST;
+
+/// @brief Recorded counters.
+typedef enum
+{
+    SERVER_SOCKET_CNT_ACCEPTS = 0           ,
+    SERVER_SOCKET_CNT_REFUSALS              ,
+    SERVER_SOCKET_CNT_ACCEPT_ERRORS         ,
+    SERVER_SOCKET_CNT_HANDSHAKE_FAILURES    ,
+    SERVER_SOCKET_CNT_IO_ERRORS             ,
+    SERVER_SOCKET_CNT_BYTES_IN              ,
+    SERVER_SOCKET_CNT_BYTES_OUT             ,
+    SERVER_SOCKET_CNT_TIMEOUTS              ,
+    SERVER_SOCKET_CNT_PAYLOAD_BYTES_IN      ,
+    SERVER_SOCKET_CNT_PAYLOAD_BYTES_OUT     ,
+    SERVER_SOCKET_CNT_CACHE_HITS            ,
+    SERVER_SOCKET_CNT_CACHE_MISSES          ,
+    SERVER_SOCKET_CNT_CACHE_EVICTIONS       ,
+    SERVER_SOCKET_CNT_SHM_UPGRADES          ,
+    SERVER_SOCKET_CNT_BROADCAST_DROPS       ,
+    SERVER_SOCKET_CNT_BUFFER_RESIZES        ,
+    SERVER_SOCKET_CNT_LOWAT_WAITS           ,
+    SERVER_SOCKET_CNT_TLS_SHUTDOWN_TIMEOUTS ,
+    SERVER_SOCKET_CNT_CLASS_REFUSALS        ,
+    SERVER_SOCKET_CNT_ZEROCOPY_BYTES_IN     ,
+
+    SERVER_SOCKET_CNT_NUM                   ,
+
+} SERVER_SOCKET_CNT;
+
+/**********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+unsigned long SocketStatsNowNs(void);
+void SocketStatsCount(const SERVER_SOCKET_CNT cnt, const unsigned long value);
+void SocketStatsRecord(const SERVER_SOCKET_HIST hist, const unsigned long value);
+
+/*************************************/
+
+#endif
@@ -0,0 +1,398 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <pthread.h>
+#include <signal.h>             // Keep signals away from the timer thread.
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/socket.h>         // shutdown.
+#include "ServerSocketTimers.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_TIMERS_SUCCESS        0
+#define SERVER_SOCKET_TIMERS_ERR_THREAD     -1
+
+#define SOCKET_TIMERS_TICK_MS               10
+#define SOCKET_TIMERS_WHEEL_BITS            6
+#define SOCKET_TIMERS_WHEEL_SLOTS           (1 << SOCKET_TIMERS_WHEEL_BITS)
+#define SOCKET_TIMERS_WHEEL_MASK            (SOCKET_TIMERS_WHEEL_SLOTS - 1)
+#define SOCKET_TIMERS_WHEEL_LEVELS          4   // 64^4 ticks of 10ms, about 46 hours.
+#define SOCKET_TIMERS_WHEEL_MAX_TICKS       (1UL << (SOCKET_TIMERS_WHEEL_BITS * SOCKET_TIMERS_WHEEL_LEVELS))
+#define SOCKET_TIMERS_NEVER                 ULONG_MAX
+#define SOCKET_TIMERS_MS_PER_SEC            1000UL
+#define SOCKET_TIMERS_NS_PER_MS             1000000UL
+
+#define SOCKET_TIMERS_LEVEL_SHIFT(level)    ((level) * SOCKET_TIMERS_WHEEL_BITS)
+#define SOCKET_TIMERS_LEVEL_SLOT(tick, level) (((tick) >> SOCKET_TIMERS_LEVEL_SHIFT(level)) & SOCKET_TIMERS_WHEEL_MASK)
+
+#define SERVER_SOCKET_MSG_TIMERS_THREAD_NOK "Could not create timers thread: <%s>."
+#define SERVER_SOCKET_MSG_TIMERS_OK         "Deadlines enabled (idle: <%lu> ms, handshake: <%lu> ms, request: <%lu> ms)."
+#define SERVER_SOCKET_MSG_TIMERS_CLEANUP    "Cleaning up timers."
+#define SERVER_SOCKET_MSG_TIMER_EXPIRED     "Deadline expired for client socket <%d>, shutting it down."
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long idle_timeout_ms        = 0;
+static unsigned long handshake_timeout_ms   = 0;
+static unsigned long request_timeout_ms     = 0;
+
+/// @brief Hierarchical wheel: level n slots span 64^n ticks each. Timers are moved down a level as their slot comes up.
+static SOCKET_TIMER*    wheel[SOCKET_TIMERS_WHEEL_LEVELS][SOCKET_TIMERS_WHEEL_SLOTS];
+/// @brief Next tick to be processed.
+static unsigned long    wheel_tick;
+static pthread_mutex_t  wheel_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t        timers_thread;
+static bool             timers_thread_running   = false;
+static bool             timers_stop             = false;
+
+/***********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+__thread SOCKET_TIMER* p_socket_timer_current = NULL;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static unsigned long SocketTimerMsToTick(const unsigned long ms);
+static unsigned long SocketTimerDeadlineMs(const SOCKET_TIMER* p_timer);
+static void SocketTimerLink(SOCKET_TIMER* p_timer, unsigned long expires);
+static void SocketTimerUnlink(SOCKET_TIMER* p_timer);
+static int SocketTimersCascade(const int level);
+static void SocketTimersExpire(void);
+static void* SocketTimersRoutine(void* args);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Converts a deadline into the tick it is due at (rounding up, so timers never fire early).
+/// @param ms Deadline in milliseconds.
+/// @return Wheel tick.
+static unsigned long SocketTimerMsToTick(const unsigned long ms)
+{
+    if(ms == SOCKET_TIMERS_NEVER)
+        return SOCKET_TIMERS_NEVER;
+
+    return (ms + SOCKET_TIMERS_TICK_MS - 1) / SOCKET_TIMERS_TICK_MS;
+}
+
+/// @brief Computes the earliest of the deadlines currently applying to a connection.
+/// @param p_timer Connection timer.
+/// @return Deadline in milliseconds, SOCKET_TIMERS_NEVER if there is none.
+static unsigned long SocketTimerDeadlineMs(const SOCKET_TIMER* p_timer)
+{
+    unsigned long deadline_ms = __atomic_load_n(&p_timer->stage_deadline_ms, __ATOMIC_RELAXED);
+
+    if(idle_timeout_ms > 0)
+    {
+        unsigned long idle_deadline_ms = __atomic_load_n(&p_timer->last_io_ms, __ATOMIC_RELAXED) + idle_timeout_ms;
+
+        if(idle_deadline_ms < deadline_ms)
+            deadline_ms = idle_deadline_ms;
+    }
+
+    return deadline_ms;
+}
+
+/// @brief Queues a timer in the wheel. To be called with wheel_mtx locked.
+/// @param p_timer Timer to be queued.
+/// @param expires Tick the timer is due at. Overdue timers are processed on the next tick,
+/// those beyond the wheel's range get queued at its far end and are re-queued from there.
+static void SocketTimerLink(SOCKET_TIMER* p_timer, unsigned long expires)
+{
+    if(expires < wheel_tick)
+        expires = wheel_tick;
+
+    if(expires - wheel_tick >= SOCKET_TIMERS_WHEEL_MAX_TICKS)
+        expires = wheel_tick + SOCKET_TIMERS_WHEEL_MAX_TICKS - 1;
+
+    unsigned long delta = expires - wheel_tick;
+    int level = 0;
+
+    while(level < SOCKET_TIMERS_WHEEL_LEVELS - 1 && delta >= (1UL << SOCKET_TIMERS_LEVEL_SHIFT(level + 1)))
+        level++;
+
+    SOCKET_TIMER** pp_slot = &wheel[level][SOCKET_TIMERS_LEVEL_SLOT(expires, level)];
+
+    p_timer->expires = expires;
+    p_timer->next = *pp_slot;
+    p_timer->pprev = pp_slot;
+
+    if(*pp_slot)
+        (*pp_slot)->pprev = &p_timer->next;
+
+    *pp_slot = p_timer;
+}
+
+/// @brief Removes a timer from the wheel if it is queued. To be called with wheel_mtx locked.
+/// @param p_timer Timer to be removed.
+static void SocketTimerUnlink(SOCKET_TIMER* p_timer)
+{
+    if(!p_timer->pprev)
+        return;
+
+    *p_timer->pprev = p_timer->next;
+
+    if(p_timer->next)
+        p_timer->next->pprev = p_timer->pprev;
+
+    p_timer->next = NULL;
+    p_timer->pprev = NULL;
+}
+
+/// @brief Moves the timers found in the current slot of a given level one or more levels down.
+/// @param level Wheel level to cascade.
+/// @return Current slot index of the level (0 means the next level up has to be cascaded as well).
+static int SocketTimersCascade(const int level)
+{
+    int slot = SOCKET_TIMERS_LEVEL_SLOT(wheel_tick, level);
+    SOCKET_TIMER* p_timer = wheel[level][slot];
+
+    wheel[level][slot] = NULL;
+
+    while(p_timer)
+    {
+        SOCKET_TIMER* p_next = p_timer->next;
+        SocketTimerLink(p_timer, p_timer->expires);
+        p_timer = p_next;
+    }
+
+    return slot;
+}
+
+/// @brief Processes every tick up to the current one. Timers whose deadline has been pushed forward meanwhile
+/// are queued again, the rest get their connection shut down so the serving thread wakes up and closes it.
+/// Shutting down with wheel_mtx locked ensures no socket gets closed (and its descriptor reused) meanwhile.
+static void SocketTimersExpire(void)
+{
+    unsigned long now_tick = SocketTimersNowMs() / SOCKET_TIMERS_TICK_MS;
+
+    pthread_mutex_lock(&wheel_mtx);
+
+    while(wheel_tick <= now_tick)
+    {
+        int slot = SOCKET_TIMERS_LEVEL_SLOT(wheel_tick, 0);
+
+        for(int level = 1; slot == 0 && level < SOCKET_TIMERS_WHEEL_LEVELS; level++)
+            slot = SocketTimersCascade(level);
+
+        slot = SOCKET_TIMERS_LEVEL_SLOT(wheel_tick, 0);
+
+        SOCKET_TIMER* p_timer = wheel[0][slot];
+        wheel[0][slot] = NULL;
+
+        while(p_timer)
+        {
+            SOCKET_TIMER* p_next = p_timer->next;
+            unsigned long deadline_tick = SocketTimerMsToTick(SocketTimerDeadlineMs(p_timer));
+
+            p_timer->next = NULL;
+            p_timer->pprev = NULL;
+
+            if(deadline_tick > wheel_tick)
+                SocketTimerLink(p_timer, deadline_tick);
+            else
+            {
+                shutdown(p_timer->client_socket, SHUT_RDWR);
+                SocketStatsCount(SERVER_SOCKET_CNT_TIMEOUTS, 1);
+                SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_TIMER_EXPIRED, p_timer->client_socket);
+            }
+
+            p_timer = p_next;
+        }
+
+        wheel_tick++;
+    }
+
+    pthread_mutex_unlock(&wheel_mtx);
+}
+
+/// @brief Timers thread routine. Wakes up once per tick to expire due timers.
+/// @param args Unused.
+/// @return NULL.
+static void* SocketTimersRoutine(void* args)
+{
+    const struct timespec tick = {.tv_sec = 0, .tv_nsec = SOCKET_TIMERS_TICK_MS * SOCKET_TIMERS_NS_PER_MS};
+
+    while(!__atomic_load_n(&timers_stop, __ATOMIC_ACQUIRE))
+    {
+        nanosleep(&tick, NULL);
+        SocketTimersExpire();
+    }
+
+    return NULL;
+}
+
+/// @brief Current time, as used by timers (coarse monotonic clock, so it is cheap enough for every read and write).
+/// @return Milliseconds.
+unsigned long SocketTimersNowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return now.tv_sec * SOCKET_TIMERS_MS_PER_SEC + now.tv_nsec / SOCKET_TIMERS_NS_PER_MS;
+}
+
+/// @brief Sets per-connection deadlines. To be called before ServerSocketRun.
+/// @param idle_ms Maximum time without successful reads or writes, 0 to disable it.
+/// @param handshake_ms Maximum TLS handshake duration, 0 to disable it.
+/// @param request_ms Maximum duration of a single interaction function call, 0 to disable it.
+void ServerSocketSetTimeouts(const unsigned long idle_ms, const unsigned long handshake_ms, const unsigned long request_ms)
+{
+    idle_timeout_ms         = idle_ms;
+    handshake_timeout_ms    = handshake_ms;
+    request_timeout_ms      = request_ms;
+}
+
+/// @brief Tells whether any deadline has been set or not.
+/// @return True if any timeout is other than 0, false otherwise.
+bool SocketTimersEnabled(void)
+{
+    return (idle_timeout_ms > 0 || handshake_timeout_ms > 0 || request_timeout_ms > 0);
+}
+
+/// @brief Launches timers thread.
+/// @return 0 if succeeded, < 0 otherwise.
+int SocketLaunchTimers(void)
+{
+    sigset_t all_signals;
+    sigset_t previous_signals;
+
+    wheel_tick = SocketTimersNowMs() / SOCKET_TIMERS_TICK_MS;
+    __atomic_store_n(&timers_stop, false, __ATOMIC_RELAXED);
+
+    // Signals are meant to be handled by the main thread, so the thread inherits a fully blocked mask.
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous_signals);
+
+    int thread_creation_status = pthread_create(&timers_thread, NULL, SocketTimersRoutine, NULL);
+
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+
+    if(thread_creation_status != 0)
+    {
+        SVRTY_LOG_ERR(SERVER_SOCKET_MSG_TIMERS_THREAD_NOK, strerror(thread_creation_status));
+        return SERVER_SOCKET_TIMERS_ERR_THREAD;
+    }
+
+    __atomic_store_n(&timers_thread_running, true, __ATOMIC_RELEASE);
+
+    SVRTY_LOG_INF(SERVER_SOCKET_MSG_TIMERS_OK, idle_timeout_ms, handshake_timeout_ms, request_timeout_ms);
+
+    return SERVER_SOCKET_TIMERS_SUCCESS;
+}
+
+/// @brief Stops timers thread. Connections still being served keep going without deadlines.
+void SocketFreeTimersResources(void)
+{
+    if(!__atomic_load_n(&timers_thread_running, __ATOMIC_ACQUIRE))
+        return;
+
+    SVRTY_LOG_DBG(SERVER_SOCKET_MSG_TIMERS_CLEANUP);
+
+    __atomic_store_n(&timers_thread_running, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&timers_stop, true, __ATOMIC_RELEASE);
+    pthread_join(timers_thread, NULL);
+}
+
+/// @brief Arms the timer of the connection served by the current thread.
+/// @param p_timer Connection timer (zeroed or cancelled).
+/// @param client_socket Socket to be shut down if the deadline expires.
+/// @param stage Stage the connection starts at.
+void SocketTimerArm(SOCKET_TIMER* p_timer, const int client_socket, const SOCKET_TIMER_STAGE stage)
+{
+    if(!__atomic_load_n(&timers_thread_running, __ATOMIC_ACQUIRE))
+        return;
+
+    p_timer->client_socket      = client_socket;
+    p_timer->stage              = SOCKET_TIMER_STAGE_NONE;
+    p_timer->stage_deadline_ms  = SOCKET_TIMERS_NEVER;
+    p_timer->last_io_ms         = SocketTimersNowMs();
+
+    p_socket_timer_current = p_timer;
+
+    SocketTimerStage(stage);
+}
+
+/// @brief Starts a new stage deadline for the connection served by the current thread.
+/// Restarting the current stage is lock-free since deadlines only move forward then; changing stages may
+/// bring the deadline closer, so the timer is queued again if needed.
+/// @param stage Stage the connection is entering.
+void SocketTimerStage(const SOCKET_TIMER_STAGE stage)
+{
+    SOCKET_TIMER* p_timer = p_socket_timer_current;
+
+    if(!p_timer)
+        return;
+
+    unsigned long timeout_ms = SOCKET_TIMERS_NEVER;
+
+    if(stage == SOCKET_TIMER_STAGE_HANDSHAKE && handshake_timeout_ms > 0)
+        timeout_ms = handshake_timeout_ms;
+    else if(stage == SOCKET_TIMER_STAGE_REQUEST && request_timeout_ms > 0)
+        timeout_ms = request_timeout_ms;
+
+    unsigned long stage_deadline_ms = (timeout_ms == SOCKET_TIMERS_NEVER ? SOCKET_TIMERS_NEVER : SocketTimersNowMs() + timeout_ms);
+
+    if(stage == p_timer->stage)
+    {
+        __atomic_store_n(&p_timer->stage_deadline_ms, stage_deadline_ms, __ATOMIC_RELAXED);
+        return;
+    }
+
+    p_timer->stage = stage;
+
+    pthread_mutex_lock(&wheel_mtx);
+
+    __atomic_store_n(&p_timer->stage_deadline_ms, stage_deadline_ms, __ATOMIC_RELAXED);
+
+    unsigned long deadline_tick = SocketTimerMsToTick(SocketTimerDeadlineMs(p_timer));
+
+    if(!p_timer->pprev || deadline_tick < p_timer->expires)
+    {
+        SocketTimerUnlink(p_timer);
+        SocketTimerLink(p_timer, deadline_tick);
+    }
+
+    pthread_mutex_unlock(&wheel_mtx);
+}
+
+/// @brief Cancels the timer of the connection served by the current thread. To be called before closing the socket.
+void SocketTimerCancel(void)
+{
+    SOCKET_TIMER* p_timer = p_socket_timer_current;
+
+    if(!p_timer)
+        return;
+
+    pthread_mutex_lock(&wheel_mtx);
+    SocketTimerUnlink(p_timer);
+    pthread_mutex_unlock(&wheel_mtx);
+
+    p_socket_timer_current = NULL;
+}
+
+/*************************************/
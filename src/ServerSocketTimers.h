@@ -0,0 +1,75 @@
+#ifndef SERVER_SOCKET_TIMERS_H
+#define SERVER_SOCKET_TIMERS_H
+
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <stdbool.h>
+
+/************************************/
+
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Connection stages with a deadline of their own.
+typedef enum
+{
+    SOCKET_TIMER_STAGE_NONE = 0 ,
+    SOCKET_TIMER_STAGE_HANDSHAKE,
+    SOCKET_TIMER_STAGE_REQUEST  ,
+
+} SOCKET_TIMER_STAGE;
+
+/// @brief Per-connection deadline timer. Meant to be embedded in connection data, so arming it allocates nothing.
+typedef struct SOCKET_TIMER
+{
+    struct SOCKET_TIMER*    next;
+    struct SOCKET_TIMER**   pprev;              // Link pointing to this timer, NULL if it is not queued.
+    unsigned long           expires;            // Wheel tick the timer is queued for.
+    unsigned long           stage_deadline_ms;  // Handshake or request deadline, written by the serving thread.
+    unsigned long           last_io_ms;         // Last successful read or write, written by the serving thread.
+    SOCKET_TIMER_STAGE      stage;              // Only accessed by the serving thread.
+    int                     client_socket;
+} SOCKET_TIMER;
+
+/**********************************/
+
+/***********************************/
+/******** Public variables *********/
+/***********************************/
+
+/// @brief Timer of the connection served by the current thread, NULL if there is none.
+extern __thread SOCKET_TIMER* p_socket_timer_current;
+
+/***********************************/
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+unsigned long SocketTimersNowMs(void);
+bool SocketTimersEnabled(void);
+int SocketLaunchTimers(void);
+void SocketFreeTimersResources(void);
+void SocketTimerArm(SOCKET_TIMER* p_timer, int client_socket, SOCKET_TIMER_STAGE stage);
+void SocketTimerStage(SOCKET_TIMER_STAGE stage);
+void SocketTimerCancel(void);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Pushes current connection's idle deadline forward. Lock-free, the wheel finds out lazily.
+static inline void SocketTimerTouch(void)
+{
+    if(p_socket_timer_current)
+        __atomic_store_n(&p_socket_timer_current->last_io_ms, SocketTimersNowMs(), __ATOMIC_RELAXED);
+}
+
+/*************************************/
+
+#endif
@@ -10,6 +10,7 @@
 #include <fcntl.h>              // Set socket flags.
 #include <sys/time.h>           // Set timeout
 #include "ServerSocketUse.h"
+#include "ServerSocketLog.h"
 #include "SeverityLog_api.h"
 
 /*************************************/
@@ -207,7 +208,7 @@ int SocketAccept(int socket_desc, bool non_blocking)
     struct sockaddr_in client;
     socklen_t file_desc_len = (socklen_t)sizeof(struct sockaddr_in);
 
-    SVRTY_LOG_INF(SERVER_SOCKET_MSG_WATING_INCOMING_CONN);
+    SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_WATING_INCOMING_CONN);
 
     int client_socket = accept(socket_desc, (struct sockaddr*)&client, (socklen_t*)&file_desc_len);
 
@@ -222,11 +223,43 @@ int SocketAccept(int socket_desc, bool non_blocking)
     }
 
     if(client_socket >= 0)
-        SVRTY_LOG_INF(SERVER_SOCKET_MSG_CLIENT_ACCEPTED, inet_ntoa(client.sin_addr));
+        SOCKET_LOG_INF_RL(SERVER_SOCKET_MSG_CLIENT_ACCEPTED, inet_ntoa(client.sin_addr));
 
     return client_socket;
 }
 
+/// @brief Passes a descriptor to the process at the other end of a UNIX socket (SCM_RIGHTS), along with a single byte.
+/// @param unix_socket Connected UNIX socket.
+/// @param msg Byte sent along with the descriptor, so the receiver can tell what it is.
+/// @param desc Descriptor to pass. The sender's copy is left open.
+/// @return < 0 if sending failed.
+int SocketSendDescriptor(int unix_socket, char msg, int desc)
+{
+    struct iovec msg_iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+
+    union
+    {
+        char            buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr  align;
+    } control = {0};
+
+    struct msghdr desc_msg =
+    {
+        .msg_iov        = &msg_iov                  ,
+        .msg_iovlen     = 1                         ,
+        .msg_control    = control.buffer            ,
+        .msg_controllen = sizeof(control.buffer)    ,
+    };
+
+    struct cmsghdr* p_cmsg = CMSG_FIRSTHDR(&desc_msg);
+    p_cmsg->cmsg_level  = SOL_SOCKET;
+    p_cmsg->cmsg_type   = SCM_RIGHTS;
+    p_cmsg->cmsg_len    = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(p_cmsg), &desc, sizeof(int));
+
+    return (sendmsg(unix_socket, &desc_msg, MSG_NOSIGNAL) == sizeof(msg) ? 0 : -1);
+}
+
 /// @brief Closes the socket.
 /// @param client_socket ID of the socket that is meant to be closed.
 /// @return < 0 if close failed.
@@ -30,6 +30,7 @@ int SocketListen(int socket_desc, int connections_number);
 int SocketSetNonBlocking(int socket_fd);
 int SocketUnsetNonBlocking(int socket_fd);
 int SocketAccept(int socket_desc, bool non_blocking);
+int SocketSendDescriptor(int unix_socket, char msg, int desc);
 int CloseSocket(int client_socket);
 
 /*************************************/
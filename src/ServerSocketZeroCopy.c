@@ -0,0 +1,279 @@
+/************************************/
+/******** Include statements ********/
+/************************************/
+
+#include <errno.h>
+#include <limits.h>             // INT_MAX
+#include <stdlib.h>
+#include <unistd.h>             // sysconf
+#include <netinet/in.h>         // IPPROTO_TCP
+#include <netinet/tcp.h>        // TCP_ZEROCOPY_RECEIVE
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "ServerSocketZeroCopy.h"
+#include "ServerSocketHelperFunctions.h"
+#include "ServerSocketSSL.h"
+#include "ServerSocketStats.h"
+#include "ServerSocketTimers.h"
+#include "ServerSocketBufTune.h"
+#include "ServerSocketCompress.h"
+#include "ServerSocketShm.h"
+#include "ServerSocketLog.h"
+#include "ServerSocket_api.h"
+#include "SeverityLog_api.h"
+
+/************************************/
+
+/************************************/
+/********* Define statements ********/
+/************************************/
+
+#define SERVER_SOCKET_ZEROCOPY_ERR_ARGS         -1
+#define SERVER_SOCKET_ZEROCOPY_ERR_ALLOC        -2
+#define SERVER_SOCKET_ZEROCOPY_ERR_TIMEOUT      -3
+
+#define SOCKET_ZEROCOPY_DISABLED                0
+#define SOCKET_ZEROCOPY_NO_SOCKET               -1
+#define SOCKET_ZEROCOPY_COPY_BUFFER_SIZE        (64 * 1024UL)   // Largest copied chunk (small reads, unaligned remainders, layered connections).
+#define SOCKET_ZEROCOPY_MAX_WINDOW_SIZE         ((unsigned long)INT_MAX)    // TCP_ZEROCOPY_RECEIVE takes a 32-bit length, and reads report sizes as int.
+
+#define SERVER_SOCKET_MSG_ZEROCOPY_MAP_NOK      "Could not map socket <%d> for zero-copy receive, copying instead."
+#define SERVER_SOCKET_MSG_ZEROCOPY_WINDOW_CLAMP "Zero-copy receive window of <%lu> bytes is too large, using <%lu> bytes instead."
+
+/************************************/
+
+/***********************************/
+/******** Private variables ********/
+/***********************************/
+
+static unsigned long zerocopy_window_size   = SOCKET_ZEROCOPY_DISABLED;
+static unsigned long zerocopy_min_size      = SERVER_SOCKET_ZEROCOPY_MIN_SIZE;
+static unsigned long zerocopy_page_size;
+
+/// @brief Per-connection state, set up on the first read of the connection served by the current thread.
+static __thread int             zerocopy_socket         = SOCKET_ZEROCOPY_NO_SOCKET;
+static __thread char*           zerocopy_window         = NULL;     // Address range received pages are mapped into, NULL if copying only.
+static __thread char*           zerocopy_copy_buffer    = NULL;
+static __thread unsigned long   zerocopy_mapped         = 0;        // Mapped bytes of the view handed out, 0 if it was copied.
+static __thread unsigned long   zerocopy_skip           = 0;        // Bytes to be copied before any further page can be mapped.
+static __thread long            zerocopy_rx_timeout_us;
+
+/***********************************/
+
+/*************************************/
+/**** Private function prototypes ****/
+/*************************************/
+
+static int SocketZeroCopySetup(int client_socket);
+static unsigned long SocketZeroCopyMappableSize(unsigned long max_size);
+static int SocketZeroCopyMap(int client_socket, unsigned long map_size);
+
+/*************************************/
+
+/*************************************/
+/******* Function definitions ********/
+/*************************************/
+
+/// @brief Sets the current connection's state up, unless it already was. Received pages are mapped into an address range
+/// taken on the socket itself (mmap), so plain connections only: TLS records have to be decrypted anyway.
+/// @param client_socket Client socket.
+/// @return 0 if succeeded (even if pages cannot be mapped, reads being copied then), < 0 if the copy buffer could not be allocated.
+static int SocketZeroCopySetup(const int client_socket)
+{
+    if(zerocopy_socket == client_socket)
+        return 0;
+
+    SocketZeroCopyRelease();
+
+    zerocopy_copy_buffer = malloc(SOCKET_ZEROCOPY_COPY_BUFFER_SIZE);
+
+    if(!zerocopy_copy_buffer)
+        return SERVER_SOCKET_ZEROCOPY_ERR_ALLOC;
+
+    if(zerocopy_window_size != SOCKET_ZEROCOPY_DISABLED && !ServerSocketIsSecure())
+    {
+        void* p_window = mmap(NULL, zerocopy_window_size, PROT_READ, MAP_SHARED, client_socket, 0);
+
+        if(p_window != MAP_FAILED)
+            zerocopy_window = p_window;
+        else
+            SOCKET_LOG_WNG_RL(SERVER_SOCKET_MSG_ZEROCOPY_MAP_NOK, client_socket);
+    }
+
+    zerocopy_rx_timeout_us = ServerSocketGetTimeoutUs(client_socket, SO_RCVTIMEO);
+    zerocopy_socket = client_socket;
+
+    return 0;
+}
+
+/// @brief Tells how much a read may map, which is whole pages only, and nothing unless the read is worth it (see
+/// ServerSocketSetZeroCopyReceive) and nothing else owns the connection's data (compression, shared memory).
+/// @param max_size Maximum bytes the read is meant to deliver.
+/// @return Bytes to ask the kernel to map, 0 if the read is meant to be copied.
+static unsigned long SocketZeroCopyMappableSize(const unsigned long max_size)
+{
+    if(!zerocopy_window || zerocopy_skip > 0 || max_size < zerocopy_min_size || SocketCompressActive() || SocketShmActive())
+        return 0;
+
+    unsigned long map_size = (max_size < zerocopy_window_size ? max_size : zerocopy_window_size);
+
+    return map_size - map_size % zerocopy_page_size;
+}
+
+/// @brief Maps whole pages of received data into the window (TCP_ZEROCOPY_RECEIVE), taking them off the socket's receive
+/// queue. Pages are only mapped as long as they hold nothing but payload, the kernel telling how many bytes have to be
+/// copied otherwise before mapping may go on.
+/// @param client_socket Client socket.
+/// @param map_size Maximum bytes to be mapped (whole pages).
+/// @return Mapped bytes, 0 if nothing could be mapped (zerocopy_skip then holding bytes to be copied first, 0 if nothing
+/// was received yet, the client got disconnected or mapping failed).
+static int SocketZeroCopyMap(const int client_socket, const unsigned long map_size)
+{
+    struct tcp_zerocopy_receive zc =
+    {
+        .address    = (unsigned long)zerocopy_window,
+        .length     = (unsigned int)map_size,
+    };
+
+    socklen_t zc_len = sizeof(zc);
+
+    // EIO tells the client got disconnected, which the copying read afterwards tells as well.
+    if(getsockopt(client_socket, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zc_len) < 0)
+    {
+        zerocopy_skip = 0;
+        return 0;
+    }
+
+    zerocopy_skip = zc.recv_skip_hint;
+    zerocopy_mapped = zc.length;
+
+    if(zc.length > 0)
+    {
+        SocketStatsCount(SERVER_SOCKET_CNT_BYTES_IN, zc.length);
+        SocketStatsCount(SERVER_SOCKET_CNT_ZEROCOPY_BYTES_IN, zc.length);
+        SocketStatsRecord(SERVER_SOCKET_HIST_READ_BYTES, zc.length);
+        SocketTimerTouch();
+        SocketBufTuneTransferred(zc.length);
+    }
+
+    return (int)zc.length;
+}
+
+/// @brief Sets TCP zero-copy receive up. To be called before ServerSocketRun.
+/// @param window_size Address range each connection maps received pages into (rounded up to whole pages, clamped to the
+/// largest whole pages under 2GB), 0 to disable (default).
+/// @param min_size Reads meant to deliver less than this are copied (see SERVER_SOCKET_ZEROCOPY_MIN_SIZE).
+void ServerSocketSetZeroCopyReceive(const unsigned long window_size, const unsigned long min_size)
+{
+    zerocopy_page_size = (unsigned long)sysconf(_SC_PAGESIZE);
+    zerocopy_window_size = (window_size + zerocopy_page_size - 1) / zerocopy_page_size * zerocopy_page_size;
+
+    if(window_size > SOCKET_ZEROCOPY_MAX_WINDOW_SIZE)
+    {
+        zerocopy_window_size = SOCKET_ZEROCOPY_MAX_WINDOW_SIZE - SOCKET_ZEROCOPY_MAX_WINDOW_SIZE % zerocopy_page_size;
+        SVRTY_LOG_WNG(SERVER_SOCKET_MSG_ZEROCOPY_WINDOW_CLAMP, window_size, zerocopy_window_size);
+    }
+
+    zerocopy_min_size = min_size;
+}
+
+/// @brief Reads bulk data from the client, handing out a read-only view of it.
+/// @param client_socket Client socket.
+/// @param p_view Target view.
+/// @param max_size Maximum bytes to be delivered.
+/// @param timeout_us Maximum time to wait for data, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeouts.
+/// @return > 0 equaling the amount of bytes delivered, 0 if client got disconnected, < 0 if any error happened.
+int ServerSocketReadZeroCopy(int client_socket, SERVER_SOCKET_MESSAGE* p_view, const unsigned long max_size, const long timeout_us)
+{
+    if(!p_view || max_size == 0)
+        return SERVER_SOCKET_ZEROCOPY_ERR_ARGS;
+
+    ServerSocketReleaseZeroCopy(client_socket);
+
+    if(SocketZeroCopySetup(client_socket) < 0)
+        return SERVER_SOCKET_ZEROCOPY_ERR_ALLOC;
+
+    unsigned long map_size = SocketZeroCopyMappableSize(max_size);
+
+    if(map_size > 0)
+    {
+        int mapped = SocketZeroCopyMap(client_socket, map_size);
+
+        // Nothing received yet: wait for it rather than copying the first bytes showing up.
+        if(mapped == 0 && zerocopy_skip == 0)
+        {
+            int wait_readable = ServerSocketWaitReadable(client_socket, (timeout_us < 0 ? zerocopy_rx_timeout_us : timeout_us));
+
+            if(wait_readable <= 0)
+            {
+                if(wait_readable == 0)
+                    errno = EAGAIN;
+
+                return SERVER_SOCKET_ZEROCOPY_ERR_TIMEOUT;
+            }
+
+            mapped = SocketZeroCopyMap(client_socket, map_size);
+        }
+
+        if(mapped > 0)
+        {
+            p_view->data = zerocopy_window;
+            p_view->size = mapped;
+
+            return mapped;
+        }
+    }
+
+    // Copied, only up to the next mappable page if the kernel told where it is.
+    unsigned long copy_size = (max_size < SOCKET_ZEROCOPY_COPY_BUFFER_SIZE ? max_size : SOCKET_ZEROCOPY_COPY_BUFFER_SIZE);
+
+    if(zerocopy_skip > 0 && zerocopy_skip < copy_size)
+        copy_size = zerocopy_skip;
+
+    int read_from_socket = (timeout_us < 0 ? ServerSocketRead(client_socket, zerocopy_copy_buffer, copy_size) :
+                                             ServerSocketReadAtLeast(client_socket, zerocopy_copy_buffer, copy_size, 1, timeout_us));
+
+    if(read_from_socket > 0)
+    {
+        zerocopy_skip = ((unsigned long)read_from_socket < zerocopy_skip ? zerocopy_skip - read_from_socket : 0);
+
+        p_view->data = zerocopy_copy_buffer;
+        p_view->size = read_from_socket;
+    }
+
+    return read_from_socket;
+}
+
+/// @brief Releases the view handed out by ServerSocketReadZeroCopy, giving mapped pages back to the kernel.
+/// @param client_socket Client socket.
+void ServerSocketReleaseZeroCopy(int client_socket)
+{
+    if(client_socket != zerocopy_socket || zerocopy_mapped == 0)
+        return;
+
+    madvise(zerocopy_window, zerocopy_mapped, MADV_DONTNEED);
+    zerocopy_mapped = 0;
+}
+
+/// @brief Unmaps the current connection's window and frees its copy buffer. To be called once it is over, before its socket
+/// is closed: the window holds a reference to the socket, which would otherwise outlive its descriptor.
+void SocketZeroCopyRelease(void)
+{
+    if(zerocopy_window)
+    {
+        munmap(zerocopy_window, zerocopy_window_size);
+        zerocopy_window = NULL;
+    }
+
+    if(zerocopy_copy_buffer)
+    {
+        free(zerocopy_copy_buffer);
+        zerocopy_copy_buffer = NULL;
+    }
+
+    zerocopy_socket = SOCKET_ZEROCOPY_NO_SOCKET;
+    zerocopy_mapped = 0;
+    zerocopy_skip = 0;
+}
+
+/*************************************/
@@ -0,0 +1,12 @@
+#ifndef SERVER_SOCKET_ZERO_COPY_H
+#define SERVER_SOCKET_ZERO_COPY_H
+
+/*************************************/
+/******** Function prototypes ********/
+/*************************************/
+
+void SocketZeroCopyRelease(void);
+
+/*************************************/
+
+#endif
@@ -25,8 +25,228 @@ extern "C" {
 
 #define C_SERVER_SOCKET_API __attribute__((visibility("default")))
 
+#define SERVER_SOCKET_WAIT_FOREVER  -1L
+
+/// @brief Minimum serving thread stack size for library's own code paths (see ServerSocketSetThreadProfile).
+/// TLS handshakes were measured to need about 20KB (OpenSSL 3.0, TLS 1.2 and 1.3, RSA 2048 and 4096 keys), so this leaves room
+/// for other OpenSSL builds and ciphers, logging and signal handlers.
+#define SERVER_SOCKET_MIN_STACK_SIZE    (64 * 1024UL)
+
+/// @brief Compressed connections' wire format (see ServerSocketEnableCompression). Both directions are made of frames,
+/// each one being a flags byte followed by payload size (32-bit big endian), then the payload.
+#define SERVER_SOCKET_COMPRESS_HEADER_SIZE  5
+#define SERVER_SOCKET_COMPRESS_MAX_FRAME    65536   // Maximum payload size.
+#define SERVER_SOCKET_COMPRESS_FLAG_DEFLATE 0x01    // Payload continues sender's raw deflate stream, sync flush trailer (00 00 FF FF) stripped off.
+#define SERVER_SOCKET_COMPRESS_FLAG_RESET   0x02    // Sender restarted its deflate stream, so the receiver must restart its own first.
+
+/// @brief Shared-memory transport layout (see ServerSocketEnableSharedMemory). The region starts with a header
+/// (SERVER_SOCKET_SHM_HEADER) padded to SERVER_SOCKET_SHM_HEADER_SIZE, followed by the client-to-server ring data,
+/// then the server-to-client one, each ring_size bytes long.
+#define SERVER_SOCKET_SHM_MAGIC         0x4D485353U     // "SSHM" in memory (little endian).
+#define SERVER_SOCKET_SHM_VERSION       1
+#define SERVER_SOCKET_SHM_HEADER_SIZE   4096
+#define SERVER_SOCKET_SHM_CHANNEL_SIZE  16              // Room for the side channel's abstract name.
+#define SERVER_SOCKET_SHM_TOKEN_SIZE    16
+#define SERVER_SOCKET_SHM_MSG_REGION    'M'             // Byte sent along with the region's descriptor.
+
+/// @brief Connection priority classes (see ServerSocketSetPriorityClass), from 0 (connections matching no rule) to 7.
+#define SERVER_SOCKET_PRIORITY_CLASSES  8
+
+/// @brief Smallest read mapped rather than copied by default (see ServerSocketSetZeroCopyReceive).
+#define SERVER_SOCKET_ZEROCOPY_MIN_SIZE (1024 * 1024UL)
+
 /*************************************/
 
+/**********************************/
+/******** Type definitions ********/
+/**********************************/
+
+/// @brief Length prefix formats for message framing.
+typedef enum
+{
+    SERVER_SOCKET_FRAME_U16_BE = 0  ,   // 2-byte unsigned integer, big endian.
+    SERVER_SOCKET_FRAME_U16_LE      ,   // 2-byte unsigned integer, little endian.
+    SERVER_SOCKET_FRAME_U32_BE      ,   // 4-byte unsigned integer, big endian (default).
+    SERVER_SOCKET_FRAME_U32_LE      ,   // 4-byte unsigned integer, little endian.
+    SERVER_SOCKET_FRAME_VARINT      ,   // Unsigned LEB128 varint (as used by Protocol Buffers).
+
+} SERVER_SOCKET_FRAME_HEADER;
+
+/// @brief Where serving threads are meant to run.
+typedef enum
+{
+    SERVER_SOCKET_AFFINITY_NONE = 0 ,   // Wherever the scheduler picks (default).
+    SERVER_SOCKET_AFFINITY_CPU      ,   // Pinned to the CPU the connection came in on (SO_INCOMING_CPU).
+    SERVER_SOCKET_AFFINITY_NODE     ,   // Pinned to the NUMA node of the CPU the connection came in on.
+
+} SERVER_SOCKET_AFFINITY;
+
+/// @brief Transport compression algorithms.
+typedef enum
+{
+    SERVER_SOCKET_COMPRESSION_NONE = 0  ,   // Uncompressed (default).
+    SERVER_SOCKET_COMPRESSION_DEFLATE   ,   // Streaming raw deflate (zlib).
+
+} SERVER_SOCKET_COMPRESSION;
+
+/// @brief Reply to a shared-memory upgrade, written on the socket (host byte order) right before the rings take over.
+/// The client connects to the abstract UNIX socket named channel (a leading NUL byte followed by channel_len bytes of
+/// channel), writes token, then receives the region's descriptor (SCM_RIGHTS, along with SERVER_SOCKET_SHM_MSG_REGION),
+/// maps it and sets client_attached.
+typedef struct
+{
+    unsigned int        magic;                                  // SERVER_SOCKET_SHM_MAGIC.
+    unsigned int        version;                                // SERVER_SOCKET_SHM_VERSION.
+    unsigned long long  map_size;                               // Region size.
+    unsigned int        channel_len;
+    char                channel[SERVER_SOCKET_SHM_CHANNEL_SIZE];
+    unsigned char       token[SERVER_SOCKET_SHM_TOKEN_SIZE];    // Proves the channel's peer is the client the reply went to.
+} SERVER_SOCKET_SHM_REPLY;
+
+/// @brief One direction of the shared-memory transport: a single-producer single-consumer byte ring. Positions only ever
+/// grow (data sits at position modulo ring size), and each cache line is only written by one side. Every field is
+/// accessed atomically, positions with acquire/release semantics. Parked sides wait on their futex word (FUTEX_WAIT,
+/// not private), which the other side only bumps and wakes if the parked flag is set once it has published its position.
+typedef struct
+{
+    unsigned long long  head                __attribute__((aligned(64)));   // Bytes produced so far. Producer's line.
+    unsigned int        data_seq;           // Bumped when data is published while the consumer is parked.
+    unsigned int        producer_parked;    // Producer waits for space_seq to change.
+    unsigned long long  tail                __attribute__((aligned(64)));   // Bytes consumed so far. Consumer's line.
+    unsigned int        space_seq;          // Bumped when space is freed while the producer is parked.
+    unsigned int        consumer_parked;    // Consumer waits for data_seq to change.
+} SERVER_SOCKET_SHM_RING;
+
+/// @brief Shared-memory region header. Whichever side closes sets its flag, then bumps and wakes every futex word it owns.
+typedef struct
+{
+    unsigned int            magic;          // SERVER_SOCKET_SHM_MAGIC.
+    unsigned int            version;        // SERVER_SOCKET_SHM_VERSION.
+    unsigned long long      ring_size;      // Size of each ring (power of two).
+    unsigned int            client_attached;
+    unsigned int            server_closed;
+    unsigned int            client_closed;
+    SERVER_SOCKET_SHM_RING  to_server       __attribute__((aligned(64)));
+    SERVER_SOCKET_SHM_RING  to_client;
+} SERVER_SOCKET_SHM_HEADER;
+
+/// @brief Received message (or line) view. It points straight into the connection's ring buffer, so it is never copied.
+typedef struct
+{
+    const char*     data;   // Message payload (length prefix excluded).
+    unsigned long   size;   // Payload size.
+} SERVER_SOCKET_MESSAGE;
+
+/// @brief Responses to a batch of requests, sent together once the batch handler returns.
+typedef struct SERVER_SOCKET_BATCH SERVER_SOCKET_BATCH;
+
+/// @brief Batch handler. Gets every complete request available after a single read.
+/// @param client_socket Client socket.
+/// @param p_requests Request views, valid until the handler returns.
+/// @param requests_num Amount of requests (always > 0).
+/// @param p_batch Batch responses are meant to be appended to (ServerSocketBatchAppend / ServerSocketBatchAppendRef).
+/// @return > 0 if interaction is meant to go on, <= 0 to close the connection.
+typedef int (*SERVER_SOCKET_BATCH_FN)(int client_socket, const SERVER_SOCKET_MESSAGE* p_requests, int requests_num, SERVER_SOCKET_BATCH* p_batch);
+
+/// @brief Connection scope (see ServerSocketSetConnectionScope). Runs on the connection's serving thread.
+/// @param client_socket Client socket.
+/// @param serve_fn Function serving every request of the connection, meant to be called once with p_serve_args.
+/// @param p_serve_args Arguments to be passed on to serve_fn.
+typedef void (*SERVER_SOCKET_SCOPE_FN)(int client_socket, void (*serve_fn)(void* p_serve_args), void* p_serve_args);
+
+/// @brief Reference-counted buffer, broadcast to many connections without being copied for each one (see ServerSocketBroadcast).
+typedef struct SERVER_SOCKET_BUFFER SERVER_SOCKET_BUFFER;
+
+/// @brief TLS memory usage figures.
+typedef struct
+{
+    unsigned long tls_connections;      // Connections currently owning an SSL object.
+    unsigned long tls_heap_bytes;       // OpenSSL heap bytes held by those connections.
+    unsigned long tls_bytes_per_conn;   // Average OpenSSL heap bytes per TLS connection.
+} SERVER_SOCKET_MEM_STATS;
+
+/// @brief Connection figures, as seen by the kernel (TCP_INFO).
+typedef struct
+{
+    unsigned int    rtt_us;         // Smoothed round-trip time.
+    unsigned int    rtt_var_us;     // Round-trip time variation.
+    unsigned int    min_rtt_us;     // Lowest round-trip time seen (0 if the kernel does not report it).
+    unsigned int    snd_cwnd;       // Congestion window, in segments.
+    unsigned int    snd_mss;        // Sending maximum segment size.
+    unsigned int    rcv_space;      // Bytes the client was measured to send per round trip.
+    unsigned long   delivery_rate;  // Bytes per second (0 if the kernel does not report it).
+    bool            app_limited;    // Delivery rate was sampled while the server had nothing to send.
+    unsigned long   bdp_bytes;      // Bandwidth-delay product: largest of delivery rate times RTT and congestion window.
+    unsigned long   snd_buf;        // Current send buffer size (as reported by the kernel, which doubles requested sizes).
+    unsigned long   rcv_buf;        // Current receive buffer size (as reported by the kernel, which doubles requested sizes).
+} SERVER_SOCKET_TCP_STATS;
+
+/// @brief Priority class figures (see ServerSocketSetPriorityClass). Every counter is cumulative since the library was loaded.
+typedef struct
+{
+    unsigned long active_connections;   // Connections currently admitted into the class.
+    unsigned long refusals;             // Connections refused because the class was full.
+    unsigned long interactions;         // Interactions scheduled (see ServerSocketSetPriorityScheduling).
+    unsigned long waits;                // Interactions which had to wait for a run slot.
+    unsigned long wait_ns;              // Time waited for run slots in total.
+    unsigned long max_wait_ns;          // Longest wait for a run slot.
+} SERVER_SOCKET_PRIORITY_STATS;
+
+/// @brief Histogram summary. Percentiles are accurate to within 1.6% of the actual value.
+typedef struct
+{
+    unsigned long count;    // Amount of recorded samples.
+    unsigned long sum;      // Sum of every recorded sample.
+    unsigned long min;      // Lowest recorded sample.
+    unsigned long max;      // Highest recorded sample.
+    unsigned long p50;      // 50th percentile.
+    unsigned long p90;      // 90th percentile.
+    unsigned long p99;      // 99th percentile.
+    unsigned long p999;     // 99.9th percentile.
+} SERVER_SOCKET_HIST_STATS;
+
+/// @brief Server runtime statistics. Every counter is cumulative since the library was loaded.
+typedef struct
+{
+    unsigned long accepts;              // Accepted connections.
+    unsigned long refusals;             // Connections refused due to lack of free server instances (or room in their class).
+    unsigned long accept_errors;        // Failed accept calls (timeouts excluded).
+    unsigned long handshake_failures;   // Failed TLS handshakes.
+    unsigned long io_errors;            // Failed reads/writes (timeouts and would-block excluded).
+    unsigned long bytes_in;             // Bytes read from clients.
+    unsigned long bytes_out;            // Bytes written to clients.
+    unsigned long timeouts;             // Connections shut down due to an expired deadline.
+    unsigned long payload_bytes_in;     // Bytes handed to compressed connections' handlers (bytes_in counts them on the wire).
+    unsigned long payload_bytes_out;    // Bytes written by compressed connections' handlers (bytes_out counts them on the wire).
+    unsigned long cache_hits;           // Requests answered from the response cache.
+    unsigned long cache_misses;         // Response cache lookups which found nothing.
+    unsigned long cache_evictions;      // Responses evicted from the cache to make room or because they expired.
+    unsigned long cache_bytes;          // Memory currently taken by cached responses.
+    unsigned long shm_upgrades;         // Connections upgraded to shared-memory rings.
+    unsigned long broadcast_drops;      // Broadcasts dropped because a connection had too many queued already.
+    unsigned long buffer_resizes;       // Socket buffers resized after their connection's bandwidth-delay product.
+    unsigned long lowat_waits;          // Writes held back until the kernel's unsent data fell below the low-water mark.
+    unsigned long tls_shutdown_timeouts;// Deferred closes which gave up waiting for the client's close_notify.
+    unsigned long class_refusals;       // Connections refused because their priority class was full (refusals include them).
+    unsigned long zerocopy_bytes_in;    // Bytes received into mapped pages instead of being copied (bytes_in includes them).
+    unsigned long active_connections;   // Server instances currently serving a client.
+
+    SERVER_SOCKET_HIST_STATS accept_to_dispatch_ns; // From accept to the server instance starting to run.
+    SERVER_SOCKET_HIST_STATS handshake_ns;          // TLS handshake duration.
+    SERVER_SOCKET_HIST_STATS interact_ns;           // Duration of each interaction function call.
+    SERVER_SOCKET_HIST_STATS read_bytes;            // Bytes per successful read.
+    SERVER_SOCKET_HIST_STATS write_bytes;           // Bytes per successful write.
+    SERVER_SOCKET_HIST_STATS lifetime_ns;           // From accept to connection close.
+    SERVER_SOCKET_HIST_STATS rtt_us;                // Smoothed RTT, per buffer tuning sample.
+    SERVER_SOCKET_HIST_STATS bdp_bytes;             // Bandwidth-delay product, per buffer tuning sample.
+    SERVER_SOCKET_HIST_STATS teardown_ns;           // From a connection handed over to the reaper to its descriptor closed.
+    SERVER_SOCKET_HIST_STATS schedule_wait_ns;      // From a request showing up to its interaction getting a run slot.
+
+    SERVER_SOCKET_MEM_STATS mem_stats;              // TLS memory usage.
+} SERVER_SOCKET_STATS;
+
+/**********************************/
+
 /*************************************/
 /******** Function prototypes ********/
 /*************************************/
@@ -45,6 +265,180 @@ C_SERVER_SOCKET_API int ServerSocketRead(int client_socket, char* rx_buffer, uns
 #define SERVER_SOCKET_READ(client_socket, rx_buffer)                \
         ServerSocketRead(client_socket, rx_buffer, sizeof(rx_buffer))
 
+/// @brief Reads at least min_size bytes, waiting for the socket to be readable (poll) in between reads.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size (maximum amount of bytes to be read).
+/// @param min_size Minimum amount of bytes to be read.
+/// @param timeout_us Maximum time to wait for in total, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes read (< min_size if time ran out or client got disconnected meanwhile),
+/// 0 if client got disconnected before sending anything, < 0 if nothing was read on time (errno set to ETIMEDOUT) or any error happened.
+C_SERVER_SOCKET_API int ServerSocketReadAtLeast(int client_socket, char* rx_buffer, unsigned long rx_buffer_size, unsigned long min_size, long timeout_us);
+
+/// @brief Reads until no more data arrives for idle_us microseconds, or until RX buffer gets full.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size (maximum amount of bytes to be read).
+/// @param idle_us Time without new data after which reading is over.
+/// @param timeout_us Maximum time to wait for the first byte, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes read, 0 if client got disconnected before sending anything,
+/// < 0 if nothing was read on time (errno set to ETIMEDOUT) or any error happened.
+C_SERVER_SOCKET_API int ServerSocketReadUntilIdle(int client_socket, char* rx_buffer, unsigned long rx_buffer_size, long idle_us, long timeout_us);
+
+/// @brief Reads until delimiter is found (delimiter included), or until RX buffer gets full.
+/// Bytes following the delimiter are left in the socket for the next read.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size (maximum amount of bytes to be read).
+/// @param delimiter Delimiter character.
+/// @param timeout_us Maximum time to wait for in total, SERVER_SOCKET_WAIT_FOREVER to wait with no limit.
+/// @return Amount of bytes read (last one not being the delimiter if time ran out, client got disconnected or buffer got full),
+/// 0 if client got disconnected before sending anything, < 0 if nothing was read on time (errno set to ETIMEDOUT) or any error happened.
+C_SERVER_SOCKET_API int ServerSocketReadUntilDelimiter(int client_socket, char* rx_buffer, unsigned long rx_buffer_size, char delimiter, long timeout_us);
+
+/// @brief Retrieves the next complete length-prefixed message sent by the client (see ServerSocketSetFraming).
+/// Data is read into a per-connection ring buffer, mapped twice back to back so messages never wrap. Each read fills
+/// as much of the ring as possible, and every complete message found in it is delivered before reading again.
+/// @param client_socket Client socket.
+/// @param p_message Target message view. Valid until the next call, or until the connection is closed.
+/// @param timeout_us Maximum time to wait for data on each read, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeouts.
+/// @return 1 if a message was delivered, 0 if client got disconnected, < 0 if any error happened
+/// (including messages not fitting into the ring buffer and malformed length prefixes, errno being set to EPROTO then).
+C_SERVER_SOCKET_API int ServerSocketReadMessage(int client_socket, SERVER_SOCKET_MESSAGE* p_message, long timeout_us);
+
+/// @brief Retrieves the next complete line sent by the client, for text protocols. Lines are read into the same per-connection
+/// ring buffer as messages (so ServerSocketReadMessage is not meant to be used on the same connection), and are searched for
+/// with SIMD instructions (AVX2 or SSE2, picked at run time), bytes searched once never being searched again.
+/// @param client_socket Client socket.
+/// @param p_line Target line view, with neither the line feed nor the carriage return before it (if any), null-terminated.
+/// Valid until the next call, or until the connection is closed.
+/// @param timeout_us Maximum time to wait for data on each read, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeouts.
+/// @return 1 if a line was delivered, 0 if client got disconnected (an unterminated last line is dropped), < 0 if any error
+/// happened (including lines not fitting into the ring buffer, see ServerSocketSetFraming).
+C_SERVER_SOCKET_API int ServerSocketReadLine(int client_socket, SERVER_SOCKET_MESSAGE* p_line, long timeout_us);
+
+/// @brief Reads bulk data from the client without copying it when possible (see ServerSocketSetZeroCopyReceive). Whole pages
+/// of payload are mapped read-only straight from the socket's receive queue (TCP_ZEROCOPY_RECEIVE), anything else (data not
+/// laid out in whole pages, reads smaller than the threshold, TLS, compressed or shared-memory connections) being copied,
+/// only up to the next mappable page. Not meant to be mixed with ServerSocketReadMessage or ServerSocketReadLine.
+/// @param client_socket Client socket.
+/// @param p_view Target read-only view. Valid until ServerSocketReleaseZeroCopy, the next call, or until the connection is closed.
+/// @param max_size Maximum amount of bytes to be delivered.
+/// @param timeout_us Maximum time to wait for data, SERVER_SOCKET_WAIT_FOREVER to rely on socket's own timeouts.
+/// @return > 0 equaling the amount of bytes delivered, 0 if client got disconnected, < 0 if any error happened.
+C_SERVER_SOCKET_API int ServerSocketReadZeroCopy(int client_socket, SERVER_SOCKET_MESSAGE* p_view, unsigned long max_size, long timeout_us);
+
+/// @brief Releases the view delivered by ServerSocketReadZeroCopy, giving its pages back to the kernel right away.
+/// @param client_socket Client socket.
+C_SERVER_SOCKET_API void ServerSocketReleaseZeroCopy(int client_socket);
+
+/// @brief Appends a response to a batch, copying its data.
+/// @param p_batch Batch the response belongs to.
+/// @param data Response data.
+/// @param size Response size.
+/// @return 0 if succeeded, < 0 otherwise.
+C_SERVER_SOCKET_API int ServerSocketBatchAppend(SERVER_SOCKET_BATCH* p_batch, const char* data, unsigned long size);
+
+/// @brief Appends a response to a batch without copying it (TLS connections copy it anyway).
+/// @param p_batch Batch the response belongs to.
+/// @param data Response data. Must stay valid until the handler returns (request views, static or heap memory, not handler's stack).
+/// @param size Response size.
+/// @return 0 if succeeded, < 0 otherwise.
+C_SERVER_SOCKET_API int ServerSocketBatchAppendRef(SERVER_SOCKET_BATCH* p_batch, const char* data, unsigned long size);
+
+/// @brief Enables low-latency mode for the current connection (see ServerSocketSetLowLatency). To be called from the interaction function.
+/// Reads spin for a bounded time before blocking, with kernel busy polling (SO_BUSY_POLL, SO_PREFER_BUSY_POLL) enabled,
+/// and the serving thread is pinned to a dedicated CPU (if any were set).
+/// @param client_socket Client socket.
+/// @return 0 if succeeded, < 0 if low-latency mode is disabled or every dedicated CPU is already taken.
+C_SERVER_SOCKET_API int ServerSocketEnableLowLatency(int client_socket);
+
+/// @brief Enables transport compression for the current connection (see ServerSocketSetCompression). To be called from
+/// the interaction function, once the client has agreed to it (e.g. after a protocol-specific request answered uncompressed).
+/// From then on, ServerSocketRead, ServerSocketWrite (and every function built on them) and batch responses go through frames
+/// (see SERVER_SOCKET_COMPRESS_HEADER_SIZE), deflated unless they are too small or do not compress, so handlers keep
+/// dealing with plain data. ServerSocketReadUntilDelimiter peeks at the socket, so it is not meant to be used then.
+/// @param client_socket Client socket.
+/// @param algorithm Compression algorithm. Compression cannot be disabled once enabled.
+/// @return 0 if succeeded, < 0 if the algorithm is not supported, the connection uses shared memory or compression state
+/// could not be allocated.
+C_SERVER_SOCKET_API int ServerSocketEnableCompression(int client_socket, SERVER_SOCKET_COMPRESSION algorithm);
+
+/// @brief Upgrades the current connection to shared-memory rings (see ServerSocketSetSharedMemory). To be called from the
+/// interaction function, once a co-located client has asked for it (e.g. after a protocol-specific request).
+/// A SERVER_SOCKET_SHM_REPLY is written on the socket, then ServerSocketRead, ServerSocketWrite (and every function built on
+/// them) and batch responses go through the rings, so handlers keep dealing with the same API. The socket itself is only
+/// watched to tell when the client is gone, so the client keeps it open (and silent) for as long as it uses the rings.
+/// The region's descriptor is handed over through a one-shot UNIX side channel named in the reply, which the client has one
+/// second to collect it from.
+/// @param client_socket Client socket, connected from a loopback address.
+/// @return 0 if succeeded, < 0 if shared memory is disabled, the client is not local, compression is enabled, the region
+/// could not be set up or the client did not collect it (the connection is meant to be closed then, as the reply is out).
+C_SERVER_SOCKET_API int ServerSocketEnableSharedMemory(int client_socket);
+
+/// @brief Creates a buffer to be broadcast (see ServerSocketBroadcast). Data is copied once, then shared by every connection.
+/// @param data Buffer data.
+/// @param size Data size.
+/// @return Buffer holding a single reference (the caller's), NULL if it could not be allocated.
+C_SERVER_SOCKET_API SERVER_SOCKET_BUFFER* ServerSocketBufferCreate(const char* data, unsigned long size);
+
+/// @brief Releases a reference on a buffer. Buffers are freed once neither the caller nor any connection refers to them.
+/// @param p_buffer Buffer.
+C_SERVER_SOCKET_API void ServerSocketBufferRelease(SERVER_SOCKET_BUFFER* p_buffer);
+
+/// @brief Writes a buffer to a set of connections (see ServerSocketSetBroadcast). May be called from any thread, at any time.
+/// Plain connections waiting for client data get it written straight away (without blocking), sharing the same memory.
+/// Otherwise it is queued (with a new reference), then written by the connection's serving thread as soon as it waits
+/// for client data again (TLS and compressed connections encrypt or compress it themselves). Connections whose queue is
+/// full drop it (whole), so slow clients never hold up the others. Connections upgraded to shared memory get no broadcasts.
+/// @param p_buffer Buffer. The caller keeps its own reference.
+/// @param p_client_sockets Client sockets, NULL for every connection.
+/// @param clients_num Amount of client sockets (ignored for every connection).
+/// @return Amount of connections the buffer was written or queued on, < 0 if broadcasting is disabled or the buffer is empty.
+C_SERVER_SOCKET_API int ServerSocketBroadcast(SERVER_SOCKET_BUFFER* p_buffer, const int* p_client_sockets, int clients_num);
+
+/// @brief Writes a message to a connection ahead of whatever its serving thread has not written yet (see
+/// ServerSocketSetNotSentLowat). May be called from any thread, at any time, broadcasting being enabled (see ServerSocketSetBroadcast).
+/// It is sent (or queued) as a broadcast to that connection alone, so it is written before the serving thread's next write
+/// (with a low-water mark) or as soon as it waits for client data. With the kernel only holding a low-water mark's worth of
+/// unsent data, it then waits for that much and for the write in progress, instead of for every byte written before it.
+/// @param client_socket Client socket.
+/// @param data Message data (copied).
+/// @param size Message size.
+/// @return 0 if the message was written or queued, < 0 if broadcasting is disabled, it could not be allocated or the
+/// connection's queue is full.
+C_SERVER_SOCKET_API int ServerSocketWriteUrgent(int client_socket, const char* data, unsigned long size);
+
+/// @brief Stores a response in the response cache (see ServerSocketSetResponseCache), replacing the one stored under the same key.
+/// With a batch handler, storing a response under its request's bytes (the message view) answers identical requests
+/// without calling the handler anymore. Only responses which depend on nothing but the key are meant to be stored.
+/// @param key Key: request bytes, or any key the handler derives from the request.
+/// @param key_size Key size.
+/// @param response Response data (copied).
+/// @param response_size Response size.
+/// @return 0 if succeeded, < 0 if the cache is disabled, the response is too big (above 1/16 of the budget) or could not be allocated.
+C_SERVER_SOCKET_API int ServerSocketCacheStore(const char* key, unsigned long key_size, const char* response, unsigned long response_size);
+
+/// @brief Drops the response stored under a key from the response cache (if any).
+/// @param key Key.
+/// @param key_size Key size.
+/// @return 1 if a response was dropped, 0 if there was none, < 0 if the cache is disabled.
+C_SERVER_SOCKET_API int ServerSocketCacheInvalidate(const char* key, unsigned long key_size);
+
+/// @brief Writes the response stored under a key straight from the response cache, without copying it.
+/// @param client_socket Client socket.
+/// @param key Key.
+/// @param key_size Key size.
+/// @return 1 if the whole response was written, 0 if there is none (the handler is meant to build it then), < 0 if writing failed.
+C_SERVER_SOCKET_API int ServerSocketWriteCached(int client_socket, const char* key, unsigned long key_size);
+
+/// @brief Gets a connection's figures as seen by the kernel (RTT, congestion window, delivery rate, bandwidth-delay
+/// product and socket buffer sizes), whether socket buffer auto-tuning is enabled or not (see ServerSocketSetBufferTuning).
+/// @param client_socket Client socket.
+/// @param p_tcp_stats Target figures.
+/// @return 0 if succeeded, < 0 if the socket is not a TCP one.
+C_SERVER_SOCKET_API int ServerSocketGetTCPStats(int client_socket, SERVER_SOCKET_TCP_STATS* p_tcp_stats);
+
 /// @brief Writes to client socket.
 /// @param client_socket Client socket.
 /// @param tx_buffer Required TX buffer in which data to write is found.
@@ -54,6 +448,248 @@ C_SERVER_SOCKET_API int ServerSocketWrite(int client_socket, const char* tx_buff
 #define SERVER_SOCKET_WRITE(client_socket, tx_buffer)                \
         ServerSocketWrite(client_socket, (const char*)tx_buffer, strlen(tx_buffer))
 
+/// @brief Reads from a plain connection's socket straight away (read), skipping every check ServerSocketRead makes to pick
+/// a transport. Bytes are still accounted in stats and push the idle deadline forward. Not meant to be used on TLS
+/// connections, nor along with compression, shared memory, broadcasts or busy polling.
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return > 0 equaling the amount of bytes read, 0 if client got disconnected, < 0 if any error happened.
+C_SERVER_SOCKET_API int ServerSocketReadPlain(int client_socket, char* rx_buffer, unsigned long rx_buffer_size);
+
+/// @brief Writes to a plain connection's socket straight away (send), skipping every check ServerSocketWrite makes to pick
+/// a transport. Same accounting and restrictions as ServerSocketReadPlain, the low-water mark included.
+/// @param client_socket Client socket.
+/// @param tx_buffer TX buffer.
+/// @param tx_buffer_size TX buffer size.
+/// @return > 0 equaling the amount of bytes written, < 0 if any error happened.
+C_SERVER_SOCKET_API int ServerSocketWritePlain(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size);
+
+/// @brief Reads from a TLS connection with SSL_read on its SSL object straight away, skipping every check ServerSocketRead
+/// makes to pick a transport. Same accounting and restrictions as ServerSocketReadPlain, TLS low-memory waits included
+/// (reads block inside SSL_read).
+/// @param client_socket Client socket.
+/// @param rx_buffer RX buffer.
+/// @param rx_buffer_size RX buffer size.
+/// @return > 0 equaling the amount of bytes read, 0 if client got disconnected, < 0 if any error happened.
+C_SERVER_SOCKET_API int ServerSocketReadTLS(int client_socket, char* rx_buffer, unsigned long rx_buffer_size);
+
+/// @brief Writes to a TLS connection with SSL_write on its SSL object straight away, skipping every check ServerSocketWrite
+/// makes to pick a transport. Same accounting and restrictions as ServerSocketReadTLS, the low-water mark included.
+/// @param client_socket Client socket.
+/// @param tx_buffer TX buffer.
+/// @param tx_buffer_size TX buffer size.
+/// @return > 0 equaling the amount of bytes written, < 0 if any error happened.
+C_SERVER_SOCKET_API int ServerSocketWriteTLS(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size);
+
+/// @brief Enables TLS low-memory mode. To be called before ServerSocketRun.
+/// Idle connections release their read/write buffers and SSL objects are not created until the client sends data.
+/// @param low_memory True to enable low-memory mode, false otherwise.
+C_SERVER_SOCKET_API void ServerSocketSetTLSLowMemory(bool low_memory);
+
+/// @brief Enables OpenSSL heap accounting (see ServerSocketGetMemStats) by installing OpenSSL memory functions. To be called
+/// before ServerSocketRun, and before anything else in the process uses OpenSSL: the allocator cannot be replaced afterwards.
+/// @param accounting True to enable accounting, false to leave OpenSSL's allocator untouched (default).
+/// @return 0 if succeeded, < 0 if OpenSSL already allocated memory.
+C_SERVER_SOCKET_API int ServerSocketSetTLSMemAccounting(bool accounting);
+
+/// @brief Sets the port metrics are meant to be served on (Prometheus text format). To be called before ServerSocketRun.
+/// Metrics are served by a dedicated thread, so scrapes do not take any time from client serving threads.
+/// @param port Metrics port, 0 to disable metrics listener (default).
+C_SERVER_SOCKET_API void ServerSocketSetMetricsPort(int port);
+
+/// @brief Sets the address the metrics listener binds to. To be called before ServerSocketRun.
+/// Metrics reveal traffic figures, so they are only served on loopback unless told otherwise.
+/// @param address IPv4 address in dotted notation, "0.0.0.0" to accept scrapers from anywhere. Loopback by default.
+/// @return 0 if succeeded, < 0 if the address could not be parsed.
+C_SERVER_SOCKET_API int ServerSocketSetMetricsAddress(const char* address);
+
+/// @brief Sets message framing used by ServerSocketReadMessage. To be called before ServerSocketRun.
+/// @param header Length prefix format (SERVER_SOCKET_FRAME_U32_BE by default).
+/// @param ring_size Per-connection ring buffer size, rounded up to a power of two and to at least a memory page (64KB by default).
+/// Messages must fit into it, length prefix included.
+C_SERVER_SOCKET_API void ServerSocketSetFraming(SERVER_SOCKET_FRAME_HEADER header, unsigned long ring_size);
+
+/// @brief Sets a batch handler, used instead of the interaction function. To be called before ServerSocketRun.
+/// Every complete request (see ServerSocketSetFraming) available after each read is handed over at once, and every
+/// response is sent with a single vectored write (a single TLS write on secure connections).
+/// @param fn Batch handler, NULL to use the interaction function (default).
+C_SERVER_SOCKET_API void ServerSocketSetBatchHandler(SERVER_SOCKET_BATCH_FN fn);
+
+/// @brief Sets serving threads' profile. To be called before ServerSocketRun.
+/// Smaller stacks let many more connections be held, as each one gets its own thread. Stacks are only backed by memory
+/// once touched either way, but they still take address space and count towards overcommit limits.
+/// @param stack_size Stack size, at least SERVER_SOCKET_MIN_STACK_SIZE plus whatever the interaction function needs (smaller
+/// sizes are raised to SERVER_SOCKET_MIN_STACK_SIZE), 0 to use system defaults (default, usually 8MB).
+/// @param guard_size Guard area below each stack, rounded up to a memory page (0 for none).
+/// @param stack_cache_size Amount of stacks kept for reuse once their connection is over, 0 to let the C library manage them.
+C_SERVER_SOCKET_API void ServerSocketSetThreadProfile(unsigned long stack_size, unsigned long guard_size, unsigned int stack_cache_size);
+
+/// @brief Sets a function wrapping every connection's requests, so per-connection state can live on its serving thread's
+/// stack. To be called before ServerSocketRun.
+/// Once the connection is established (TLS handshake included), its serving thread calls the scope function, which calls
+/// serve_fn: the interaction function (or batch handler) is then called for each request as usual, until it returns <= 0.
+/// The connection is closed once the scope function returns, whether serve_fn was called or not.
+/// @param scope_fn Connection scope function, NULL to serve requests straight away (default).
+C_SERVER_SOCKET_API void ServerSocketSetConnectionScope(SERVER_SOCKET_SCOPE_FN scope_fn);
+
+/// @brief Logs an error which made a connection's handler give up (e.g. an exception thrown by a C++ handler), rate limited
+/// like every other per-connection message. Closing the connection is up to the caller.
+/// @param client_socket Client socket.
+/// @param reason What went wrong.
+C_SERVER_SOCKET_API void ServerSocketReportHandlerError(int client_socket, const char* reason);
+
+/// @brief Sets transport compression parameters. To be called before ServerSocketRun.
+/// Connections opt in by calling ServerSocketEnableCompression.
+/// @param level zlib compression level, from 1 (fastest) to 9 (smallest), -1 for zlib's default (6).
+/// @param min_size Writes smaller than this are sent uncompressed (128 bytes by default).
+C_SERVER_SOCKET_API void ServerSocketSetCompression(int level, unsigned long min_size);
+
+/// @brief Sets the response cache up. To be called before ServerSocketRun.
+/// Responses are stored by handlers (ServerSocketCacheStore) and kept in 16 independently locked shards, each one evicting
+/// its entries with CLOCK (an approximation of LRU which only sets a flag on hits) once its part of the budget is used up.
+/// @param max_bytes Memory budget (responses, keys and bookkeeping), 0 to disable the cache (default).
+/// @param ttl_ms Time responses are valid for, 0 to keep them until evicted or invalidated.
+C_SERVER_SOCKET_API void ServerSocketSetResponseCache(unsigned long max_bytes, unsigned long ttl_ms);
+
+/// @brief Sets shared-memory transport parameters. To be called before ServerSocketRun.
+/// Co-located connections opt in by calling ServerSocketEnableSharedMemory.
+/// @param ring_size Size of each ring (one per direction), rounded up to a power of two and to at least a memory page,
+/// 0 to disable the shared-memory transport (default).
+/// @param spin_us Time an empty (or full) ring is polled for before parking on its futex (20us by default, never on single-CPU hosts).
+C_SERVER_SOCKET_API void ServerSocketSetSharedMemory(unsigned long ring_size, unsigned long spin_us);
+
+/// @brief Sets broadcasting up. To be called before ServerSocketRun.
+/// Serving threads then wait for client data with ppoll instead of blocking reads, so they can be woken up (SIGURG)
+/// to write queued broadcasts. SIGURG is therefore taken over by the library.
+/// @param max_queued_bytes Bytes queued per connection (64 buffers at most), 0 to disable broadcasting (default).
+C_SERVER_SOCKET_API void ServerSocketSetBroadcast(unsigned long max_queued_bytes);
+
+/// @brief Sets socket buffer auto-tuning up. To be called before ServerSocketRun.
+/// Each connection is sampled (TCP_INFO) once it has transferred about a send buffer's worth of bytes and after each
+/// interaction, no more often than the sampling period. Its send buffer is then sized to twice its bandwidth-delay product,
+/// and its receive buffer to twice the largest of that and what the client sends per round trip, growing right away but only
+/// shrinking once they are twice too big. Buffers set this way are no longer tuned by the kernel, and are capped by
+/// net.core.wmem_max / rmem_max unless the process has CAP_NET_ADMIN.
+/// @param min_bytes Smallest buffer size.
+/// @param max_bytes Largest buffer size, 0 to disable auto-tuning (default).
+/// @param sample_ms Minimum time between two samples of the same connection.
+C_SERVER_SOCKET_API void ServerSocketSetBufferTuning(unsigned long min_bytes, unsigned long max_bytes, unsigned long sample_ms);
+
+/// @brief Sets the unsent data low-water mark of client sockets (TCP_NOTSENT_LOWAT). To be called before ServerSocketRun.
+/// The kernel then reports sockets writable only once their unsent data fell below it, and ServerSocketWrite feeds it that
+/// much at a time, waiting for writability in between, so large writes no longer fill send buffers with megabytes of data.
+/// Queued broadcasts (ServerSocketWriteUrgent included) are written before each ServerSocketWrite rather than only between
+/// interactions, so protocols are expected to write each message with a single call. Other writes (batch responses,
+/// compressed connections) are left to the kernel, whose blocking writes keep unsent data under the mark as well.
+/// @param lowat Unsent bytes the kernel holds per connection, at most, 0 to disable (default).
+C_SERVER_SOCKET_API void ServerSocketSetNotSentLowat(unsigned long lowat);
+
+/// @brief Sets TCP zero-copy receive up (see ServerSocketReadZeroCopy). To be called before ServerSocketRun.
+/// Each plain connection reading that way maps an address range on its socket, received pages being mapped into it instead
+/// of being copied. Pages are only mapped when the network card delivers payload in whole pages (e.g. header split, or a
+/// sender using MSG_ZEROCOPY from page-aligned buffers on loopback). Mapped pages stop counting against the receive buffer.
+/// @param window_size Address range mapped per connection (rounded up to whole pages, clamped to the largest whole pages under
+/// 2GB), so the largest mapped view, 0 to disable (default).
+/// @param min_size Reads meant to deliver less than this are copied, SERVER_SOCKET_ZEROCOPY_MIN_SIZE being where mapping was
+/// measured to beat copying.
+C_SERVER_SOCKET_API void ServerSocketSetZeroCopyReceive(unsigned long window_size, unsigned long min_size);
+
+/// @brief Sets deferred close up. To be called before ServerSocketRun.
+/// Serving threads then give their slot back and hand their connection over to a reaper thread once it is over, instead of
+/// freeing its SSL object and closing it themselves. The reaper sends TLS clients a close_notify and waits for theirs
+/// (without blocking, up to shutdown_ms), then frees SSL objects and closes descriptors in batches. Descriptors stay open
+/// until then, so they cannot be reused meanwhile.
+/// @param deferred True to tear connections down on the reaper thread, false to do it on serving threads (default).
+/// @param shutdown_ms Time TLS connections wait for the client's close_notify, 0 to only send ours.
+/// @param linger_s Time connections wait for their unsent data to be acknowledged once their write side is shut down (as
+/// SO_LINGER would, but without blocking the reaper), being reset afterwards, 0 to reset connections instead of closing them
+/// gracefully, < 0 to keep system defaults.
+C_SERVER_SOCKET_API void ServerSocketSetDeferredClose(bool deferred, unsigned long shutdown_ms, int linger_s);
+
+/// @brief Sets a connection priority class up. To be called before ServerSocketRun.
+/// Connections are classified once accepted, by the classifier (see ServerSocketSetPriorityClassifier), then by peer address
+/// rules (see ServerSocketAddPriorityRule), falling back to class 0. Connections whose class is full are refused, so
+/// limiting bulk classes keeps server instances free for the others.
+/// @param class_id Class, from 0 to SERVER_SOCKET_PRIORITY_CLASSES - 1.
+/// @param weight Share of run slots the class gets while others wait for them too (1 by default, see ServerSocketSetPriorityScheduling).
+/// @param max_conn Connections the class may hold at once, 0 for no limit other than the server's (default).
+/// @return 0 if succeeded, < 0 if the class does not exist or the weight is 0.
+C_SERVER_SOCKET_API int ServerSocketSetPriorityClass(int class_id, unsigned int weight, int max_conn);
+
+/// @brief Adds a peer address rule, rules being matched in the order they were added. To be called before ServerSocketRun.
+/// @param peer_cidr IPv4 network in CIDR notation ("10.1.0.0/16"), a single address if no prefix length is given.
+/// @param class_id Class connections from that network belong to.
+/// @return 0 if succeeded, < 0 if the class does not exist, the network is malformed or there are too many rules (64).
+C_SERVER_SOCKET_API int ServerSocketAddPriorityRule(const char* peer_cidr, int class_id);
+
+/// @brief Sets a connection classifier, checked before peer address rules. To be called before ServerSocketRun.
+/// It runs on the accepting thread, so it is meant to be quick (e.g. telling listening ports or peer ports apart).
+/// @param classifier_fn Classifier returning the connection's class, < 0 to leave it to peer address rules.
+/// NULL to rely on peer address rules only (default).
+C_SERVER_SOCKET_API void ServerSocketSetPriorityClassifier(int (*classifier_fn)(int client_socket));
+
+/// @brief Sets weighted fair scheduling of interactions up. To be called before ServerSocketRun.
+/// Each interaction function call takes a run slot once its request shows up, so connections waiting for their clients never
+/// hold one. Once every slot is taken, they are handed over to waiting classes in proportion to their weights (stride
+/// scheduling), oldest request first within each class, so bulk classes absorb overload while others keep their latency.
+/// Slots are held for the whole call, so interaction functions are not meant to wait for their clients in the middle of it.
+/// Low-latency connections (see ServerSocketEnableLowLatency) are never held back.
+/// @param run_slots Interactions running at once (e.g. the amount of CPUs), 0 not to schedule them (default).
+C_SERVER_SOCKET_API void ServerSocketSetPriorityScheduling(unsigned int run_slots);
+
+/// @brief Sets low-latency mode parameters. To be called before ServerSocketRun.
+/// Connections opt in by calling ServerSocketEnableLowLatency, trading a whole CPU each for lower wake-up latency.
+/// @param spin_us Time reads spin for before blocking, 0 to disable low-latency mode (default).
+/// @param first_cpu First CPU dedicated to spinning threads.
+/// @param cpus_num Amount of dedicated CPUs (one per low-latency connection), 0 not to pin spinning threads.
+C_SERVER_SOCKET_API void ServerSocketSetLowLatency(unsigned long spin_us, int first_cpu, int cpus_num);
+
+/// @brief Sets CPU affinity. To be called before ServerSocketRun.
+/// Each serving thread is created on the CPU (or NUMA node) which processed its connection's packets, so request data
+/// does not move between cores. If the port is shared (reuse_port) and the accepting thread is pinned, connections are
+/// also steered to the listener whose index (listeners being opened in CPU order, one per CPU) matches their CPU.
+/// @param policy Where serving threads are meant to run (SERVER_SOCKET_AFFINITY_NONE by default).
+/// @param accept_cpu CPU the accepting thread is meant to be pinned to, < 0 not to pin it (default).
+C_SERVER_SOCKET_API void ServerSocketSetCPUAffinity(SERVER_SOCKET_AFFINITY policy, int accept_cpu);
+
+/// @brief Enables hot restart. To be called before ServerSocketRun.
+/// A server started with the same path while another one is running takes its listening socket over (SCM_RIGHTS),
+/// so no connection is refused. Once the new server accepts connections, the old one stops accepting them and lets
+/// active ones end on their own up to a deadline, shutting the remaining ones down afterwards.
+/// @param path UNIX socket path used to hand the listening socket over (only processes owned by the same user are served),
+/// NULL to disable hot restart (default).
+/// @param drain_timeout_ms Maximum time for active connections to end on their own once a successor took over.
+C_SERVER_SOCKET_API void ServerSocketSetHotRestart(const char* path, unsigned long drain_timeout_ms);
+
+/// @brief Tells whether the server is draining, so interaction functions can end connections at request boundaries.
+/// @return True if a successor took over and no more connections are being accepted, false otherwise.
+C_SERVER_SOCKET_API bool ServerSocketIsDraining(void);
+
+/// @brief Sets per-connection deadlines. To be called before ServerSocketRun.
+/// Expired connections are shut down, so their serving thread wakes up and closes them. Deadlines are tracked by a
+/// hierarchical timer wheel on a dedicated thread, so re-arming them on every read or write costs a single store.
+/// @param idle_ms Maximum time without successful reads or writes, 0 to disable it (default).
+/// @param handshake_ms Maximum TLS handshake duration, 0 to disable it (default).
+/// @param request_ms Maximum duration of a single interaction function call, 0 to disable it (default).
+C_SERVER_SOCKET_API void ServerSocketSetTimeouts(unsigned long idle_ms, unsigned long handshake_ms, unsigned long request_ms);
+
+/// @brief Retrieves TLS memory usage figures.
+/// @param p_mem_stats Target structure to which figures are meant to be copied.
+/// @return 0 if succeeded, < 0 if OpenSSL heap accounting is not available.
+C_SERVER_SOCKET_API int ServerSocketGetMemStats(SERVER_SOCKET_MEM_STATS* p_mem_stats);
+
+/// @brief Retrieves a priority class' figures. Can be called at any time without stopping traffic.
+/// @param class_id Class.
+/// @param p_priority_stats Target structure to which figures are meant to be copied.
+/// @return 0 if succeeded, < 0 if the class does not exist.
+C_SERVER_SOCKET_API int ServerSocketGetPriorityStats(int class_id, SERVER_SOCKET_PRIORITY_STATS* p_priority_stats);
+
+/// @brief Retrieves server runtime statistics. Can be called at any time without stopping traffic.
+/// @param p_stats Target structure to which statistics are meant to be copied.
+/// @return 0 if succeeded, < 0 otherwise.
+C_SERVER_SOCKET_API int ServerSocketGetStats(SERVER_SOCKET_STATS* p_stats);
+
 /// @brief Runs server socket.
 /// @param server_port Port server is meant to be listening to.
 /// @param max_conn_num Maximum number of connections.
@@ -91,4 +727,263 @@ C_SERVER_SOCKET_API int ServerSocketRun(int             server_port
 }
 #endif
 
+/*************************************/
+/*********** C++ front-end ***********/
+/*************************************/
+
+// Header-only, C++17 or newer. The C core still calls a single interaction function per request (deadlines, priority
+// scheduling and stats hang on that call), but that function is instantiated for each handler and transport, so both the
+// handler and the transport are called directly and can be inlined instead of going through further function pointers.
+// PlainTransport and TlsTransport pick read/send or SSL_read/SSL_write at compile time, with no per-call transport checks.
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <exception>
+#include <string_view>
+#include <type_traits>
+#include <unistd.h>
+
+#ifdef __GLIBCXX__
+#include <cxxabi.h>     // Thread cancellation unwinds serving threads' stacks, which must not be swallowed.
+#endif
+
+namespace ServerSocket
+{
+
+/// @brief Transport going through ServerSocketRead / ServerSocketWrite, which check at run time which of the optional
+/// features (compression, shared memory, broadcasts, low-water mark, busy polling, TLS low-memory waits) the connection
+/// uses. Meant for handlers enabling any of them, PlainTransport or TlsTransport being faster otherwise.
+/// @tparam Secure Whether connections are TLS ones, only passed on to ServerSocketRun.
+template<bool Secure>
+struct LibraryTransport
+{
+    static constexpr bool secure = Secure;
+
+    static int Read(int client_socket, char* rx_buffer, unsigned long rx_buffer_size)
+    {
+        return ServerSocketRead(client_socket, rx_buffer, rx_buffer_size);
+    }
+
+    static int Write(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size)
+    {
+        return ServerSocketWrite(client_socket, tx_buffer, tx_buffer_size);
+    }
+};
+
+/// @brief Plain transport calling read / send straight away (see ServerSocketReadPlain). Bytes are accounted in stats and
+/// push idle deadlines forward, but optional features are not checked for (see LibraryTransport).
+struct PlainTransport
+{
+    static constexpr bool secure = false;
+
+    static int Read(int client_socket, char* rx_buffer, unsigned long rx_buffer_size)
+    {
+        return ServerSocketReadPlain(client_socket, rx_buffer, rx_buffer_size);
+    }
+
+    static int Write(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size)
+    {
+        return ServerSocketWritePlain(client_socket, tx_buffer, tx_buffer_size);
+    }
+};
+
+/// @brief TLS transport calling SSL_read / SSL_write on the connection's SSL object straight away (see
+/// ServerSocketReadTLS). Same accounting and restrictions as PlainTransport.
+struct TlsTransport
+{
+    static constexpr bool secure = true;
+
+    static int Read(int client_socket, char* rx_buffer, unsigned long rx_buffer_size)
+    {
+        return ServerSocketReadTLS(client_socket, rx_buffer, rx_buffer_size);
+    }
+
+    static int Write(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size)
+    {
+        return ServerSocketWriteTLS(client_socket, tx_buffer, tx_buffer_size);
+    }
+};
+
+/// @brief Plain transport reading and writing the socket straight away, with none of the per-call checks the library
+/// wrappers make. Bytes are not accounted in stats and reads / writes do not push idle deadlines forward (request and
+/// connection deadlines still apply), and it is not meant to be used along with compression, shared memory, broadcasts,
+/// the low-water mark, busy polling or framing.
+struct RawTransport
+{
+    static constexpr bool secure = false;
+
+    static int Read(int client_socket, char* rx_buffer, unsigned long rx_buffer_size)
+    {
+        return (int)::read(client_socket, rx_buffer, rx_buffer_size);
+    }
+
+    static int Write(int client_socket, const char* tx_buffer, unsigned long tx_buffer_size)
+    {
+        return (int)::write(client_socket, tx_buffer, tx_buffer_size);
+    }
+};
+
+/// @brief Client connection handed over to handlers. Any C API function may still be called on Socket().
+/// @tparam Transport Transport policy.
+template<typename Transport>
+class Connection
+{
+public:
+    explicit Connection(int client_socket) : client_socket(client_socket) {}
+
+    /// @brief Client socket.
+    int Socket() const { return client_socket; }
+
+    /// @brief Reads from client socket (see ServerSocketRead).
+    /// @return > 0 equaling the amount of bytes read, 0 if client got disconnected, < 0 if any error happened.
+    int Read(char* rx_buffer, unsigned long rx_buffer_size) const
+    {
+        return Transport::Read(client_socket, rx_buffer, rx_buffer_size);
+    }
+
+    template<std::size_t N>
+    int Read(char (&rx_buffer)[N]) const
+    {
+        return Read(rx_buffer, N);
+    }
+
+    /// @brief Writes to client socket (see ServerSocketWrite).
+    /// @return < 0 if any error happens, number of bytes sent otherwise.
+    int Write(const char* tx_buffer, unsigned long tx_buffer_size) const
+    {
+        return Transport::Write(client_socket, tx_buffer, tx_buffer_size);
+    }
+
+    int Write(std::string_view data) const
+    {
+        return Write(data.data(), data.size());
+    }
+
+private:
+    int client_socket;
+};
+
+/// @brief ServerSocketRun parameters, but for the secure flag (set by the transport) and the interaction function.
+struct ServerOptions
+{
+    int             port            = 0;
+    int             max_conn_num    = 1024;
+    bool            concurrent      = true;
+    bool            non_blocking    = false;
+    bool            reuse_address   = true;
+    bool            reuse_port      = false;
+    unsigned long   rx_timeout_s    = 0;
+    unsigned long   rx_timeout_us   = 0;
+    unsigned long   tx_timeout_s    = 0;
+    unsigned long   tx_timeout_us   = 0;
+    const char*     cert_path       = nullptr;
+    const char*     pkey_path       = nullptr;
+};
+
+/// @brief Server specialized at compile time for a handler and a transport.
+/// @tparam Handler Default-constructible type called as int(Connection<Transport>&) once per request, returning > 0 if
+/// interaction is meant to go on, <= 0 to close the connection. Each connection gets its own instance, living on its
+/// serving thread's stack (see ServerSocketSetConnectionScope) from the end of the handshake until the connection is closed.
+/// An exception leaving the handler (or its constructor) is logged (see ServerSocketReportHandlerError), then the
+/// connection is closed.
+/// @tparam Transport Transport policy (PlainTransport, TlsTransport, LibraryTransport or RawTransport).
+template<typename Handler, typename Transport = PlainTransport>
+class Server
+{
+    static_assert(std::is_default_constructible_v<Handler>, "Handler must be default-constructible.");
+    static_assert(std::is_invocable_r_v<int, Handler&, Connection<Transport>&>, "Handler must be callable as int(Connection<Transport>&).");
+
+public:
+    /// @brief Runs the server (see ServerSocketRun). Optional settings (ServerSocketSet*) are meant to be called before,
+    /// but for the connection scope, which is set here.
+    /// @param options Server options.
+    /// @return 0 always, exit sending failure signal if SIGINT signal handler could not be properly set.
+    static int Run(const ServerOptions& options)
+    {
+        ServerSocketSetConnectionScope(Scope);
+
+        return ServerSocketRun(options.port, options.max_conn_num, options.concurrent, options.non_blocking,
+                               options.reuse_address, options.reuse_port, options.rx_timeout_s, options.rx_timeout_us,
+                               options.tx_timeout_s, options.tx_timeout_us, Transport::secure, options.cert_path,
+                               options.pkey_path, Interact);
+    }
+
+    /// @brief Connection scope handed over to the C core (see ServerSocketSetConnectionScope): the connection's handler is
+    /// constructed on the serving thread's stack, then serves every request of the connection.
+    /// @param client_socket Client socket.
+    /// @param serve_fn Function serving every request of the connection.
+    /// @param p_serve_args Arguments to be passed on to serve_fn.
+    static void Scope(int client_socket, void (*serve_fn)(void* p_serve_args), void* p_serve_args)
+    {
+        try
+        {
+            Handler handler;
+
+            p_handler = &handler;
+            serve_fn(p_serve_args);
+        }
+#ifdef __GLIBCXX__
+        catch(abi::__forced_unwind&)
+        {
+            p_handler = nullptr;
+            throw;
+        }
+#endif
+        catch(const std::exception& exception)
+        {
+            ServerSocketReportHandlerError(client_socket, exception.what());
+        }
+        catch(...)
+        {
+            ServerSocketReportHandlerError(client_socket, "unknown exception");
+        }
+
+        // Returning closes the connection, whether requests were served or not.
+        p_handler = nullptr;
+    }
+
+    /// @brief Interaction function handed over to the C core, as ServerSocketRun's last parameter.
+    /// @param client_socket Client socket.
+    /// @return Handler's result, 0 if it threw (or if there is no handler), which closes the connection.
+    static int Interact(int client_socket)
+    {
+        if(!p_handler)
+            return 0;
+
+        Connection<Transport> connection(client_socket);
+
+        try
+        {
+            return (*p_handler)(connection);
+        }
+#ifdef __GLIBCXX__
+        catch(abi::__forced_unwind&)
+        {
+            throw;
+        }
+#endif
+        catch(const std::exception& exception)
+        {
+            ServerSocketReportHandlerError(client_socket, exception.what());
+            return 0;
+        }
+        catch(...)
+        {
+            ServerSocketReportHandlerError(client_socket, "unknown exception");
+            return 0;
+        }
+    }
+
+private:
+    /// @brief Handler of the connection served by the current thread, owned by Scope's stack frame.
+    static inline thread_local Handler* p_handler = nullptr;
+};
+
+} // namespace ServerSocket
+
+#endif
+
+/*************************************/
+
 #endif
\ No newline at end of file
@@ -99,6 +99,22 @@
 #define SECURE_CONN_DETAIL                  "Secure connection."
 #define SECURE_CONN_DEFAULT_VALUE           false
 
+/********* Low-memory TLS *********/
+
+#define LOW_MEMORY_CHAR                     'l'
+#define LOW_MEMORY_LONG                     "LowMemory"
+#define LOW_MEMORY_DETAIL                   "TLS low-memory mode."
+#define LOW_MEMORY_DEFAULT_VALUE            false
+
+/************ Metrics port ************/
+
+#define METRICS_PORT_OPT_CHAR               'e'
+#define METRICS_PORT_OPT_LONG               "MetricsPort"
+#define METRICS_PORT_OPT_DETAIL             "Metrics port (0 disables metrics)."
+#define METRICS_PORT_MIN_VALUE              0
+#define METRICS_PORT_MAX_VALUE              65535
+#define METRICS_PORT_DEFAULT_VALUE          0
+
 /********* Certificate and private key path *********/
 
 /************ Server certificate ************/
@@ -139,6 +155,8 @@ int main(int argc, char** argv)
     int tx_timeout_s            ;
     int tx_timeout_us           ;
     bool secure_connection      ;
+    bool low_memory             ;
+    int metrics_port            ;
     char* path_cert = calloc(100, 1);
     char* path_pkey = calloc(100, 1);
 
@@ -220,6 +238,20 @@ int main(int argc, char** argv)
                                 SECURE_CONN_DEFAULT_VALUE           ,
                                 &secure_connection                  );
 
+    SetOptionDefinitionBool(    LOW_MEMORY_CHAR                     ,
+                                LOW_MEMORY_LONG                     ,
+                                LOW_MEMORY_DETAIL                   ,
+                                LOW_MEMORY_DEFAULT_VALUE            ,
+                                &low_memory                         );
+
+    SetOptionDefinitionInt(     METRICS_PORT_OPT_CHAR               ,
+                                METRICS_PORT_OPT_LONG               ,
+                                METRICS_PORT_OPT_DETAIL             ,
+                                METRICS_PORT_MIN_VALUE              ,
+                                METRICS_PORT_MAX_VALUE              ,
+                                METRICS_PORT_DEFAULT_VALUE          ,
+                                &metrics_port                       );
+
     SetOptionDefinitionStringNL(CERT_OPT_CHAR                       ,
                                 CERT_OPT_LONG                       ,
                                 CERT_OPT_DETAIL                     ,
@@ -241,6 +273,10 @@ int main(int argc, char** argv)
 
     SVRTY_LOG_INF("Arguments successfully parsed!");
 
+    ServerSocketSetTLSMemAccounting(true);
+    ServerSocketSetTLSLowMemory(low_memory);
+    ServerSocketSetMetricsPort(metrics_port);
+
     ServerSocketRun(server_port         ,
                     max_clients_num     ,
                     concurrency_enabled ,